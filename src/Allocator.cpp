@@ -0,0 +1,286 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include "Allocator.hpp"
+#include "Context.hpp"
+#include "concurrent.hpp"
+
+using namespace kanzi;
+using namespace std;
+
+
+void MemoryUsage::reset()
+{
+    for (int i = 0; i < NB_STAGES; i++) {
+        _current[i] = 0;
+        _peak[i] = 0;
+        _allocated[i] = 0;
+        _allocations[i] = 0;
+    }
+
+    _currentTotal = 0;
+    _peakTotal = 0;
+}
+
+void MemoryUsage::restart()
+{
+    for (int i = 0; i < NB_STAGES; i++) {
+        _peak[i] = _current[i];
+        _allocated[i] = 0;
+        _allocations[i] = 0;
+    }
+
+    _peakTotal = _currentTotal;
+}
+
+void MemoryUsage::add(int stage, int64 size)
+{
+    _current[stage] += size;
+    _allocated[stage] += size;
+    _allocations[stage]++;
+    _currentTotal += size;
+
+    if (_current[stage] > _peak[stage])
+        _peak[stage] = _current[stage];
+
+    if (_currentTotal > _peakTotal)
+        _peakTotal = _currentTotal;
+}
+
+void MemoryUsage::remove(int stage, int64 size)
+{
+    _current[stage] -= size;
+    _currentTotal -= size;
+}
+
+const char* MemoryUsage::getStageName(int stage)
+{
+    switch (stage) {
+    case STREAM:
+        return "stream";
+
+    case TRANSFORM:
+        return "transform";
+
+    case ENTROPY:
+        return "entropy";
+
+    default:
+        return "unknown";
+    }
+}
+
+
+Allocator& Allocator::getAllocator(const Context& ctx)
+{
+    if (ctx.getAllocator() != nullptr)
+        return *ctx.getAllocator();
+
+    return getDefault(ctx.getInt("hugePages", 0) != 0);
+}
+
+Allocator& Allocator::getDefault(bool hugePages)
+{
+    static DefaultAllocator defaultAllocator(false);
+    static DefaultAllocator hugePagesAllocator(true);
+    return (hugePages == true) ? hugePagesAllocator : defaultAllocator;
+}
+
+
+#ifdef MEMORY_TRACKING
+
+namespace {
+    class Allocation {
+    public:
+        int64 _size;
+        int _stage;
+        uint64 _scopeId; // 0 if allocated outside of a block scope
+    };
+
+    // Process wide state (function statics: no dependency on initialization order)
+    class TrackerState {
+    public:
+        map<const void*, Allocation> _allocations;
+        MemoryUsage _usage;
+        uint64 _nextScopeId;
+#ifdef CONCURRENCY_ENABLED
+        mutex _mutex;
+#endif
+
+        TrackerState() : _nextScopeId(1) {}
+    };
+
+    TrackerState& getState()
+    {
+        static TrackerState state;
+        return state;
+    }
+
+#ifdef CONCURRENCY_ENABLED
+    thread_local MemoryTracker::BlockScope* currentScope = nullptr;
+#else
+    MemoryTracker::BlockScope* currentScope = nullptr;
+#endif
+}
+
+
+MemoryTracker::BlockScope::BlockScope()
+{
+    TrackerState& state = getState();
+
+    {
+#ifdef CONCURRENCY_ENABLED
+        lock_guard<mutex> lock(state._mutex);
+#endif
+        _id = state._nextScopeId++;
+    }
+
+    _previous = currentScope;
+    currentScope = this;
+}
+
+MemoryTracker::BlockScope::~BlockScope()
+{
+    currentScope = _previous;
+}
+
+MemoryTracker::TaskScope::TaskScope(BlockScope* scope)
+{
+    _previous = currentScope;
+    currentScope = scope;
+}
+
+MemoryTracker::TaskScope::~TaskScope()
+{
+    currentScope = _previous;
+}
+
+bool MemoryTracker::isEnabled()
+{
+    return true;
+}
+
+void MemoryTracker::getUsage(MemoryUsage& usage)
+{
+    TrackerState& state = getState();
+#ifdef CONCURRENCY_ENABLED
+    lock_guard<mutex> lock(state._mutex);
+#endif
+    usage = state._usage;
+}
+
+void MemoryTracker::restart()
+{
+    TrackerState& state = getState();
+#ifdef CONCURRENCY_ENABLED
+    lock_guard<mutex> lock(state._mutex);
+#endif
+    state._usage.restart();
+}
+
+bool MemoryTracker::getBlockUsage(MemoryUsage& usage)
+{
+    if (currentScope == nullptr)
+        return false;
+
+#ifdef CONCURRENCY_ENABLED
+    lock_guard<mutex> lock(getState()._mutex);
+#endif
+    usage = currentScope->_usage;
+    return true;
+}
+
+MemoryTracker::BlockScope* MemoryTracker::getBlockScope()
+{
+    return currentScope;
+}
+
+void MemoryTracker::onAllocate(const void* ptr, size_t size, int stage)
+{
+    TrackerState& state = getState();
+    Allocation a;
+    a._size = int64(size);
+    a._stage = stage;
+    a._scopeId = (currentScope == nullptr) ? 0 : currentScope->_id;
+
+#ifdef CONCURRENCY_ENABLED
+    lock_guard<mutex> lock(state._mutex); // the scope may be shared by sub-tasks
+#endif
+    state._allocations[ptr] = a;
+    state._usage.add(stage, a._size);
+
+    if (currentScope != nullptr)
+        currentScope->_usage.add(stage, a._size);
+}
+
+void MemoryTracker::onDeallocate(const void* ptr)
+{
+    if (ptr == nullptr)
+        return;
+
+    TrackerState& state = getState();
+#ifdef CONCURRENCY_ENABLED
+    lock_guard<mutex> lock(state._mutex);
+#endif
+    map<const void*, Allocation>::iterator it = state._allocations.find(ptr);
+
+    if (it == state._allocations.end())
+        return;
+
+    const Allocation a = it->second;
+    state._allocations.erase(it);
+    state._usage.remove(a._stage, a._size);
+
+    // Only count the memory released in the scope that allocated it
+    if ((currentScope != nullptr) && (currentScope->_id == a._scopeId))
+        currentScope->_usage.remove(a._stage, a._size);
+}
+
+#else
+
+bool MemoryTracker::isEnabled()
+{
+    return false;
+}
+
+void MemoryTracker::getUsage(MemoryUsage& usage)
+{
+    usage.reset();
+}
+
+void MemoryTracker::restart()
+{
+}
+
+bool MemoryTracker::getBlockUsage(MemoryUsage&)
+{
+    return false;
+}
+
+MemoryTracker::BlockScope* MemoryTracker::getBlockScope()
+{
+    return nullptr;
+}
+
+void MemoryTracker::onAllocate(const void*, size_t, int)
+{
+}
+
+void MemoryTracker::onDeallocate(const void*)
+{
+}
+
+#endif
@@ -0,0 +1,293 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef _Allocator_
+#define _Allocator_
+
+#include <cstddef>
+#include <new>
+#include "Memory.hpp"
+#include "types.hpp"
+
+namespace kanzi
+{
+
+   // Memory allocated by the streams, transforms and entropy codecs
+   class MemoryUsage {
+   public:
+       enum Stage {
+           STREAM,
+           TRANSFORM,
+           ENTROPY
+       };
+
+       static const int NB_STAGES = 3;
+
+       int64 _current[NB_STAGES]; // bytes currently allocated
+       int64 _peak[NB_STAGES]; // max of _current
+       int64 _allocated[NB_STAGES]; // cumulated bytes allocated
+       int64 _allocations[NB_STAGES]; // number of allocations
+       int64 _currentTotal; // all stages
+       int64 _peakTotal; // max of _currentTotal
+
+       MemoryUsage() { reset(); }
+
+       void reset();
+
+       // Restart the peaks from the current values and clear the cumulated counters
+       void restart();
+
+       void add(int stage, int64 size);
+
+       void remove(int stage, int64 size);
+
+       static const char* getStageName(int stage);
+   };
+
+
+   // Record the allocations made with allocate() when
+   // MEMORY_TRACKING is defined (make MEMORY_TRACKING=1). Otherwise, nothing
+   // is recorded and the allocation functions reduce to new[] and delete[].
+   // The counters are process wide. The allocations made by a thread while a
+   // BlockScope is active are also attributed to the scope (usage of a block).
+   // The sub-tasks of a block run by other threads share the scope of the block
+   // with a TaskScope.
+   class MemoryTracker {
+   public:
+       class BlockScope {
+       public:
+#ifdef MEMORY_TRACKING
+           BlockScope();
+
+           ~BlockScope();
+#else
+           BlockScope() {}
+
+           ~BlockScope() {}
+#endif
+
+           const MemoryUsage& getUsage() const { return _usage; }
+
+       private:
+           MemoryUsage _usage;
+           uint64 _id;
+           BlockScope* _previous;
+
+           friend class MemoryTracker;
+       };
+
+       // Attribute the allocations of the calling thread to the provided scope
+       // (captured with getBlockScope() by the thread that created the task)
+       class TaskScope {
+       public:
+#ifdef MEMORY_TRACKING
+           TaskScope(BlockScope* scope);
+
+           ~TaskScope();
+#else
+           TaskScope(BlockScope*) {}
+
+           ~TaskScope() {}
+#endif
+
+       private:
+           BlockScope* _previous;
+
+           TaskScope(const TaskScope&); // not copyable
+           TaskScope& operator=(const TaskScope&);
+       };
+
+       static bool isEnabled();
+
+       // Snapshot of the process wide usage
+       static void getUsage(MemoryUsage& usage);
+
+       // Restart the process wide peaks and cumulated counters (new run)
+       static void restart();
+
+       // Usage of the block scope of the calling thread. Return false if none.
+       static bool getBlockUsage(MemoryUsage& usage);
+
+       // Block scope of the calling thread (null if none)
+       static BlockScope* getBlockScope();
+
+       static void onAllocate(const void* ptr, size_t size, int stage);
+
+       // Ignore pointers not allocated by allocate()
+       static void onDeallocate(const void* ptr);
+
+   private:
+       MemoryTracker() {}
+       ~MemoryTracker() {}
+   };
+
+
+   // Allocate an array of n (default constructed) values. Release with deallocate().
+   template <class T>
+   inline T* allocate(size_t n, MemoryUsage::Stage stage)
+   {
+       T* p = new T[n];
+
+#ifdef MEMORY_TRACKING
+       MemoryTracker::onAllocate(p, n * sizeof(T), stage);
+#else
+       (void) stage;
+#endif
+       return p;
+   }
+
+   template <class T>
+   inline void deallocate(T* p)
+   {
+#ifdef MEMORY_TRACKING
+       MemoryTracker::onDeallocate(p);
+#endif
+       delete[] p;
+   }
+
+   // Buffer allocated with allocate() and released when going out of scope
+   // (no leak when an exception is thrown while the buffer is in use).
+   template <class T>
+   class ScopedBuffer {
+   public:
+       ScopedBuffer(size_t n, MemoryUsage::Stage stage) : _data(allocate<T>(n, stage)) {}
+
+       ~ScopedBuffer() { deallocate(_data); }
+
+       T* get() const { return _data; }
+
+       T& operator[](size_t i) const { return _data[i]; }
+
+   private:
+       T* _data;
+
+       ScopedBuffer(const ScopedBuffer&); // not copyable
+       ScopedBuffer& operator=(const ScopedBuffer&);
+   };
+
+   class Context;
+
+   // Allocator of the big buffers and tables (stream buffers, BWT, BWTS, LZ,
+   // ROLZ and TPAQ tables). A custom allocator (arena, pool, ...) can be set
+   // with Context::setAllocator(). It must outlive the streams that use it
+   // and be thread safe if blocks are processed concurrently (jobs > 1).
+   class Allocator {
+   public:
+       static const size_t CACHE_LINE_SIZE = 64;
+
+       virtual ~Allocator() {}
+
+       // Return a block of at least one byte aligned on 'alignment' (power of 2).
+       // Throw std::bad_alloc on failure.
+       virtual void* allocate(size_t size, size_t alignment) = 0;
+
+       virtual void deallocate(void* ptr) = 0;
+
+       // The allocator set in the context or else the default allocator
+       // (backed by huge pages if "hugePages" is set in the context).
+       static Allocator& getAllocator(const Context& ctx);
+
+       static Allocator& getDefault(bool hugePages = false);
+   };
+
+
+   // Blocks aligned on a cache line. With huge pages, the blocks of 2 MB or
+   // more are aligned on 2 MB and the kernel is asked to back them with huge
+   // pages to reduce TLB misses on big tables (Linux only, best effort).
+   class DefaultAllocator : public Allocator {
+   public:
+       DefaultAllocator(bool hugePages = false) : _hugePages(hugePages) {}
+
+       ~DefaultAllocator() {}
+
+       void* allocate(size_t size, size_t alignment) { return alignedAlloc(size, _hugePages, alignment); }
+
+       void deallocate(void* ptr) { alignedFree(ptr); }
+
+   private:
+       bool _hugePages;
+   };
+
+
+   // Adapter of C style allocation callbacks (see the C API). The callbacks
+   // return null on failure and may be called concurrently if jobs > 1.
+   class CallbackAllocator : public Allocator {
+   public:
+       typedef void* (*AllocateFunc)(void* opaque, size_t size, size_t alignment);
+       typedef void (*DeallocateFunc)(void* opaque, void* ptr);
+
+       CallbackAllocator(AllocateFunc allocate, DeallocateFunc deallocate, void* opaque)
+           : _allocate(allocate)
+           , _deallocate(deallocate)
+           , _opaque(opaque)
+       {
+       }
+
+       ~CallbackAllocator() {}
+
+       void* allocate(size_t size, size_t alignment)
+       {
+           void* ptr = _allocate(_opaque, size, alignment);
+
+           if (ptr == nullptr)
+               throw std::bad_alloc();
+
+           return ptr;
+       }
+
+       void deallocate(void* ptr) { _deallocate(_opaque, ptr); }
+
+   private:
+       AllocateFunc _allocate;
+       DeallocateFunc _deallocate;
+       void* _opaque;
+   };
+
+
+   // Allocate n values of a POD type (not initialized) with the provided allocator
+   // or with new[] if the allocator is null. Release with deallocate(allocator, p).
+   template <class T>
+   inline T* allocate(Allocator* allocator, size_t n, MemoryUsage::Stage stage)
+   {
+       if (allocator == nullptr)
+           return allocate<T>(n, stage);
+
+       T* p = static_cast<T*>(allocator->allocate((n == 0) ? 1 : n * sizeof(T), Allocator::CACHE_LINE_SIZE));
+
+#ifdef MEMORY_TRACKING
+       MemoryTracker::onAllocate(p, n * sizeof(T), stage);
+#endif
+       return p;
+   }
+
+   template <class T>
+   inline void deallocate(Allocator* allocator, T* p)
+   {
+       if (allocator == nullptr) {
+           deallocate(p);
+           return;
+       }
+
+       if (p == nullptr)
+           return;
+
+#ifdef MEMORY_TRACKING
+       MemoryTracker::onDeallocate(p);
+#endif
+       allocator->deallocate(p);
+   }
+}
+#endif
@@ -32,6 +32,7 @@ limitations under the License.
 
 namespace kanzi
 {
+   class Allocator;
 
    // Poor's man equivalent to std::variant used to support C++98 and up.
    // union cannot be used due to the std:string field.
@@ -53,17 +54,17 @@ namespace kanzi
 #ifdef CONCURRENCY_ENABLED
     #if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
        // Windows already has a built-in threadpool. Using it is better for performance.
-       Context(const ThreadPool*) { _pool = nullptr; }
-       Context(const Context& c, const ThreadPool*) : _map(c._map) { _pool = nullptr; }
-       Context() { _pool = nullptr; }
-       Context(const Context& c) : _map(c._map) { _pool = nullptr; }
+       Context(const ThreadPool*) : _allocator(nullptr) { _pool = nullptr; }
+       Context(const Context& c, const ThreadPool*) : _map(c._map), _allocator(c._allocator) { _pool = nullptr; }
+       Context() : _allocator(nullptr) { _pool = nullptr; }
+       Context(const Context& c) : _map(c._map), _allocator(c._allocator) { _pool = nullptr; }
     #else
-       Context(ThreadPool* p = nullptr) : _pool(p) {}
-       Context(const Context& c, ThreadPool* p = nullptr) : _map(c._map), _pool(p) {}
+       Context(ThreadPool* p = nullptr) : _allocator(nullptr), _pool(p) {}
+       Context(const Context& c, ThreadPool* p = nullptr) : _map(c._map), _allocator(c._allocator), _pool(p) {}
     #endif
 #else
-       Context() {}
-       Context(const Context& c) : _map(c._map) {}
+       Context() : _allocator(nullptr) {}
+       Context(const Context& c) : _map(c._map), _allocator(c._allocator) {}
 #endif
 
        bool has(const std::string& key) const;
@@ -78,8 +79,14 @@ namespace kanzi
        ThreadPool* getPool() const { return _pool; }
 #endif
 
+       // Allocator of the big buffers and tables (null: default allocator)
+       Allocator* getAllocator() const { return _allocator; }
+
+       void setAllocator(Allocator* allocator) { _allocator = allocator; }
+
    private:
        CTX_MAP<std::string, ContextVal> _map;
+       Allocator* _allocator;
 
 #ifdef CONCURRENCY_ENABLED
        ThreadPool* _pool;
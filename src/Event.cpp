@@ -16,10 +16,70 @@ limitations under the License.
 #include <iomanip>
 #include <ios>
 #include <sstream>
+#include "Allocator.hpp"
 #include "Event.hpp"
+#include "concurrent.hpp"
+
+#if __cplusplus >= 201103L || _MSC_VER >= 1700
+   #include <chrono>
+#endif
+
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+   #include <windows.h>
+#endif
 
 using namespace kanzi;
 
+
+EventTime::EventTime()
+{
+    _wallTime = wallTime();
+    _cpuTime = threadCpuTime();
+    _threadId = threadId();
+}
+
+int64 EventTime::wallTime()
+{
+#if __cplusplus >= 201103L || _MSC_VER >= 1700
+    return int64(std::chrono::duration_cast<std::chrono::nanoseconds>(
+       std::chrono::steady_clock::now().time_since_epoch()).count());
+#else
+    return int64(clock()) * (int64(1000000000) / CLOCKS_PER_SEC);
+#endif
+}
+
+int64 EventTime::threadCpuTime()
+{
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+    FILETIME creation, exit, kernel, user;
+
+    if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user) != 0) {
+        // 100 ns units
+        const uint64 k = (uint64(kernel.dwHighDateTime) << 32) | uint64(kernel.dwLowDateTime);
+        const uint64 u = (uint64(user.dwHighDateTime) << 32) | uint64(user.dwLowDateTime);
+        return int64(k + u) * 100;
+    }
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        return int64(ts.tv_sec) * 1000000000 + int64(ts.tv_nsec);
+#endif
+
+    // Process CPU time as fallback
+    return int64(clock()) * (int64(1000000000) / CLOCKS_PER_SEC);
+}
+
+uint64 EventTime::threadId()
+{
+#ifdef CONCURRENCY_ENABLED
+    return uint64(std::hash<std::thread::id>()(std::this_thread::get_id()));
+#else
+    return 0;
+#endif
+}
+
+
 Event::Event(Event::Type type, int id, int64 size, clock_t evtTime)
     : _type(type)
     , _time(evtTime)
@@ -28,6 +88,10 @@ Event::Event(Event::Type type, int id, int64 size, clock_t evtTime)
 {
     _hash = 0;
     _hashing = false;
+    _stage = -1;
+    _skipFlags = -1;
+    _copyBlock = false;
+    _memory = nullptr;
 }
 
 Event::Event(Event::Type type, int id, const std::string& msg, clock_t evtTime)
@@ -39,6 +103,10 @@ Event::Event(Event::Type type, int id, const std::string& msg, clock_t evtTime)
     _size = 0;
     _hash = 0;
     _hashing = false;
+    _stage = -1;
+    _skipFlags = -1;
+    _copyBlock = false;
+    _memory = nullptr;
 }
 
 Event::Event(Event::Type type, int id, int64 size, int hash, bool hashing, clock_t evtTime)
@@ -49,6 +117,41 @@ Event::Event(Event::Type type, int id, int64 size, int hash, bool hashing, clock
     , _hash(hash)
     , _hashing(hashing)
 {
+    _stage = -1;
+    _skipFlags = -1;
+    _copyBlock = false;
+    _memory = nullptr;
+}
+
+Event::Event(Event::Type type, int id, int64 size, int hash, bool hashing, clock_t evtTime,
+    const EventTime& stamp)
+    : _type(type)
+    , _time(evtTime)
+    , _stamp(stamp)
+    , _id(id)
+    , _size(size)
+    , _hash(hash)
+    , _hashing(hashing)
+{
+    _stage = -1;
+    _skipFlags = -1;
+    _copyBlock = false;
+    _memory = nullptr;
+}
+
+Event::Event(Event::Type type, int id, int64 size, int stage, const char* name)
+    : _type(type)
+    , _time(clock())
+    , _name(name)
+    , _id(id)
+    , _size(size)
+    , _stage(stage)
+{
+    _hash = 0;
+    _hashing = false;
+    _skipFlags = -1;
+    _copyBlock = false;
+    _memory = nullptr;
 }
 
 std::string Event::toString() const
@@ -64,6 +167,28 @@ std::string Event::toString() const
 
     ss << ", \"size\":" << getSize();
     ss << ", \"time\":" << getTime();
+    ss << ", \"wallTime\":" << getWallTime();
+    ss << ", \"cpuTime\":" << getCpuTime();
+    ss << ", \"thread\":" << getThreadId();
+
+    if (_stage >= 0) {
+        ss << ", \"stage\":" << getStage();
+        ss << ", \"name\":\"" << getName() << "\"";
+    }
+
+    if (_skipFlags >= 0)
+        ss << ", \"skipFlags\":" << _skipFlags;
+
+    if (_copyBlock == true)
+        ss << ", \"copy\":true";
+
+    if (_transform.length() > 0) {
+        ss << ", \"transform\":\"" << _transform << "\"";
+        ss << ", \"entropy\":\"" << _entropy << "\"";
+    }
+
+    if (_memory != nullptr)
+        ss << ", \"memoryPeak\":" << _memory->_peakTotal;
 
     if (_hashing == true) {
         ss << ", \"hash\":";
@@ -104,6 +229,30 @@ std::string Event::getTypeAsString() const
     case COMPRESSION_START:
         return "COMPRESSION_START";
 
+    case BEFORE_TRANSFORM_STAGE:
+        return "BEFORE_TRANSFORM_STAGE";
+
+    case AFTER_TRANSFORM_STAGE:
+        return "AFTER_TRANSFORM_STAGE";
+
+    case BEFORE_WAIT:
+        return "BEFORE_WAIT";
+
+    case AFTER_WAIT:
+        return "AFTER_WAIT";
+
+    case BEFORE_READ:
+        return "BEFORE_READ";
+
+    case AFTER_READ:
+        return "AFTER_READ";
+
+    case BEFORE_WRITE:
+        return "BEFORE_WRITE";
+
+    case AFTER_WRITE:
+        return "AFTER_WRITE";
+
     default:
         return "Unknown Type";
     }
@@ -24,6 +24,29 @@ limitations under the License.
 namespace kanzi
 {
 
+   class MemoryUsage;
+
+   // Time stamps captured when an event is created: monotonic wall clock
+   // time and CPU time consumed by the calling thread (both in nanoseconds)
+   // plus an identifier of the calling thread.
+   class EventTime {
+      public:
+          int64 _wallTime;
+          int64 _cpuTime;
+          uint64 _threadId;
+
+          EventTime();
+
+          // Monotonic wall clock time in nanoseconds
+          static int64 wallTime();
+
+          // CPU time used by the calling thread in nanoseconds
+          static int64 threadCpuTime();
+
+          // Identifier of the calling thread (0 if not available)
+          static uint64 threadId();
+   };
+
    class Event {
       public:
           enum Type {
@@ -35,7 +58,15 @@ namespace kanzi
               AFTER_ENTROPY,
               DECOMPRESSION_START,
               DECOMPRESSION_END,
-              AFTER_HEADER_DECODING
+              AFTER_HEADER_DECODING,
+              BEFORE_TRANSFORM_STAGE,
+              AFTER_TRANSFORM_STAGE,
+              BEFORE_WAIT, // wait for the previous block
+              AFTER_WAIT,
+              BEFORE_READ, // block (id >= 0) or file (id < 0) read
+              AFTER_READ,
+              BEFORE_WRITE, // block (id >= 0) or file (id < 0) write
+              AFTER_WRITE
           };
 
           Event(Type type, int id, const std::string& msg, clock_t evtTime);
@@ -44,6 +75,12 @@ namespace kanzi
 
           Event(Type type, int id, int64 size, int hash, bool hashing, clock_t evtTime);
 
+          Event(Type type, int id, int64 size, int hash, bool hashing, clock_t evtTime,
+              const EventTime& stamp);
+
+          // Event for one transform (at index 'stage') of a transform sequence
+          Event(Type type, int id, int64 size, int stage, const char* name);
+
           ~Event() {}
 
           int getId() const { return _id; }
@@ -58,16 +95,64 @@ namespace kanzi
 
           int getHash() const { return _hashing ? _hash : 0; }
 
+          int64 getWallTime() const { return _stamp._wallTime; }
+
+          int64 getCpuTime() const { return _stamp._cpuTime; }
+
+          uint64 getThreadId() const { return _stamp._threadId; }
+
+          int getStage() const { return _stage; }
+
+          const std::string& getName() const { return _name; }
+
+          // Transform skip flags of the block (-1 if not provided)
+          int getSkipFlags() const { return _skipFlags; }
+
+          // True if the block is stored without transform and entropy coding
+          bool isCopyBlock() const { return _copyBlock; }
+
+          void setBlockMode(int skipFlags, bool copyBlock)
+          {
+              _skipFlags = skipFlags;
+              _copyBlock = copyBlock;
+          }
+
+          // Transform and entropy codec of the block when they are chosen per
+          // block (adaptive mode). Empty otherwise (see the stream header).
+          const std::string& getTransform() const { return _transform; }
+
+          const std::string& getEntropy() const { return _entropy; }
+
+          void setBlockTypes(const std::string& transform, const std::string& entropy)
+          {
+              _transform = transform;
+              _entropy = entropy;
+          }
+
+          // Memory allocated while processing the block (nullptr if not provided).
+          // Only valid during the notification of the event.
+          const MemoryUsage* getMemoryUsage() const { return _memory; }
+
+          void setMemoryUsage(const MemoryUsage* memory) { _memory = memory; }
+
           std::string toString() const;
 
       private:
           Event::Type _type;
           clock_t _time;
+          EventTime _stamp;
           std::string _msg;
+          std::string _name;
+          std::string _transform;
+          std::string _entropy;
           int _id;
           int64 _size;
           int _hash;
           bool _hashing;
+          int _stage;
+          int _skipFlags;
+          bool _copyBlock;
+          const MemoryUsage* _memory;
       };
 }
 #endif
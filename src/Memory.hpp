@@ -17,7 +17,10 @@ limitations under the License.
 #ifndef _Memory_
 #define _Memory_
 
+#include <cstdlib>
 #include <cstring>
+#include <new>
+#include "Global.hpp"
 #include "types.hpp"
 
 #if defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__bsdi__) || defined(__DragonFly__) || defined(BSD)
@@ -26,6 +29,11 @@ limitations under the License.
         #include <machine/endian.h>
 #elif defined(__linux__) || defined(__linux) || defined(__gnu_linux__)
 #include <endian.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <malloc.h>
 #endif
 
 
@@ -56,6 +64,170 @@ namespace kanzi {
     #endif
     }
 
+    // Allocate a block of memory aligned on a cache line (or 'alignment'
+    // bytes if bigger). Big tables can optionally be backed by huge pages
+    // to reduce TLB misses (Linux only, best effort). Release with alignedFree().
+    static inline void* alignedAlloc(size_t size, bool hugePages = false, size_t alignment = 64) {
+        const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+        const size_t align = (hugePages == true) && (size >= HUGE_PAGE_SIZE) ? HUGE_PAGE_SIZE :
+           ((alignment > 64) ? alignment : 64);
+        void* ptr = nullptr;
+
+    #if defined(_MSC_VER)
+        ptr = _aligned_malloc(size, align);
+    #else
+        if (posix_memalign(&ptr, align, size) != 0)
+            ptr = nullptr;
+    #endif
+
+        if (ptr == nullptr)
+            throw std::bad_alloc();
+
+    #if (defined(__linux__) || defined(__linux) || defined(__gnu_linux__)) && defined(MADV_HUGEPAGE)
+        if (align == HUGE_PAGE_SIZE)
+            madvise(ptr, size, MADV_HUGEPAGE);
+    #endif
+
+        return ptr;
+    }
+
+    static inline void alignedFree(void* ptr) {
+    #if defined(_MSC_VER)
+        _aligned_free(ptr);
+    #else
+        free(ptr);
+    #endif
+    }
+
+    // Number of bytes that copyMatch() may write past the end of the match
+    static const int MATCH_COPY_SLACK = 32;
+
+    // Copy a LZ match of 'length' bytes located 'dist' bytes before 'dst'.
+    // Overlapping matches (dist < length) repeat the pattern of the last
+    // 'dist' bytes. Fast path for decoders: writes in blocks of up to 32
+    // bytes and may write up to MATCH_COPY_SLACK bytes past dst + length.
+    static inline void copyMatch(byte* dst, int dist, int length) {
+        const byte* ref = dst - dist;
+        byte* const end = dst + length;
+
+    #if defined(__SSE2__)
+        // Short matches (most common case): one store
+        if ((dist >= 16) && (length <= 16)) {
+            _mm_storeu_si128((__m128i*) dst, _mm_loadu_si128((const __m128i*) ref));
+            return;
+        }
+    #endif
+
+    #if defined(__AVX2__)
+        if (dist >= 32) {
+            do {
+                _mm256_storeu_si256((__m256i*) dst, _mm256_loadu_si256((const __m256i*) ref));
+                ref += 32;
+                dst += 32;
+            } while (dst < end);
+
+            return;
+        }
+    #endif
+
+    #if defined(__SSE2__)
+        if (dist >= 16) {
+            do {
+                _mm_storeu_si128((__m128i*) dst, _mm_loadu_si128((const __m128i*) ref));
+                ref += 16;
+                dst += 16;
+            } while (dst < end);
+
+            return;
+        }
+    #endif
+
+    #if defined(__SSSE3__)
+        // Build a 16 byte vector repeating the pattern ref[0..dist-1] and
+        // store it with a step that is a multiple of dist (keeps the phase)
+        static const int8 PATTERNS[16][16] = {
+            { 0 }, // unused
+            { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+            { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 },
+            { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+            { 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3 },
+            { 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0 },
+            { 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3 },
+            { 0, 1, 2, 3, 4, 5, 6, 0, 1, 2, 3, 4, 5, 6, 0, 1 },
+            { 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 },
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 0, 1, 2, 3, 4, 5, 6 },
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 2, 3, 4, 5 },
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0, 1, 2, 3, 4 },
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0, 1, 2, 3 },
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 0, 1, 2 },
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0, 1 },
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 0 }
+        };
+
+        // 16 - (16 % dist)
+        static const int8 STEPS[16] = { 0, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15 };
+
+        if (dist > 0) {
+            const __m128i mask = _mm_loadu_si128((const __m128i*) PATTERNS[dist]);
+            const __m128i pattern = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) ref), mask);
+            const int step = STEPS[dist];
+
+            do {
+                _mm_storeu_si128((__m128i*) dst, pattern);
+                dst += step;
+            } while (dst < end);
+        }
+    #else
+        if (dist >= 8) {
+            do {
+                memcpy(dst, ref, 8);
+                ref += 8;
+                dst += 8;
+            } while (dst < end);
+        }
+        else {
+            while (dst < end)
+                *dst++ = *ref++;
+        }
+    #endif
+    }
+
+
+    // Return the number of leading bytes in p[0..n-1] equal to 'val'
+    // (run detection by blocks of 32 or 16 bytes).
+    static inline int countRun(const byte* p, int n, byte val) {
+        int i = 0;
+
+    #if defined(__AVX2__)
+        const __m256i v32 = _mm256_set1_epi8(char(val));
+
+        for (; i + 32 <= n; i += 32) {
+            const __m256i x = _mm256_loadu_si256((const __m256i*) &p[i]);
+            const uint32 m = uint32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, v32)));
+
+            if (m != 0xFFFFFFFF)
+                return i + Global::trailingZeros(~m);
+        }
+    #endif
+
+    #if defined(__SSE2__)
+        const __m128i v16 = _mm_set1_epi8(char(val));
+
+        for (; i + 16 <= n; i += 16) {
+            const __m128i x = _mm_loadu_si128((const __m128i*) &p[i]);
+            const uint32 m = uint32(_mm_movemask_epi8(_mm_cmpeq_epi8(x, v16)));
+
+            if (m != 0xFFFF)
+                return i + Global::trailingZeros(~m);
+        }
+    #endif
+
+        while ((i < n) && (p[i] == val))
+            i++;
+
+        return i;
+    }
+
 
 #if !defined(__FreeBSD__) && !defined(__NetBSD__) && !defined(__OpenBSD__) && !defined(__bsdi__) && !defined(__DragonFly__) && !defined(BSD)
    static inline uint32 bswap32(uint32 x) {
@@ -20,6 +20,13 @@ limitations under the License.
 namespace kanzi
 {
 
+   class Context;
+   class Predictor;
+
+   // Create a new predictor configured by the context
+   typedef Predictor* (*PredictorFactory)(Context& ctx);
+
+
    // Predictor predicts the probability of the next bit being 1.
    class Predictor
    {
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "Compressor.hpp"
 #include "../types.hpp"
+#include "../Allocator.hpp"
+#include "../Context.hpp"
 #include "../Error.hpp"
 #include "../io/CompressedOutputStream.hpp"
 #include "../transform/TransformFactory.hpp"
@@ -90,12 +92,23 @@ namespace kanzi {
 
 // Create internal cContext and CompressedOutputStream
 int CDECL initCompressor(struct cData* pData, FILE* dst, struct cContext** pCtx)
+{
+    return initCompressorWithAllocator(pData, dst, nullptr, pCtx);
+}
+
+int CDECL initCompressorWithAllocator(struct cData* pData, FILE* dst,
+                                      const struct kAllocator* pAlloc, struct cContext** pCtx)
 {
     if ((pData == nullptr) || (pCtx == nullptr) || (dst == nullptr))
         return Error::ERR_INVALID_PARAM;
 
+    // Both callbacks or none
+    if ((pAlloc != nullptr) && ((pAlloc->allocate == nullptr) != (pAlloc->deallocate == nullptr)))
+        return Error::ERR_INVALID_PARAM;
+
     FileOutputStream* fos = nullptr;
     cContext* cctx = nullptr;
+    Allocator* allocator = nullptr;
 
     try {
         // Process params
@@ -131,17 +144,28 @@ int CDECL initCompressor(struct cData* pData, FILE* dst, struct cContext** pCtx)
         // Create compression stream and update context
         fos = new FileOutputStream(fd);
         cctx = new cContext();
-        bool checksum = pData->checksum == 0 ? false : true;
-        bool headerless = pData->headerless == 0 ? false : true;
-
-#ifdef CONCURRENCY_ENABLED
-        cctx->pCos = new CompressedOutputStream(*fos, pData->entropy, pData->transform, pData->blockSize, checksum, pData->jobs, fileSize, nullptr, headerless);
-#else
-        cctx->pCos = new CompressedOutputStream(*fos, pData->entropy, pData->transform, pData->blockSize, checksum, pData->jobs, fileSize, headerless);
-#endif
+        Context ctx;
+        ctx.putString("entropy", pData->entropy);
+        ctx.putString("transform", pData->transform);
+        ctx.putInt("blockSize", int(pData->blockSize));
+        ctx.putInt("checksum", (pData->checksum == 0) ? 0 : 1);
+        ctx.putInt("jobs", int(pData->jobs));
+        ctx.putLong("fileSize", int64(fileSize));
+        ctx.putInt("headerless", (pData->headerless == 0) ? 0 : 1);
+
+        if (pAlloc != nullptr) {
+            if (pAlloc->allocate != nullptr)
+                allocator = new CallbackAllocator(pAlloc->allocate, pAlloc->deallocate, pAlloc->opaque);
+            else if (pAlloc->hugePages != 0)
+                ctx.putInt("hugePages", 1);
+        }
 
+        // The stream keeps a copy of the context (but not of the allocator)
+        ctx.setAllocator(allocator);
+        cctx->pCos = new CompressedOutputStream(*fos, ctx);
         cctx->blockSize = pData->blockSize;
         cctx->fos = fos;
+        cctx->allocator = allocator;
         *pCtx = cctx;
     }
     catch (exception&) {
@@ -151,6 +175,9 @@ int CDECL initCompressor(struct cData* pData, FILE* dst, struct cContext** pCtx)
         if (cctx != nullptr)
            delete cctx;
 
+        if (allocator != nullptr)
+           delete allocator;
+
         return Error::ERR_CREATE_COMPRESSOR;
     }
 
@@ -214,13 +241,20 @@ int CDECL disposeCompressor(struct cContext* pCtx, int* outSize)
         if (pCtx->fos != nullptr)
             delete (FileOutputStream*)pCtx->fos;
 
+        if (pCtx->allocator != nullptr)
+            delete (Allocator*)pCtx->allocator;
+
         pCtx->fos = nullptr;
+        pCtx->allocator = nullptr;
         delete pCtx;
     }
     catch (exception&) {
         if (pCtx->fos != nullptr)
             delete (FileOutputStream*)pCtx->fos;
 
+        if (pCtx->allocator != nullptr)
+            delete (Allocator*)pCtx->allocator;
+
         delete pCtx;
         return Error::ERR_UNKNOWN;
     }
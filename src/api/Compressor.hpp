@@ -46,6 +46,18 @@ limitations under the License.
        int headerless;          /* bool to indicate if the bitstream has a header (usually yes) */
    };
 
+   /**
+    *  Custom memory allocator (optional): used for the block buffers and the
+    *  big tables of the transforms and entropy codecs. The callbacks must be
+    *  thread safe if jobs > 1.
+    */
+   struct kAllocator {
+       void* (*allocate)(void* opaque, size_t size, size_t alignment); /* return NULL on failure */
+       void (*deallocate)(void* opaque, void* ptr);
+       void* opaque;            /* user data passed to the callbacks */
+       int hugePages;           /* bool: if no callbacks, back the big tables with huge pages (best effort) */
+   };
+
    /**
     *  Compression context: encapsulates compressor state (opaque: could change in future versions)
     */
@@ -53,6 +65,7 @@ limitations under the License.
        void* pCos;
        unsigned int blockSize;
        void* fos;
+       void* allocator;
    };
 
 
@@ -67,6 +80,19 @@ limitations under the License.
     */
    int CDECL initCompressor(struct cData* cParam, FILE* dst, struct cContext** ctx);
 
+    /**
+    *  Initialize the compressor internal states with a custom allocator.
+    *
+    *  @param cParam [IN] - the compression parameters
+    *  @param dst [IN] - the destination stream of compressed data
+    *  @param allocator [IN] - the allocator (may be NULL: default allocator)
+    *  @param ctx [IN|OUT] - pointer to the compression context created by the call
+    *
+    *  @return 0 in case of success
+    */
+   int CDECL initCompressorWithAllocator(struct cData* cParam, FILE* dst,
+                                         const struct kAllocator* allocator, struct cContext** ctx);
+
     /**
     *  Compress a block of data. The compressor must have been initialized.
     *
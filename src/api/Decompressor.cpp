@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "Decompressor.hpp"
 #include "../types.hpp"
+#include "../Allocator.hpp"
+#include "../Context.hpp"
 #include "../Error.hpp"
 #include "../io/CompressedInputStream.hpp"
 #include "../transform/TransformFactory.hpp"
@@ -79,6 +81,12 @@ namespace kanzi {
 
 // Create internal dContext and CompressedInputStream
 int CDECL initDecompressor(struct dData* pData, FILE* src, struct dContext** pCtx)
+{
+    return initDecompressorWithAllocator(pData, src, nullptr, pCtx);
+}
+
+int CDECL initDecompressorWithAllocator(struct dData* pData, FILE* src,
+                                        const struct kAllocator* pAlloc, struct dContext** pCtx)
 {
     if ((pData == nullptr) || (pCtx == nullptr) || (src == nullptr))
         return Error::ERR_INVALID_PARAM;
@@ -86,8 +94,14 @@ int CDECL initDecompressor(struct dData* pData, FILE* src, struct dContext** pCt
     if (pData->bufferSize > uint(2) * 1024 * 1024 * 1024) // max buffer size
         return Error::ERR_INVALID_PARAM;
 
+    // Both callbacks or none
+    if ((pAlloc != nullptr) && ((pAlloc->allocate == nullptr) != (pAlloc->deallocate == nullptr)))
+        return Error::ERR_INVALID_PARAM;
+
     dContext* dctx = nullptr;
     FileInputStream* fis = nullptr;
+    Context* ctx = nullptr;
+    Allocator* allocator = nullptr;
 
     try {
         const int fd = FILENO(src);
@@ -97,53 +111,57 @@ int CDECL initDecompressor(struct dData* pData, FILE* src, struct dContext** pCt
 
         // Create decompression stream and update context
         *pCtx = nullptr;
-        fis = new FileInputStream(fd);
-        dctx = new dContext();
+        const bool headerless = pData->headerless != 0;
 
-        if (pData->headerless != 0) {
+        if (headerless == true) {
            // Headerless mode: process params
            string transform = TransformFactory<byte>::getName(TransformFactory<byte>::getType(pData->transform));
 
-           if (transform.length() >= 63) {
-               delete fis;
-               delete dctx;
+           if (transform.length() >= 63)
                return Error::ERR_INVALID_PARAM;
-           }
 
            strncpy(pData->transform, transform.data(), transform.length());
            pData->transform[transform.length() + 1] = 0;
            string entropy = EntropyEncoderFactory::getName(EntropyEncoderFactory::getType(pData->entropy));
 
-           if (entropy.length() >= 15) {
-               delete fis;
-               delete dctx;
+           if (entropy.length() >= 15)
                return Error::ERR_INVALID_PARAM;
-           }
 
            strncpy(pData->entropy, entropy.data(), entropy.length());
            pData->entropy[entropy.length() + 1] = 0;
            pData->blockSize = (pData->blockSize + 15) & -16;
-           bool checksum = pData->checksum == 0 ? false : true;
-
-#ifdef CONCURRENCY_ENABLED
-   #if __cplusplus >= 201103L
-           dctx->pCis = new CompressedInputStream(*fis, pData->jobs, nullptr, true,
-               checksum, pData->blockSize, std::move(transform), std::move(entropy), pData->originalSize, pData->bsVersion);
-   #else
-           dctx->pCis = new CompressedInputStream(*fis, pData->jobs, nullptr, true,
-               checksum, pData->blockSize, transform, entropy, pData->originalSize, pData->bsVersion);
-   #endif
-#else
-           dctx->pCis = new CompressedInputStream(*fis, pData->jobs, true,
-               checksum, pData->blockSize, transform, entropy, pData->originalSize, pData->bsVersion);
-#endif
         }
-        else {
-           dctx->pCis = new CompressedInputStream(*fis, pData->jobs);
+
+        fis = new FileInputStream(fd);
+        dctx = new dContext();
+
+        // The stream keeps a pointer to the context: owned by dContext
+        ctx = new Context();
+        ctx->putInt("jobs", int(pData->jobs));
+
+        if (headerless == true) {
+           ctx->putString("transform", pData->transform);
+           ctx->putString("entropy", pData->entropy);
+           ctx->putInt("blockSize", int(pData->blockSize));
+           ctx->putLong("outputSize", int64(pData->originalSize));
+           ctx->putInt("checksum", (pData->checksum == 0) ? 0 : 1);
+           if (pData->bsVersion > 0)
+               ctx->putInt("bsVersion", pData->bsVersion);
         }
 
+        if (pAlloc != nullptr) {
+            if (pAlloc->allocate != nullptr)
+                allocator = new CallbackAllocator(pAlloc->allocate, pAlloc->deallocate, pAlloc->opaque);
+            else if (pAlloc->hugePages != 0)
+                ctx->putInt("hugePages", 1);
+        }
+
+        ctx->setAllocator(allocator);
+        dctx->pCis = new CompressedInputStream(*fis, *ctx, headerless);
         dctx->bufferSize = pData->bufferSize;
         dctx->fis = fis;
+        dctx->ctx = ctx;
+        dctx->allocator = allocator;
         *pCtx = dctx;
     }
     catch (exception&) {
@@ -153,6 +171,12 @@ int CDECL initDecompressor(struct dData* pData, FILE* src, struct dContext** pCt
         if (dctx != nullptr)
            delete dctx;
 
+        if (ctx != nullptr)
+           delete ctx;
+
+        if (allocator != nullptr)
+           delete allocator;
+
         return Error::ERR_CREATE_DECOMPRESSOR;
     }
 
@@ -213,13 +237,27 @@ int CDECL disposeDecompressor(struct dContext* pCtx)
         if (pCtx->fis != nullptr)
             delete (FileInputStream*)pCtx->fis;
 
+        if (pCtx->ctx != nullptr)
+            delete (Context*)pCtx->ctx;
+
+        if (pCtx->allocator != nullptr)
+            delete (Allocator*)pCtx->allocator;
+
         pCtx->fis = nullptr;
+        pCtx->ctx = nullptr;
+        pCtx->allocator = nullptr;
         delete pCtx;
     }
     catch (exception&) {
         if (pCtx->fis != nullptr)
             delete (FileInputStream*)pCtx->fis;
 
+        if (pCtx->ctx != nullptr)
+            delete (Context*)pCtx->ctx;
+
+        if (pCtx->allocator != nullptr)
+            delete (Allocator*)pCtx->allocator;
+
         delete pCtx;
         return Error::ERR_UNKNOWN;
     }
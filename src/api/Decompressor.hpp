@@ -50,6 +50,18 @@ limitations under the License.
        int bsVersion;                /* version of the bitstream */
    };
 
+   /**
+    *  Custom memory allocator (optional): used for the block buffers and the
+    *  big tables of the transforms and entropy codecs. The callbacks must be
+    *  thread safe if jobs > 1.
+    */
+   struct kAllocator {
+       void* (*allocate)(void* opaque, size_t size, size_t alignment); /* return NULL on failure */
+       void (*deallocate)(void* opaque, void* ptr);
+       void* opaque;            /* user data passed to the callbacks */
+       int hugePages;           /* bool: if no callbacks, back the big tables with huge pages (best effort) */
+   };
+
    /**
     *  Decompression context: encapsulates decompressor state (opaque: could change in future versions)
     */
@@ -57,6 +69,8 @@ limitations under the License.
        void* pCis;
        unsigned int bufferSize;
        void* fis;
+       void* ctx;
+       void* allocator;
    };
 
    /**
@@ -70,6 +84,19 @@ limitations under the License.
     */
    int CDECL initDecompressor(struct dData* dParam, FILE* src, struct dContext** ctx);
 
+   /**
+    *  Initialize the decompressor internal states with a custom allocator.
+    *
+    *  @param dParam [IN] - the decompression parameters
+    *  @param src [IN] - the source stream of compressed data
+    *  @param allocator [IN] - the allocator (may be NULL: default allocator)
+    *  @param ctx [IN|OUT] - a pointer to the decompression context created by the call
+    *
+    *  @return 0 in case of success
+    */
+   int CDECL initDecompressorWithAllocator(struct dData* dParam, FILE* src,
+                                           const struct kAllocator* allocator, struct dContext** ctx);
+
    /**
     *  Decompress a block of data. The decompressor must have been initialized.
     *
@@ -0,0 +1,445 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "BlockBenchmark.hpp"
+#include "BlockCompressor.hpp"
+#include "StatsCollector.hpp"
+#include "../Error.hpp"
+#include "../Event.hpp"
+#include "../util.hpp"
+#include "../entropy/EntropyEncoderFactory.hpp"
+#include "../io/CompressedInputStream.hpp"
+#include "../io/CompressedOutputStream.hpp"
+#include "../io/IOUtil.hpp"
+#include "../transform/TransformFactory.hpp"
+#include "../util/Printer.hpp"
+
+using namespace kanzi;
+using namespace std;
+
+
+BlockBenchmark::BlockBenchmark(const Context& ctx) :
+            _ctx(ctx)
+{
+    _verbosity = _ctx.getInt("verbosity", 1);
+    _jobs = _ctx.getInt("jobs", 1);
+    _iterations = _ctx.getInt("iterations", DEFAULT_ITERATIONS);
+    _warmup = _ctx.getInt("warmup", DEFAULT_WARMUP);
+    _stats = _ctx.getString("stats") == "json";
+    _cBuffer = nullptr;
+    _cBufferSize = 0;
+    _dBuffer = nullptr;
+
+    if (_iterations < 1)
+        throw invalid_argument("Invalid number of iterations");
+
+    if (_warmup < 0)
+        throw invalid_argument("Invalid number of warm-up iterations");
+
+    if ((_ctx.has("inputName") == false) || (_ctx.getString("inputName") == ""))
+        throw invalid_argument("Missing input name");
+
+    _inputName = _ctx.getString("inputName");
+    vector<string> levels;
+    vector<string> transforms;
+    vector<string> entropies;
+    vector<string> blockSizes;
+    split(_ctx.getString("levels"), levels);
+    split(_ctx.getString("transform"), transforms);
+    split(_ctx.getString("entropy"), entropies);
+    split(_ctx.getString("blockSizes"), blockSizes);
+
+    // Default to level 3 (same as the compressor)
+    if ((levels.size() == 0) && (transforms.size() == 0) && (entropies.size() == 0))
+        levels.push_back("3");
+
+    if ((transforms.size() == 0) && (entropies.size() > 0))
+        transforms.push_back("NONE");
+
+    if ((entropies.size() == 0) && (transforms.size() > 0))
+        entropies.push_back("NONE");
+
+    vector<int> bSizes;
+
+    for (size_t i = 0; i < blockSizes.size(); i++) {
+        const int64 bl = atoll(blockSizes[i].c_str());
+
+        if ((bl < BlockCompressor::MIN_BLOCK_SIZE) || (bl > BlockCompressor::MAX_BLOCK_SIZE))
+            throw invalid_argument("Invalid block size: " + blockSizes[i]);
+
+        bSizes.push_back(min(int((bl + 15) & -16), BlockCompressor::MAX_BLOCK_SIZE));
+    }
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const int level = atoi(levels[i].c_str());
+
+        if ((level < 0) || (level > 9))
+            throw invalid_argument("Invalid compression level: " + levels[i]);
+
+        string tranformAndCodec[2];
+        BlockCompressor::getTransformAndCodec(level, tranformAndCodec);
+
+        if (bSizes.size() == 0) {
+            _configs.push_back(BenchConfig(level, tranformAndCodec[0], tranformAndCodec[1],
+                BlockCompressor::getDefaultBlockSize(level)));
+            continue;
+        }
+
+        for (size_t j = 0; j < bSizes.size(); j++)
+            _configs.push_back(BenchConfig(level, tranformAndCodec[0], tranformAndCodec[1], bSizes[j]));
+    }
+
+    for (size_t i = 0; i < transforms.size(); i++) {
+        // Curate input (EG. NONE+NONE+xxxx => xxxx). Throws if invalid.
+        const string t = TransformFactory<byte>::getName(TransformFactory<byte>::getType(transforms[i].c_str()));
+
+        for (size_t j = 0; j < entropies.size(); j++) {
+            const string e = EntropyEncoderFactory::getName(EntropyEncoderFactory::getType(entropies[j].c_str()));
+
+            if (bSizes.size() == 0) {
+                _configs.push_back(BenchConfig(-1, t, e, BlockCompressor::getDefaultBlockSize(-1)));
+                continue;
+            }
+
+            for (size_t k = 0; k < bSizes.size(); k++)
+                _configs.push_back(BenchConfig(-1, t, e, bSizes[k]));
+        }
+    }
+}
+
+BlockBenchmark::~BlockBenchmark()
+{
+    for (size_t i = 0; i < _inputs.size(); i++)
+        delete[] _inputs[i]._data;
+
+    _inputs.clear();
+
+    if (_cBuffer != nullptr)
+        delete[] _cBuffer;
+
+    if (_dBuffer != nullptr)
+        delete[] _dBuffer;
+}
+
+int BlockBenchmark::run()
+{
+    int res = loadInputs();
+
+    if (res != 0)
+        return res;
+
+    Printer log(cout);
+    stringstream ss;
+    uint64 inputSize = 0;
+
+    for (size_t i = 0; i < _inputs.size(); i++)
+        inputSize += _inputs[i]._size;
+
+    ss << _inputs.size() << (_inputs.size() > 1 ? " files" : " file") << " (" << inputSize;
+    ss << (inputSize > 1 ? " bytes" : " byte") << ") loaded in memory" << endl;
+    ss << _iterations << (_iterations > 1 ? " iterations" : " iteration") << " per configuration (+" << _warmup;
+    ss << " warm-up), " << _jobs << (_jobs > 1 ? " jobs" : " job") << endl;
+    log.println(ss.str(), (_verbosity > 0) && (_stats == false));
+    ss.str(string());
+
+    if (_stats == false) {
+        ss << left << setw(44) << "Configuration" << right << setw(8) << "Block";
+        ss << setw(9) << "Ratio" << setw(12) << "Comp MB/s" << setw(14) << "Decomp MB/s";
+        ss << setw(12) << "Memory MB";
+        log.println(ss.str(), _verbosity > 0);
+        ss.str(string());
+    }
+
+    stringstream json;
+    json << fixed << setprecision(3);
+    json << "{\"mode\":\"benchmark\",\"jobs\":" << _jobs << ",\"iterations\":" << _iterations;
+    json << ",\"warmup\":" << _warmup << ",\"files\":" << _inputs.size() << ",\"inputSize\":" << inputSize;
+    json << ",\n \"configurations\":[";
+
+    for (size_t i = 0; i < _configs.size(); i++) {
+        const BenchConfig& cfg = _configs[i];
+        BenchResult br;
+        res = runConfig(cfg, br);
+
+        if (res != 0)
+            return res;
+
+        const double ratio = (br._inputSize == 0) ? 0.0 : double(br._outputSize) / double(br._inputSize);
+        const double cThroughput = (br._compressTime <= 0) ? 0.0 :
+            double(br._inputSize) * 1e9 / (1024.0 * 1024.0 * double(br._compressTime));
+        const double dThroughput = (br._decompressTime <= 0) ? 0.0 :
+            double(br._inputSize) * 1e9 / (1024.0 * 1024.0 * double(br._decompressTime));
+
+        if (_stats == true) {
+            json << ((i == 0) ? "\n  " : ",\n  ");
+            json << "{";
+
+            if (cfg._level >= 0)
+                json << "\"level\":" << cfg._level << ",";
+
+            json << "\"transform\":\"" << StatsCollector::escape(cfg._transform) << "\"";
+            json << ",\"entropy\":\"" << StatsCollector::escape(cfg._entropy) << "\"";
+            json << ",\"blockSize\":" << cfg._blockSize;
+            json << ",\"outputSize\":" << br._outputSize << ",\"ratio\":" << ratio;
+            json << ",\"compressTime\":" << double(br._compressTime) / 1000000.0;
+            json << ",\"compressThroughput\":" << cThroughput;
+            json << ",\"decompressTime\":" << double(br._decompressTime) / 1000000.0;
+            json << ",\"decompressThroughput\":" << dThroughput;
+
+            if (br._memory >= 0)
+                json << ",\"memory\":" << br._memory;
+
+            json << "}";
+            continue;
+        }
+
+        string name = cfg._transform + "&" + cfg._entropy;
+
+        if (cfg._level >= 0) {
+            stringstream sl;
+            sl << "Level " << cfg._level << " (" << name << ")";
+            name = sl.str();
+        }
+
+        ss << left << setw(44) << name << right << setw(8) << formatSize(cfg._blockSize);
+        ss << fixed << setprecision(3) << setw(9) << ratio << setprecision(1);
+        ss << setw(12) << cThroughput << setw(14) << dThroughput;
+
+        if (br._memory >= 0)
+            ss << setw(12) << double(br._memory) / (1024.0 * 1024.0);
+        else
+            ss << setw(12) << "n/a";
+
+        log.println(ss.str(), _verbosity > 0);
+        ss.str(string());
+    }
+
+    if (_stats == true) {
+        json << "]}";
+        cout << json.str() << endl;
+    }
+
+    return 0;
+}
+
+int BlockBenchmark::loadInputs()
+{
+    vector<FileData> files;
+    vector<string> errors;
+    bool isRecursive = (_inputName.length() < 2) ||
+        (_inputName[_inputName.length() - 2] != PATH_SEPARATOR) ||
+        (_inputName[_inputName.length() - 1] != '.');
+    FileListConfig cfg = { isRecursive, _ctx.getInt("noLinks", 0) != 0, false, _ctx.getInt("noDotFiles", 0) != 0 };
+    createFileList(_inputName, files, cfg, errors);
+
+    if (files.size() == 0) {
+        cerr << "Cannot access input file '" << _inputName << "'" << endl;
+        return Error::ERR_OPEN_FILE;
+    }
+
+    if (errors.size() > 0) {
+        for (size_t i = 0; i < errors.size(); i++)
+           cerr << errors[i] << endl;
+
+        return Error::ERR_OPEN_FILE;
+    }
+
+    sortFilesByPathAndSize(files);
+    int64 maxSize = 0;
+
+    for (size_t i = 0; i < files.size(); i++) {
+        const string name = files[i].fullPath();
+        ifstream ifs(name.c_str(), ifstream::in | ifstream::binary);
+
+        if (!ifs) {
+            cerr << "Cannot open input file '" << name << "'" << endl;
+            return Error::ERR_OPEN_FILE;
+        }
+
+        const int64 size = files[i]._size;
+        byte* data = new byte[size_t(max(size, int64(1)))];
+        ifs.read(reinterpret_cast<char*>(data), streamsize(size));
+
+        if (ifs.gcount() != streamsize(size)) {
+            delete[] data;
+            cerr << "Failed to read input file '" << name << "'" << endl;
+            return Error::ERR_READ_FILE;
+        }
+
+        _inputs.push_back(BenchInput(name, data, size));
+        maxSize = max(maxSize, size);
+    }
+
+    // Room for incompressible data plus block headers. Touch the pages now so that
+    // the buffers do not count in the memory used by a configuration.
+    _cBufferSize = maxSize + (maxSize >> 4) + 1024 * 1024;
+    _cBuffer = new byte[size_t(_cBufferSize)];
+    _dBuffer = new byte[size_t(maxSize + 1)];
+    memset(_cBuffer, 0, size_t(_cBufferSize));
+    memset(_dBuffer, 0, size_t(maxSize + 1));
+    return 0;
+}
+
+int BlockBenchmark::runConfig(const BenchConfig& cfg, BenchResult& br)
+{
+    vector<int64> cTimes;
+    vector<int64> dTimes;
+    const bool peakReset = StatsCollector::resetPeakRSS();
+    const int64 baseRSS = StatsCollector::getPeakRSS();
+
+    for (int n = 0; n < _warmup + _iterations; n++) {
+        int64 cTime = 0;
+        int64 dTime = 0;
+        uint64 outputSize = 0;
+        uint64 inputSize = 0;
+
+        for (size_t i = 0; i < _inputs.size(); i++) {
+            int64 ct, dt;
+            uint64 written;
+            const int res = runIteration(cfg, _inputs[i], ct, dt, written);
+
+            if (res != 0)
+                return res;
+
+            cTime += ct;
+            dTime += dt;
+            outputSize += written;
+            inputSize += _inputs[i]._size;
+        }
+
+        // Discard warm-up iterations (cold caches, page faults, thread creation)
+        if (n < _warmup)
+            continue;
+
+        cTimes.push_back(cTime);
+        dTimes.push_back(dTime);
+        br._inputSize = inputSize;
+        br._outputSize = outputSize;
+    }
+
+    br._compressTime = median(cTimes);
+    br._decompressTime = median(dTimes);
+    br._memory = (peakReset == true) ? max(StatsCollector::getPeakRSS() - baseRSS, int64(0)) : -1;
+    return 0;
+}
+
+int BlockBenchmark::runIteration(const BenchConfig& cfg, const BenchInput& input,
+    int64& compressTime, int64& decompressTime, uint64& outputSize)
+{
+    Context ctx(_ctx);
+    ctx.putString("transform", cfg._transform);
+    ctx.putString("entropy", cfg._entropy);
+    ctx.putInt("blockSize", cfg._blockSize);
+    ctx.putLong("fileSize", input._size);
+    ctx.putInt("jobs", _jobs);
+
+    try {
+        ostreambuf<char> obuf(reinterpret_cast<char*>(_cBuffer), streamsize(_cBufferSize));
+        ostream os(&obuf);
+        const int64 before = EventTime::wallTime();
+        CompressedOutputStream cos(os, ctx);
+        cos.write(reinterpret_cast<const char*>(input._data), streamsize(input._size));
+        cos.close();
+        compressTime = EventTime::wallTime() - before;
+        outputSize = cos.getWritten();
+    }
+    catch (exception& e) {
+        cerr << "Compression of '" << input._name << "' with " << cfg._transform << "&" << cfg._entropy;
+        cerr << " failed: " << e.what() << endl;
+        return Error::ERR_PROCESS_BLOCK;
+    }
+
+    int64 decoded = 0;
+
+    try {
+        istreambuf<char> ibuf(reinterpret_cast<char*>(_cBuffer), streamsize(outputSize));
+        istream is(&ibuf);
+        const int64 before = EventTime::wallTime();
+        CompressedInputStream cis(is, ctx);
+
+        // Ask for one extra byte to detect trailing data
+        while (decoded <= input._size) {
+            cis.read(reinterpret_cast<char*>(&_dBuffer[decoded]), streamsize(input._size + 1 - decoded));
+
+            if (cis.gcount() <= 0)
+                break;
+
+            decoded += int64(cis.gcount());
+        }
+
+        cis.close();
+        decompressTime = EventTime::wallTime() - before;
+    }
+    catch (exception& e) {
+        cerr << "Decompression of '" << input._name << "' with " << cfg._transform << "&" << cfg._entropy;
+        cerr << " failed: " << e.what() << endl;
+        return Error::ERR_PROCESS_BLOCK;
+    }
+
+    if ((decoded != input._size) || (memcmp(_dBuffer, input._data, size_t(input._size)) != 0)) {
+        cerr << "Round trip failure for '" << input._name << "' with " << cfg._transform << "&" << cfg._entropy;
+        cerr << " (block size " << cfg._blockSize << ")" << endl;
+        return Error::ERR_PROCESS_BLOCK;
+    }
+
+    return 0;
+}
+
+void BlockBenchmark::split(const string& s, vector<string>& tokens)
+{
+    size_t start = 0;
+
+    while (start < s.length()) {
+        size_t end = s.find(',', start);
+
+        if (end == string::npos)
+            end = s.length();
+
+        if (end > start)
+            tokens.push_back(s.substr(start, end - start));
+
+        start = end + 1;
+    }
+}
+
+int64 BlockBenchmark::median(vector<int64>& values)
+{
+    if (values.size() == 0)
+        return 0;
+
+    sort(values.begin(), values.end());
+    const size_t n = values.size();
+    return ((n & 1) != 0) ? values[n >> 1] : (values[(n >> 1) - 1] + values[n >> 1]) >> 1;
+}
+
+string BlockBenchmark::formatSize(int64 size)
+{
+    stringstream ss;
+
+    if ((size >= 1024 * 1024) && ((size & (1024 * 1024 - 1)) == 0))
+        ss << (size >> 20) << " MB";
+    else if ((size >= 1024) && ((size & 1023) == 0))
+        ss << (size >> 10) << " KB";
+    else
+        ss << size;
+
+    return ss.str();
+}
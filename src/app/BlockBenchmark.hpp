@@ -0,0 +1,118 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef _BlockBenchmark_
+#define _BlockBenchmark_
+
+#include <string>
+#include <vector>
+#include "../Context.hpp"
+#include "../types.hpp"
+
+namespace kanzi {
+
+   class BenchInput {
+   public:
+       std::string _name;
+       byte* _data;
+       int64 _size;
+
+       BenchInput(const std::string& name, byte* data, int64 size)
+           : _name(name)
+           , _data(data)
+           , _size(size)
+       {
+       }
+   };
+
+   class BenchConfig {
+   public:
+       int _level; // -1 for explicit transform and entropy
+       std::string _transform;
+       std::string _entropy;
+       int _blockSize;
+
+       BenchConfig(int level, const std::string& transform, const std::string& entropy, int blockSize)
+           : _level(level)
+           , _transform(transform)
+           , _entropy(entropy)
+           , _blockSize(blockSize)
+       {
+       }
+   };
+
+   class BenchResult {
+   public:
+       uint64 _inputSize;
+       uint64 _outputSize;
+       int64 _compressTime; // median over iterations in ns
+       int64 _decompressTime; // median over iterations in ns
+       int64 _memory; // peak RSS increase in bytes (-1 if not available)
+
+       BenchResult()
+           : _inputSize(0)
+           , _outputSize(0)
+           , _compressTime(0)
+           , _decompressTime(0)
+           , _memory(-1)
+       {
+       }
+   };
+
+   // In memory benchmark (--bench option): the input files are loaded once, then
+   // compressed and decompressed several times for each configuration (level or
+   // transform and entropy codec, block size) with a CompressedOutputStream and a
+   // CompressedInputStream backed by memory buffers. No disk IO is measured.
+   class BlockBenchmark {
+   public:
+       static const int DEFAULT_ITERATIONS = 5;
+       static const int DEFAULT_WARMUP = 1;
+
+       BlockBenchmark(const Context& ctx);
+
+       ~BlockBenchmark();
+
+       int run();
+
+   private:
+       int _verbosity;
+       int _iterations;
+       int _warmup;
+       int _jobs;
+       bool _stats; // --stats=json
+       std::string _inputName;
+       std::vector<BenchConfig> _configs;
+       std::vector<BenchInput> _inputs;
+       byte* _cBuffer; // compressed data
+       int64 _cBufferSize;
+       byte* _dBuffer; // decompressed data
+       Context _ctx;
+
+       int loadInputs();
+
+       int runConfig(const BenchConfig& cfg, BenchResult& res);
+
+       int runIteration(const BenchConfig& cfg, const BenchInput& input,
+           int64& compressTime, int64& decompressTime, uint64& outputSize);
+
+       static void split(const std::string& s, std::vector<std::string>& tokens);
+
+       static int64 median(std::vector<int64>& values);
+
+       static std::string formatSize(int64 size);
+   };
+}
+#endif
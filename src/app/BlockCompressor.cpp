@@ -19,6 +19,7 @@ limitations under the License.
 #include <time.h>
 #include "BlockCompressor.hpp"
 #include "InfoPrinter.hpp"
+#include "TraceWriter.hpp"
 #include "../SliceArray.hpp"
 #include "../transform/TransformFactory.hpp"
 #include "../io/IOException.hpp"
@@ -100,26 +101,12 @@ BlockCompressor::BlockCompressor(const Context& ctx) :
 
     string str = _ctx.getString("outputName");
     _outputName = (str == "") && (_inputName == "STDIN") ? "STDOUT" : str;
+    _traceFile = _ctx.getString("traceFile", "");
+    _stats = _ctx.getString("stats") == "json";
 
 
     if (_ctx.has("blockSize") == false) {
-        switch (level) {
-        case 6:
-            _blockSize = 2 * DEFAULT_BLOCK_SIZE;
-            break;
-        case 7:
-            _blockSize = 4 * DEFAULT_BLOCK_SIZE;
-            break;
-        case 8:
-            _blockSize = 4 * DEFAULT_BLOCK_SIZE;
-            break;
-        case 9:
-            _blockSize = 8 * DEFAULT_BLOCK_SIZE;
-            break;
-        default:
-            _blockSize = DEFAULT_BLOCK_SIZE;
-        }
-
+        _blockSize = getDefaultBlockSize(level);
         _ctx.putInt("blockSize", _blockSize);
     }
     else {
@@ -154,8 +141,15 @@ int BlockCompressor::compress(uint64& outputSize)
 {
     vector<FileData> files;
     Clock stopClock;
+    const int64 startTime = EventTime::wallTime();
+    const int64 startCpu = (_stats == true) ? StatsCollector::getProcessCpuTime() : 0;
+
+    if (_stats == true)
+        MemoryTracker::restart(); // per run memory peaks
+
+    string stats; // JSON objects of the files (--stats=json)
     int nbFiles = 1;
-    Printer log(cout);
+    Printer log((_stats == true) ? cerr : cout);
     stringstream ss;
     string str = _inputName;
     transform(str.begin(), str.end(), str.begin(), ::toupper);
@@ -223,11 +217,16 @@ int BlockCompressor::compress(uint64& outputSize)
         ss.str(string());
     }
 
-    InfoPrinter listener(_verbosity, InfoPrinter::ENCODING, cout);
+    InfoPrinter listener(_verbosity, InfoPrinter::ENCODING, (_stats == true) ? cerr : cout);
 
     if (_verbosity > 2)
         addListener(listener);
 
+    TraceWriter tracer;
+
+    if (_traceFile.length() > 0)
+        addListener(tracer);
+
     int res = 0;
     uint64 read = 0;
     uint64 written = 0;
@@ -322,6 +321,10 @@ int BlockCompressor::compress(uint64& outputSize)
         _ctx.putString("outputName", oName);
         FileCompressTask<FileCompressResult> task(_ctx, _listeners);
         FileCompressResult fcr = task.run();
+
+        if (fcr._stats.length() > 0)
+            stats += ((stats.length() > 0) ? ",\n  " : "") + fcr._stats;
+
         res = fcr._code;
         read = fcr._read;
         written = fcr._written;
@@ -388,6 +391,10 @@ int BlockCompressor::compress(uint64& outputSize)
             // Wait for results
             for (int i = 0; i < _jobs; i++) {
                 FileCompressResult fcr = results[i].get();
+
+                if (fcr._stats.length() > 0)
+                    stats += ((stats.length() > 0) ? ",\n  " : "") + fcr._stats;
+
                 res = fcr._code;
                 read += fcr._read;
                 written += fcr._written;
@@ -407,6 +414,10 @@ int BlockCompressor::compress(uint64& outputSize)
         if (!doConcurrent) {
             for (uint i = 0; i < tasks.size(); i++) {
                 FileCompressResult fcr = tasks[i]->run();
+
+                if (fcr._stats.length() > 0)
+                    stats += ((stats.length() > 0) ? ",\n  " : "") + fcr._stats;
+
                 res = fcr._code;
                 read += fcr._read;
                 written += fcr._written;
@@ -457,6 +468,24 @@ int BlockCompressor::compress(uint64& outputSize)
     if (_verbosity > 2)
         removeListener(listener);
 
+    if (_traceFile.length() > 0) {
+        removeListener(tracer);
+
+        if (tracer.save(_traceFile) == false) {
+            cerr << "Cannot create trace file '" << _traceFile << "'" << endl;
+
+            if (res == 0)
+                res = Error::ERR_CREATE_FILE;
+        }
+    }
+
+    if (_stats == true) {
+        const int64 cpuTime = StatsCollector::getProcessCpuTime() - startCpu;
+        const string doc = StatsCollector::toJSON(StatsCollector::ENCODING, _jobs, read, written,
+            EventTime::wallTime() - startTime, cpuTime, stats);
+        (isStdOut ? cerr : cout) << doc << endl;
+    }
+
     outputSize += written;
     return res;
 }
@@ -484,60 +513,25 @@ void BlockCompressor::notifyListeners(vector<Listener*>& listeners, const Event&
         (*it)->processEvent(evt);
 }
 
-void BlockCompressor::getTransformAndCodec(int level, string tranformAndCodec[2])
+int BlockCompressor::getDefaultBlockSize(int level)
 {
     switch (level) {
-    case 0:
-        tranformAndCodec[0] = "NONE";
-        tranformAndCodec[1] = "NONE";
-        break;
-
-    case 1:
-        tranformAndCodec[0] = "PACK+LZ";
-        tranformAndCodec[1] = "NONE";
-        break;
-
-    case 2:
-        tranformAndCodec[0] = "PACK+LZ";
-        tranformAndCodec[1] = "HUFFMAN";
-        break;
-
-    case 3:
-        tranformAndCodec[0] = "TEXT+UTF+PACK+MM+LZX";
-        tranformAndCodec[1] = "HUFFMAN";
-        break;
-
-    case 4:
-        tranformAndCodec[0] = "TEXT+UTF+EXE+PACK+MM+ROLZ";
-        tranformAndCodec[1] = "NONE";
-        break;
-
-    case 5:
-        tranformAndCodec[0] = "TEXT+UTF+BWT+RANK+ZRLT";
-        tranformAndCodec[1] = "ANS0";
-        break;
-
     case 6:
-        tranformAndCodec[0] = "TEXT+UTF+BWT+SRT+ZRLT";
-        tranformAndCodec[1] = "FPAQ";
-        break;
-
+        return 2 * DEFAULT_BLOCK_SIZE;
     case 7:
-        tranformAndCodec[0] = "LZP+TEXT+UTF+BWT+LZP";
-        tranformAndCodec[1] = "CM";
-        break;
-
+        return 4 * DEFAULT_BLOCK_SIZE;
     case 8:
-        tranformAndCodec[0] = "EXE+RLT+TEXT+UTF";
-        tranformAndCodec[1] = "TPAQ";
-        break;
-
+        return 4 * DEFAULT_BLOCK_SIZE;
     case 9:
-        tranformAndCodec[0] = "EXE+RLT+TEXT+UTF";
-        tranformAndCodec[1] = "TPAQX";
-        break;
-
+        return 8 * DEFAULT_BLOCK_SIZE;
     default:
+        return DEFAULT_BLOCK_SIZE;
+    }
+}
+
+void BlockCompressor::getTransformAndCodec(int level, string tranformAndCodec[2])
+{
+    if (CompressedOutputStream::getTransformAndCodec(level, tranformAndCodec[0], tranformAndCodec[1]) == false) {
         tranformAndCodec[0] = "Unknown";
         tranformAndCodec[1] = "Unknown";
     }
@@ -550,12 +544,18 @@ FileCompressTask<T>::FileCompressTask(const Context& ctx, vector<Listener*>& lis
 {
     _is = nullptr;
     _cos = nullptr;
+    _stats = nullptr;
+
+    if (_ctx.getString("stats") == "json") {
+        _stats = new StatsCollector(StatsCollector::ENCODING);
+        _listeners.push_back(_stats);
+    }
 }
 
 template <class T>
 T FileCompressTask<T>::run()
 {
-    Printer log(cout);
+    Printer log((_ctx.getString("stats") == "json") ? cerr : cout);
     int verbosity = _ctx.getInt("verbosity");
     string inputName = _ctx.getString("inputName");
     string outputName = _ctx.getString("outputName");
@@ -696,8 +696,18 @@ T FileCompressTask<T>::run()
             int len;
 
             try {
+                if (_listeners.size() > 0) {
+                    Event evt(Event::BEFORE_READ, -1, int64(0), clock());
+                    BlockCompressor::notifyListeners(_listeners, evt);
+                }
+
                 _is->read(reinterpret_cast<char*>(&sa._array[0]), sa._length);
                 len = *_is ? sa._length : int(_is->gcount());
+
+                if (_listeners.size() > 0) {
+                    Event evt(Event::AFTER_READ, -1, int64(len), clock());
+                    BlockCompressor::notifyListeners(_listeners, evt);
+                }
             }
             catch (exception& e) {
                 stringstream sserr;
@@ -711,7 +721,18 @@ T FileCompressTask<T>::run()
 
             // Just write block to the compressed output stream !
             read += len;
+
+            if (_listeners.size() > 0) {
+                Event evt(Event::BEFORE_WRITE, -1, int64(len), clock());
+                BlockCompressor::notifyListeners(_listeners, evt);
+            }
+
             _cos->write(reinterpret_cast<const char*>(&sa._array[0]), len);
+
+            if (_listeners.size() > 0) {
+                Event evt(Event::AFTER_WRITE, -1, int64(len), clock());
+                BlockCompressor::notifyListeners(_listeners, evt);
+            }
         }
     }
     catch (IOException& ioe) {
@@ -827,7 +848,15 @@ T FileCompressTask<T>::run()
     }
 
     delete[] buf;
-    return T(0, read, encoded, "");
+    string stats;
+
+    if (_stats != nullptr) {
+        string entropy = _ctx.getString("entropy");
+        transform(entropy.begin(), entropy.end(), entropy.begin(), ::toupper);
+        stats = _stats->toJSON(inputName, read, encoded, _ctx.getString("transform"), entropy);
+    }
+
+    return T(0, read, encoded, "", stats);
 }
 
 template <class T>
@@ -835,6 +864,11 @@ FileCompressTask<T>::~FileCompressTask()
 {
     dispose();
 
+    if (_stats != nullptr) {
+        delete _stats;
+        _stats = nullptr;
+    }
+
     if (_cos != nullptr) {
         delete _cos;
         _cos = nullptr;
@@ -877,6 +911,7 @@ R FileCompressWorker<T, R>::run()
     uint64 read = 0;
     uint64 written = 0;
     string errMsg;
+    string stats;
 
     while (res == 0) {
         T* task = _queue->get();
@@ -889,11 +924,14 @@ R FileCompressWorker<T, R>::run()
         read += result._read;
         written += result._written;
 
+        if (result._stats.length() > 0)
+            stats += ((stats.length() > 0) ? ",\n  " : "") + result._stats;
+
         if (res != 0) {
             errMsg += result._errMsg;
         }
     }
 
-    return R(res, read, written, errMsg);
+    return R(res, read, written, errMsg, stats);
 }
 #endif
@@ -21,6 +21,7 @@ limitations under the License.
 #include <vector>
 #include "../InputStream.hpp"
 #include "../io/CompressedOutputStream.hpp"
+#include "StatsCollector.hpp"
 
 namespace kanzi {
 
@@ -30,20 +31,24 @@ namespace kanzi {
        uint64 _read;
        uint64 _written;
        std::string _errMsg;
+       std::string _stats; // JSON statistics (--stats=json)
 
        FileCompressResult()
           : _code(0)
           , _read(0)
           , _written(0)
           , _errMsg()
+          , _stats()
        {
        }
 
-       FileCompressResult(int code, uint64 read, uint64 written, const std::string& errMsg)
+       FileCompressResult(int code, uint64 read, uint64 written, const std::string& errMsg,
+          const std::string& stats = "")
            : _code(code)
            , _read(read)
            , _written(written)
            , _errMsg(errMsg)
+           , _stats(stats)
        {
        }
 
@@ -53,12 +58,14 @@ namespace kanzi {
            , _read(fcr._read)
            , _written(fcr._written)
            , _errMsg(fcr._errMsg)
+           , _stats(fcr._stats)
        {
        }
 
        FileCompressResult& operator=(const FileCompressResult& fcr)
        {
            _errMsg = fcr._errMsg;
+           _stats = fcr._stats;
            _code = fcr._code;
            _read = fcr._read;
            _written = fcr._written;
@@ -112,6 +119,7 @@ namespace kanzi {
        InputStream* _is;
        CompressedOutputStream* _cos;
        std::vector<Listener*> _listeners;
+       StatsCollector* _stats; // null unless --stats=json
    };
 
 
@@ -133,17 +141,24 @@ namespace kanzi {
 
        void dispose() const {};
 
-   private:
-       static const int DEFAULT_BLOCK_SIZE = 4 * 1024 * 1024;
        static const int MIN_BLOCK_SIZE = 1024;
        static const int MAX_BLOCK_SIZE = 1024 * 1024 * 1024;
 
+       static void getTransformAndCodec(int level, std::string tranformAndCodec[2]);
+
+       static int getDefaultBlockSize(int level);
+
+   private:
+       static const int DEFAULT_BLOCK_SIZE = 4 * 1024 * 1024;
+
        int _verbosity;
        bool _overwrite;
        bool _checksum;
        bool _skipBlocks;
        std::string _inputName;
        std::string _outputName;
+       std::string _traceFile;
+       bool _stats; // --stats=json
        std::string _codec;
        std::string _transform;
        int _blockSize;
@@ -156,8 +171,6 @@ namespace kanzi {
        Context _ctx;
 
        static void notifyListeners(std::vector<Listener*>& listeners, const Event& evt);
-
-       static void getTransformAndCodec(int level, std::string tranformAndCodec[2]);
    };
 }
 #endif
@@ -19,6 +19,7 @@ limitations under the License.
 #include <time.h>
 #include "BlockDecompressor.hpp"
 #include "InfoPrinter.hpp"
+#include "TraceWriter.hpp"
 #include "../Global.hpp"
 #include "../SliceArray.hpp"
 #include "../io/IOException.hpp"
@@ -61,6 +62,8 @@ BlockDecompressor::BlockDecompressor(const Context& ctx) :
 
     string str = _ctx.getString("outputName");
     _outputName = (str == "") && (_inputName == "STDIN") ? "STDOUT" : str;
+    _traceFile = _ctx.getString("traceFile", "");
+    _stats = _ctx.getString("stats") == "json";
 }
 
 BlockDecompressor::~BlockDecompressor()
@@ -74,8 +77,15 @@ int BlockDecompressor::decompress(uint64& inputSize)
     vector<FileData> files;
     uint64 read = 0;
     Clock stopClock;
+    const int64 startTime = EventTime::wallTime();
+    const int64 startCpu = (_stats == true) ? StatsCollector::getProcessCpuTime() : 0;
+
+    if (_stats == true)
+        MemoryTracker::restart(); // per run memory peaks
+
+    string stats; // JSON objects of the files (--stats=json)
     int nbFiles = 1;
-    Printer log(cout);
+    Printer log((_stats == true) ? cerr : cout);
     stringstream ss;
     string str = _inputName;
     transform(str.begin(), str.end(), str.begin(), ::toupper);
@@ -130,11 +140,16 @@ int BlockDecompressor::decompress(uint64& inputSize)
         ss.str(string());
     }
 
-    InfoPrinter listener(_verbosity, InfoPrinter::DECODING, cout);
+    InfoPrinter listener(_verbosity, InfoPrinter::DECODING, (_stats == true) ? cerr : cout);
 
     if (_verbosity > 2)
         addListener(listener);
 
+    TraceWriter tracer;
+
+    if (_traceFile.length() > 0)
+        addListener(tracer);
+
     int res = 0;
     bool inputIsDir = false;
     string formattedOutName = _outputName;
@@ -224,6 +239,10 @@ int BlockDecompressor::decompress(uint64& inputSize)
         _ctx.putString("outputName", oName);
         FileDecompressTask<FileDecompressResult> task(_ctx, _listeners);
         FileDecompressResult fdr = task.run();
+
+        if (fdr._stats.length() > 0)
+            stats += ((stats.length() > 0) ? ",\n  " : "") + fdr._stats;
+
         res = fdr._code;
         read = fdr._read;
 
@@ -280,6 +299,10 @@ int BlockDecompressor::decompress(uint64& inputSize)
             // Wait for results
             for (int i = 0; i < _jobs; i++) {
                 FileDecompressResult fdr = results[i].get();
+
+                if (fdr._stats.length() > 0)
+                    stats += ((stats.length() > 0) ? ",\n  " : "") + fdr._stats;
+
                 res = fdr._code;
                 read += fdr._read;
 
@@ -298,6 +321,10 @@ int BlockDecompressor::decompress(uint64& inputSize)
         if (!doConcurrent) {
             for (uint i = 0; i < tasks.size(); i++) {
                 FileDecompressResult fdr = tasks[i]->run();
+
+                if (fdr._stats.length() > 0)
+                    stats += ((stats.length() > 0) ? ",\n  " : "") + fdr._stats;
+
                 res = fdr._code;
                 read += fdr._read;
 
@@ -338,6 +365,29 @@ int BlockDecompressor::decompress(uint64& inputSize)
     if (_verbosity > 2)
         removeListener(listener);
 
+    if (_traceFile.length() > 0) {
+        removeListener(tracer);
+
+        if (tracer.save(_traceFile) == false) {
+            cerr << "Cannot create trace file '" << _traceFile << "'" << endl;
+
+            if (res == 0)
+                res = Error::ERR_CREATE_FILE;
+        }
+    }
+
+    if (_stats == true) {
+        uint64 packed = 0;
+
+        for (size_t i = 0; i < files.size(); i++)
+            packed += uint64(files[i]._size);
+
+        const int64 cpuTime = StatsCollector::getProcessCpuTime() - startCpu;
+        const string doc = StatsCollector::toJSON(StatsCollector::DECODING, _jobs, packed, read,
+            EventTime::wallTime() - startTime, cpuTime, stats);
+        (isStdOut ? cerr : cout) << doc << endl;
+    }
+
     inputSize += read;
     return res;
 }
@@ -372,6 +422,12 @@ FileDecompressTask<T>::FileDecompressTask(const Context& ctx, vector<Listener*>&
 {
     _os = nullptr;
     _cis = nullptr;
+    _stats = nullptr;
+
+    if (_ctx.getString("stats") == "json") {
+        _stats = new StatsCollector(StatsCollector::DECODING);
+        _listeners.push_back(_stats);
+    }
 }
 
 template <class T>
@@ -379,6 +435,11 @@ FileDecompressTask<T>::~FileDecompressTask()
 {
     dispose();
 
+    if (_stats != nullptr) {
+        delete _stats;
+        _stats = nullptr;
+    }
+
     if (_cis != nullptr) {
         delete _cis;
         _cis = nullptr;
@@ -399,7 +460,7 @@ FileDecompressTask<T>::~FileDecompressTask()
 template <class T>
 T FileDecompressTask<T>::run()
 {
-    Printer log(cout);
+    Printer log((_ctx.getString("stats") == "json") ? cerr : cout);
     int verbosity = _ctx.getInt("verbosity");
     string inputName = _ctx.getString("inputName");
     string outputName = _ctx.getString("outputName");
@@ -548,9 +609,19 @@ T FileDecompressTask<T>::run()
 
         // Decode next block
         do {
+            if (_listeners.size() > 0) {
+                Event evt(Event::BEFORE_READ, -1, int64(0), clock());
+                BlockDecompressor::notifyListeners(_listeners, evt);
+            }
+
             _cis->read(reinterpret_cast<char*>(&sa._array[0]), sa._length);
             decoded = int(_cis->gcount());
 
+            if (_listeners.size() > 0) {
+                Event evt(Event::AFTER_READ, -1, int64(decoded), clock());
+                BlockDecompressor::notifyListeners(_listeners, evt);
+            }
+
             if (decoded < 0) {
                 delete[] buf;
                 stringstream sserr;
@@ -560,8 +631,18 @@ T FileDecompressTask<T>::run()
 
             try {
                 if (decoded > 0) {
+                    if (_listeners.size() > 0) {
+                        Event evt(Event::BEFORE_WRITE, -1, int64(decoded), clock());
+                        BlockDecompressor::notifyListeners(_listeners, evt);
+                    }
+
                     _os->write(reinterpret_cast<const char*>(&sa._array[0]), decoded);
                     read += decoded;
+
+                    if (_listeners.size() > 0) {
+                        Event evt(Event::AFTER_WRITE, -1, int64(decoded), clock());
+                        BlockDecompressor::notifyListeners(_listeners, evt);
+                    }
                 }
             }
             catch (exception& e) {
@@ -704,7 +785,12 @@ T FileDecompressTask<T>::run()
     }
 
     delete[] buf;
-    return T(0, read, "");
+    string stats;
+
+    if (_stats != nullptr)
+        stats = _stats->toJSON(inputName, decoded, read, _ctx.getString("transform"), _ctx.getString("entropy"));
+
+    return T(0, read, "", stats);
 }
 
 // Close and flush streams. Do not deallocate resources. Idempotent.
@@ -731,6 +817,7 @@ R FileDecompressWorker<T, R>::run()
     int res = 0;
     uint64 read = 0;
     string errMsg;
+    string stats;
 
     while (res == 0) {
         T* task = _queue->get();
@@ -742,11 +829,14 @@ R FileDecompressWorker<T, R>::run()
         res = result._code;
         read += result._read;
 
+        if (result._stats.length() > 0)
+            stats += ((stats.length() > 0) ? ",\n  " : "") + result._stats;
+
         if (res != 0) {
             errMsg += result._errMsg;
         }
     }
 
-    return R(res, read, errMsg);
+    return R(res, read, errMsg, stats);
 }
 #endif
@@ -21,6 +21,7 @@ limitations under the License.
 #include <vector>
 #include "../OutputStream.hpp"
 #include "../io/CompressedInputStream.hpp"
+#include "StatsCollector.hpp"
 
 namespace kanzi {
    class FileDecompressResult {
@@ -28,18 +29,22 @@ namespace kanzi {
        int _code;
        uint64 _read;
        std::string _errMsg;
+       std::string _stats; // JSON statistics (--stats=json)
 
        FileDecompressResult()
           : _code(0)
           , _read(0)
           , _errMsg()
+          , _stats()
        {
        }
 
-       FileDecompressResult(int code, uint64 read, const std::string& errMsg)
+       FileDecompressResult(int code, uint64 read, const std::string& errMsg,
+          const std::string& stats = "")
            : _code(code)
            , _read(read)
            , _errMsg(errMsg)
+           , _stats(stats)
        {
        }
 
@@ -48,12 +53,14 @@ namespace kanzi {
            : _code(fdr._code)
            , _read(fdr._read)
            , _errMsg(fdr._errMsg)
+           , _stats(fdr._stats)
        {
        }
 
        FileDecompressResult& operator=(const FileDecompressResult& fdr)
        {
            _errMsg = fdr._errMsg;
+           _stats = fdr._stats;
            _code = fdr._code;
            _read = fdr._read;
            return *this;
@@ -106,6 +113,7 @@ namespace kanzi {
        OutputStream* _os;
        CompressedInputStream* _cis;
        std::vector<Listener*> _listeners;
+       StatsCollector* _stats; // null unless --stats=json
    };
 
    typedef FileDecompressTask<FileDecompressResult> FDTask;
@@ -133,6 +141,8 @@ namespace kanzi {
        bool _overwrite;
        std::string _inputName;
        std::string _outputName;
+       std::string _traceFile;
+       bool _stats; // --stats=json
        int _blockSize;
        int _jobs;
        std::vector<Listener*> _listeners;
@@ -54,7 +54,13 @@ void InfoPrinter::processEvent(const Event& evt)
     if (evt.getType() == _thresholds[1]) {
         // Register initial block size
         BlockInfo* bi = new BlockInfo();
-        _clock12.start();
+        bi->_time0 = evt.getWallTime();
+        bi->_time1 = bi->_time0;
+        bi->_time2 = bi->_time0;
+        bi->_time3 = bi->_time0;
+        bi->_stageTime = bi->_time0;
+        bi->_stage0Size = 0;
+        bi->_stage1Size = 0;
 
         if (_type == InfoPrinter::ENCODING)
             bi->_stage0Size = evt.getSize();
@@ -74,12 +80,14 @@ void InfoPrinter::processEvent(const Event& evt)
         if (_type == InfoPrinter::DECODING)
             bi->_stage0Size = evt.getSize();
 
-        _clock12.stop();
-        _clock23.start();
+        if (evt.getTransform().length() > 0)
+            bi->_types = evt.getTransform() + "&" + evt.getEntropy();
+
+        bi->_time1 = evt.getWallTime();
 
         if (_level >= 5) {
             stringstream ss;
-            ss << evt.toString() << " [" << int64(_clock12.elapsed()) << " ms]";
+            ss << evt.toString() << " [" << (bi->_time1 - bi->_time0) / 1000000 << " ms]";
             _os << ss.str() << endl;
         }
     }
@@ -89,10 +97,12 @@ void InfoPrinter::processEvent(const Event& evt)
         if (bi == nullptr)
             return;
 
-        _clock23.stop();
-        _clock34.start();
+        bi->_time2 = evt.getWallTime();
         bi->_stage1Size = evt.getSize();
 
+        if (evt.getTransform().length() > 0)
+            bi->_types = evt.getTransform() + "&" + evt.getEntropy();
+
         if (_level >= 5) {
             _os << evt.toString() << endl;
         }
@@ -110,7 +120,7 @@ void InfoPrinter::processEvent(const Event& evt)
         }
 
         int64 stage2Size = evt.getSize();
-        _clock34.stop();
+        bi->_time3 = evt.getWallTime();
         stringstream ss;
 
         if (_level >= 5) {
@@ -119,9 +129,14 @@ void InfoPrinter::processEvent(const Event& evt)
 
         // Display block info
         if (_level >= 4) {
-            ss << "Block " << currentBlockId << ": " << bi->_stage0Size << " => ";
-            ss << bi->_stage1Size << " [" << int64(_clock12.elapsed()) << " ms] => " << stage2Size;
-            ss << " [" << int64(_clock34.elapsed()) << " ms]";
+            ss << "Block " << currentBlockId;
+
+            if (bi->_types.length() > 0)
+                ss << " (" << bi->_types << ")";
+
+            ss << ": " << bi->_stage0Size << " => ";
+            ss << bi->_stage1Size << " [" << (bi->_time1 - bi->_time0) / 1000000 << " ms] => " << stage2Size;
+            ss << " [" << (bi->_time3 - bi->_time2) / 1000000 << " ms]";
 
             // Add compression ratio for encoding
             if ((_type == InfoPrinter::ENCODING) && (bi->_stage0Size != 0)) {
@@ -140,6 +155,34 @@ void InfoPrinter::processEvent(const Event& evt)
         delete bi;
         _map[hash(currentBlockId)] = nullptr;
     }
+    else if (evt.getType() == Event::BEFORE_TRANSFORM_STAGE) {
+        BlockInfo* bi = _map[hash(currentBlockId)];
+
+        if (bi == nullptr)
+            return;
+
+        bi->_stageTime = evt.getWallTime();
+
+        if (_level >= 5) {
+            _os << evt.toString() << endl;
+        }
+    }
+    else if (evt.getType() == Event::AFTER_TRANSFORM_STAGE) {
+        BlockInfo* bi = _map[hash(currentBlockId)];
+
+        if ((bi == nullptr) || (_level < 5))
+            return;
+
+        // Duration of one transform of the sequence (e.g. BWT in TEXT+BWT)
+        stringstream ss;
+        ss << evt.toString() << " [" << std::fixed << std::setprecision(3);
+        ss << double(evt.getWallTime() - bi->_stageTime) / 1000000.0 << " ms]";
+        _os << ss.str() << endl;
+    }
+    else if ((evt.getType() >= Event::BEFORE_WAIT) && (evt.getType() <= Event::AFTER_WRITE)) {
+        // Wait and I/O events are too frequent to be displayed (see TraceWriter)
+        return;
+    }
     else if ((evt.getType() == Event::AFTER_HEADER_DECODING) && (_level >= 3)) {
         _os << evt.toString() << endl;
     }
@@ -17,9 +17,9 @@ limitations under the License.
 #ifndef _InfoPrinter_
 #define _InfoPrinter_
 
+#include <string>
 #include "../Listener.hpp"
 #include "../OutputStream.hpp"
-#include "../util/Clock.hpp"
 
 
 namespace kanzi
@@ -27,8 +27,14 @@ namespace kanzi
 
    class BlockInfo {
    public:
+       int64 _time0; // wall clock times (in ns) of the block events
+       int64 _time1;
+       int64 _time2;
+       int64 _time3;
+       int64 _stageTime; // start of current transform stage
        int64 _stage0Size;
        int64 _stage1Size;
+       std::string _types; // transform&entropy of the block if chosen per block
    };
 
    // An implementation of Listener to display block information (verbose option
@@ -52,10 +58,7 @@ namespace kanzi
        Event::Type _thresholds[6];
        InfoPrinter::Type _type;
        int _level;
-       Clock _clock12;
-       Clock _clock23;
-       Clock _clock34;
-	   
+
        static int hash(int id) { return (id * 0x1E35A7BD) & 0x03FF; }
    };
 }
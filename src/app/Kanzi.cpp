@@ -17,6 +17,7 @@ limitations under the License.
 #include <iostream>
 #include <map>
 
+#include "BlockBenchmark.hpp"
 #include "BlockCompressor.hpp"
 #include "BlockDecompressor.hpp"
 #include "../Error.hpp"
@@ -72,11 +73,27 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
    log.println("   -h, --help", true);
    log.println("        Display this message\n", true);
 
-   if ((mode.compare(0, 1, "c") != 0) && (mode.compare(0, 1, "d") != 0)) {
+   if ((mode.compare(0, 1, "c") != 0) && (mode.compare(0, 1, "d") != 0) && (mode.compare(0, 1, "b") != 0)) {
        log.println("   -c, --compress", true);
        log.println("        Compress mode\n", true);
        log.println("   -d, --decompress", true);
        log.println("        Decompress mode\n", true);
+       log.println("   --bench[=<iterations>]", true);
+       log.println("        Benchmark mode (see --bench --help)\n", true);
+   }
+
+   if (mode.compare(0, 1, "b") == 0) {
+       log.println("   --bench[=<iterations>]", true);
+       log.println("        Benchmark mode. Load the input files in memory, then compress and", true);
+       log.println("        decompress them <iterations> times (default 5) per configuration.", true);
+       log.println("        Each round trip is verified. Report the ratio, the median compression", true);
+       log.println("        and decompression throughputs (MB/s) and the memory used.", true);
+       log.println("        A configuration is a level or a transform and an entropy codec", true);
+       log.println("        combined with a block size. Lists are accepted:", true);
+       log.println("        -l 1,3,5-7 or -t BWT+SRT,LZX -e FPAQ,HUFFMAN and -b 1m,4m", true);
+       log.println("        (default level 3). Use --stats=json to get the results as JSON.\n", true);
+       log.println("   --warmup=<iterations>", true);
+       log.println("        Number of iterations run before measuring (default 1).\n", true);
    }
 
    log.println("   -i, --input=<inputName>", true);
@@ -134,6 +151,20 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
        log.println("        Enable block checksum\n", true);
        log.println("   -s, --skip", true);
        log.println("        Copy blocks with high entropy instead of compressing them.\n", true);
+       log.println("   --substreams", true);
+       log.println("        Split the CM/TPAQ/TPAQX coding of each block into sub-streams of", true);
+       log.println("        4 MB or more coded concurrently (faster with several jobs). The ratio", true);
+       log.println("        drops a lot when the block repeats content across sub-streams", true);
+       log.println("        (up to several times bigger output).\n", true);
+       log.println("   --lz-depth=<depth>", true);
+       log.println("        Maximum number of match candidates checked by the LZ and LZX encoders", true);
+       log.println("        (default is 1). Higher values improve the ratio at the expense of", true);
+       log.println("        compression speed. The decompression speed is unchanged.\n", true);
+       log.println("   --adaptive[=<MB/s>]", true);
+       log.println("        Choose the transform and entropy codec of each block among the levels", true);
+       log.println("        to compress at the provided throughput (the level is then the highest", true);
+       log.println("        level used). Without a value, use higher levels when writing to the", true);
+       log.println("        output stalls (the level is then the lowest level used).\n", true);
    }
 
    log.println("   -j, --jobs=<jobs>", true);
@@ -154,10 +185,22 @@ void printHelp(Printer& log, const string& mode, bool showHeader)
    log.println("   --rm", true);
    log.println("        Remove the input file after successful (de)compression.", true);
    log.println("        If the input is a folder, all processed files under the folder are removed.\n", true);
+   log.println("   --huge-pages", true);
+   log.println("        Back the big buffers and tables (block buffers, BWT, TPAQ, ...) with", true);
+   log.println("        2 MB huge pages when available (Linux, best effort).\n", true);
    log.println("   --no-link", true);
    log.println("        Skip links\n", true);
    log.println("   --no-dot-file", true);
    log.println("        Skip dot files\n", true);
+   log.println("   --stats=json", true);
+   log.println("        Print run statistics as JSON at the end of the run (to stderr when the", true);
+   log.println("        output is 'stdout'): per file and per block sizes, ratios, stage", true);
+   log.println("        throughputs (MB/s), skipped transforms and blocks, peak RSS and", true);
+   log.println("        thread utilization. The other messages then go to stderr.\n", true);
+   log.println("   --trace=<traceFile>", true);
+   log.println("        Record the timeline of block processing (transforms, entropy coding,", true);
+   log.println("        waits, reads and writes) per thread in a Chrome Trace Event JSON file", true);
+   log.println("        (open with chrome://tracing or https://ui.perfetto.dev).\n", true);
 
    if (mode.compare(0, 1, "d") == 0) {
        log.println("   --from=blockId", true);
@@ -266,6 +309,93 @@ bool toInt(string& s, int& res)
    return true;
 }
 
+// Parse a block size with an optional K, M or G suffix (upper case)
+bool toBlockSize(string& s, int& res)
+{
+   uint64 scale = 1;
+   const char lastChar = (s.length() == 0) ? 0 : s[s.length() - 1];
+
+   // Process K or M or G suffix
+   if ('K' == lastChar) {
+       scale = 1024;
+       s.resize(s.length() - 1);
+   }
+   else if ('M' == lastChar) {
+       scale = 1024 * 1024;
+       s.resize(s.length() - 1);
+   }
+   else if ('G' == lastChar) {
+       scale = 1024 * 1024 * 1024;
+       s.resize(s.length() - 1);
+   }
+
+   if ((s.length() == 0) || (toInt(s, res) == false))
+      return false;
+
+   res = int(uint64(res) * scale);
+   return true;
+}
+
+// Parse a comma separated list of levels or ranges (EG. 1,3,5-7) into
+// a comma separated list of levels (EG. 1,3,5,6,7)
+bool toLevelList(const string& s, string& res)
+{
+   stringstream ss;
+   size_t start = 0;
+
+   while (start < s.length()) {
+      size_t end = s.find(',', start);
+
+      if (end == string::npos)
+         end = s.length();
+
+      string token = s.substr(start, end - start);
+      const size_t dash = token.find('-');
+      string first = (dash == string::npos) ? token : token.substr(0, dash);
+      string last = (dash == string::npos) ? token : token.substr(dash + 1);
+      int lo, hi;
+
+      if ((toInt(first, lo) == false) || (toInt(last, hi) == false) || (first.length() == 0) ||
+          (last.length() == 0) || (lo > hi) || (hi > 9))
+         return false;
+
+      for (int l = lo; l <= hi; l++)
+         ss << ((ss.tellp() > 0) ? "," : "") << l;
+
+      start = end + 1;
+   }
+
+   res = ss.str();
+   return res.length() > 0;
+}
+
+// Parse a comma separated list of block sizes (EG. 1M,4M) into a comma
+// separated list of sizes in bytes
+bool toBlockSizeList(const string& s, string& res)
+{
+   stringstream ss;
+   size_t start = 0;
+
+   while (start < s.length()) {
+      size_t end = s.find(',', start);
+
+      if (end == string::npos)
+         end = s.length();
+
+      string token = s.substr(start, end - start);
+      int bl;
+
+      if (toBlockSize(token, bl) == false)
+         return false;
+
+      ss << ((ss.tellp() > 0) ? "," : "") << bl;
+      start = end + 1;
+   }
+
+   res = ss.str();
+   return res.length() > 0;
+}
+
 int processCommandLine(int argc, const char* argv[], Context& map)
 {
     string inputName;
@@ -277,8 +407,18 @@ int processCommandLine(int argc, const char* argv[], Context& map)
     int reorder = -1;
     int noDotFiles = -1;
     int noLinks = -1;
+    int hugePages = -1;
+    int subStreams = -1;
+    int lzDepth = -1;
+    int adaptive = -1;
     string codec;
     string transf;
+    string traceFile;
+    string stats;
+    string levels; // benchmark only
+    string blockSizes; // benchmark only
+    int iterations = -1;
+    int warmup = -1;
     bool verboseFlag = false;
     int verbose = 1;
     int ctx = -1;
@@ -289,7 +429,17 @@ int processCommandLine(int argc, const char* argv[], Context& map)
     int blockSize = -1;
     int autoBlockSize = -1;
     string mode;
-    Printer log(cout); 
+    bool jsonStats = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        trim(arg);
+        transform(arg.begin(), arg.end(), arg.begin(), ::tolower);
+        jsonStats |= (arg == "--stats=json");
+    }
+
+    // Keep stdout for the JSON statistics (--stats=json)
+    Printer log(jsonStats ? cerr : cout);
     bool showHeader = true;
     bool showHelp = false;
 
@@ -319,6 +469,11 @@ int processCommandLine(int argc, const char* argv[], Context& map)
                 return Error::ERR_INVALID_PARAM;
             }
 
+            if (mode == "b") {
+                cerr << "Both compression and benchmark options were provided." << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
             mode = "c";
             continue;
         }
@@ -329,10 +484,25 @@ int processCommandLine(int argc, const char* argv[], Context& map)
                 return Error::ERR_INVALID_PARAM;
             }
 
+            if (mode == "b") {
+                cerr << "Both decompression and benchmark options were provided." << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
             mode = "d";
             continue;
         }
 
+        if ((arg == "--bench") || (arg.compare(0, 8, "--bench=") == 0)) {
+            if ((mode == "c") || (mode == "d")) {
+                cerr << "Both " << (mode == "c" ? "compression" : "decompression") << " and benchmark options were provided." << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            mode = "b";
+            continue;
+        }
+
         if ((ctx == ARG_IDX_VERBOSE) || (arg.compare(0, 10, "--verbose=") == 0)) {
            if (verboseFlag == true) {
                 WARNING_OPT_DUPLICATE("verbosity level", arg);
@@ -409,7 +579,7 @@ int processCommandLine(int argc, const char* argv[], Context& map)
            arg = arg.substr(k);
         }
 
-        if ((arg == "-c") || (arg == "-d") || (arg == "--compress") || (arg == "--decompress")) {
+        if ((arg == "-c") || (arg == "-d") || (arg == "--compress") || (arg == "--decompress") || (arg == "--bench")) {
             if (ctx != -1) {
                 WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
             }
@@ -418,6 +588,41 @@ int processCommandLine(int argc, const char* argv[], Context& map)
             continue;
         }
 
+        if ((arg.compare(0, 8, "--bench=") == 0) && (ctx == -1)) {
+            arg = arg.substr(8);
+
+            if (iterations >= 0) {
+                WARNING_OPT_DUPLICATE("iterations", arg);
+            } else {
+                if ((toInt(arg, iterations) == false) || (iterations < 1)) {
+                    cerr << "Invalid number of benchmark iterations provided on command line: " << arg << endl;
+                    return Error::ERR_INVALID_PARAM;
+                }
+            }
+
+            continue;
+        }
+
+        if ((arg.compare(0, 9, "--warmup=") == 0) && (ctx == -1)) {
+            arg = arg.substr(9);
+
+            if (mode != "b"){
+                log.println("Warning: ignoring warm-up iterations (only valid for benchmark)", verbose > 0);
+                continue;
+            }
+
+            if (warmup >= 0) {
+                WARNING_OPT_DUPLICATE("warm-up iterations", arg);
+            } else {
+                if ((toInt(arg, warmup) == false) || (arg.length() == 0)) {
+                    cerr << "Invalid number of warm-up iterations provided on command line: " << arg << endl;
+                    return Error::ERR_INVALID_PARAM;
+                }
+            }
+
+            continue;
+        }
+
         if ((arg == "--force") || (arg == "-f")) {
             if (ctx != -1) {
                 WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
@@ -458,6 +663,16 @@ int processCommandLine(int argc, const char* argv[], Context& map)
             continue;
         }
 
+        if (arg == "--huge-pages") {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+
+            hugePages = 1;
+            ctx = -1;
+            continue;
+        }
+
         if (arg == "--no-file-reorder") {
             if (ctx != -1) {
                 WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
@@ -494,6 +709,16 @@ int processCommandLine(int argc, const char* argv[], Context& map)
             continue;
         }
 
+        if (arg == "--substreams") {
+            if (ctx != -1) {
+                WARNING_OPT_NOVALUE(CMD_LINE_ARGS[ctx]);
+            }
+
+            ctx = -1;
+            subStreams = 1;
+            continue;
+        }
+
         if (ctx == -1) {
             for (int j = 0; j < 10; j++) {
                 if (arg == CMD_LINE_ARGS[j]) {
@@ -591,7 +816,7 @@ int processCommandLine(int argc, const char* argv[], Context& map)
         }
 
         if ((ctx == ARG_IDX_LEVEL) || (arg.compare(0, 8, "--level=") == 0)) {
-            if (mode != "c"){
+            if ((mode != "c") && (mode != "b")) {
                 log.println("Warning: ignoring level (only valid for compression)", verbose > 0);
                 ctx = -1;
                 continue;
@@ -600,8 +825,13 @@ int processCommandLine(int argc, const char* argv[], Context& map)
             if (ctx != ARG_IDX_LEVEL)
                arg = arg.substr(8);
 
-            if (level >= 0) {
+            if ((level >= 0) || (levels.length() > 0)) {
                 WARNING_OPT_DUPLICATE("level", arg);
+            } else if (mode == "b") {
+                if (toLevelList(arg, levels) == false) {
+                    cerr << "Invalid compression levels provided on command line: " << arg << endl;
+                    return Error::ERR_INVALID_PARAM;
+                }
             } else {
                 if ((toInt(arg, level) == false) || ((level < 0) || (level > 9))) {
                     cerr << "Invalid compression level provided on command line: " << arg << endl;
@@ -622,7 +852,7 @@ int processCommandLine(int argc, const char* argv[], Context& map)
                 return Error::ERR_INVALID_PARAM;
             }
 
-            if ((blockSize >= 0) || (autoBlockSize >= 0)) {
+            if ((blockSize >= 0) || (autoBlockSize >= 0) || (blockSizes.length() > 0)) {
                 WARNING_OPT_DUPLICATE("block size", arg);
                 ctx = -1;
                 continue;
@@ -630,36 +860,20 @@ int processCommandLine(int argc, const char* argv[], Context& map)
 
             transform(arg.begin(), arg.end(), arg.begin(), ::toupper);
 
-            if (arg == "AUTO") {
+            if (mode == "b") {
+                if (toBlockSizeList(arg, blockSizes) == false) {
+                    cerr << "Invalid block sizes provided on command line: " << arg << endl;
+                    return Error::ERR_INVALID_PARAM;
+                }
+            }
+            else if (arg == "AUTO") {
                 autoBlockSize = 1;
             }
             else {
-                uint64 scale = 1;
-                char lastChar = arg[arg.length() - 1];
-
-                // Process K or M or G suffix
-                if ('K' == lastChar) {
-                    scale = 1024;
-                    arg.resize(arg.length() - 1);
-                }
-                else if ('M' == lastChar) {
-                    scale = 1024 * 1024;
-                    arg.resize(arg.length() - 1);
-                }
-                else if ('G' == lastChar) {
-                    scale = 1024 * 1024 * 1024;
-                    arg.resize(arg.length() - 1);
-                }
-
-                if (toInt(arg, blockSize) == false) {
+                if (toBlockSize(arg, blockSize) == false) {
                     cerr << "Invalid block size provided on command line: " << arg << endl;
                     return Error::ERR_INVALID_PARAM;
                 }
-
-                stringstream ss1;
-                ss1 << arg;
-                ss1 >> blockSize;
-                blockSize = int(uint64(blockSize) * scale);
             }
 
             ctx = -1;
@@ -685,6 +899,82 @@ int processCommandLine(int argc, const char* argv[], Context& map)
             continue;
         }
 
+        if (((arg == "--adaptive") || (arg.compare(0, 11, "--adaptive=") == 0)) && (ctx == -1)) {
+            arg = (arg.length() > 10) ? arg.substr(11) : "0";
+
+            if (mode != "c"){
+                log.println("Warning: ignoring adaptive mode (only valid for compression)", verbose > 0);
+                continue;
+            }
+
+            if (adaptive >= 0) {
+                WARNING_OPT_DUPLICATE("adaptive mode", arg);
+            } else {
+                if ((toInt(arg, adaptive) == false) || (adaptive < 0)) {
+                    cerr << "Invalid adaptive throughput provided on command line: " << arg << endl;
+                    return Error::ERR_INVALID_PARAM;
+                }
+            }
+
+            continue;
+        }
+
+        if ((arg.compare(0, 11, "--lz-depth=") == 0) && (ctx == -1)) {
+            arg = arg.substr(11);
+
+            if (mode != "c"){
+                log.println("Warning: ignoring LZ search depth (only valid for compression)", verbose > 0);
+                continue;
+            }
+
+            if (lzDepth >= 0) {
+                WARNING_OPT_DUPLICATE("LZ search depth", arg);
+            } else {
+                if ((toInt(arg, lzDepth) == false) || (lzDepth < 1)) {
+                    cerr << "Invalid LZ search depth provided on command line: " << arg << endl;
+                    return Error::ERR_INVALID_PARAM;
+                }
+            }
+
+            continue;
+        }
+
+        if ((arg.compare(0, 8, "--stats=") == 0) && (ctx == -1)) {
+            arg = arg.substr(8);
+
+            if (stats.length() > 0) {
+                WARNING_OPT_DUPLICATE("stats format", arg);
+            } else {
+                transform(arg.begin(), arg.end(), arg.begin(), ::tolower);
+
+                if (arg != "json") {
+                    cerr << "Invalid stats format provided on command line: " << arg << endl;
+                    return Error::ERR_INVALID_PARAM;
+                }
+
+                stats = arg;
+            }
+
+            continue;
+        }
+
+        if ((arg.compare(0, 8, "--trace=") == 0) && (ctx == -1)) {
+            arg = arg.substr(8);
+
+            if (traceFile.length() > 0) {
+                WARNING_OPT_DUPLICATE("trace file", arg);
+            } else {
+                if (arg.length() == 0) {
+                    cerr << "Invalid trace file provided on command line: " << arg << endl;
+                    return Error::ERR_INVALID_PARAM;
+                }
+
+                traceFile = arg;
+            }
+
+            continue;
+        }
+
         if ((arg.compare(0, 7, "--from=") == 0) && (ctx == -1)) {
             arg = arg.substr(7);
 
@@ -745,6 +1035,11 @@ int processCommandLine(int argc, const char* argv[], Context& map)
         log.println(ss.str(), verbose > 0);
     }
 
+    if ((adaptive >= 0) && (level < 0) && ((codec.length() > 0) || (transf.length() > 0))) {
+        cerr << "The adaptive mode chooses the transform and entropy codec: use the 'level' option instead" << endl;
+        return Error::ERR_INVALID_PARAM;
+    }
+
     if (level >= 0) {
         if (codec.length() > 0) {
             stringstream ss;
@@ -800,6 +1095,36 @@ int processCommandLine(int argc, const char* argv[], Context& map)
     if (noLinks == 1)
         map.putInt("noLinks", 1);
 
+    if (hugePages == 1)
+        map.putInt("hugePages", 1);
+
+    if (subStreams == 1)
+        map.putInt("entropySubStreams", 1);
+
+    if (lzDepth > 0)
+        map.putInt("lzSearchDepth", lzDepth);
+
+    if (adaptive >= 0)
+        map.putInt("adaptive", adaptive);
+
+    if (traceFile.length() > 0)
+        map.putString("traceFile", traceFile);
+
+    if (stats.length() > 0)
+        map.putString("stats", stats);
+
+    if (levels.length() > 0)
+        map.putString("levels", levels);
+
+    if (blockSizes.length() > 0)
+        map.putString("blockSizes", blockSizes);
+
+    if (iterations > 0)
+        map.putInt("iterations", iterations);
+
+    if (warmup >= 0)
+        map.putInt("warmup", warmup);
+
     if (from >= 0)
         map.putInt("from", from);
 
@@ -850,7 +1175,7 @@ int main(int argc, const char* argv[])
             const int verbosity = args.getInt("verbosity");
             stringstream ss;
             ss << "Warning: the number of jobs is  limited to 1 in this version";
-            Printer log(cout);
+            Printer log((args.getString("stats") == "json") ? cerr : cout);
             log.println(ss.str(), verbosity > 0);
         }
 
@@ -869,7 +1194,7 @@ int main(int argc, const char* argv[])
             const int verbosity = args.getInt("verbosity");
             stringstream ss;
             ss << "Warning: the number of jobs is too high, defaulting to " << MAX_CONCURRENCY;
-            Printer log(cout);
+            Printer log((args.getString("stats") == "json") ? cerr : cout);
             log.println(ss.str(), verbosity > 0);
             jobs = MAX_CONCURRENCY;
         }
@@ -905,6 +1230,18 @@ int main(int argc, const char* argv[])
             }
         }
 
+        if (mode == "b") {
+            try {
+                BlockBenchmark bb(ctx);
+                int code = bb.run();
+                exit(code);
+            }
+            catch (exception& e) {
+                cerr << "Could not create the benchmark: " << e.what() << endl;
+                exit(Error::ERR_INVALID_PARAM);
+            }
+        }
+
         cout << "Missing arguments: try --help or -h" << endl;
         return Error::ERR_MISSING_PARAM;
     }
@@ -0,0 +1,552 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include "StatsCollector.hpp"
+
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+   #include <windows.h>
+   #include <psapi.h>
+
+   #ifdef _MSC_VER
+      #pragma comment(lib, "psapi.lib")
+   #endif
+#else
+   #include <sys/resource.h>
+
+   #ifdef __linux__
+      #include <malloc.h>
+   #endif
+#endif
+
+using namespace kanzi;
+using namespace std;
+
+
+BlockStats::BlockStats()
+    : _inputSize(0)
+    , _stage1Size(0)
+    , _outputSize(0)
+    , _transformStart(0)
+    , _transformTime(0)
+    , _entropyStart(0)
+    , _entropyTime(0)
+    , _waitStart(0)
+    , _waitTime(0)
+    , _stageStart(0)
+    , _transformCpuStart(0)
+    , _transformCpuTime(0)
+    , _entropyCpuStart(0)
+    , _entropyCpuTime(0)
+    , _waitCpuStart(0)
+    , _waitCpuTime(0)
+    , _stageCpuStart(0)
+    , _memoryPeak(-1)
+    , _skipFlags(-1)
+    , _copyBlock(false)
+{
+    for (int i = 0; i < MemoryUsage::NB_STAGES; i++)
+        _memoryStagePeaks[i] = 0;
+}
+
+StatsCollector::StatsCollector(StatsCollector::Type type)
+    : _type(type)
+    , _startTime(0)
+    , _endTime(0)
+{
+}
+
+void StatsCollector::processEvent(const Event& evt)
+{
+    const Event::Type type = evt.getType();
+    const int64 t = evt.getWallTime();
+    const int64 c = evt.getCpuTime();
+
+    switch (type) {
+    case Event::COMPRESSION_START:
+    case Event::DECOMPRESSION_START:
+        _startTime = t;
+        return;
+
+    case Event::COMPRESSION_END:
+    case Event::DECOMPRESSION_END:
+        _endTime = t;
+        return;
+
+    case Event::BEFORE_TRANSFORM:
+    case Event::AFTER_TRANSFORM:
+    case Event::BEFORE_ENTROPY:
+    case Event::AFTER_ENTROPY:
+    case Event::BEFORE_WAIT:
+    case Event::AFTER_WAIT:
+    case Event::BEFORE_TRANSFORM_STAGE:
+    case Event::AFTER_TRANSFORM_STAGE:
+        if (evt.getId() >= 0)
+            break;
+
+        return;
+
+    default:
+        // File reads/writes, header
+        return;
+    }
+
+#ifdef CONCURRENCY_ENABLED
+    lock_guard<mutex> lock(_mutex);
+#endif
+    BlockStats& b = _blocks[evt.getId()];
+
+    if (evt.getSkipFlags() >= 0) {
+        b._skipFlags = evt.getSkipFlags();
+        b._copyBlock = evt.isCopyBlock();
+    }
+
+    if (evt.getTransform().length() > 0) {
+        b._transform = evt.getTransform();
+        b._entropy = evt.getEntropy();
+    }
+
+    if (evt.getMemoryUsage() != nullptr) {
+        const MemoryUsage* mu = evt.getMemoryUsage();
+        b._memoryPeak = mu->_peakTotal;
+
+        for (int i = 0; i < MemoryUsage::NB_STAGES; i++)
+            b._memoryStagePeaks[i] = mu->_peak[i];
+    }
+
+    switch (type) {
+    case Event::BEFORE_TRANSFORM:
+        b._transformStart = t;
+        b._transformCpuStart = c;
+
+        if (_type == StatsCollector::ENCODING)
+            b._inputSize = evt.getSize();
+        else
+            b._stage1Size = evt.getSize();
+
+        break;
+
+    case Event::AFTER_TRANSFORM:
+        // The decoder may report the end of stream (no transform) as a block
+        if (b._transformStart == 0)
+            break;
+
+        b._transformTime += (t - b._transformStart);
+        b._transformCpuTime += (c - b._transformCpuStart);
+
+        if (_type == StatsCollector::ENCODING)
+            b._stage1Size = evt.getSize();
+        else
+            b._outputSize = evt.getSize();
+
+        break;
+
+    case Event::BEFORE_ENTROPY:
+        b._entropyStart = t;
+        b._entropyCpuStart = c;
+        break;
+
+    case Event::AFTER_ENTROPY:
+        b._entropyTime += (t - b._entropyStart);
+        b._entropyCpuTime += (c - b._entropyCpuStart);
+
+        // The encoder waits (spinning) for the previous block before emitting AFTER_ENTROPY
+        if (b._waitStart >= b._entropyStart) {
+            b._entropyTime -= b._waitTime;
+            b._entropyCpuTime -= b._waitCpuTime;
+        }
+
+        if (_type == StatsCollector::ENCODING)
+            b._outputSize = evt.getSize();
+        else
+            b._inputSize = evt.getSize();
+
+        break;
+
+    case Event::BEFORE_WAIT:
+        b._waitStart = t;
+        b._waitCpuStart = c;
+        break;
+
+    case Event::AFTER_WAIT:
+        b._waitTime = t - b._waitStart;
+        b._waitCpuTime = c - b._waitCpuStart;
+        break;
+
+    case Event::BEFORE_TRANSFORM_STAGE:
+        b._stageStart = t;
+        b._stageCpuStart = c;
+        _stages[make_pair(evt.getStage(), evt.getName())]._size += evt.getSize();
+        break;
+
+    case Event::AFTER_TRANSFORM_STAGE: {
+        StageStats& s = _stages[make_pair(evt.getStage(), evt.getName())];
+        s._time += (t - b._stageStart);
+        s._cpuTime += (c - b._stageCpuStart);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+// In MB/s (1 MB = 1048576 bytes)
+static double throughput(int64 size, int64 ns)
+{
+    return (ns <= 0) ? 0.0 : double(size) * 1e9 / (double(ns) * 1048576.0);
+}
+
+// Names of the transforms in a sequence (EG. TEXT+BWT)
+static void splitTransform(const string& transform, vector<string>& names)
+{
+    size_t prv = 0;
+    names.clear();
+
+    while (prv <= transform.length()) {
+        size_t pos = transform.find('+', prv);
+
+        if (pos == string::npos)
+            pos = transform.length();
+
+        names.push_back(transform.substr(prv, pos - prv));
+        prv = pos + 1;
+    }
+}
+
+string StatsCollector::toJSON(const string& fileName, uint64 inputSize, uint64 outputSize,
+    const string& transform, const string& entropy)
+{
+#ifdef CONCURRENCY_ENABLED
+    lock_guard<mutex> lock(_mutex);
+#endif
+    vector<string> fileNames;
+    vector<string> blockNames;
+    splitTransform(transform, fileNames);
+
+    const int64 time = _endTime - _startTime;
+    const uint64 rawSize = (_type == StatsCollector::ENCODING) ? inputSize : outputSize;
+    const uint64 packedSize = (_type == StatsCollector::ENCODING) ? outputSize : inputSize;
+    int64 transformCpuTime = 0;
+    int64 entropyCpuTime = 0;
+    int64 transformSize = 0;
+    int64 entropySize = 0;
+    int64 memoryPeak = -1;
+    int copied = 0;
+    int nbBlocks = 0;
+    map<pair<int, string>, int> applied; // per stage index and name
+    map<pair<int, string>, int> skipped;
+    map<pair<string, string>, int> blockTypes; // blocks per transform and entropy codec
+    stringstream ss;
+    stringstream sb;
+    ss << fixed << setprecision(3);
+    sb << fixed << setprecision(3);
+
+    for (map<int, BlockStats>::const_iterator it = _blocks.begin(); it != _blocks.end(); ++it) {
+        const BlockStats& b = it->second;
+
+        // Skip end of stream (no data)
+        if ((b._inputSize == 0) && (b._outputSize == 0))
+            continue;
+
+        nbBlocks++;
+        const int64 rawBlockSize = (_type == StatsCollector::ENCODING) ? b._inputSize : b._outputSize;
+        const int64 packedBlockSize = (_type == StatsCollector::ENCODING) ? b._outputSize : b._inputSize;
+        transformCpuTime += b._transformCpuTime;
+        entropyCpuTime += b._entropyCpuTime;
+        transformSize += rawBlockSize;
+        entropySize += b._stage1Size;
+
+        if (b._copyBlock == true)
+            copied++;
+
+        if (b._transform.length() > 0) {
+            blockTypes[make_pair(b._transform, b._entropy)]++;
+            splitTransform(b._transform, blockNames);
+        }
+
+        const vector<string>& names = (b._transform.length() > 0) ? blockNames : fileNames;
+
+        if (nbBlocks > 1)
+            sb << ",";
+
+        sb << "\n    {\"id\":" << it->first;
+        sb << ",\"inputSize\":" << b._inputSize;
+        sb << ",\"stage1Size\":" << b._stage1Size;
+        sb << ",\"outputSize\":" << b._outputSize;
+
+        if (rawBlockSize > 0)
+            sb << ",\"ratio\":" << double(packedBlockSize) / double(rawBlockSize);
+
+        sb << ",\"transformTime\":" << double(b._transformTime) / 1e6;
+        sb << ",\"transformCpuTime\":" << double(b._transformCpuTime) / 1e6;
+        sb << ",\"transformThroughput\":" << throughput(rawBlockSize, b._transformCpuTime);
+        sb << ",\"entropyTime\":" << double(b._entropyTime) / 1e6;
+        sb << ",\"entropyCpuTime\":" << double(b._entropyCpuTime) / 1e6;
+        sb << ",\"entropyThroughput\":" << throughput(b._stage1Size, b._entropyCpuTime);
+        sb << ",\"waitTime\":" << double(b._waitTime) / 1e6;
+        sb << ",\"copy\":" << (b._copyBlock ? "true" : "false");
+
+        if (b._transform.length() > 0) {
+            sb << ",\"transform\":\"" << escape(b._transform) << "\"";
+            sb << ",\"entropy\":\"" << escape(b._entropy) << "\"";
+        }
+
+        if (b._memoryPeak >= 0) {
+            memoryPeak = max(memoryPeak, b._memoryPeak);
+            sb << ",\"memoryPeak\":" << b._memoryPeak;
+
+            for (int i = 0; i < MemoryUsage::NB_STAGES; i++)
+                sb << ",\"" << MemoryUsage::getStageName(i) << "MemoryPeak\":" << b._memoryStagePeaks[i];
+        }
+
+        if (b._skipFlags >= 0) {
+            sb << ",\"skipFlags\":" << b._skipFlags << ",\"skipped\":[";
+            bool first = true;
+
+            for (int i = 0; (i < 8) && (i < int(names.size())); i++) {
+                if (b._copyBlock == true)
+                    break;
+
+                if (((b._skipFlags >> (7 - i)) & 1) == 0) {
+                    applied[make_pair(i, names[i])]++;
+                    continue;
+                }
+
+                skipped[make_pair(i, names[i])]++;
+                sb << (first ? "" : ",") << "\"" << escape(names[i]) << "\"";
+                first = false;
+            }
+
+            sb << "]";
+        }
+
+        sb << "}";
+    }
+
+    ss << "{\"name\":\"" << escape(fileName) << "\"";
+    ss << ",\"inputSize\":" << inputSize;
+    ss << ",\"outputSize\":" << outputSize;
+
+    if (rawSize > 0)
+        ss << ",\"ratio\":" << double(packedSize) / double(rawSize);
+
+    ss << ",\"time\":" << double(time) / 1e6;
+    ss << ",\"throughput\":" << throughput(int64(rawSize), time);
+    if (blockTypes.size() == 0) {
+        ss << ",\"transform\":\"" << escape(transform) << "\"";
+        ss << ",\"entropy\":\"" << escape(entropy) << "\"";
+    }
+    else {
+        ss << ",\"blockTypes\":[";
+
+        for (map<pair<string, string>, int>::const_iterator it = blockTypes.begin(); it != blockTypes.end(); ++it) {
+            if (it != blockTypes.begin())
+                ss << ",";
+
+            ss << "{\"transform\":\"" << escape(it->first.first) << "\"";
+            ss << ",\"entropy\":\"" << escape(it->first.second) << "\"";
+            ss << ",\"blockCount\":" << it->second << "}";
+        }
+
+        ss << "]";
+    }
+    ss << ",\"blockCount\":" << nbBlocks;
+    ss << ",\"copiedBlocks\":" << copied;
+    ss << ",\"transformCpuTime\":" << double(transformCpuTime) / 1e6;
+    ss << ",\"transformThroughput\":" << throughput(transformSize, transformCpuTime);
+    ss << ",\"entropyCpuTime\":" << double(entropyCpuTime) / 1e6;
+    ss << ",\"entropyThroughput\":" << throughput(entropySize, entropyCpuTime);
+
+    // Max over the blocks (several blocks can be processed concurrently)
+    if (memoryPeak >= 0)
+        ss << ",\"blockMemoryPeak\":" << memoryPeak;
+
+    ss << ",\n   \"stages\":[";
+
+    for (map<pair<int, string>, StageStats>::const_iterator it = _stages.begin(); it != _stages.end(); ++it) {
+        const StageStats& s = it->second;
+
+        if (it != _stages.begin())
+            ss << ",";
+
+        ss << "\n    {\"index\":" << it->first.first << ",\"name\":\"" << escape(it->first.second) << "\"";
+        ss << ",\"time\":" << double(s._time) / 1e6;
+        ss << ",\"cpuTime\":" << double(s._cpuTime) / 1e6;
+        ss << ",\"throughput\":" << throughput(s._size, s._cpuTime);
+        ss << ",\"applied\":" << applied[it->first] << ",\"skipped\":" << skipped[it->first] << "}";
+    }
+
+    ss << "],\n   \"blocks\":[" << sb.str() << "]}";
+    return ss.str();
+}
+
+string StatsCollector::toJSON(StatsCollector::Type type, int jobs, uint64 inputSize,
+    uint64 outputSize, int64 time, int64 cpuTime, const string& files)
+{
+    const uint64 rawSize = (type == StatsCollector::ENCODING) ? inputSize : outputSize;
+    const uint64 packedSize = (type == StatsCollector::ENCODING) ? outputSize : inputSize;
+    stringstream ss;
+    ss << fixed << setprecision(3);
+    ss << "{\"mode\":\"" << ((type == StatsCollector::ENCODING) ? "compress" : "decompress") << "\"";
+    ss << ",\"jobs\":" << jobs;
+    ss << ",\"inputSize\":" << inputSize;
+    ss << ",\"outputSize\":" << outputSize;
+
+    if (rawSize > 0)
+        ss << ",\"ratio\":" << double(packedSize) / double(rawSize);
+
+    ss << ",\"time\":" << double(time) / 1e6;
+    ss << ",\"throughput\":" << throughput(int64(rawSize), time);
+    ss << ",\"cpuTime\":" << double(cpuTime) / 1e6;
+
+    if ((time > 0) && (jobs > 0))
+        ss << ",\"threadUtilization\":" << double(cpuTime) / (double(time) * double(jobs));
+
+    ss << ",\"peakRSS\":" << getPeakRSS();
+
+    const string memory = getMemoryUsageAsJSON();
+
+    if (memory.length() > 0)
+        ss << ",\n \"memory\":" << memory;
+
+    ss << ",\n \"files\":[\n  " << files << "]}";
+    return ss.str();
+}
+
+string StatsCollector::getMemoryUsageAsJSON()
+{
+    if (MemoryTracker::isEnabled() == false)
+        return "";
+
+    MemoryUsage mu;
+    MemoryTracker::getUsage(mu);
+    stringstream ss;
+    ss << "{\"peak\":" << mu._peakTotal << ",\"stages\":[";
+
+    for (int i = 0; i < MemoryUsage::NB_STAGES; i++) {
+        ss << ((i == 0) ? "" : ",");
+        ss << "{\"name\":\"" << MemoryUsage::getStageName(i) << "\"";
+        ss << ",\"peak\":" << mu._peak[i];
+        ss << ",\"allocated\":" << mu._allocated[i];
+        ss << ",\"allocations\":" << mu._allocations[i] << "}";
+    }
+
+    ss << "]}";
+    return ss.str();
+}
+
+int64 StatsCollector::getPeakRSS()
+{
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) != 0)
+        return int64(pmc.PeakWorkingSetSize);
+
+    return 0;
+#else
+   #ifdef __linux__
+    // VmHWM is reset by resetPeakRSS(), ru_maxrss is not
+    ifstream ifs("/proc/self/status");
+    string line;
+
+    while (getline(ifs, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return int64(atoll(line.c_str() + 6)) * 1024; // KB
+    }
+   #endif
+
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+
+   #ifdef __APPLE__
+    return int64(ru.ru_maxrss); // bytes
+   #else
+    return int64(ru.ru_maxrss) * 1024; // KB
+   #endif
+#endif
+}
+
+bool StatsCollector::resetPeakRSS()
+{
+#ifdef __linux__
+   #ifdef __GLIBC__
+    // Return the free heap memory to the system first, otherwise memory
+    // reused from the heap does not show in the next peak
+    malloc_trim(0);
+   #endif
+
+    // Set the peak RSS to the current RSS
+    ofstream ofs("/proc/self/clear_refs");
+
+    if (!ofs)
+        return false;
+
+    ofs << "5";
+    ofs.close();
+    return !ofs.fail();
+#else
+    return false;
+#endif
+}
+
+int64 StatsCollector::getProcessCpuTime()
+{
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+    FILETIME creation, exit, kernel, user;
+
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) == 0)
+        return 0;
+
+    // 100 ns units
+    const uint64 k = (uint64(kernel.dwHighDateTime) << 32) | uint64(kernel.dwLowDateTime);
+    const uint64 u = (uint64(user.dwHighDateTime) << 32) | uint64(user.dwLowDateTime);
+    return int64(k + u) * 100;
+#else
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+
+    return (int64(ru.ru_utime.tv_sec) + int64(ru.ru_stime.tv_sec)) * 1000000000 +
+        (int64(ru.ru_utime.tv_usec) + int64(ru.ru_stime.tv_usec)) * 1000;
+#endif
+}
+
+string StatsCollector::escape(const string& s)
+{
+    stringstream ss;
+
+    for (size_t i = 0; i < s.length(); i++) {
+        const char c = s[i];
+
+        if ((c == '"') || (c == '\\'))
+            ss << '\\' << c;
+        else if (uint8(c) < 0x20)
+            ss << "\\u" << hex << setw(4) << setfill('0') << int(c) << dec;
+        else
+            ss << c;
+    }
+
+    return ss.str();
+}
@@ -0,0 +1,127 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef _StatsCollector_
+#define _StatsCollector_
+
+#include <map>
+#include <string>
+#include <utility>
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
+#include "../Listener.hpp"
+
+
+namespace kanzi
+{
+
+   class BlockStats {
+   public:
+       int64 _inputSize; // block size before the first stage
+       int64 _stage1Size; // block size between transform and entropy coding
+       int64 _outputSize; // block size after the last stage
+       int64 _transformStart; // wall clock times in ns
+       int64 _transformTime;
+       int64 _entropyStart;
+       int64 _entropyTime;
+       int64 _waitStart;
+       int64 _waitTime; // waiting for the previous block during entropy coding
+       int64 _stageStart; // start of current transform stage
+       int64 _transformCpuStart; // thread CPU times in ns
+       int64 _transformCpuTime;
+       int64 _entropyCpuStart;
+       int64 _entropyCpuTime;
+       int64 _waitCpuStart;
+       int64 _waitCpuTime;
+       int64 _stageCpuStart;
+       int64 _memoryPeak; // peak of memory allocated for the block (-1 if not tracked)
+       int64 _memoryStagePeaks[MemoryUsage::NB_STAGES];
+       int _skipFlags;
+       bool _copyBlock;
+       std::string _transform; // types of the block if chosen per block (else empty)
+       std::string _entropy;
+
+       BlockStats();
+   };
+
+   class StageStats {
+   public:
+       int64 _size; // bytes processed
+       int64 _time; // wall clock time in ns
+       int64 _cpuTime; // thread CPU time in ns
+
+       StageStats() : _size(0), _time(0), _cpuTime(0) {}
+   };
+
+   // An implementation of Listener collecting per block and per transform statistics
+   // of one file (sizes, throughput, skipped transforms and blocks) and reporting
+   // them as a JSON object (--stats=json option of the BlockCompressor/BlockDecompressor).
+   // The throughputs of the transforms and entropy codecs are computed from the CPU
+   // time of the threads processing the blocks: with more jobs than cores, the wall
+   // clock time of a block includes the time its thread was not running.
+   class StatsCollector : public Listener {
+   public:
+       enum Type {
+           ENCODING,
+           DECODING
+       };
+
+       StatsCollector(StatsCollector::Type type);
+
+       ~StatsCollector() {}
+
+       void processEvent(const Event& evt);
+
+       // Return the statistics of the file as a JSON object. If the blocks have
+       // their own transform and entropy codec (adaptive mode), the count of
+       // blocks per types replaces the 'transform' and 'entropy' of the file.
+       std::string toJSON(const std::string& fileName, uint64 inputSize, uint64 outputSize,
+           const std::string& transform, const std::string& entropy);
+
+       // Return the JSON document for a run: totals, process statistics and
+       // the comma separated JSON objects of the files
+       static std::string toJSON(StatsCollector::Type type, int jobs, uint64 inputSize,
+           uint64 outputSize, int64 time, int64 cpuTime, const std::string& files);
+
+       // Peak resident set size of the process in bytes (0 if not available)
+       static int64 getPeakRSS();
+
+       // Reset the peak resident set size to the current value. Return false if
+       // not supported (Linux only).
+       static bool resetPeakRSS();
+
+       // Memory allocated by the streams, transforms and entropy codecs during
+       // the run as a JSON object (empty if MEMORY_TRACKING is not defined)
+       static std::string getMemoryUsageAsJSON();
+
+       // CPU time used by all the threads of the process in ns (0 if not available)
+       static int64 getProcessCpuTime();
+
+       static std::string escape(const std::string& s);
+
+   private:
+       StatsCollector::Type _type;
+       std::map<int, BlockStats> _blocks;
+       std::map<std::pair<int, std::string>, StageStats> _stages; // per index and name
+       int64 _startTime;
+       int64 _endTime;
+#ifdef CONCURRENCY_ENABLED
+       std::mutex _mutex;
+#endif
+   };
+}
+#endif
+
@@ -0,0 +1,273 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include "TraceWriter.hpp"
+
+using namespace kanzi;
+using namespace std;
+
+
+#ifdef CONCURRENCY_ENABLED
+ATOMIC_INT TraceWriter::_instances(0);
+#endif
+
+
+TraceBuffer::TraceBuffer(int logCapacity)
+{
+    _records = new TraceRecord[1 << logCapacity];
+    _count = 0;
+    _mask = (1 << logCapacity) - 1;
+}
+
+void TraceBuffer::add(const Event& evt)
+{
+    TraceRecord& r = _records[_count & _mask];
+    r._wallTime = evt.getWallTime();
+    r._cpuTime = evt.getCpuTime();
+    r._threadId = evt.getThreadId();
+    r._size = evt.getSize();
+    r._id = evt.getId();
+    r._stage = short(evt.getStage());
+    r._type = short(evt.getType());
+    const size_t n = min(evt.getName().length(), sizeof(r._name) - 1);
+    memcpy(r._name, evt.getName().data(), n);
+    r._name[n] = 0;
+    _count++;
+}
+
+static bool compareRecords(const TraceRecord& r1, const TraceRecord& r2)
+{
+    return r1._wallTime < r2._wallTime;
+}
+
+
+TraceWriter::TraceWriter(int logCapacity)
+{
+    _logCapacity = max(min(logCapacity, 24), 4);
+#ifdef CONCURRENCY_ENABLED
+    _uid = _instances.fetch_add(1);
+#else
+    _uid = 0;
+#endif
+}
+
+TraceWriter::~TraceWriter()
+{
+    for (size_t i = 0; i < _buffers.size(); i++)
+        delete _buffers[i];
+
+    _buffers.clear();
+}
+
+// Return the ring buffer owned by the calling thread
+TraceBuffer* TraceWriter::getBuffer()
+{
+#ifdef CONCURRENCY_ENABLED
+    static thread_local int owner = -1;
+    static thread_local TraceBuffer* buffer = nullptr;
+
+    if (owner == _uid)
+        return buffer;
+
+    // First event of this thread
+    lock_guard<mutex> lock(_mutex);
+    buffer = new TraceBuffer(_logCapacity);
+    _buffers.push_back(buffer);
+    owner = _uid;
+    return buffer;
+#else
+    if (_buffers.size() == 0)
+        _buffers.push_back(new TraceBuffer(_logCapacity));
+
+    return _buffers[0];
+#endif
+}
+
+void TraceWriter::processEvent(const Event& evt)
+{
+    getBuffer()->add(evt);
+}
+
+// Return the (positive) index of the span started by the event type or the
+// negative index of the span ended by the event type (0 if not a span).
+int TraceWriter::getSpan(int type, const char*& name, const char*& category)
+{
+    switch (type) {
+    case Event::COMPRESSION_START:
+    case Event::COMPRESSION_END:
+        name = "compress";
+        category = "file";
+        return (type == Event::COMPRESSION_START) ? 1 : -1;
+
+    case Event::DECOMPRESSION_START:
+    case Event::DECOMPRESSION_END:
+        name = "decompress";
+        category = "file";
+        return (type == Event::DECOMPRESSION_START) ? 2 : -2;
+
+    case Event::BEFORE_TRANSFORM:
+    case Event::AFTER_TRANSFORM:
+        name = "transform";
+        category = "block";
+        return (type == Event::BEFORE_TRANSFORM) ? 3 : -3;
+
+    case Event::BEFORE_TRANSFORM_STAGE:
+    case Event::AFTER_TRANSFORM_STAGE:
+        name = nullptr; // name of the transform
+        category = "transform";
+        return (type == Event::BEFORE_TRANSFORM_STAGE) ? 4 : -4;
+
+    case Event::BEFORE_ENTROPY:
+    case Event::AFTER_ENTROPY:
+        name = "entropy";
+        category = "block";
+        return (type == Event::BEFORE_ENTROPY) ? 5 : -5;
+
+    case Event::BEFORE_WAIT:
+    case Event::AFTER_WAIT:
+        name = "wait";
+        category = "block";
+        return (type == Event::BEFORE_WAIT) ? 6 : -6;
+
+    case Event::BEFORE_READ:
+    case Event::AFTER_READ:
+        name = "read";
+        category = nullptr; // block or file
+        return (type == Event::BEFORE_READ) ? 7 : -7;
+
+    case Event::BEFORE_WRITE:
+    case Event::AFTER_WRITE:
+        name = "write";
+        category = nullptr; // block or file
+        return (type == Event::BEFORE_WRITE) ? 8 : -8;
+
+    default:
+        return 0;
+    }
+}
+
+void TraceWriter::save(OutputStream& os) const
+{
+    vector<TraceRecord> records;
+    uint64 dropped = 0;
+
+    for (size_t i = 0; i < _buffers.size(); i++) {
+        const TraceBuffer& b = *_buffers[i];
+        const uint64 n = min(b._count, uint64(b._mask) + 1);
+
+        for (uint64 k = b._count - n; k < b._count; k++)
+            records.push_back(b._records[k & b._mask]);
+
+        dropped += b._count - n;
+    }
+
+    stable_sort(records.begin(), records.end(), compareRecords);
+    const int64 t0 = (records.size() == 0) ? 0 : records[0]._wallTime;
+    map<uint64, int> tids; // small thread ids in order of appearance
+    map<pair<uint64, uint64>, size_t> started; // index of span start events
+    bool first = true;
+    os << "{\"traceEvents\":[";
+    os << fixed << setprecision(3);
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const TraceRecord& r = records[i];
+        map<uint64, int>::iterator itt = tids.find(r._threadId);
+        int tid;
+
+        if (itt == tids.end()) {
+            tid = int(tids.size()) + 1;
+            tids[r._threadId] = tid;
+        }
+        else
+            tid = itt->second;
+
+        if (r._type == Event::AFTER_HEADER_DECODING) {
+            os << (first ? "\n" : ",\n");
+            os << "{\"name\":\"header\",\"cat\":\"file\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << tid;
+            os << ",\"ts\":" << double(r._wallTime - t0) / 1000.0 << "}";
+            first = false;
+            continue;
+        }
+
+        const char* name;
+        const char* category;
+        const int span = getSpan(r._type, name, category);
+
+        if (span == 0)
+            continue;
+
+        const uint64 key = (uint64(span < 0 ? -span : span) << 40) | (uint64(r._stage & 0xFF) << 32) | uint64(uint32(r._id));
+        const pair<uint64, uint64> k(r._threadId, key);
+
+        if (span > 0) {
+            started[k] = i;
+            continue;
+        }
+
+        map<pair<uint64, uint64>, size_t>::iterator its = started.find(k);
+
+        // Span start overwritten in ring buffer or task aborted
+        if (its == started.end())
+            continue;
+
+        const TraceRecord& s = records[its->second];
+        started.erase(its);
+        os << (first ? "\n" : ",\n");
+        os << "{\"name\":\"" << ((name == nullptr) ? r._name : name) << "\"";
+        os << ",\"cat\":\"" << ((category == nullptr) ? ((r._id >= 0) ? "block" : "file") : category) << "\"";
+        os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid;
+        os << ",\"ts\":" << double(s._wallTime - t0) / 1000.0;
+        os << ",\"dur\":" << double(r._wallTime - s._wallTime) / 1000.0;
+        os << ",\"args\":{";
+
+        if (r._id >= 0)
+            os << "\"block\":" << r._id << ",";
+
+        os << "\"in\":" << s._size << ",\"out\":" << r._size;
+        os << ",\"cpu\":" << double(r._cpuTime - s._cpuTime) / 1000.0 << "}}";
+        first = false;
+    }
+
+    for (map<uint64, int>::const_iterator it = tids.begin(); it != tids.end(); ++it) {
+        os << (first ? "\n" : ",\n");
+        os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << it->second;
+        os << ",\"args\":{\"name\":\"thread " << it->second << "\"}}";
+        first = false;
+    }
+
+    os << "\n],\"displayTimeUnit\":\"ms\"";
+
+    if (dropped != 0)
+        os << ",\"otherData\":{\"droppedEvents\":" << dropped << "}";
+
+    os << "}" << endl;
+}
+
+bool TraceWriter::save(const string& fileName) const
+{
+    ofstream ofs(fileName.c_str(), ofstream::out | ofstream::binary);
+
+    if (!ofs)
+        return false;
+
+    save(ofs);
+    ofs.close();
+    return !ofs.fail();
+}
@@ -0,0 +1,93 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef _TraceWriter_
+#define _TraceWriter_
+
+#include <string>
+#include <vector>
+#include "../concurrent.hpp"
+#include "../Listener.hpp"
+#include "../OutputStream.hpp"
+
+
+namespace kanzi
+{
+
+   // Compact copy of an event
+   class TraceRecord {
+   public:
+       int64 _wallTime;
+       int64 _cpuTime;
+       uint64 _threadId;
+       int64 _size;
+       int _id;
+       short _stage;
+       short _type;
+       char _name[8];
+   };
+
+   // Ring buffer of records appended by a single thread.
+   // When full, the oldest records are overwritten.
+   class TraceBuffer {
+   public:
+       TraceBuffer(int logCapacity);
+
+       ~TraceBuffer() { delete[] _records; }
+
+       void add(const Event& evt);
+
+       TraceRecord* _records;
+       uint64 _count; // number of records added so far
+       uint _mask;
+   };
+
+   // An implementation of Listener recording the processing of blocks (transform
+   // stages, entropy coding, wait for the previous block, reads and writes) per
+   // thread and exporting the spans in the Chrome Trace Event JSON format
+   // (chrome://tracing or https://ui.perfetto.dev).
+   // Each thread appends events to its own ring buffer: no lock is taken on the
+   // recording path except when a thread emits its first event.
+   class TraceWriter : public Listener {
+   public:
+       TraceWriter(int logCapacity = 16);
+
+       ~TraceWriter();
+
+       void processEvent(const Event& evt);
+
+       // Write the trace. Must be called once all event producers are done.
+       void save(OutputStream& os) const;
+
+       // Write the trace to a file. Return false if the file cannot be created.
+       bool save(const std::string& fileName) const;
+
+   private:
+       std::vector<TraceBuffer*> _buffers;
+       int _logCapacity;
+       int _uid;
+#ifdef CONCURRENCY_ENABLED
+       std::mutex _mutex;
+       static ATOMIC_INT _instances;
+#endif
+
+       TraceBuffer* getBuffer();
+
+       static int getSpan(int type, const char*& name, const char*& category);
+   };
+}
+#endif
+
@@ -14,6 +14,7 @@ limitations under the License.
 */
 
 #include "DefaultInputBitStream.hpp"
+#include "../Allocator.hpp"
 #include "../util.hpp"
 #include "../io/IOException.hpp"
 
@@ -32,7 +33,7 @@ DefaultInputBitStream::DefaultInputBitStream(InputStream& is, uint bufferSize) :
         throw invalid_argument("Invalid buffer size (must be a multiple of 8)");
 
     _bufferSize = bufferSize;
-    _buffer = new byte[_bufferSize];
+    _buffer = allocate<byte>(_bufferSize, MemoryUsage::STREAM);
     _availBits = 0;
     _maxPosition = -1;
     _position = 0;
@@ -44,7 +45,7 @@ DefaultInputBitStream::DefaultInputBitStream(InputStream& is, uint bufferSize) :
 DefaultInputBitStream::~DefaultInputBitStream()
 {
     _close();
-    delete[] _buffer;
+    deallocate(_buffer);
 }
 
 uint DefaultInputBitStream::readBits(byte bits[], uint count)
@@ -14,6 +14,7 @@ limitations under the License.
 */
 
 #include "DefaultOutputBitStream.hpp"
+#include "../Allocator.hpp"
 
 using namespace kanzi;
 using namespace std;
@@ -31,7 +32,7 @@ DefaultOutputBitStream::DefaultOutputBitStream(OutputStream& os, uint bufferSize
 
     _availBits = 64;
     _bufferSize = bufferSize;
-    _buffer = new byte[_bufferSize];
+    _buffer = allocate<byte>(_bufferSize, MemoryUsage::STREAM);
     _position = 0;
     _current = 0;
     _written = 0;
@@ -175,9 +176,9 @@ void DefaultOutputBitStream::_close()
 
     // Reset fields to force a flush() and trigger an exception
     // on writeBit() or writeBits()
-    delete[] _buffer;
+    deallocate(_buffer);
     _bufferSize = 8;
-    _buffer = new byte[_bufferSize];
+    _buffer = allocate<byte>(_bufferSize, MemoryUsage::STREAM);
     memset(&_buffer[0], 0, size_t(_bufferSize));
 }
 
@@ -212,5 +213,5 @@ DefaultOutputBitStream::~DefaultOutputBitStream()
         // Ignore and continue
     }
 
-    delete[] _buffer;
+    deallocate(_buffer);
 }
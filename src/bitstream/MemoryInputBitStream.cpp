@@ -0,0 +1,102 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstring>
+#include "MemoryInputBitStream.hpp"
+
+using namespace kanzi;
+using namespace std;
+
+MemoryInputBitStream::MemoryInputBitStream(SliceArray<byte>& buffer, int count)
+    : _sa(buffer)
+{
+    if (count < 0)
+        throw invalid_argument("Invalid count (must be at least 0)");
+
+    if (buffer._index + count > buffer._length)
+        throw invalid_argument("Invalid count (must be at most the buffer length minus the buffer index)");
+
+    _buffer = &buffer._array[buffer._index];
+    _end = uint(count);
+    _availBits = 0;
+    _position = 0;
+    _current = 0;
+    _read = 0;
+    _closed = false;
+}
+
+uint MemoryInputBitStream::readBits(byte bits[], uint count)
+{
+    if (isClosed() == true)
+        throw BitStreamException("Stream closed", BitStreamException::STREAM_CLOSED);
+
+    if (count == 0)
+        return 0;
+
+    uint remaining = count;
+    uint start = 0;
+
+    // Byte aligned cursor ?
+    if ((_availBits & 7) == 0) {
+        // Empty _current
+        while ((_availBits > 0) && (remaining >= 8)) {
+            bits[start] = byte(readBits(8));
+            start++;
+            remaining -= 8;
+        }
+
+        // Copy buffer to bits array
+        const uint r = min(remaining >> 3, _end - _position);
+        memcpy(&bits[start], &_buffer[_position], r);
+        _position += r;
+        start += r;
+        remaining -= (r << 3);
+    }
+    else {
+        while (remaining >= 64) {
+            BigEndian::writeLong64(&bits[start], readBits(64));
+            start += 8;
+            remaining -= 64;
+        }
+    }
+
+    // Last bytes
+    while (remaining >= 8) {
+        bits[start] = byte(readBits(8));
+        start++;
+        remaining -= 8;
+    }
+
+    if (remaining > 0)
+        bits[start] = byte(readBits(remaining) << (8 - remaining));
+
+    return count;
+}
+
+void MemoryInputBitStream::_close()
+{
+    if (isClosed() == true)
+        return;
+
+    const uint64 read = this->read();
+    _closed = true;
+    _sa._index += int((read + 7) >> 3);
+
+    // Reset fields to force an exception on readBit() or readBits()
+    // and keep the value returned by read()
+    _availBits = 0;
+    _end = _position;
+    _read = int64(read) - (int64(_position) << 3);
+}
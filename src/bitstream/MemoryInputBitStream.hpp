@@ -0,0 +1,138 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef _MemoryInputBitStream_
+#define _MemoryInputBitStream_
+
+#include "../BitStreamException.hpp"
+#include "../InputBitStream.hpp"
+#include "../Memory.hpp"
+#include "../SliceArray.hpp"
+#include "../util/strings.hpp"
+
+
+namespace kanzi {
+
+   // An input bitstream reading directly from a byte array (no intermediate
+   // buffer, no iostream). 'count' bytes are read from buffer._index.
+   // On close, the index of the slice is moved past the last byte read
+   // (the very last one may be partially consumed).
+   class MemoryInputBitStream FINAL : public InputBitStream
+   {
+   private:
+       SliceArray<byte>& _sa;
+       const byte* _buffer;
+       uint _position; // index of next byte to load in _current
+       uint _end; // number of bytes in _buffer
+       uint _availBits; // bits not consumed in _current
+       int64 _read; // adjustment after close
+       uint64 _current;
+       bool _closed;
+
+       // return number of available bits
+       uint pullCurrent();
+
+       void _close();
+
+
+   public:
+       // Returns 1 or 0
+       int readBit();
+
+       uint64 readBits(uint length);
+
+       uint readBits(byte bits[], uint count);
+
+       void close() { _close(); }
+
+       // Number of bits read
+       uint64 read() const
+       {
+           return uint64(_read + (int64(_position) << 3) - int64(_availBits));
+       }
+
+       // Return false when the bitstream is closed or the End-Of-Stream has been reached
+       bool hasMoreToRead()
+       {
+           return (_closed == false) && ((_position < _end) || (_availBits > 0));
+       }
+
+       bool isClosed() const { return _closed; }
+
+       MemoryInputBitStream(SliceArray<byte>& buffer, int count);
+
+       ~MemoryInputBitStream() { _close(); }
+   };
+
+   // Returns 1 or 0
+   inline int MemoryInputBitStream::readBit()
+   {
+       if (_availBits == 0)
+           _availBits = pullCurrent() - 1; // Triggers an exception if stream is closed
+       else
+           _availBits--;
+
+       return int(_current >> _availBits) & 1;
+   }
+
+   inline uint64 MemoryInputBitStream::readBits(uint count)
+   {
+       if ((count == 0) || (count > 64))
+           throw BitStreamException("Invalid bit count: " + TOSTR(count) + " (must be in [1..64])");
+
+       if (count <= _availBits) {
+           // Enough spots available in 'current'
+           _availBits -= count;
+           return (_current >> _availBits) & (uint64(-1) >> (64 - count));
+       }
+
+       // Not enough spots available in 'current'
+       count -= _availBits;
+       const uint64 res = _current & ((uint64(1) << _availBits) - 1);
+       _availBits = pullCurrent() - count;
+       return (res << count) | (_current >> _availBits);
+   }
+
+   // Pull 64 bits of current value from buffer.
+   inline uint MemoryInputBitStream::pullCurrent()
+   {
+       if (_position + 8 <= _end) {
+           _current = BigEndian::readLong64(&_buffer[_position]);
+           _position += 8;
+           return 64;
+       }
+
+       if (_position >= _end) {
+           if (_closed == true)
+               throw BitStreamException("Stream closed", BitStreamException::STREAM_CLOSED);
+
+           throw BitStreamException("No more data to read in the bitstream",
+               BitStreamException::END_OF_STREAM);
+       }
+
+       // End of buffer: load the remaining bytes (MSB aligned)
+       const uint n = _end - _position;
+       uint64 val = 0;
+
+       for (uint i = 0; i < n; i++)
+           val = (val << 8) | uint64(_buffer[_position++]);
+
+       _current = val;
+       return n << 3;
+   }
+}
+#endif
+
@@ -0,0 +1,154 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstring>
+#include "MemoryOutputBitStream.hpp"
+
+using namespace kanzi;
+using namespace std;
+
+MemoryOutputBitStream::MemoryOutputBitStream(SliceArray<byte>& buffer, bool growable, Allocator* allocator)
+    : _sa(buffer)
+{
+    if (buffer._index > buffer._length)
+        throw invalid_argument("Invalid buffer index (must be at most the buffer length)");
+
+    _growable = growable;
+    _allocator = allocator;
+    _buffer = &buffer._array[buffer._index];
+    _capacity = uint(buffer._length - buffer._index);
+    _availBits = 64;
+    _position = 0;
+    _current = 0;
+    _written = 0;
+    _closed = false;
+}
+
+MemoryOutputBitStream::~MemoryOutputBitStream()
+{
+    try {
+        _close();
+    }
+    catch (exception&) {
+        // Ignore and continue
+    }
+}
+
+uint MemoryOutputBitStream::writeBits(const byte bits[], uint count)
+{
+    if (isClosed() == true)
+        throw BitStreamException("Stream closed", BitStreamException::STREAM_CLOSED);
+
+    uint remaining = count;
+    uint start = 0;
+
+    // Byte aligned cursor ?
+    if (((_availBits & 7) == 0) && (remaining >= 64)) {
+        // Empty _current (whole bytes only)
+        const uint nbBytes = (64 - _availBits) >> 3;
+
+        if (_position + nbBytes > _capacity)
+            grow(_position + nbBytes);
+
+        for (uint i = 0; i < nbBytes; i++)
+            _buffer[_position++] = byte(_current >> (56 - 8 * i));
+
+        _availBits = 64;
+        _current = 0;
+
+        // Copy bits array to buffer
+        const uint r = remaining >> 3;
+
+        if (_position + r > _capacity)
+            grow(_position + r);
+
+        memcpy(&_buffer[_position], &bits[start], r);
+        _position += r;
+        start += r;
+        remaining &= 7;
+    }
+    else {
+        while (remaining >= 64) {
+            writeBits(uint64(BigEndian::readLong64(&bits[start])), 64);
+            start += 8;
+            remaining -= 64;
+        }
+    }
+
+    // Last bytes
+    while (remaining >= 8) {
+        writeBits(uint64(bits[start]), 8);
+        start++;
+        remaining -= 8;
+    }
+
+    if (remaining > 0)
+        writeBits(uint64(bits[start]) >> (8 - remaining), remaining);
+
+    return count;
+}
+
+void MemoryOutputBitStream::grow(uint minCapacity)
+{
+    if (_growable == false) {
+        throw BitStreamException("Write to bitstream failed: buffer full",
+            BitStreamException::INPUT_OUTPUT);
+    }
+
+    const uint64 newCap = max(uint64(minCapacity) + 64, uint64(_capacity) * 2);
+
+    if (newCap + uint64(_sa._index) > uint64(1) << 31)
+        throw BitStreamException("Write to bitstream failed: buffer too large",
+            BitStreamException::INPUT_OUTPUT);
+
+    const int newLength = _sa._index + int(newCap);
+    byte* newArray = allocate<byte>(_allocator, newLength, MemoryUsage::STREAM);
+    memcpy(&newArray[0], &_sa._array[0], size_t(_sa._index + int(_position)));
+    deallocate(_allocator, _sa._array);
+    _sa._array = newArray;
+    _sa._length = newLength;
+    _buffer = &_sa._array[_sa._index];
+    _capacity = uint(newCap);
+}
+
+void MemoryOutputBitStream::_close()
+{
+    if (isClosed() == true)
+        return;
+
+    // Push last bytes (the very last byte may be incomplete)
+    const uint64 written = this->written();
+    const uint nbBytes = (64 - _availBits + 7) >> 3;
+
+    if (_position + nbBytes > _capacity)
+        grow(_position + nbBytes);
+
+    uint shift = 56;
+
+    for (uint i = 0; i < nbBytes; i++) {
+        _buffer[_position++] = byte(_current >> shift);
+        shift -= 8;
+    }
+
+    _sa._index += int(_position);
+    _closed = true;
+
+    // Reset fields to force an exception on writeBit() or writeBits()
+    // and keep the value returned by written()
+    _availBits = 0;
+    _current = 0;
+    _capacity = 0;
+    _written = int64(written) - (int64(_position) << 3) - 64;
+}
@@ -0,0 +1,135 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef _MemoryOutputBitStream_
+#define _MemoryOutputBitStream_
+
+#include "../Allocator.hpp"
+#include "../BitStreamException.hpp"
+#include "../OutputBitStream.hpp"
+#include "../Memory.hpp"
+#include "../SliceArray.hpp"
+#include "../util/strings.hpp"
+
+
+namespace kanzi
+{
+
+   // An output bitstream writing directly to a byte array (no intermediate
+   // buffer, no iostream). Bits are written from buffer._index.
+   // If 'growable' is true, the array of the slice is re-allocated when full
+   // (the slice must own an array allocated with 'allocator', or with new[]
+   // if the allocator is null). Otherwise, an exception is thrown when the
+   // array is full.
+   // On close, the index of the slice is moved past the last written byte.
+   class MemoryOutputBitStream FINAL : public OutputBitStream
+   {
+   private:
+       SliceArray<byte>& _sa;
+       byte* _buffer;
+       bool _closed;
+       bool _growable;
+       Allocator* _allocator;
+       uint _capacity; // size of _buffer in bytes
+       uint _position; // index of current byte in buffer
+       uint _availBits; // bits not consumed in _current
+       int64 _written; // adjustment after close
+       uint64 _current; // cached bits
+
+       void pushCurrent();
+
+       void grow(uint minCapacity);
+
+       void _close();
+
+   public:
+       MemoryOutputBitStream(SliceArray<byte>& buffer, bool growable = false, Allocator* allocator = nullptr);
+
+       ~MemoryOutputBitStream();
+
+       void writeBit(int bit);
+
+       uint writeBits(uint64 bits, uint length);
+
+       uint writeBits(const byte bits[], uint length);
+
+       void close() { _close(); }
+
+       // Return number of bits written so far
+       uint64 written() const
+       {
+           return uint64(_written + (int64(_position) << 3) + int64(64 - _availBits));
+       }
+
+       bool isClosed() const { return _closed; }
+   };
+
+   // Write least significant bit of the input integer. Trigger exception if stream is closed
+   inline void MemoryOutputBitStream::writeBit(int bit)
+   {
+       if (_availBits <= 1) { // _availBits = 0 if stream is closed => force pushCurrent()
+           _current |= (uint64(bit) & 1);
+           pushCurrent();
+       }
+       else {
+           _availBits--;
+           _current |= (uint64(bit & 1) << _availBits);
+       }
+   }
+
+   // Write 'count' (in [1..64]) bits. Trigger exception if stream is closed
+   inline uint MemoryOutputBitStream::writeBits(uint64 value, uint count)
+   {
+       if (count > 64)
+           throw BitStreamException("Invalid bit count: " + TOSTR(count) + " (must be in [1..64])");
+
+       _current |= ((value << (64 - count)) >> (64 - _availBits));
+
+       if (count >= _availBits) {
+           // Not enough spots available in 'current'
+           const uint remaining = count - _availBits;
+           pushCurrent();
+
+           if (remaining != 0) {
+               _availBits -= remaining;
+               _current = value << _availBits;
+           }
+       }
+       else {
+           _availBits -= count;
+       }
+
+       return count;
+   }
+
+   // Push 64 bits of current value into buffer.
+   inline void MemoryOutputBitStream::pushCurrent()
+   {
+       if (_position + 8 > _capacity) {
+           if (_closed == true)
+               throw BitStreamException("Stream closed", BitStreamException::STREAM_CLOSED);
+
+           grow(_position + 8);
+       }
+
+       BigEndian::writeLong64(&_buffer[_position], _current);
+       _availBits = 64;
+       _current = 0;
+       _position += 8;
+   }
+}
+#endif
+
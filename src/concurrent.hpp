@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef _concurrent_
 #define _concurrent_
 
+#include <vector>
 #include "types.hpp"
 
 #if __cplusplus >= 201103L || _MSC_VER >= 1700
@@ -75,6 +76,24 @@ class Task {
 };
 
 
+// Own a list of tasks: the tasks are deleted when the list goes out of scope
+template <class T>
+class TaskList {
+    public:
+        TaskList() {}
+        ~TaskList() { for (size_t i = 0; i < _tasks.size(); i++) delete _tasks[i]; }
+        void add(T* task) { _tasks.push_back(task); }
+        T* operator[](size_t i) const { return _tasks[i]; }
+        int size() const { return int(_tasks.size()); }
+
+    private:
+        std::vector<T*> _tasks;
+
+        TaskList(const TaskList&); // not copyable
+        TaskList& operator=(const TaskList&);
+};
+
+
 #ifdef CONCURRENCY_ENABLED
    class ThreadPool FINAL {
    public:
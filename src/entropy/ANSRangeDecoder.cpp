@@ -16,9 +16,15 @@ limitations under the License.
 #include <algorithm>
 #include <cstring>
 #include <sstream>
+#include "../Allocator.hpp"
 #include "../BitStreamException.hpp"
 #include "ANSRangeDecoder.hpp"
 #include "EntropyUtils.hpp"
+#include "../Global.hpp"
+
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
 
 using namespace kanzi;
 using namespace std;
@@ -26,6 +32,28 @@ using namespace std;
 // The chunk size indicates how many bytes are encoded (per block) before
 // resetting the frequency stats.
 ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, int order, int chunkSize) : _bitstream(bitstream)
+{
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
+    init(order, chunkSize);
+}
+
+// The number of jobs available to decode the block is provided by the context.
+// Chunks may be decoded concurrently if several jobs are available.
+ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, Context& ctx, int order, int chunkSize) : _bitstream(bitstream)
+{
+    _jobs = ctx.getInt("jobs", 1);
+#ifdef CONCURRENCY_ENABLED
+    _pool = ctx.getPool(); // can be null
+#else
+    _jobs = 1;
+#endif
+    init(order, chunkSize);
+}
+
+void ANSRangeDecoder::init(int order, int chunkSize)
 {
     if ((order != 0) && (order != 1))
         throw invalid_argument("ANS Codec: The order must be 0 or 1");
@@ -45,11 +73,11 @@ ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, int order, int chunk
     _chunkSize = min(chunkSize << (8 * order), MAX_CHUNK_SIZE);
     _order = order;
     const int dim = 255 * order + 1;
-    _freqs = new uint[dim * 256];
-    _symbols = new ANSDecSymbol[dim * 256];
-    _buffer = new byte[0];
+    _freqs = allocate<uint>(dim * 256, MemoryUsage::ENTROPY);
+    _symbols = allocate<ANSDecSymbol>(dim * 256, MemoryUsage::ENTROPY);
+    _buffer = allocate<byte>(0, MemoryUsage::ENTROPY);
     _bufferSize = 0;
-    _f2s = new uint8[0];
+    _f2s = allocate<uint8>(0, MemoryUsage::ENTROPY);
     _f2sSize = 0;
     _logRange = DEFAULT_LOG_RANGE;
 }
@@ -57,10 +85,10 @@ ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, int order, int chunk
 ANSRangeDecoder::~ANSRangeDecoder()
 {
     _dispose();
-    delete[] _buffer;
-    delete[] _symbols;
-    delete[] _f2s;
-    delete[] _freqs;
+    deallocate(_buffer);
+    deallocate(_symbols);
+    deallocate(_f2s);
+    deallocate(_freqs);
 }
 
 int ANSRangeDecoder::decodeHeader(uint frequencies[], uint alphabet[])
@@ -75,13 +103,6 @@ int ANSRangeDecoder::decodeHeader(uint frequencies[], uint alphabet[])
 
     int res = 0;
     const int dim = 255 * _order + 1;
-
-    if (_f2sSize < (dim << _logRange)) {
-        delete[] _f2s;
-        _f2sSize = dim << _logRange;
-        _f2s = new uint8[_f2sSize];
-    }
-
     const uint scale = 1 << _logRange;
     int llr = 3;
 
@@ -91,11 +112,13 @@ int ANSRangeDecoder::decodeHeader(uint frequencies[], uint alphabet[])
     for (int k = 0; k < dim; k++) {
         const int alphabetSize = EntropyUtils::decodeAlphabet(_bitstream, alphabet);
 
-        if (alphabetSize == 0)
+        uint* f = &frequencies[k << 8];
+
+        if (alphabetSize == 0) {
+            memset(f, 0, sizeof(uint) * 256);
             continue;
+        }
 
-        uint* f = &frequencies[k << 8];
- 
         if (alphabetSize != 256)
             memset(f, 0, sizeof(uint) * 256);
 
@@ -141,11 +164,29 @@ int ANSRangeDecoder::decodeHeader(uint frequencies[], uint alphabet[])
         }
 
         f[alphabet[0]] = uint(scale - sum);
-        sum = 0;
+        res += alphabetSize;
+    }
+
+    return res;
+}
+
+void ANSRangeDecoder::buildTables(const uint frequencies[])
+{
+    const int dim = 255 * _order + 1;
+
+    if (_f2sSize < (dim << _logRange)) {
+        deallocate(_f2s);
+        _f2sSize = dim << _logRange;
+        _f2s = allocate<uint8>(_f2sSize, MemoryUsage::ENTROPY);
+    }
+
+    for (int k = 0; k < dim; k++) {
+        const uint* f = &frequencies[k << 8];
         ANSDecSymbol* symb = &_symbols[k << 8];
         uint8* freq2sym = &_f2s[k << _logRange];
+        uint sum = 0;
 
-        // Create reverse mapping
+        // Create reverse mapping (empty contexts have all frequencies set to 0)
         for (int i = 0; i < 256; i++) {
             if (f[i] == 0)
                 continue;
@@ -154,11 +195,7 @@ int ANSRangeDecoder::decodeHeader(uint frequencies[], uint alphabet[])
             symb[i].reset(sum, f[i], _logRange);
             sum += f[i];
         }
-
-        res += alphabetSize;
     }
-
-    return res;
 }
 
 int ANSRangeDecoder::decode(byte block[], uint blkptr, uint count)
@@ -169,8 +206,113 @@ int ANSRangeDecoder::decode(byte block[], uint blkptr, uint count)
     }
 
     const uint end = blkptr + count;
+    int nbChunks = int((count + _chunkSize - 1) / _chunkSize);
+    int nbTasks = min(min(min(_jobs, MAX_CONCURRENCY), nbChunks), max(int(count / MIN_TASK_SIZE), 1));
+
+    if (nbTasks <= 1)
+        return decodeChunks(block, blkptr, end);
+
+#ifdef CONCURRENCY_ENABLED
+    // The chunk headers and encoded data must be read sequentially from the
+    // bitstream. Since each chunk carries the size of its encoded data, the
+    // (expensive) symbol decoding can then be performed concurrently.
+    const int dim = 255 * _order + 1;
+    vector<ANSDecChunk> chunks(nbChunks);
+    ScopedBuffer<uint> freqs(size_t(nbChunks) * dim * 256, MemoryUsage::ENTROPY);
+    uint alphabet[256];
+    uint dataSize = 0;
     uint startChunk = blkptr;
-    uint sz = uint(_chunkSize);
+    const uint sz = uint(_chunkSize);
+
+    for (int n = 0; n < nbChunks; n++) {
+        ANSDecChunk& c = chunks[n];
+        c._start = startChunk;
+        c._size = min(sz, end - startChunk);
+        c._freqs = uint(n * dim * 256);
+        const int alphabetSize = decodeHeader(&freqs[c._freqs], alphabet);
+
+        if (alphabetSize == 0) {
+            // Early end of block (as in decodeChunks): decode the chunks read so far
+            nbChunks = n;
+            break;
+        }
+
+        c._logRange = _logRange;
+        c._symbol = ((_order == 0) && (alphabetSize == 1)) ? int(alphabet[0]) : -1;
+        c._data = dataSize;
+
+        if (c._symbol < 0) {
+            // Read chunk size
+            const uint chkSize = uint(EntropyUtils::readVarInt(_bitstream) & (MAX_CHUNK_SIZE - 1));
+
+            // Read initial ANS states
+            for (int i = 0; i < 4; i++)
+                c._states[i] = int(_bitstream.readBits(32));
+
+            // Accumulate encoded data
+            if (_bufferSize < dataSize + chkSize) {
+                const uint newSize = max(dataSize + chkSize, _bufferSize + (_bufferSize >> 1));
+                byte* buf = allocate<byte>(newSize, MemoryUsage::ENTROPY);
+                memcpy(&buf[0], &_buffer[0], size_t(dataSize));
+                deallocate(_buffer);
+                _buffer = buf;
+                _bufferSize = newSize;
+            }
+
+            if (chkSize != 0)
+                _bitstream.readBits(&_buffer[dataSize], 8 * chkSize);
+
+            dataSize += chkSize;
+        }
+
+        startChunk += c._size;
+    }
+
+    if (nbChunks == 0)
+        return 0;
+
+    nbTasks = min(nbTasks, nbChunks);
+    int chunksPerTask[MAX_CONCURRENCY];
+    Global::computeJobsPerTask(chunksPerTask, nbChunks, nbTasks);
+    vector<ANSDecodingTask<int>*> tasks;
+    vector<future<int> > futures;
+    int firstChunk = 0;
+
+    for (int i = 0; i < nbTasks; i++) {
+        ANSDecodingTask<int>* task = new ANSDecodingTask<int>(*this, block, chunks,
+            firstChunk, firstChunk + chunksPerTask[i], freqs.get(), _buffer);
+        tasks.push_back(task);
+
+        if (_pool == nullptr)
+            futures.push_back(async(launch::async, &ANSDecodingTask<int>::run, task));
+        else
+            futures.push_back(_pool->schedule(&ANSDecodingTask<int>::run, task));
+
+        firstChunk += chunksPerTask[i];
+    }
+
+    int res = 0;
+
+    // Wait for completion of all concurrent tasks
+    for (int i = 0; i < nbTasks; i++)
+        res |= futures[i].get();
+
+    for (int i = 0; i < nbTasks; i++)
+        delete tasks[i];
+
+    if (res != 0)
+        throw runtime_error("ANS Codec: Failed to decode chunks concurrently");
+
+    return startChunk - blkptr;
+#else
+    return count;
+#endif
+}
+
+int ANSRangeDecoder::decodeChunks(byte block[], uint start, uint end)
+{
+    uint startChunk = start;
+    const uint sz = uint(_chunkSize);
     uint alphabet[256];
 
     while (startChunk < end) {
@@ -178,19 +320,20 @@ int ANSRangeDecoder::decode(byte block[], uint blkptr, uint count)
         const int alphabetSize = decodeHeader(_freqs, alphabet);
 
         if (alphabetSize == 0)
-            return startChunk - blkptr;
+            return startChunk - start;
 
         if ((_order == 0) && (alphabetSize == 1)) {
             // Shortcut for chunks with only one symbol
             memset(&block[startChunk], alphabet[0], size_t(sizeChunk));
         } else {
+            buildTables(_freqs);
             decodeChunk(&block[startChunk], sizeChunk);
         }
 
         startChunk += sizeChunk;
     }
 
-    return count;
+    return end - start;
 }
 
 void ANSRangeDecoder::decodeChunk(byte block[], int end)
@@ -199,23 +342,31 @@ void ANSRangeDecoder::decodeChunk(byte block[], int end)
     const uint sz = uint(EntropyUtils::readVarInt(_bitstream) & (MAX_CHUNK_SIZE - 1));
 
     // Read initial ANS states
-    int st0 = int(_bitstream.readBits(32));
-    int st1 = int(_bitstream.readBits(32));
-    int st2 = int(_bitstream.readBits(32));
-    int st3 = int(_bitstream.readBits(32));
+    int states[4];
+
+    for (int i = 0; i < 4; i++)
+        states[i] = int(_bitstream.readBits(32));
 
     // Read encoded data from bitstream
     if (sz != 0) {
          if (_bufferSize < sz) {
-            delete[] _buffer;
+            deallocate(_buffer);
             _bufferSize = max(sz + (sz >> 3), uint(256));
-            _buffer = new byte[_bufferSize];
+            _buffer = allocate<byte>(_bufferSize, MemoryUsage::ENTROPY);
         }
 
         _bitstream.readBits(&_buffer[0], 8 * sz);
     }
 
-    byte* p = &_buffer[0];
+    decodeSymbols(block, end, &_buffer[0], states);
+}
+
+void ANSRangeDecoder::decodeSymbols(byte block[], int end, byte* p, int states[])
+{
+    int st0 = states[0];
+    int st1 = states[1];
+    int st2 = states[2];
+    int st3 = states[3];
     const int mask = (1 << _logRange) - 1;
     const int end4 = end & -4;
 
@@ -266,3 +417,53 @@ void ANSRangeDecoder::decodeChunk(byte block[], int end)
     for (int i = end4; i < end; i++)
         block[i] = *p++;
 }
+
+template <class T>
+ANSDecodingTask<T>::ANSDecodingTask(const ANSRangeDecoder& parent, byte block[], const vector<ANSDecChunk>& chunks,
+    int firstChunk, int lastChunk, const uint freqs[], byte data[])
+    : _block(block)
+    , _chunks(chunks)
+    , _firstChunk(firstChunk)
+    , _lastChunk(lastChunk)
+    , _freqs(freqs)
+    , _data(data)
+    , _memScope(MemoryTracker::getBlockScope())
+{
+    // The bitstream is never read by the task decoder
+    _decoder = new ANSRangeDecoder(parent._bitstream, parent._order);
+    _decoder->_chunkSize = parent._chunkSize;
+}
+
+template <class T>
+ANSDecodingTask<T>::~ANSDecodingTask()
+{
+    delete _decoder;
+}
+
+template <class T>
+T ANSDecodingTask<T>::run()
+{
+    MemoryTracker::TaskScope memScope(_memScope); // may run in another thread
+
+    try {
+        for (int n = _firstChunk; n < _lastChunk; n++) {
+            const ANSDecChunk& c = _chunks[n];
+
+            if (c._symbol >= 0) {
+                // Shortcut for chunks with only one symbol
+                memset(&_block[c._start], c._symbol, size_t(c._size));
+                continue;
+            }
+
+            int states[4] = { c._states[0], c._states[1], c._states[2], c._states[3] };
+            _decoder->_logRange = c._logRange;
+            _decoder->buildTables(&_freqs[c._freqs]);
+            _decoder->decodeSymbols(&_block[c._start], int(c._size), &_data[c._data], states);
+        }
+    }
+    catch (std::exception&) {
+        return T(1);
+    }
+
+    return T(0);
+}
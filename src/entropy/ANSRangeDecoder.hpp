@@ -17,6 +17,10 @@ limitations under the License.
 #ifndef _ANSRangeDecoder_
 #define _ANSRangeDecoder_
 
+#include <vector>
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
+#include "../Context.hpp"
 #include "../EntropyDecoder.hpp"
 #include "../types.hpp"
 
@@ -43,7 +47,48 @@ namespace kanzi
    };
 
 
+   // Chunk header and location of the encoded data, as read from the bitstream
+   struct ANSDecChunk
+   {
+      uint _start; // index of first symbol in block
+      uint _size; // number of symbols
+      uint _logRange;
+      int _symbol; // only symbol in the chunk or -1
+      uint _freqs; // index of chunk frequencies
+      uint _data; // index of chunk encoded data
+      int _states[4]; // initial ANS states
+   };
+
+
+   class ANSRangeDecoder;
+
+   // Decode a range of chunks previously read from the bitstream.
+   // Each task rebuilds the decoding tables of its chunks.
+   template <class T>
+   class ANSDecodingTask FINAL : public Task<T> {
+   private:
+       ANSRangeDecoder* _decoder;
+       byte* _block;
+       const std::vector<ANSDecChunk>& _chunks;
+       int _firstChunk;
+       int _lastChunk;
+       const uint* _freqs;
+       byte* _data;
+       MemoryTracker::BlockScope* _memScope; // scope of the block that created the task
+
+   public:
+       ANSDecodingTask(const ANSRangeDecoder& parent, byte block[], const std::vector<ANSDecChunk>& chunks,
+           int firstChunk, int lastChunk, const uint freqs[], byte data[]);
+
+       ~ANSDecodingTask();
+
+       T run();
+   };
+
+
    class ANSRangeDecoder : public EntropyDecoder {
+      friend class ANSDecodingTask<int>;
+
    public:
       static const int ANS_TOP = 1 << 15; // max possible for ANS_TOP=1<<23
 
@@ -51,6 +96,11 @@ namespace kanzi
                       int order = 0,
                       int chunkSize = DEFAULT_ANS0_CHUNK_SIZE);
 
+      ANSRangeDecoder(InputBitStream& bitstream,
+                      Context& ctx,
+                      int order = 0,
+                      int chunkSize = DEFAULT_ANS0_CHUNK_SIZE);
+
       ~ANSRangeDecoder();
 
       int decode(byte block[], uint blkptr, uint len);
@@ -65,6 +115,8 @@ namespace kanzi
       static const int DEFAULT_LOG_RANGE = 12;
       static const int MIN_CHUNK_SIZE = 1024;
       static const int MAX_CHUNK_SIZE = 1 << 27; // 8*MAX_CHUNK_SIZE must not overflow
+      static const int MIN_TASK_SIZE = 1 << 18; // min number of bytes decoded by a concurrent task
+      static const int MAX_CONCURRENCY = 64; // max number of concurrent tasks
 
       InputBitStream& _bitstream;
       uint* _freqs;
@@ -76,13 +128,25 @@ namespace kanzi
       uint _chunkSize;
       uint _order;
       uint _logRange;
+      int _jobs;
+#ifdef CONCURRENCY_ENABLED
+      ThreadPool* _pool;
+#endif
+
+      void init(int order, int chunkSize);
+
+      int decodeChunks(byte block[], uint start, uint end);
 
       void decodeChunk(byte block[], int end);
 
+      void decodeSymbols(byte block[], int end, byte* p, int states[]);
+
       int decodeSymbol(byte*& p, int& st, const ANSDecSymbol& sym, const int mask) const;
 
       int decodeHeader(uint frequencies[], uint alphabet[]);
 
+      void buildTables(const uint frequencies[]);
+
       void _dispose() const {}
    };
 
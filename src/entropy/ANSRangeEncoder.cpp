@@ -18,8 +18,14 @@ limitations under the License.
 #include <sstream>
 #include "ANSRangeEncoder.hpp"
 #include "EntropyUtils.hpp"
+#include "../Allocator.hpp"
 #include "../Global.hpp"
 #include "../Memory.hpp"
+#include "../bitstream/MemoryOutputBitStream.hpp"
+
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
 
 using namespace kanzi;
 using namespace std;
@@ -27,6 +33,28 @@ using namespace std;
 // The chunk size indicates how many bytes are encoded (per block) before
 // resetting the frequency stats.
 ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chunkSize, int logRange) : _bitstream(bitstream)
+{
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
+    init(order, chunkSize, logRange);
+}
+
+// The number of jobs available to encode the block is provided by the context.
+// Chunks may be encoded concurrently if several jobs are available.
+ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, Context& ctx, int order, int chunkSize, int logRange) : _bitstream(bitstream)
+{
+    _jobs = ctx.getInt("jobs", 1);
+#ifdef CONCURRENCY_ENABLED
+    _pool = ctx.getPool(); // can be null
+#else
+    _jobs = 1;
+#endif
+    init(order, chunkSize, logRange);
+}
+
+void ANSRangeEncoder::init(int order, int chunkSize, int logRange)
 {
     if ((order != 0) && (order != 1))
         throw invalid_argument("ANS Codec: The order must be 0 or 1");
@@ -52,9 +80,9 @@ ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chun
     _chunkSize = min(chunkSize << (8 * order), MAX_CHUNK_SIZE);
     _order = order;
     const int dim = 255 * order + 1;
-    _symbols = new ANSEncSymbol[dim * 256];
-    _freqs = new uint[dim * 257]; // freqs[x][256] = total(freqs[x][0..255])
-    _buffer = new byte[0];
+    _symbols = allocate<ANSEncSymbol>(dim * 256, MemoryUsage::ENTROPY);
+    _freqs = allocate<uint>(dim * 257, MemoryUsage::ENTROPY); // freqs[x][256] = total(freqs[x][0..255])
+    _buffer = allocate<byte>(0, MemoryUsage::ENTROPY);
     _bufferSize = 0;
     _logRange = (order == 0) ? logRange : logRange - 1;
 }
@@ -62,9 +90,9 @@ ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chun
 ANSRangeEncoder::~ANSRangeEncoder()
 {
     _dispose();
-    delete[] _buffer;
-    delete[] _symbols;
-    delete[] _freqs;
+    deallocate(_buffer);
+    deallocate(_symbols);
+    deallocate(_freqs);
 }
 
 
@@ -155,14 +183,67 @@ int ANSRangeEncoder::encode(const byte block[], uint blkptr, uint count)
     }
 
     const uint end = blkptr + count;
-    uint startChunk = blkptr;
-    uint sz = uint(_chunkSize);
-    const uint size = max(min(sz + (sz >> 3), 2 * count), uint(65536));
+    const int nbChunks = int((count + _chunkSize - 1) / _chunkSize);
+    const int nbTasks = min(min(min(_jobs, MAX_CONCURRENCY), nbChunks), max(int(count / MIN_TASK_SIZE), 1));
+
+    if (nbTasks <= 1) {
+        encodeChunks(block, blkptr, end);
+        return count;
+    }
+
+#ifdef CONCURRENCY_ENABLED
+    // Each task encodes a range of chunks into a private bitstream. The bits
+    // are then appended in chunk order, so the output does not depend on the
+    // number of jobs.
+    int chunksPerTask[MAX_CONCURRENCY];
+    Global::computeJobsPerTask(chunksPerTask, nbChunks, nbTasks);
+    vector<ANSEncodingTask<int>*> tasks;
+    vector<future<int> > futures;
+    uint start = blkptr;
+
+    for (int i = 0; i < nbTasks; i++) {
+        const uint stop = min(start + uint(chunksPerTask[i]) * _chunkSize, end);
+        ANSEncodingTask<int>* task = new ANSEncodingTask<int>(*this, block, start, stop);
+        tasks.push_back(task);
+
+        if (_pool == nullptr)
+            futures.push_back(async(launch::async, &ANSEncodingTask<int>::run, task));
+        else
+            futures.push_back(_pool->schedule(&ANSEncodingTask<int>::run, task));
+
+        start = stop;
+    }
+
+    int res = 0;
+
+    // Wait for completion of all concurrent tasks
+    for (int i = 0; i < nbTasks; i++)
+        res |= futures[i].get();
+
+    for (int i = 0; i < nbTasks; i++) {
+        if (res == 0)
+            tasks[i]->copyTo(_bitstream);
+
+        delete tasks[i];
+    }
+
+    if (res != 0)
+        throw runtime_error("ANS Codec: Failed to encode chunks concurrently");
+#endif
+
+    return count;
+}
+
+void ANSRangeEncoder::encodeChunks(const byte block[], uint start, uint end)
+{
+    uint startChunk = start;
+    const uint sz = _chunkSize;
+    const uint size = max(min(sz + (sz >> 3), 2 * (end - start)), uint(65536));
 
     if (_bufferSize < size) {
-        delete[] _buffer;
+        deallocate(_buffer);
         _bufferSize = size;
-        _buffer = new byte[_bufferSize];
+        _buffer = allocate<byte>(_bufferSize, MemoryUsage::ENTROPY);
     }
 
     while (startChunk < end) {
@@ -178,8 +259,6 @@ int ANSRangeEncoder::encode(const byte block[], uint blkptr, uint count)
         encodeChunk(&block[startChunk], sizeChunk);
         startChunk += sizeChunk;
     }
-
-    return count;
 }
 
 void ANSRangeEncoder::encodeChunk(const byte block[], int end)
@@ -276,3 +355,55 @@ int ANSRangeEncoder::rebuildStatistics(const byte block[], int end, uint lr)
 
     return updateFrequencies(_freqs, lr);
 }
+
+template <class T>
+ANSEncodingTask<T>::ANSEncodingTask(const ANSRangeEncoder& parent, const byte block[], uint start, uint end)
+    : _buf(allocate<byte>(end - start + 1024, MemoryUsage::ENTROPY), int(end - start + 1024))
+    , _block(block)
+    , _start(start)
+    , _end(end)
+    , _memScope(MemoryTracker::getBlockScope())
+{
+    _obs = new MemoryOutputBitStream(_buf, true);
+    _encoder = new ANSRangeEncoder(*_obs, parent._order);
+    _encoder->_chunkSize = parent._chunkSize;
+    _encoder->_logRange = parent._logRange;
+}
+
+template <class T>
+ANSEncodingTask<T>::~ANSEncodingTask()
+{
+    delete _encoder;
+    delete _obs;
+    deallocate(_buf._array);
+}
+
+template <class T>
+T ANSEncodingTask<T>::run()
+{
+    MemoryTracker::TaskScope memScope(_memScope); // may run in another thread
+
+    try {
+        _encoder->encodeChunks(_block, _start, _end);
+        _obs->close();
+    }
+    catch (std::exception&) {
+        return T(1);
+    }
+
+    return T(0);
+}
+
+template <class T>
+void ANSEncodingTask<T>::copyTo(OutputBitStream& obs)
+{
+    const byte* data = _buf._array;
+    uint64 written = _obs->written();
+
+    for (uint n = 0; written > 0; ) {
+        const uint chkSize = uint(min(written, uint64(1) << 30));
+        obs.writeBits(&data[n], chkSize);
+        n += (chkSize >> 3);
+        written -= uint64(chkSize);
+    }
+}
@@ -17,7 +17,11 @@ limitations under the License.
 #ifndef _ANSRangeEncoder_
 #define _ANSRangeEncoder_
 
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
+#include "../Context.hpp"
 #include "../EntropyEncoder.hpp"
+#include "../SliceArray.hpp"
 
 
 // Implementation of an Asymmetric Numeral System encoder.
@@ -52,8 +56,37 @@ namespace kanzi
    };
 
 
+   class ANSRangeEncoder;
+
+   // Encode a range of chunks into a private bitstream.
+   // Chunks are independent since statistics are reset for each of them.
+   template <class T>
+   class ANSEncodingTask FINAL : public Task<T> {
+   private:
+       SliceArray<byte> _buf;
+       OutputBitStream* _obs;
+       ANSRangeEncoder* _encoder;
+       const byte* _block;
+       uint _start;
+       uint _end;
+       MemoryTracker::BlockScope* _memScope; // scope of the block that created the task
+
+   public:
+       ANSEncodingTask(const ANSRangeEncoder& parent, const byte block[], uint start, uint end);
+
+       ~ANSEncodingTask();
+
+       T run();
+
+       // Append the encoded bits to the provided bitstream
+       void copyTo(OutputBitStream& obs);
+   };
+
+
    class ANSRangeEncoder : public EntropyEncoder
    {
+       friend class ANSEncodingTask<int>;
+
    public:
        static const int ANS_TOP = 1 << 15; // max possible for ANS_TOP=1<<23
 
@@ -62,6 +95,12 @@ namespace kanzi
                       int chunkSize = DEFAULT_ANS0_CHUNK_SIZE,
                       int logRange = DEFAULT_LOG_RANGE);
 
+       ANSRangeEncoder(OutputBitStream& bitstream,
+                      Context& ctx,
+                      int order = 0,
+                      int chunkSize = DEFAULT_ANS0_CHUNK_SIZE,
+                      int logRange = DEFAULT_LOG_RANGE);
+
        ~ANSRangeEncoder();
 
        int updateFrequencies(uint frequencies[], uint lr);
@@ -78,6 +117,8 @@ namespace kanzi
        static const int DEFAULT_LOG_RANGE = 12;
        static const int MIN_CHUNK_SIZE = 1024;
        static const int MAX_CHUNK_SIZE = 1 << 27; // 8*MAX_CHUNK_SIZE must not overflow
+       static const int MIN_TASK_SIZE = 1 << 18; // min number of bytes encoded by a concurrent task
+       static const int MAX_CONCURRENCY = 64; // max number of concurrent tasks
 
        ANSEncSymbol* _symbols;
        uint* _freqs;
@@ -87,7 +128,14 @@ namespace kanzi
        uint _chunkSize;
        uint _logRange;
        uint _order;
+       int _jobs;
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* _pool;
+#endif
+
+       void init(int order, int chunkSize, int logRange);
 
+       void encodeChunks(const byte block[], uint start, uint end);
 
        int rebuildStatistics(const byte block[], int end, uint lr);
 
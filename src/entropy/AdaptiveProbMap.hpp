@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef _AdaptiveProbMap_
 #define _AdaptiveProbMap_
 
+#include "../Allocator.hpp"
 #include "../Global.hpp"
 
 // APM maps a probability and a context into a new probability
@@ -30,11 +31,11 @@ namespace kanzi {
 #if __cplusplus >= 202002L // simple-template-id in ctors and dtors rejected in C++20
        LinearAdaptiveProbMap(int n);
 
-       ~LinearAdaptiveProbMap() { delete[] _data; }
+       ~LinearAdaptiveProbMap() { deallocate(_data); }
 #else
        LinearAdaptiveProbMap<RATE>(int n);
 
-       ~LinearAdaptiveProbMap<RATE>() { delete[] _data; }
+       ~LinearAdaptiveProbMap<RATE>() { deallocate(_data); }
 #endif
 
        int get(int bit, int pr, int ctx);
@@ -48,7 +49,7 @@ namespace kanzi {
    inline LinearAdaptiveProbMap<RATE>::LinearAdaptiveProbMap(int n)
    {
        const int size = (n == 0) ? 65 : n * 65;
-       _data = new uint16[size];
+       _data = allocate<uint16>(size, MemoryUsage::ENTROPY);
        _index = 0;
 
        for (int j = 0; j <= 64; j++) {
@@ -85,11 +86,11 @@ namespace kanzi {
 #if __cplusplus >= 202002L // simple-template-id in ctors and dtors rejected in C++20
        LogisticAdaptiveProbMap(int n);
 
-       ~LogisticAdaptiveProbMap() { delete[] _data; }
+       ~LogisticAdaptiveProbMap() { deallocate(_data); }
 #else
        LogisticAdaptiveProbMap<FAST, RATE>(int n);
 
-       ~LogisticAdaptiveProbMap<FAST, RATE>() { delete[] _data; }
+       ~LogisticAdaptiveProbMap<FAST, RATE>() { deallocate(_data); }
 #endif
 
        int get(int bit, int pr, int ctx);
@@ -104,7 +105,7 @@ namespace kanzi {
    {
        const int mult = (FAST == false) ? 33 : 32;
        const int size = (n == 0) ? mult : n * mult;
-       _data = new uint16[size];
+       _data = allocate<uint16>(size, MemoryUsage::ENTROPY);
        _index = 0;
 
        for (int j = 0; j < mult; j++)
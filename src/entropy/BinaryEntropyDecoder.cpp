@@ -16,9 +16,17 @@ limitations under the License.
 #include <algorithm>
 #include <stdexcept>
 #include "BinaryEntropyDecoder.hpp"
+#include "../Allocator.hpp"
+#include "../BitStreamException.hpp"
+#include "../Global.hpp"
 #include "../Memory.hpp"
+#include "../bitstream/MemoryInputBitStream.hpp"
 #include "EntropyUtils.hpp"
 
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
+
 using namespace kanzi;
 using namespace std;
 
@@ -26,7 +34,7 @@ BinaryEntropyDecoder::BinaryEntropyDecoder(InputBitStream& bitstream, Predictor*
     : _predictor(predictor)
     , _bitstream(bitstream)
     , _deallocate(deallocate)
-    , _sba(new byte[0], 0)
+    , _sba(allocate<byte>(0, MemoryUsage::ENTROPY), 0)
 {
     if (predictor == nullptr)
         throw invalid_argument("Invalid null predictor parameter");
@@ -34,12 +42,38 @@ BinaryEntropyDecoder::BinaryEntropyDecoder(InputBitStream& bitstream, Predictor*
     _low = 0;
     _high = TOP;
     _current = 0;
+    _ctx = nullptr;
+    _newPredictor = nullptr;
+    _subStreams = false;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
+}
+
+BinaryEntropyDecoder::BinaryEntropyDecoder(InputBitStream& bitstream, Context& ctx, PredictorFactory newPredictor)
+    : _predictor(nullptr)
+    , _bitstream(bitstream)
+    , _deallocate(true)
+    , _sba(allocate<byte>(0, MemoryUsage::ENTROPY), 0)
+{
+    if (newPredictor == nullptr)
+        throw invalid_argument("Invalid null predictor factory parameter");
+
+    _low = 0;
+    _high = TOP;
+    _current = 0;
+    _ctx = &ctx;
+    _newPredictor = newPredictor;
+    _subStreams = ctx.getInt("entropySubStreams", 0) != 0; // header flag
+#ifdef CONCURRENCY_ENABLED
+    _pool = ctx.getPool(); // can be null
+#endif
 }
 
 BinaryEntropyDecoder::~BinaryEntropyDecoder()
 {
     _dispose();
-    delete[] _sba._array;
+    deallocate(_sba._array);
 
     if (_deallocate)
         delete _predictor;
@@ -50,8 +84,100 @@ int BinaryEntropyDecoder::decode(byte block[], uint blkptr, uint count)
     if (count >= MAX_BLOCK_SIZE)
         throw invalid_argument("Invalid block size parameter (max is 1<<30)");
 
-    uint startChunk = blkptr;
-    const uint end = blkptr + count;
+    int nbStreams = 1;
+
+    if (_subStreams == true)
+        nbStreams = int(EntropyUtils::readVarInt(_bitstream)) + 1;
+
+    if ((nbStreams <= 0) || (nbStreams > MAX_SUBSTREAMS) || (uint(nbStreams) > max(count, uint(1)))
+        || ((nbStreams > 1) && (_newPredictor == nullptr)))
+        throw BitStreamException("Invalid bitstream: incorrect number of sub-streams",
+            BitStreamException::INVALID_STREAM);
+
+    if (nbStreams == 1) {
+        if (_predictor == nullptr)
+            _predictor = _newPredictor(*_ctx);
+
+        decodeChunks(block, blkptr, blkptr + count);
+        return count;
+    }
+
+    // Read the sub-streams sequentially then decode them (concurrently if
+    // possible), each one with a new predictor
+    int sizes[MAX_SUBSTREAMS];
+    uint szBytes[MAX_SUBSTREAMS];
+    Global::computeJobsPerTask(sizes, int(count), nbStreams);
+
+    for (int i = 0; i < nbStreams; i++) {
+        szBytes[i] = uint(EntropyUtils::readVarInt(_bitstream));
+
+        // Reject sizes the encoder cannot produce before allocating
+        if (szBytes[i] > getMaxEncodedLength(uint(sizes[i])))
+            throw BitStreamException("Invalid bitstream: incorrect sub-stream size",
+                BitStreamException::INVALID_STREAM);
+    }
+
+    TaskList<BinaryDecodingTask<int> > tasks;
+    uint start = blkptr;
+
+    for (int i = 0; i < nbStreams; i++) {
+        Context ctx(*_ctx);
+        ctx.putInt("size", sizes[i]);
+        BinaryDecodingTask<int>* task = new BinaryDecodingTask<int>(_newPredictor(ctx), szBytes[i],
+            block, start, start + uint(sizes[i]));
+        tasks.add(task);
+        byte* data = task->data();
+        uint64 remaining = uint64(szBytes[i]) << 3;
+
+        for (uint n = 0; remaining > 0; ) {
+            const uint chkSize = uint(min(remaining, uint64(1) << 30));
+            _bitstream.readBits(&data[n], chkSize);
+            n += (chkSize >> 3);
+            remaining -= uint64(chkSize);
+        }
+
+        start += uint(sizes[i]);
+    }
+
+    int res = 0;
+
+#ifdef CONCURRENCY_ENABLED
+    vector<future<int> > futures;
+
+    for (int i = 0; i < nbStreams; i++) {
+        if (_pool == nullptr)
+            futures.push_back(async(launch::async, &BinaryDecodingTask<int>::run, tasks[i]));
+        else
+            futures.push_back(_pool->schedule(&BinaryDecodingTask<int>::run, tasks[i]));
+    }
+
+    // Wait for completion of all concurrent tasks
+    for (int i = 0; i < nbStreams; i++)
+        res |= futures[i].get();
+#else
+    // Same bitstream, decoded sequentially
+    for (int i = 0; i < nbStreams; i++)
+        res |= tasks[i]->run();
+#endif
+
+    if (res != 0)
+        throw BitStreamException("Invalid bitstream: failed to decode sub-streams",
+            BitStreamException::INVALID_STREAM);
+
+    return count;
+}
+
+// Upper bound of the size of an encoded sub-stream of 'count' bytes: the
+// encoder buffers at most 1/8 more than a chunk, plus the chunk headers.
+uint BinaryEntropyDecoder::getMaxEncodedLength(uint count)
+{
+    return count + (count >> 3) + 1024;
+}
+
+void BinaryEntropyDecoder::decodeChunks(byte block[], uint start, uint end)
+{
+    uint startChunk = start;
+    const uint count = end - start;
     uint length = max(count, uint(64));
 
     if (length >= MAX_CHUNK_SIZE) {
@@ -65,9 +191,9 @@ int BinaryEntropyDecoder::decode(byte block[], uint blkptr, uint count)
         const uint chunkSize = min(length, end - startChunk);
 
         if (_sba._length < int(chunkSize + (chunkSize >> 3))) {
-            delete[] _sba._array;
+            deallocate(_sba._array);
             _sba._length = int(chunkSize + (chunkSize >> 3));
-            _sba._array = new byte[_sba._length];
+            _sba._array = allocate<byte>(_sba._length, MemoryUsage::ENTROPY);
         }
 
         const int szBytes = int(EntropyUtils::readVarInt(_bitstream));
@@ -92,11 +218,8 @@ int BinaryEntropyDecoder::decode(byte block[], uint blkptr, uint count)
 
         startChunk = endChunk;
     }
-
-    return count;
 }
 
-
 // no inline
 void BinaryEntropyDecoder::read()
 {
@@ -120,3 +243,44 @@ byte BinaryEntropyDecoder::decodeByte()
         |  decodeBit(_predictor->get()));
 }
 
+
+template <class T>
+BinaryDecodingTask<T>::BinaryDecodingTask(Predictor* predictor, uint size, byte block[], uint start, uint end)
+    : _data(allocate<byte>(size, MemoryUsage::ENTROPY))
+    , _size(size)
+    , _predictor(predictor)
+    , _block(block)
+    , _start(start)
+    , _end(end)
+    , _memScope(MemoryTracker::getBlockScope())
+{
+}
+
+template <class T>
+BinaryDecodingTask<T>::~BinaryDecodingTask()
+{
+    deallocate(_data);
+
+    if (_predictor != nullptr)
+        delete _predictor;
+}
+
+template <class T>
+T BinaryDecodingTask<T>::run()
+{
+    MemoryTracker::TaskScope memScope(_memScope); // may run in another thread
+
+    try {
+        SliceArray<byte> sa(_data, int(_size), 0);
+        MemoryInputBitStream ibs(sa, int(_size));
+        BinaryEntropyDecoder decoder(ibs, _predictor, true);
+        _predictor = nullptr; // now owned by the decoder
+        decoder.decodeChunks(_block, _start, _end);
+        ibs.close();
+    }
+    catch (std::exception&) {
+        return T(1);
+    }
+
+    return T(0);
+}
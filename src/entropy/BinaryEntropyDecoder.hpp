@@ -17,6 +17,9 @@ limitations under the License.
 #ifndef _BinaryEntropyDecoder_
 #define _BinaryEntropyDecoder_
 
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
+#include "../Context.hpp"
 #include "../EntropyDecoder.hpp"
 #include "../Predictor.hpp"
 #include "../SliceArray.hpp"
@@ -24,15 +27,44 @@ limitations under the License.
 namespace kanzi
 {
 
+   class BinaryEntropyDecoder;
+
+   // Decode a sub-stream (slice of the block) with its own predictor
+   template <class T>
+   class BinaryDecodingTask FINAL : public Task<T> {
+   private:
+       byte* _data;
+       uint _size;
+       Predictor* _predictor;
+       byte* _block;
+       uint _start;
+       uint _end;
+       MemoryTracker::BlockScope* _memScope; // scope of the block that created the task
+
+   public:
+       BinaryDecodingTask(Predictor* predictor, uint size, byte block[], uint start, uint end);
+
+       ~BinaryDecodingTask();
+
+       T run();
+
+       // Buffer of 'size' bytes to fill with the encoded sub-stream
+       byte* data() const { return _data; }
+   };
+
+
    // This class is a generic implementation of a bool entropy decoder
    class BinaryEntropyDecoder FINAL : public EntropyDecoder
    {
+       friend class BinaryDecodingTask<int>;
+
    private:
        static const uint64 TOP = 0x00FFFFFFFFFFFFFF;
        static const uint64 MASK_0_56 = 0x00FFFFFFFFFFFFFF;
        static const uint64 MASK_0_32 = 0x00000000FFFFFFFF;
        static const int MAX_BLOCK_SIZE = 1 << 30;
        static const int MAX_CHUNK_SIZE = 1 << 26;
+       static const int MAX_SUBSTREAMS = 64;
 
        Predictor* _predictor;
        uint64 _low;
@@ -41,14 +73,27 @@ namespace kanzi
        InputBitStream& _bitstream;
        bool _deallocate;
        SliceArray<byte> _sba;
+       Context* _ctx;
+       PredictorFactory _newPredictor;
+       bool _subStreams;
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* _pool;
+#endif
 
        void read();
 
+       void decodeChunks(byte block[], uint start, uint end);
+
+       static uint getMaxEncodedLength(uint count);
+
        void _dispose() const {}
 
    public:
        BinaryEntropyDecoder(InputBitStream& bitstream, Predictor* predictor, bool deallocate=true);
 
+       // The predictors are created by the factory on demand
+       BinaryEntropyDecoder(InputBitStream& bitstream, Context& ctx, PredictorFactory newPredictor);
+
        ~BinaryEntropyDecoder();
 
        int decode(byte block[], uint blkptr, uint count);
@@ -16,9 +16,16 @@ limitations under the License.
 #include <algorithm>
 #include <stdexcept>
 #include "BinaryEntropyEncoder.hpp"
+#include "../Allocator.hpp"
+#include "../Global.hpp"
 #include "../Memory.hpp"
+#include "../bitstream/MemoryOutputBitStream.hpp"
 #include "EntropyUtils.hpp"
 
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
+
 using namespace kanzi;
 using namespace std;
 
@@ -26,7 +33,7 @@ BinaryEntropyEncoder::BinaryEntropyEncoder(OutputBitStream& bitstream, Predictor
     : _predictor(predictor)
     , _bitstream(bitstream)
     , _deallocate(deallocate)
-    , _sba(new byte[0], 0)
+    , _sba(allocate<byte>(0, MemoryUsage::ENTROPY), 0)
 {
     if (predictor == nullptr)
         throw invalid_argument("Invalid null predictor parameter");
@@ -34,12 +41,46 @@ BinaryEntropyEncoder::BinaryEntropyEncoder(OutputBitStream& bitstream, Predictor
     _low = 0;
     _high = TOP;
     _disposed = false;
+    _ctx = nullptr;
+    _newPredictor = nullptr;
+    _subStreams = false;
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
+}
+
+BinaryEntropyEncoder::BinaryEntropyEncoder(OutputBitStream& bitstream, Context& ctx, PredictorFactory newPredictor)
+    : _predictor(nullptr)
+    , _bitstream(bitstream)
+    , _deallocate(true)
+    , _sba(allocate<byte>(0, MemoryUsage::ENTROPY), 0)
+{
+    if (newPredictor == nullptr)
+        throw invalid_argument("Invalid null predictor factory parameter");
+
+    _low = 0;
+    _high = TOP;
+    _disposed = false;
+    _ctx = &ctx;
+    _newPredictor = newPredictor;
+    // The number of sub-streams does not depend on the availability of
+    // concurrency (the sub-streams are then encoded sequentially).
+    _jobs = ctx.getInt("jobs", 1);
+#ifdef CONCURRENCY_ENABLED
+    _pool = ctx.getPool(); // can be null
+#endif
+    _subStreams = ctx.getInt("entropySubStreams", 0) != 0;
+
+    // With sub-streams, predictors are only created once the block size is known
+    if (_subStreams == false)
+        _predictor = _newPredictor(ctx);
 }
 
 BinaryEntropyEncoder::~BinaryEntropyEncoder()
 {
     _dispose();
-    delete[] _sba._array;
+    deallocate(_sba._array);
 
     if (_deallocate)
         delete _predictor;
@@ -50,8 +91,78 @@ int BinaryEntropyEncoder::encode(const byte block[], uint blkptr, uint count)
     if (count >= MAX_BLOCK_SIZE)
         throw invalid_argument("Invalid block size parameter (max is 1<<30)");
 
-    uint startChunk = blkptr;
-    const uint end = blkptr + count;
+    int nbStreams = 1;
+
+    if (_subStreams == true) {
+        nbStreams = min(min(_jobs, MAX_SUBSTREAMS), max(int(count / MIN_SUBSTREAM_SIZE), 1));
+
+        // Emit number of sub-streams - 1 (only with the sub-streams header flag)
+        EntropyUtils::writeVarInt(_bitstream, uint32(nbStreams - 1));
+    }
+
+    if (nbStreams == 1) {
+        if (_predictor == nullptr)
+            _predictor = _newPredictor(*_ctx);
+
+        encodeChunks(block, blkptr, blkptr + count);
+        return count;
+    }
+
+    // Each sub-stream is encoded by a new encoder with a new predictor
+    // (concurrently if possible). The sizes of the encoded sub-streams are
+    // emitted before the sub-streams so that they can be decoded concurrently.
+    int sizes[MAX_SUBSTREAMS];
+    Global::computeJobsPerTask(sizes, int(count), nbStreams);
+    TaskList<BinaryEncodingTask<int> > tasks;
+    uint start = blkptr;
+
+    for (int i = 0; i < nbStreams; i++) {
+        Context ctx(*_ctx);
+        ctx.putInt("size", sizes[i]);
+        tasks.add(new BinaryEncodingTask<int>(_newPredictor(ctx), block, start, start + uint(sizes[i])));
+        start += uint(sizes[i]);
+    }
+
+    int res = 0;
+
+#ifdef CONCURRENCY_ENABLED
+    vector<future<int> > futures;
+
+    for (int i = 0; i < nbStreams; i++) {
+        if (_pool == nullptr)
+            futures.push_back(async(launch::async, &BinaryEncodingTask<int>::run, tasks[i]));
+        else
+            futures.push_back(_pool->schedule(&BinaryEncodingTask<int>::run, tasks[i]));
+    }
+
+    // Wait for completion of all concurrent tasks
+    for (int i = 0; i < nbStreams; i++)
+        res |= futures[i].get();
+#else
+    // Same bitstream, encoded sequentially
+    for (int i = 0; i < nbStreams; i++)
+        res |= tasks[i]->run();
+#endif
+
+    // The sub-streams are complete, nothing to write at disposal
+    _disposed = true;
+
+    if (res != 0)
+        throw runtime_error("Binary entropy codec: Failed to encode sub-streams");
+
+    for (int i = 0; i < nbStreams; i++)
+        EntropyUtils::writeVarInt(_bitstream, tasks[i]->size());
+
+    for (int i = 0; i < nbStreams; i++)
+        tasks[i]->copyTo(_bitstream);
+
+    return count;
+}
+
+void BinaryEntropyEncoder::encodeChunks(const byte block[], uint start, uint end)
+{
+    uint startChunk = start;
+    const uint count = end - start;
     uint length = max(count, uint(64));
 
     if (length >= MAX_CHUNK_SIZE) {
@@ -65,9 +176,9 @@ int BinaryEntropyEncoder::encode(const byte block[], uint blkptr, uint count)
         const uint chunkSize = min(length, end - startChunk);
 
         if (_sba._length < int(chunkSize + (chunkSize >> 3))) {
-            delete[] _sba._array;
+            deallocate(_sba._array);
             _sba._length = chunkSize + (chunkSize >> 3);
-            _sba._array = new byte[_sba._length];
+            _sba._array = allocate<byte>(_sba._length, MemoryUsage::ENTROPY);
         }
 
         _sba._index = 0;
@@ -91,8 +202,6 @@ int BinaryEntropyEncoder::encode(const byte block[], uint blkptr, uint count)
         if (startChunk < end)
             _bitstream.writeBits(_low | MASK_0_24, 56);
     }
-
-    return count;
 }
 
 void BinaryEntropyEncoder::_dispose()
@@ -126,3 +235,60 @@ void BinaryEntropyEncoder::encodeByte(byte val)
     encodeBit(int(val) & 0x01, _predictor->get());
 }
 
+
+template <class T>
+BinaryEncodingTask<T>::BinaryEncodingTask(Predictor* predictor, const byte block[], uint start, uint end)
+    : _buf(allocate<byte>(end - start + 1024, MemoryUsage::ENTROPY), int(end - start + 1024))
+    , _block(block)
+    , _start(start)
+    , _end(end)
+    , _memScope(MemoryTracker::getBlockScope())
+{
+    _obs = new MemoryOutputBitStream(_buf, true);
+    _encoder = new BinaryEntropyEncoder(*_obs, predictor, true);
+}
+
+template <class T>
+BinaryEncodingTask<T>::~BinaryEncodingTask()
+{
+    delete _encoder;
+    delete _obs;
+    deallocate(_buf._array);
+}
+
+template <class T>
+T BinaryEncodingTask<T>::run()
+{
+    MemoryTracker::TaskScope memScope(_memScope); // may run in another thread
+
+    try {
+        _encoder->encodeChunks(_block, _start, _end);
+        _encoder->dispose();
+        _obs->close();
+    }
+    catch (std::exception&) {
+        return T(1);
+    }
+
+    return T(0);
+}
+
+template <class T>
+uint BinaryEncodingTask<T>::size() const
+{
+    return uint((_obs->written() + 7) >> 3);
+}
+
+template <class T>
+void BinaryEncodingTask<T>::copyTo(OutputBitStream& obs)
+{
+    const byte* data = _buf._array;
+    uint64 written = uint64(size()) << 3;
+
+    for (uint n = 0; written > 0; ) {
+        const uint chkSize = uint(min(written, uint64(1) << 30));
+        obs.writeBits(&data[n], chkSize);
+        n += (chkSize >> 3);
+        written -= uint64(chkSize);
+    }
+}
@@ -17,6 +17,9 @@ limitations under the License.
 #ifndef _BinaryEntropyEncoder_
 #define _BinaryEntropyEncoder_
 
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
+#include "../Context.hpp"
 #include "../EntropyEncoder.hpp"
 #include "../Predictor.hpp"
 #include "../SliceArray.hpp"
@@ -24,15 +27,54 @@ limitations under the License.
 namespace kanzi
 {
 
+   class BinaryEntropyEncoder;
+
+   // Encode a sub-stream (slice of the block) with its own predictor
+   // into a private bitstream.
+   template <class T>
+   class BinaryEncodingTask FINAL : public Task<T> {
+   private:
+       SliceArray<byte> _buf;
+       OutputBitStream* _obs;
+       BinaryEntropyEncoder* _encoder;
+       const byte* _block;
+       uint _start;
+       uint _end;
+       MemoryTracker::BlockScope* _memScope; // scope of the block that created the task
+
+   public:
+       BinaryEncodingTask(Predictor* predictor, const byte block[], uint start, uint end);
+
+       ~BinaryEncodingTask();
+
+       T run();
+
+       // Size of the encoded sub-stream in bytes
+       uint size() const;
+
+       // Append the encoded sub-stream to the provided bitstream
+       void copyTo(OutputBitStream& obs);
+   };
+
+
    // This class is a generic implementation of a bool entropy encoder
+   // The block can optionally be split into sub-streams (each with its own
+   // predictor) encoded concurrently. This is enabled by the 'entropySubStreams'
+   // context entry and trades compression for speed: a sub-stream cannot use
+   // the statistics of the previous ones, so the loss is high when the block
+   // repeats content far apart (EG. 3x bigger on a text repeated 4 times).
    class BinaryEntropyEncoder FINAL : public EntropyEncoder
    {
+       friend class BinaryEncodingTask<int>;
+
    private:
        static const uint64 TOP = 0x00FFFFFFFFFFFFFF;
        static const uint64 MASK_0_24 = 0x0000000000FFFFFF;
        static const uint64 MASK_0_32 = 0x00000000FFFFFFFF;
        static const int MAX_BLOCK_SIZE = 1 << 30;
        static const int MAX_CHUNK_SIZE = 1 << 26;
+       static const int MIN_SUBSTREAM_SIZE = 1 << 22; // a predictor needs a few MB to learn
+       static const int MAX_SUBSTREAMS = 64;
 
        Predictor* _predictor;
        uint64 _low;
@@ -41,14 +83,26 @@ namespace kanzi
        bool _disposed;
        bool _deallocate;
        SliceArray<byte> _sba;
+       Context* _ctx;
+       PredictorFactory _newPredictor;
+       bool _subStreams;
+       int _jobs;
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* _pool;
+#endif
 
        void _dispose();
 
        void flush();
 
+       void encodeChunks(const byte block[], uint start, uint end);
+
    public:
        BinaryEntropyEncoder(OutputBitStream& bitstream, Predictor* predictor, bool deallocate=true);
 
+       // The predictors are created by the factory on demand
+       BinaryEntropyEncoder(OutputBitStream& bitstream, Context& ctx, PredictorFactory newPredictor);
+
        ~BinaryEntropyEncoder();
 
        int encode(const byte block[], uint blkptr, uint count);
@@ -45,6 +45,8 @@ namespace kanzi
 
        ~CMPredictor(){}
 
+       static Predictor* create(Context&) { return new CMPredictor(); }
+
        void update(int bit);
 
        int get();
@@ -63,13 +63,13 @@ namespace kanzi {
        // Each block is decoded separately
        // Rebuild the entropy decoder to reset block statistics
        case HUFFMAN_TYPE:
-           return new HuffmanDecoder(ibs);
+           return new HuffmanDecoder(ibs, ctx);
 
        case ANS0_TYPE:
-           return new ANSRangeDecoder(ibs, 0);
+           return new ANSRangeDecoder(ibs, ctx, 0);
 
        case ANS1_TYPE:
-           return new ANSRangeDecoder(ibs, 1);
+           return new ANSRangeDecoder(ibs, ctx, 1);
 
        case RANGE_TYPE:
            return new RangeDecoder(ibs);
@@ -78,13 +78,13 @@ namespace kanzi {
            return new FPAQDecoder(ibs);
 
        case CM_TYPE:
-           return new BinaryEntropyDecoder(ibs, new CMPredictor());
+           return new BinaryEntropyDecoder(ibs, ctx, CMPredictor::create);
 
        case TPAQ_TYPE:
-           return new BinaryEntropyDecoder(ibs, new TPAQPredictor<false>(&ctx));
+           return new BinaryEntropyDecoder(ibs, ctx, TPAQPredictor<false>::create);
 
        case TPAQX_TYPE:
-           return new BinaryEntropyDecoder(ibs, new TPAQPredictor<true>(&ctx));
+           return new BinaryEntropyDecoder(ibs, ctx, TPAQPredictor<true>::create);
 
        case NONE_TYPE:
            return new NullEntropyDecoder(ibs);
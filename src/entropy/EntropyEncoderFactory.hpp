@@ -62,28 +62,28 @@ namespace kanzi {
    {
        switch (entropyType) {
        case HUFFMAN_TYPE:
-           return new HuffmanEncoder(obs);
+           return new HuffmanEncoder(obs, ctx);
 
        case ANS0_TYPE:
-           return new ANSRangeEncoder(obs, 0);
+           return new ANSRangeEncoder(obs, ctx, 0);
 
        case ANS1_TYPE:
-           return new ANSRangeEncoder(obs, 1);
+           return new ANSRangeEncoder(obs, ctx, 1);
 
        case RANGE_TYPE:
-           return new RangeEncoder(obs);
+           return new RangeEncoder(obs, ctx);
 
        case FPAQ_TYPE:
            return new FPAQEncoder(obs);
 
        case CM_TYPE:
-           return new BinaryEntropyEncoder(obs, new CMPredictor());
+           return new BinaryEntropyEncoder(obs, ctx, CMPredictor::create);
 
        case TPAQ_TYPE:
-           return new BinaryEntropyEncoder(obs, new TPAQPredictor<false>(&ctx));
+           return new BinaryEntropyEncoder(obs, ctx, TPAQPredictor<false>::create);
 
        case TPAQX_TYPE:
-           return new BinaryEntropyEncoder(obs, new TPAQPredictor<true>(&ctx));
+           return new BinaryEntropyEncoder(obs, ctx, TPAQPredictor<true>::create);
 
        case NONE_TYPE:
            return new NullEntropyEncoder(obs);
@@ -17,13 +17,14 @@ limitations under the License.
 #include <stdexcept>
 #include "FPAQDecoder.hpp"
 #include "EntropyUtils.hpp"
+#include "../Allocator.hpp"
 
 using namespace kanzi;
 using namespace std;
 
 FPAQDecoder::FPAQDecoder(InputBitStream& bitstream)
     : _bitstream(bitstream)
-    , _sba(new byte[0], 0)
+    , _sba(allocate<byte>(0, MemoryUsage::ENTROPY), 0)
 {
     reset();
 }
@@ -31,7 +32,7 @@ FPAQDecoder::FPAQDecoder(InputBitStream& bitstream)
 FPAQDecoder::~FPAQDecoder()
 {
     _dispose();
-    delete[] _sba._array;
+    deallocate(_sba._array);
 }
 
 bool FPAQDecoder::reset()
@@ -66,9 +67,9 @@ int FPAQDecoder::decode(byte block[], uint blkptr, uint count)
         const int bufSize = max(szBytes + (szBytes >> 3), 1024);
 
         if (_sba._length < bufSize) {
-            delete[] _sba._array;
+            deallocate(_sba._array);
             _sba._length = bufSize;
-            _sba._array = new byte[_sba._length];
+            _sba._array = allocate<byte>(_sba._length, MemoryUsage::ENTROPY);
         }
 
         _bitstream.readBits(&_sba._array[0], 8 * szBytes);
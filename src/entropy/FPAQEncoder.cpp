@@ -17,13 +17,14 @@ limitations under the License.
 #include <stdexcept>
 #include "FPAQEncoder.hpp"
 #include "EntropyUtils.hpp"
+#include "../Allocator.hpp"
 
 using namespace kanzi;
 using namespace std;
 
 FPAQEncoder::FPAQEncoder(OutputBitStream& bitstream)
     : _bitstream(bitstream)
-    , _sba(new byte[0], 0)
+    , _sba(allocate<byte>(0, MemoryUsage::ENTROPY), 0)
 {
     reset();
 }
@@ -31,7 +32,7 @@ FPAQEncoder::FPAQEncoder(OutputBitStream& bitstream)
 FPAQEncoder::~FPAQEncoder()
 {
     _dispose();
-    delete[] _sba._array;
+    deallocate(_sba._array);
 }
 
 bool FPAQEncoder::reset()
@@ -61,9 +62,9 @@ int FPAQEncoder::encode(const byte block[], uint blkptr, uint count)
         const uint chunkSize = min(DEFAULT_CHUNK_SIZE, end - startChunk);
 
         if (_sba._length < int(chunkSize + (chunkSize >> 3))) {
-            delete[] _sba._array;
+            deallocate(_sba._array);
             _sba._length = chunkSize + (chunkSize >> 3);
-            _sba._array = new byte[_sba._length];
+            _sba._array = allocate<byte>(_sba._length, MemoryUsage::ENTROPY);
         }
 
         _sba._index = 0;
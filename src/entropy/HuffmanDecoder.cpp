@@ -19,14 +19,41 @@ limitations under the License.
 #include "EntropyUtils.hpp"
 #include "ExpGolombDecoder.hpp"
 #include "../BitStreamException.hpp"
+#include "../Global.hpp"
 #include "../Memory.hpp"
 
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
+
 using namespace kanzi;
 using namespace std;
 
 // The chunk size indicates how many bytes are encoded (per block) before
 // resetting the frequency stats.
 HuffmanDecoder::HuffmanDecoder(InputBitStream& bitstream, int chunkSize) : _bitstream(bitstream)
+{
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
+    init(chunkSize);
+}
+
+// The number of jobs available to decode the block is provided by the context.
+// Chunks may be decoded concurrently if several jobs are available.
+HuffmanDecoder::HuffmanDecoder(InputBitStream& bitstream, Context& ctx, int chunkSize) : _bitstream(bitstream)
+{
+    _jobs = ctx.getInt("jobs", 1);
+#ifdef CONCURRENCY_ENABLED
+    _pool = ctx.getPool(); // can be null
+#else
+    _jobs = 1;
+#endif
+    init(chunkSize);
+}
+
+void HuffmanDecoder::init(int chunkSize)
 {
     if (chunkSize < 1024)
         throw invalid_argument("Huffman codec: The chunk size must be at least 1024");
@@ -38,7 +65,7 @@ HuffmanDecoder::HuffmanDecoder(InputBitStream& bitstream, int chunkSize) : _bits
     }
 
     _chunkSize = chunkSize;
-    _buffer = new byte[0];
+    _buffer = allocate<byte>(0, MemoryUsage::ENTROPY);
     _bufferSize = 0;
     reset();
 }
@@ -130,8 +157,116 @@ int HuffmanDecoder::decode(byte block[], uint blkptr, uint count)
     if (count == 0)
         return 0;
 
-    uint startChunk = blkptr;
     const uint end = blkptr + count;
+    int nbChunks = int((count + _chunkSize - 1) / _chunkSize);
+    int nbTasks = min(min(min(_jobs, MAX_CONCURRENCY), nbChunks), max(int(count / MIN_TASK_SIZE), 1));
+
+    if (nbTasks <= 1)
+        return decodeChunks(block, blkptr, end);
+
+#ifdef CONCURRENCY_ENABLED
+    // The chunk codes and encoded data must be read sequentially from the
+    // bitstream. Since each chunk carries the size of its encoded data, the
+    // (expensive) symbol decoding can then be performed concurrently.
+    vector<HuffmanDecChunk> chunks(nbChunks);
+    uint dataSize = 0;
+    uint startChunk = blkptr;
+
+    for (int n = 0; n < nbChunks; n++) {
+        HuffmanDecChunk& c = chunks[n];
+        c._start = startChunk;
+        c._end = min(startChunk + _chunkSize, end);
+        c._alphabetSize = readLengths();
+        c._szBits = 0;
+        c._data = dataSize;
+
+        if (c._alphabetSize <= 0) {
+            // Early end of block (as in decodeChunks): decode the chunks read so far
+            nbChunks = n;
+            break;
+        }
+
+        memcpy(c._alphabet, _alphabet, sizeof(_alphabet));
+
+        if (c._alphabetSize > 1) {
+            memcpy(c._codes, _codes, sizeof(_codes));
+            memcpy(c._sizes, _sizes, sizeof(_sizes));
+
+            // Read number of streams. Only 1 steam supported for now
+            if (_bitstream.readBits(2) != 0)
+                return -1;
+
+            // Read chunk size
+            c._szBits = EntropyUtils::readVarInt(_bitstream);
+
+            if (c._szBits < 0)
+                return -1;
+
+            // Accumulate encoded data
+            const uint sz = uint(c._szBits + 7) >> 3;
+
+            if (_bufferSize < dataSize + sz) {
+                const uint newSize = max(dataSize + sz, _bufferSize + (_bufferSize >> 1));
+                byte* buf = allocate<byte>(newSize, MemoryUsage::ENTROPY);
+                memcpy(&buf[0], &_buffer[0], size_t(dataSize));
+                deallocate(_buffer);
+                _buffer = buf;
+                _bufferSize = newSize;
+            }
+
+            if (c._szBits != 0)
+                _bitstream.readBits(&_buffer[dataSize], c._szBits);
+
+            dataSize += sz;
+        }
+
+        startChunk = c._end;
+    }
+
+    if (nbChunks == 0)
+        return 0;
+
+    nbTasks = min(nbTasks, nbChunks);
+    int chunksPerTask[MAX_CONCURRENCY];
+    Global::computeJobsPerTask(chunksPerTask, nbChunks, nbTasks);
+    vector<HuffmanDecodingTask<int>*> tasks;
+    vector<future<int> > futures;
+    int firstChunk = 0;
+
+    for (int i = 0; i < nbTasks; i++) {
+        HuffmanDecodingTask<int>* task = new HuffmanDecodingTask<int>(*this, block, chunks,
+            firstChunk, firstChunk + chunksPerTask[i], _buffer);
+        tasks.push_back(task);
+
+        if (_pool == nullptr)
+            futures.push_back(async(launch::async, &HuffmanDecodingTask<int>::run, task));
+        else
+            futures.push_back(_pool->schedule(&HuffmanDecodingTask<int>::run, task));
+
+        firstChunk += chunksPerTask[i];
+    }
+
+    int res = 0;
+
+    // Wait for completion of all concurrent tasks
+    for (int i = 0; i < nbTasks; i++)
+        res |= futures[i].get();
+
+    for (int i = 0; i < nbTasks; i++)
+        delete tasks[i];
+
+    if (res != 0)
+        throw runtime_error("Huffman codec: Failed to decode chunks concurrently");
+
+    return startChunk - blkptr;
+#else
+    return count;
+#endif
+}
+
+int HuffmanDecoder::decodeChunks(byte block[], uint start, uint end)
+{
+    uint startChunk = start;
 
     while (startChunk < end) {
         const uint endChunk = min(startChunk + _chunkSize, end);
@@ -140,7 +275,7 @@ int HuffmanDecoder::decode(byte block[], uint blkptr, uint count)
         const int alphabetSize = readLengths();
 
         if (alphabetSize <= 0)
-            return startChunk - blkptr;
+            return startChunk - start;
 
         if (alphabetSize == 1) {
             // Shortcut for chunks with only one symbol
@@ -167,69 +302,125 @@ int HuffmanDecoder::decode(byte block[], uint blkptr, uint count)
             const uint minLenBuf = uint(max(sz + (sz >> 3), 1024));
 
             if (_bufferSize < minLenBuf) {
-                delete[] _buffer;
+                deallocate(_buffer);
                 _bufferSize = minLenBuf;
-                _buffer = new byte[_bufferSize];
+                _buffer = allocate<byte>(_bufferSize, MemoryUsage::ENTROPY);
             }
 
             _bitstream.readBits(&_buffer[0], szBits);
+            decodeSymbols(block, startChunk, endChunk, _buffer, szBits);
+        }
 
-            uint64 state = 0; // holds bits read from bitstream
-            uint8 bits = 0; // number of available bits in state
-            int idx = 0;
-            uint n = startChunk;
-
-            while (idx < sz - 8) {
-                const uint8 shift = (56 - bits) & -8;
-                state = (state << shift) | (uint64(BigEndian::readLong64(&_buffer[idx])) >> 1 >> (63 - shift)); // handle shift = 0
-                idx += (shift >> 3);
-                uint8 bs = bits + shift - DECODING_BATCH_SIZE;
-                const uint16 val0 = _table[(state >> bs) & TABLE_MASK];
-                bs -= uint8(val0);
-                const uint16 val1 = _table[(state >> bs) & TABLE_MASK];
-                bs -= uint8(val1);
-                const uint16 val2 = _table[(state >> bs) & TABLE_MASK];
-                bs -= uint8(val2);
-                const uint16 val3 = _table[(state >> bs) & TABLE_MASK];
-                bs -= uint8(val3);
-                bits = bs + DECODING_BATCH_SIZE;
-                block[n + 0] = byte(val0 >> 8);
-                block[n + 1] = byte(val1 >> 8);
-                block[n + 2] = byte(val2 >> 8);
-                block[n + 3] = byte(val3 >> 8);
-                n += 4;
-            }
-
-            // Last bytes
-            uint nbBits = idx * 8;
+        startChunk = endChunk;
+    }
 
-            while (n < endChunk) {
-                while ((bits < HuffmanCommon::MAX_SYMBOL_SIZE) && (idx < sz)) {
-                    state = (state << 8) | uint64(_buffer[idx] & byte(0xFF));
-                    idx++;
-                    nbBits = (idx == sz) ? szBits : nbBits + 8;
+    return end - start;
+}
 
-                    // 'bits' may overshoot when idx == sz due to padding state bits
-                    // It is necessary to compute proper _table indexes
-                    // and has no consequence (except bits != 0 at end of chunk)
-                    bits += 8;
-                }
+void HuffmanDecoder::decodeSymbols(byte block[], uint startChunk, uint endChunk, const byte data[], int szBits)
+{
+    const int sz = (szBits + 7) >> 3;
+    uint64 state = 0; // holds bits read from bitstream
+    uint8 bits = 0; // number of available bits in state
+    int idx = 0;
+    uint n = startChunk;
+
+    while (idx < sz - 8) {
+        const uint8 shift = (56 - bits) & -8;
+        state = (state << shift) | (uint64(BigEndian::readLong64(&data[idx])) >> 1 >> (63 - shift)); // handle shift = 0
+        idx += (shift >> 3);
+        uint8 bs = bits + shift - DECODING_BATCH_SIZE;
+        const uint16 val0 = _table[(state >> bs) & TABLE_MASK];
+        bs -= uint8(val0);
+        const uint16 val1 = _table[(state >> bs) & TABLE_MASK];
+        bs -= uint8(val1);
+        const uint16 val2 = _table[(state >> bs) & TABLE_MASK];
+        bs -= uint8(val2);
+        const uint16 val3 = _table[(state >> bs) & TABLE_MASK];
+        bs -= uint8(val3);
+        bits = bs + DECODING_BATCH_SIZE;
+        block[n + 0] = byte(val0 >> 8);
+        block[n + 1] = byte(val1 >> 8);
+        block[n + 2] = byte(val2 >> 8);
+        block[n + 3] = byte(val3 >> 8);
+        n += 4;
+    }
 
-                uint16 val;
+    // Last bytes
+    uint nbBits = idx * 8;
 
-                if (bits >= DECODING_BATCH_SIZE)
-                    val = _table[(state >> (bits - DECODING_BATCH_SIZE)) & TABLE_MASK];
-                else
-                    val = _table[(state << (DECODING_BATCH_SIZE - bits)) & TABLE_MASK];
+    while (n < endChunk) {
+        while ((bits < HuffmanCommon::MAX_SYMBOL_SIZE) && (idx < sz)) {
+            state = (state << 8) | uint64(data[idx] & byte(0xFF));
+            idx++;
+            nbBits = (idx == sz) ? szBits : nbBits + 8;
 
-                bits -= uint8(val);
-                block[n++] = byte(val >> 8);
-            }
+            // 'bits' may overshoot when idx == sz due to padding state bits
+            // It is necessary to compute proper _table indexes
+            // and has no consequence (except bits != 0 at end of chunk)
+            bits += 8;
         }
 
-        startChunk = endChunk;
+        uint16 val;
+
+        if (bits >= DECODING_BATCH_SIZE)
+            val = _table[(state >> (bits - DECODING_BATCH_SIZE)) & TABLE_MASK];
+        else
+            val = _table[(state << (DECODING_BATCH_SIZE - bits)) & TABLE_MASK];
+
+        bits -= uint8(val);
+        block[n++] = byte(val >> 8);
     }
+}
 
-    return count;
+template <class T>
+HuffmanDecodingTask<T>::HuffmanDecodingTask(const HuffmanDecoder& parent, byte block[], const vector<HuffmanDecChunk>& chunks,
+    int firstChunk, int lastChunk, const byte data[])
+    : _block(block)
+    , _chunks(chunks)
+    , _firstChunk(firstChunk)
+    , _lastChunk(lastChunk)
+    , _data(data)
+    , _memScope(MemoryTracker::getBlockScope())
+{
+    // The bitstream is never read by the task decoder
+    _decoder = new HuffmanDecoder(parent._bitstream, parent._chunkSize);
 }
 
+template <class T>
+HuffmanDecodingTask<T>::~HuffmanDecodingTask()
+{
+    delete _decoder;
+}
+
+template <class T>
+T HuffmanDecodingTask<T>::run()
+{
+    MemoryTracker::TaskScope memScope(_memScope); // may run in another thread
+
+    try {
+        for (int n = _firstChunk; n < _lastChunk; n++) {
+            const HuffmanDecChunk& c = _chunks[n];
+
+            if (c._alphabetSize == 1) {
+                // Shortcut for chunks with only one symbol
+                memset(&_block[c._start], c._alphabet[0], size_t(c._end - c._start));
+                continue;
+            }
+
+            if (c._szBits == 0)
+                continue;
+
+            memcpy(_decoder->_alphabet, c._alphabet, sizeof(c._alphabet));
+            memcpy(_decoder->_codes, c._codes, sizeof(c._codes));
+            memcpy(_decoder->_sizes, c._sizes, sizeof(c._sizes));
+            _decoder->buildDecodingTable(c._alphabetSize);
+            _decoder->decodeSymbols(_block, c._start, c._end, &_data[c._data], c._szBits);
+        }
+    }
+    catch (std::exception&) {
+        return T(1);
+    }
+
+    return T(0);
+}
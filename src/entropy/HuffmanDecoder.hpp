@@ -17,20 +17,67 @@ limitations under the License.
 #ifndef _HuffmanDecoder_
 #define _HuffmanDecoder_
 
+#include <vector>
 #include "HuffmanCommon.hpp"
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
+#include "../Context.hpp"
 #include "../EntropyDecoder.hpp"
 
 
 namespace kanzi
 {
 
+   // Chunk codes and location of the encoded data, as read from the bitstream
+   struct HuffmanDecChunk
+   {
+       uint _start; // index of first symbol in block
+       uint _end; // index of last symbol in block + 1
+       int _alphabetSize;
+       int _szBits; // size of encoded data in bits
+       uint _data; // index of chunk encoded data
+       uint _alphabet[256];
+       uint16 _codes[256];
+       uint16 _sizes[256];
+   };
+
+
+   class HuffmanDecoder;
+
+   // Decode a range of chunks previously read from the bitstream.
+   // Each task rebuilds the decoding tables of its chunks.
+   template <class T>
+   class HuffmanDecodingTask FINAL : public Task<T> {
+   private:
+       HuffmanDecoder* _decoder;
+       byte* _block;
+       const std::vector<HuffmanDecChunk>& _chunks;
+       int _firstChunk;
+       int _lastChunk;
+       const byte* _data;
+       MemoryTracker::BlockScope* _memScope; // scope of the block that created the task
+
+   public:
+       HuffmanDecodingTask(const HuffmanDecoder& parent, byte block[], const std::vector<HuffmanDecChunk>& chunks,
+           int firstChunk, int lastChunk, const byte data[]);
+
+       ~HuffmanDecodingTask();
+
+       T run();
+   };
+
+
    // Implementation of a static Huffman coder.
    class HuffmanDecoder : public EntropyDecoder
    {
+       friend class HuffmanDecodingTask<int>;
+
    public:
        HuffmanDecoder(InputBitStream& bitstream, int chunkSize = HuffmanCommon::MAX_CHUNK_SIZE);
 
-       ~HuffmanDecoder() { _dispose(); delete[] _buffer; }
+       HuffmanDecoder(InputBitStream& bitstream, Context& ctx, int chunkSize = HuffmanCommon::MAX_CHUNK_SIZE);
+
+       ~HuffmanDecoder() { _dispose(); deallocate(_buffer); }
 
        int decode(byte block[], uint blkptr, uint len);
 
@@ -41,6 +88,8 @@ namespace kanzi
    private:
        static const int DECODING_BATCH_SIZE = 12; // ensures decoding table fits in L1 cache
        static const int TABLE_MASK = (1 << DECODING_BATCH_SIZE) - 1;
+       static const int MIN_TASK_SIZE = 1 << 18; // min number of bytes decoded by a concurrent task
+       static const int MAX_CONCURRENCY = 64; // max number of concurrent tasks
 
        InputBitStream& _bitstream;
        byte* _buffer;
@@ -50,6 +99,16 @@ namespace kanzi
        uint16 _sizes[256];
        uint16 _table[TABLE_MASK + 1]; // decoding table: code -> size, symbol
        int _chunkSize;
+       int _jobs;
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* _pool;
+#endif
+
+       void init(int chunkSize);
+
+       int decodeChunks(byte block[], uint start, uint end);
+
+       void decodeSymbols(byte block[], uint start, uint end, const byte data[], int szBits);
 
        int readLengths();
 
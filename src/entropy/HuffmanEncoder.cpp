@@ -22,6 +22,11 @@ limitations under the License.
 #include "ExpGolombEncoder.hpp"
 #include "../Global.hpp"
 #include "../Memory.hpp"
+#include "../bitstream/MemoryOutputBitStream.hpp"
+
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
 
 using namespace kanzi;
 using namespace std;
@@ -30,6 +35,28 @@ using namespace std;
 // resetting the frequency stats. 0 means that frequencies calculated at the
 // beginning of the block apply to the whole block.
 HuffmanEncoder::HuffmanEncoder(OutputBitStream& bitstream, int chunkSize) : _bitstream(bitstream)
+{
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
+    init(chunkSize);
+}
+
+// The number of jobs available to encode the block is provided by the context.
+// Chunks may be encoded concurrently if several jobs are available.
+HuffmanEncoder::HuffmanEncoder(OutputBitStream& bitstream, Context& ctx, int chunkSize) : _bitstream(bitstream)
+{
+    _jobs = ctx.getInt("jobs", 1);
+#ifdef CONCURRENCY_ENABLED
+    _pool = ctx.getPool(); // can be null
+#else
+    _jobs = 1;
+#endif
+    init(chunkSize);
+}
+
+void HuffmanEncoder::init(int chunkSize)
 {
     if (chunkSize < 1024)
         throw invalid_argument("Huffman codec: The chunk size must be at least 1024");
@@ -41,7 +68,7 @@ HuffmanEncoder::HuffmanEncoder(OutputBitStream& bitstream, int chunkSize) : _bit
     }
 
     _chunkSize = chunkSize;
-    _buffer = new byte[0];
+    _buffer = allocate<byte>(0, MemoryUsage::ENTROPY);
     _bufferSize = 0;
     reset();
 }
@@ -293,14 +320,67 @@ int HuffmanEncoder::encode(const byte block[], uint blkptr, uint count)
         return 0;
 
     const uint end = blkptr + count;
-    uint startChunk = blkptr;
+    const int nbChunks = int((count + _chunkSize - 1) / _chunkSize);
+    const int nbTasks = min(min(min(_jobs, MAX_CONCURRENCY), nbChunks), max(int(count / MIN_TASK_SIZE), 1));
+
+    if (nbTasks <= 1) {
+        encodeChunks(block, blkptr, end);
+        return count;
+    }
+
+#ifdef CONCURRENCY_ENABLED
+    // Each task encodes a range of chunks into a private bitstream. The bits
+    // are then appended in chunk order, so the output does not depend on the
+    // number of jobs.
+    int chunksPerTask[MAX_CONCURRENCY];
+    Global::computeJobsPerTask(chunksPerTask, nbChunks, nbTasks);
+    vector<HuffmanEncodingTask<int>*> tasks;
+    vector<future<int> > futures;
+    uint start = blkptr;
+
+    for (int i = 0; i < nbTasks; i++) {
+        const uint stop = min(start + uint(chunksPerTask[i]) * uint(_chunkSize), end);
+        HuffmanEncodingTask<int>* task = new HuffmanEncodingTask<int>(_chunkSize, block, start, stop);
+        tasks.push_back(task);
+
+        if (_pool == nullptr)
+            futures.push_back(async(launch::async, &HuffmanEncodingTask<int>::run, task));
+        else
+            futures.push_back(_pool->schedule(&HuffmanEncodingTask<int>::run, task));
+
+        start = stop;
+    }
+
+    int res = 0;
+
+    // Wait for completion of all concurrent tasks
+    for (int i = 0; i < nbTasks; i++)
+        res |= futures[i].get();
+
+    for (int i = 0; i < nbTasks; i++) {
+        if (res == 0)
+            tasks[i]->copyTo(_bitstream);
+
+        delete tasks[i];
+    }
+
+    if (res != 0)
+        throw runtime_error("Huffman codec: Failed to encode chunks concurrently");
+#endif
+
+    return count;
+}
+
+void HuffmanEncoder::encodeChunks(const byte block[], uint start, uint end)
+{
+    uint startChunk = start;
     uint sz = uint(_chunkSize);
-    const uint minLenBuf = max(min(sz + (sz >> 3), 2 * count), uint(65536));
+    const uint minLenBuf = max(min(sz + (sz >> 3), 2 * (end - start)), uint(65536));
 
     if (_bufferSize < minLenBuf) {
-        delete[] _buffer;
+        deallocate(_buffer);
         _bufferSize = minLenBuf;
-        _buffer = new byte[_bufferSize];
+        _buffer = allocate<byte>(_bufferSize, MemoryUsage::ENTROPY);
     }
 
     while (startChunk < end) {
@@ -368,7 +448,55 @@ int HuffmanEncoder::encode(const byte block[], uint blkptr, uint count)
 
         startChunk = endChunk;
     }
+}
 
-    return count;
+
+template <class T>
+HuffmanEncodingTask<T>::HuffmanEncodingTask(int chunkSize, const byte block[], uint start, uint end)
+    : _buf(allocate<byte>(end - start + 1024, MemoryUsage::ENTROPY), int(end - start + 1024))
+    , _block(block)
+    , _start(start)
+    , _end(end)
+    , _memScope(MemoryTracker::getBlockScope())
+{
+    _obs = new MemoryOutputBitStream(_buf, true);
+    _encoder = new HuffmanEncoder(*_obs, chunkSize);
 }
 
+template <class T>
+HuffmanEncodingTask<T>::~HuffmanEncodingTask()
+{
+    delete _encoder;
+    delete _obs;
+    deallocate(_buf._array);
+}
+
+template <class T>
+T HuffmanEncodingTask<T>::run()
+{
+    MemoryTracker::TaskScope memScope(_memScope); // may run in another thread
+
+    try {
+        _encoder->encodeChunks(_block, _start, _end);
+        _obs->close();
+    }
+    catch (std::exception&) {
+        return T(1);
+    }
+
+    return T(0);
+}
+
+template <class T>
+void HuffmanEncodingTask<T>::copyTo(OutputBitStream& obs)
+{
+    const byte* data = _buf._array;
+    uint64 written = _obs->written();
+
+    for (uint n = 0; written > 0; ) {
+        const uint chkSize = uint(min(written, uint64(1) << 30));
+        obs.writeBits(&data[n], chkSize);
+        n += (chkSize >> 3);
+        written -= uint64(chkSize);
+    }
+}
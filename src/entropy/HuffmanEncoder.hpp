@@ -18,20 +18,55 @@ limitations under the License.
 #define _HuffmanEncoder_
 
 #include "HuffmanCommon.hpp"
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
+#include "../Context.hpp"
 #include "../EntropyEncoder.hpp"
+#include "../SliceArray.hpp"
 
 
 namespace kanzi
 {
 
+   class HuffmanEncoder;
+
+   // Encode a range of chunks into a private bitstream.
+   // Chunks are independent since codes are rebuilt for each of them.
+   template <class T>
+   class HuffmanEncodingTask FINAL : public Task<T> {
+   private:
+       SliceArray<byte> _buf;
+       OutputBitStream* _obs;
+       HuffmanEncoder* _encoder;
+       const byte* _block;
+       uint _start;
+       uint _end;
+       MemoryTracker::BlockScope* _memScope; // scope of the block that created the task
+
+   public:
+       HuffmanEncodingTask(int chunkSize, const byte block[], uint start, uint end);
+
+       ~HuffmanEncodingTask();
+
+       T run();
+
+       // Append the encoded bits to the provided bitstream
+       void copyTo(OutputBitStream& obs);
+   };
+
+
    // Implementation of a static Huffman encoder.
    // Uses in place generation of canonical codes instead of a tree
    class HuffmanEncoder : public EntropyEncoder
    {
+       friend class HuffmanEncodingTask<int>;
+
    public:
        HuffmanEncoder(OutputBitStream& bitstream, int chunkSize = HuffmanCommon::MAX_CHUNK_SIZE);
 
-       ~HuffmanEncoder() { _dispose(); delete[] _buffer; }
+       HuffmanEncoder(OutputBitStream& bitstream, Context& ctx, int chunkSize = HuffmanCommon::MAX_CHUNK_SIZE);
+
+       ~HuffmanEncoder() { _dispose(); deallocate(_buffer); }
 
        int updateFrequencies(uint frequencies[]);
 
@@ -43,11 +78,22 @@ namespace kanzi
 
 
    private:
+       static const int MIN_TASK_SIZE = 1 << 18; // min number of bytes encoded by a concurrent task
+       static const int MAX_CONCURRENCY = 64; // max number of concurrent tasks
+
        OutputBitStream& _bitstream;
        uint16 _codes[256];
        int _chunkSize;
        byte* _buffer;
        uint _bufferSize;
+       int _jobs;
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* _pool;
+#endif
+
+       void init(int chunkSize);
+
+       void encodeChunks(const byte block[], uint start, uint end);
 
        uint computeCodeLengths(uint16 sizes[], uint sranks[], int count) const;
 
@@ -33,7 +33,7 @@ RangeDecoder::RangeDecoder(InputBitStream& bitstream, int chunkSize) : _bitstrea
     if (chunkSize > MAX_CHUNK_SIZE)
         throw invalid_argument("The chunk size must be at most 2^30");
 
-    _f2s = new short[0];
+    _f2s = allocate<short>(0, MemoryUsage::ENTROPY);
     _chunkSize = chunkSize;
     reset();
 }
@@ -115,9 +115,9 @@ int RangeDecoder::decodeHeader(uint frequencies[])
     _cumFreqs[0] = 0;
 
     if (_lenF2S < scale) {
-        delete[] _f2s;
+        deallocate(_f2s);
         _lenF2S = scale;
-        _f2s = new short[_lenF2S];
+        _f2s = allocate<short>(_lenF2S, MemoryUsage::ENTROPY);
     }
 
     // Create histogram of frequencies scaled to 'range' and reverse mapping
@@ -18,6 +18,7 @@ limitations under the License.
 #ifndef _RangeDecoder_
 #define _RangeDecoder_
 
+#include "../Allocator.hpp"
 #include "../EntropyDecoder.hpp"
 
 
@@ -36,7 +37,7 @@ namespace kanzi
 
        RangeDecoder(InputBitStream& bitstream, int chunkSize = DEFAULT_CHUNK_SIZE);
 
-       ~RangeDecoder() { _dispose(); delete[] _f2s; }
+       ~RangeDecoder() { _dispose(); deallocate(_f2s); }
 
        int decode(byte block[], uint blkptr, uint len);
 
@@ -18,7 +18,13 @@ limitations under the License.
 #include <sstream>
 #include "RangeEncoder.hpp"
 #include "EntropyUtils.hpp"
+#include "../Allocator.hpp"
 #include "../Global.hpp"
+#include "../bitstream/MemoryOutputBitStream.hpp"
+
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
 
 using namespace kanzi;
 using namespace std;
@@ -26,6 +32,28 @@ using namespace std;
 // The chunk size indicates how many bytes are encoded (per block) before
 // resetting the frequency stats.
 RangeEncoder::RangeEncoder(OutputBitStream& bitstream, int chunkSize, int logRange) : _bitstream(bitstream)
+{
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
+    init(chunkSize, logRange);
+}
+
+// The number of jobs available to encode the block is provided by the context.
+// Chunks may be encoded concurrently if several jobs are available.
+RangeEncoder::RangeEncoder(OutputBitStream& bitstream, Context& ctx, int chunkSize, int logRange) : _bitstream(bitstream)
+{
+    _jobs = ctx.getInt("jobs", 1);
+#ifdef CONCURRENCY_ENABLED
+    _pool = ctx.getPool(); // can be null
+#else
+    _jobs = 1;
+#endif
+    init(chunkSize, logRange);
+}
+
+void RangeEncoder::init(int chunkSize, int logRange)
 {
     if (chunkSize < 1024)
         throw invalid_argument("The chunk size must be at least 1024");
@@ -124,8 +152,61 @@ int RangeEncoder::encode(const byte block[], uint blkptr, uint count)
         return 0;
 
     const uint end = blkptr + count;
+    const int nbChunks = int((count + _chunkSize - 1) / _chunkSize);
+    const int nbTasks = min(min(min(_jobs, MAX_CONCURRENCY), nbChunks), max(int(count / MIN_TASK_SIZE), 1));
+
+    if (nbTasks <= 1) {
+        encodeChunks(block, blkptr, end);
+        return count;
+    }
+
+#ifdef CONCURRENCY_ENABLED
+    // Each task encodes a range of chunks into a private bitstream. The bits
+    // are then appended in chunk order, so the output does not depend on the
+    // number of jobs.
+    int chunksPerTask[MAX_CONCURRENCY];
+    Global::computeJobsPerTask(chunksPerTask, nbChunks, nbTasks);
+    vector<RangeEncodingTask<int>*> tasks;
+    vector<future<int> > futures;
+    uint start = blkptr;
+
+    for (int i = 0; i < nbTasks; i++) {
+        const uint stop = min(start + uint(chunksPerTask[i]) * _chunkSize, end);
+        RangeEncodingTask<int>* task = new RangeEncodingTask<int>(_chunkSize, _logRange, block, start, stop);
+        tasks.push_back(task);
+
+        if (_pool == nullptr)
+            futures.push_back(async(launch::async, &RangeEncodingTask<int>::run, task));
+        else
+            futures.push_back(_pool->schedule(&RangeEncodingTask<int>::run, task));
+
+        start = stop;
+    }
+
+    int res = 0;
+
+    // Wait for completion of all concurrent tasks
+    for (int i = 0; i < nbTasks; i++)
+        res |= futures[i].get();
+
+    for (int i = 0; i < nbTasks; i++) {
+        if (res == 0)
+            tasks[i]->copyTo(_bitstream);
+
+        delete tasks[i];
+    }
+
+    if (res != 0)
+        throw runtime_error("Range codec: Failed to encode chunks concurrently");
+#endif
+
+    return count;
+}
+
+void RangeEncoder::encodeChunks(const byte block[], uint start, uint end)
+{
     const uint sz = _chunkSize;
-    uint startChunk = blkptr;
+    uint startChunk = start;
 
     while (startChunk < end) {
         const uint endChunk = min(startChunk + sz, end);
@@ -152,8 +233,6 @@ int RangeEncoder::encode(const byte block[], uint blkptr, uint count)
         _bitstream.writeBits(_low, 60);
         startChunk = endChunk;
     }
-
-    return count;
 }
 
 void RangeEncoder::encodeByte(byte b)
@@ -189,3 +268,54 @@ int RangeEncoder::rebuildStatistics(const byte block[], int start, int end, int
     Global::computeHistogram(&block[start], end - start, _freqs);
     return updateFrequencies(_freqs, end - start, lr);
 }
+
+
+template <class T>
+RangeEncodingTask<T>::RangeEncodingTask(int chunkSize, int logRange, const byte block[], uint start, uint end)
+    : _buf(allocate<byte>(end - start + 1024, MemoryUsage::ENTROPY), int(end - start + 1024))
+    , _block(block)
+    , _start(start)
+    , _end(end)
+    , _memScope(MemoryTracker::getBlockScope())
+{
+    _obs = new MemoryOutputBitStream(_buf, true);
+    _encoder = new RangeEncoder(*_obs, chunkSize, logRange);
+}
+
+template <class T>
+RangeEncodingTask<T>::~RangeEncodingTask()
+{
+    delete _encoder;
+    delete _obs;
+    deallocate(_buf._array);
+}
+
+template <class T>
+T RangeEncodingTask<T>::run()
+{
+    MemoryTracker::TaskScope memScope(_memScope); // may run in another thread
+
+    try {
+        _encoder->encodeChunks(_block, _start, _end);
+        _obs->close();
+    }
+    catch (std::exception&) {
+        return T(1);
+    }
+
+    return T(0);
+}
+
+template <class T>
+void RangeEncodingTask<T>::copyTo(OutputBitStream& obs)
+{
+    const byte* data = _buf._array;
+    uint64 written = _obs->written();
+
+    for (uint n = 0; written > 0; ) {
+        const uint chkSize = uint(min(written, uint64(1) << 30));
+        obs.writeBits(&data[n], chkSize);
+        n += (chkSize >> 3);
+        written -= uint64(chkSize);
+    }
+}
@@ -17,7 +17,11 @@ limitations under the License.
 #ifndef _RangeEncoder_
 #define _RangeEncoder_
 
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
+#include "../Context.hpp"
 #include "../EntropyEncoder.hpp"
+#include "../SliceArray.hpp"
 
 
 namespace kanzi
@@ -28,11 +32,42 @@ namespace kanzi
    // [G.N.N. Martin on the Data Recording Conference, Southampton, 1979]
    // Optimized for speed.
 
+   class RangeEncoder;
+
+   // Encode a range of chunks into a private bitstream.
+   // Chunks are independent since statistics are reset for each of them.
+   template <class T>
+   class RangeEncodingTask FINAL : public Task<T> {
+   private:
+       SliceArray<byte> _buf;
+       OutputBitStream* _obs;
+       RangeEncoder* _encoder;
+       const byte* _block;
+       uint _start;
+       uint _end;
+       MemoryTracker::BlockScope* _memScope; // scope of the block that created the task
+
+   public:
+       RangeEncodingTask(int chunkSize, int logRange, const byte block[], uint start, uint end);
+
+       ~RangeEncodingTask();
+
+       T run();
+
+       // Append the encoded bits to the provided bitstream
+       void copyTo(OutputBitStream& obs);
+   };
+
+
    class RangeEncoder : public EntropyEncoder
    {
+       friend class RangeEncodingTask<int>;
+
    public:
        RangeEncoder(OutputBitStream& bitstream, int chunkSize = DEFAULT_CHUNK_SIZE, int logRange=DEFAULT_LOG_RANGE);
 
+       RangeEncoder(OutputBitStream& bitstream, Context& ctx, int chunkSize = DEFAULT_CHUNK_SIZE, int logRange=DEFAULT_LOG_RANGE);
+
        ~RangeEncoder() { _dispose(); }
 
        int encode(const byte block[], uint blkptr, uint len);
@@ -48,6 +83,8 @@ namespace kanzi
        static const int DEFAULT_CHUNK_SIZE = 1 << 15; // 32 KB by default
        static const int DEFAULT_LOG_RANGE = 12;
        static const int MAX_CHUNK_SIZE = 1 << 30;
+       static const int MIN_TASK_SIZE = 1 << 18; // min number of bytes encoded by a concurrent task
+       static const int MAX_CONCURRENCY = 64; // max number of concurrent tasks
 
        uint64 _low;
        uint64 _range;
@@ -58,6 +95,14 @@ namespace kanzi
        uint _chunkSize;
        uint _logRange;
        uint _shift;
+       int _jobs;
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* _pool;
+#endif
+
+       void init(int chunkSize, int logRange);
+
+       void encodeChunks(const byte block[], uint start, uint end);
 
        int rebuildStatistics(const byte block[], int start, int end, int lr);
 
@@ -22,8 +22,11 @@ TPAQMixer::TPAQMixer()
 {
     _pr = 2048;
     _skew = 0;
-    _w0 = _w1 = _w2 = _w3 = _w4 = _w5 = _w6 = _w7 = 32768;
-    _p0 = _p1 = _p2 = _p3 = _p4 = _p5 = _p6 = _p7 = 0;
     _learnRate = BEGIN_LEARN_RATE;
+
+    for (int i = 0; i < 8; i++) {
+        _w[i] = 32768;
+        _p[i] = 0;
+    }
 }
 
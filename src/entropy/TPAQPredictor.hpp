@@ -18,6 +18,7 @@ limitations under the License.
 #define _TPAQPredictor_
 
 #include <cstring>
+#include "../Allocator.hpp"
 #include "../Context.hpp"
 #include "../Predictor.hpp"
 #include "../Memory.hpp"
@@ -33,6 +34,8 @@ namespace kanzi
    // See http://encode.su/threads/1738-TANGELO-new-compressor-(derived-from-PAQ8-FP8)
 
    // Mixer combines models using neural networks with 8 inputs.
+   // The dot product and the weight update are vectorized when AVX2 or SSE4.1
+   // are available (32 bit lanes, so the result is identical to the scalar code).
    class TPAQMixer
    {
    public:
@@ -48,8 +51,8 @@ namespace kanzi
        static const int BEGIN_LEARN_RATE = 60 << 7;
        static const int END_LEARN_RATE = 11 << 7;
 
-       int _w0, _w1, _w2, _w3, _w4, _w5, _w6, _w7;
-       int _p0, _p1, _p2, _p3, _p4, _p5, _p6, _p7;
+       int32 _w[8]; // weights
+       int32 _p[8]; // inputs
        int _pr;
        int _skew;
        int _learnRate;
@@ -64,6 +67,8 @@ namespace kanzi
 
        ~TPAQPredictor();
 
+       static Predictor* create(Context& ctx) { return new TPAQPredictor<T>(&ctx); }
+
        void update(int bit);
 
        // Return the split value representing the probability of 1 in the [0..4095] range.
@@ -97,6 +102,7 @@ namespace kanzi
        TPAQMixer* _mixer; // current mixer
        byte* _buffer;
        int* _hashes; // hash table(context, buffer position)
+       Allocator* _allocator; // big tables
        uint8* _bigStatesMap;// hash table(context, prediction)
        uint8* _smallStatesMap0; // hash table(context, prediction)
        uint8* _smallStatesMap1; // hash table(context, prediction)
@@ -144,31 +150,65 @@ namespace kanzi
        _skew += err;
 
        // Train Neural Network: update weights
-       _w0 += ((_p0 * err + 0) >> 12);
-       _w1 += ((_p1 * err + 0) >> 12);
-       _w2 += ((_p2 * err + 0) >> 12);
-       _w3 += ((_p3 * err + 0) >> 12);
-       _w4 += ((_p4 * err + 0) >> 12);
-       _w5 += ((_p5 * err + 0) >> 12);
-       _w6 += ((_p6 * err + 0) >> 12);
-       _w7 += ((_p7 * err + 0) >> 12);
+#if defined(__AVX2__)
+       const __m256i e = _mm256_set1_epi32(err);
+       const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&_p[0]));
+       __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&_w[0]));
+       w = _mm256_add_epi32(w, _mm256_srai_epi32(_mm256_mullo_epi32(p, e), 12));
+       _mm256_storeu_si256(reinterpret_cast<__m256i*>(&_w[0]), w);
+#elif defined(__SSE4_1__)
+       const __m128i e = _mm_set1_epi32(err);
+       const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_p[0]));
+       const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_p[4]));
+       __m128i w0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_w[0]));
+       __m128i w1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_w[4]));
+       w0 = _mm_add_epi32(w0, _mm_srai_epi32(_mm_mullo_epi32(p0, e), 12));
+       w1 = _mm_add_epi32(w1, _mm_srai_epi32(_mm_mullo_epi32(p1, e), 12));
+       _mm_storeu_si128(reinterpret_cast<__m128i*>(&_w[0]), w0);
+       _mm_storeu_si128(reinterpret_cast<__m128i*>(&_w[4]), w1);
+#else
+       for (int i = 0; i < 8; i++)
+           _w[i] += ((_p[i] * err + 0) >> 12);
+#endif
    }
 
    inline int TPAQMixer::get(int p0, int p1, int p2, int p3, int p4, int p5, int p6, int p7)
    {
-       _p0 = p0;
-       _p1 = p1;
-       _p2 = p2;
-       _p3 = p3;
-       _p4 = p4;
-       _p5 = p5;
-       _p6 = p6;
-       _p7 = p7;
-
        // Neural Network dot product (sum weights*inputs)
-       _pr = Global::squash(((p0 * _w0) + (p1 * _w1) + (p2 * _w2) + (p3 * _w3) +
-                             (p4 * _w4) + (p5 * _w5) + (p6 * _w6) + (p7 * _w7) +
-                             _skew + 65536) >> 17);
+#if defined(__AVX2__)
+       const __m256i p = _mm256_set_epi32(p7, p6, p5, p4, p3, p2, p1, p0);
+       _mm256_storeu_si256(reinterpret_cast<__m256i*>(&_p[0]), p);
+       const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&_w[0]));
+       const __m256i m = _mm256_mullo_epi32(p, w);
+       __m128i s = _mm_add_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+       s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+       s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+       const int dot = _mm_cvtsi128_si32(s);
+#elif defined(__SSE4_1__)
+       const __m128i pl = _mm_set_epi32(p3, p2, p1, p0);
+       const __m128i ph = _mm_set_epi32(p7, p6, p5, p4);
+       _mm_storeu_si128(reinterpret_cast<__m128i*>(&_p[0]), pl);
+       _mm_storeu_si128(reinterpret_cast<__m128i*>(&_p[4]), ph);
+       const __m128i wl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_w[0]));
+       const __m128i wh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_w[4]));
+       __m128i s = _mm_add_epi32(_mm_mullo_epi32(pl, wl), _mm_mullo_epi32(ph, wh));
+       s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+       s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+       const int dot = _mm_cvtsi128_si32(s);
+#else
+       _p[0] = p0;
+       _p[1] = p1;
+       _p[2] = p2;
+       _p[3] = p3;
+       _p[4] = p4;
+       _p[5] = p5;
+       _p[6] = p6;
+       _p[7] = p7;
+       const int dot = (p0 * _w[0]) + (p1 * _w[1]) + (p2 * _w[2]) + (p3 * _w[3]) +
+                       (p4 * _w[4]) + (p5 * _w[5]) + (p6 * _w[6]) + (p7 * _w[7]);
+#endif
+
+       _pr = Global::squash((dot + _skew + 65536) >> 17);
        return _pr;
    }
 
@@ -303,8 +343,12 @@ namespace kanzi
        uint hashSize = HASH_SIZE;
        uint extraMem = 0;
        uint bufferSize = BUFFER_SIZE;
+       _allocator = &Allocator::getDefault();
 
        if (ctx != nullptr) {
+           // Custom allocator or huge pages for the big hash tables
+           _allocator = &Allocator::getAllocator(*ctx);
+
            extraMem = (T == true) ? 1 : 0;
 
            // Block size requested by the user
@@ -347,12 +391,13 @@ namespace kanzi
        _mixersMask = (mixersSize - 1) & ~1;
        _hashMask = hashSize - 1;
        _bufferMask = bufferSize - 1;
-       _mixers = new TPAQMixer[mixersSize];
-       _bigStatesMap = new uint8[statesSize];
-       _smallStatesMap0 = new uint8[1 << 16];
-       _smallStatesMap1 = new uint8[1 << 24];
-       _hashes = new int[hashSize];
-       _buffer = new byte[bufferSize];
+       _mixers = allocate<TPAQMixer>(mixersSize, MemoryUsage::ENTROPY);
+       // Cache line aligned tables (huge pages if the allocator provides them)
+       _bigStatesMap = allocate<uint8>(_allocator, statesSize, MemoryUsage::ENTROPY);
+       _smallStatesMap0 = allocate<uint8>(1 << 16, MemoryUsage::ENTROPY);
+       _smallStatesMap1 = allocate<uint8>(_allocator, 1 << 24, MemoryUsage::ENTROPY);
+       _hashes = allocate<int>(_allocator, hashSize, MemoryUsage::ENTROPY);
+       _buffer = allocate<byte>(bufferSize, MemoryUsage::ENTROPY);
 
        reset();
    }
@@ -391,12 +436,12 @@ namespace kanzi
    template <bool T>
    TPAQPredictor<T>::~TPAQPredictor()
    {
-       delete[] _bigStatesMap;
-       delete[] _smallStatesMap0;
-       delete[] _smallStatesMap1;
-       delete[] _hashes;
-       delete[] _buffer;
-       delete[] _mixers;
+       deallocate(_allocator, _bigStatesMap);
+       deallocate(_smallStatesMap0);
+       deallocate(_allocator, _smallStatesMap1);
+       deallocate(_allocator, _hashes);
+       deallocate(_buffer);
+       deallocate(_mixers);
    }
 
    // Update the probability model
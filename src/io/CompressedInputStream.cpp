@@ -18,6 +18,7 @@ limitations under the License.
 #include "IOException.hpp"
 #include "../Error.hpp"
 #include "../bitstream/DefaultInputBitStream.hpp"
+#include "../bitstream/MemoryInputBitStream.hpp"
 #include "../entropy/EntropyDecoderFactory.hpp"
 #include "../transform/TransformFactory.hpp"
 
@@ -80,6 +81,7 @@ CompressedInputStream::CompressedInputStream(InputStream& is, int tasks,
     _hasher = (checksum == true) ? new XXHash32(BITSTREAM_TYPE) : nullptr;
     _outputSize = originalSize;
     _nbInputBlocks = 0;
+    _allocator = &Allocator::getAllocator(_ctx);
     _buffers = new SliceArray<byte>*[2 * _jobs];
     _headless = headerless;
 
@@ -97,7 +99,7 @@ CompressedInputStream::CompressedInputStream(InputStream& is, int tasks,
     }
 
     for (int i = 0; i < 2 * _jobs; i++)
-        _buffers[i] = new SliceArray<byte>(new byte[0], 0, 0);
+        _buffers[i] = new SliceArray<byte>(allocate<byte>(_allocator, 0, MemoryUsage::STREAM), 0, 0);
 }
 
 #if __cplusplus >= 201103L
@@ -155,13 +157,14 @@ CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx, bool
         // Optional bsVersion
         const int bsVersion = _ctx.getInt("bsVersion", BITSTREAM_FORMAT_VERSION);
 
-        if (bsVersion != BITSTREAM_FORMAT_VERSION) {
+        if ((bsVersion <= 0) || (bsVersion > BITSTREAM_FORMAT_VERSION)) {
             stringstream ss;
             ss << "Invalid or missing bitstream version, cannot read this version of the stream: " << bsVersion;
             throw invalid_argument(ss.str());
         }
 
-        _ctx.putInt("bsVersion", BITSTREAM_FORMAT_VERSION);
+        // Block framing depends on the version
+        _ctx.putInt("bsVersion", bsVersion);
         string entropy = _ctx.getString("entropy");
         _entropyType = EntropyDecoderFactory::getType(entropy.c_str()); // throws on error
 
@@ -194,10 +197,11 @@ CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx, bool
             _hasher = new XXHash32(BITSTREAM_TYPE);
     }
 
+    _allocator = &Allocator::getAllocator(_ctx);
     _buffers = new SliceArray<byte>*[2 * _jobs];
 
     for (int i = 0; i < 2 * _jobs; i++)
-        _buffers[i] = new SliceArray<byte>(new byte[0], 0, 0);
+        _buffers[i] = new SliceArray<byte>(allocate<byte>(_allocator, 0, MemoryUsage::STREAM), 0, 0);
 }
 
 CompressedInputStream::~CompressedInputStream()
@@ -210,7 +214,7 @@ CompressedInputStream::~CompressedInputStream()
     }
 
     for (int i = 0; i < 2 * _jobs; i++) {
-        delete[] _buffers[i]->_array;
+        deallocate(_allocator, _buffers[i]->_array);
         delete _buffers[i];
     }
 
@@ -296,6 +300,22 @@ void CompressedInputStream::readHeader()
         _nbInputBlocks = min(nbBlocks, MAX_CONCURRENCY - 1);
     }
 
+    // Read flags
+    uint flags = 0;
+
+    if (bsVersion >= HEADER_FLAGS_VERSION) {
+        flags = uint(_ibs->readBits(8));
+
+        if ((flags & ~uint(BLOCK_TYPES_FLAG | SUBSTREAMS_FLAG)) != 0) {
+            stringstream ss;
+            ss << "Invalid bitstream, unknown header flags: " << flags;
+            throw IOException(ss.str(), Error::ERR_INVALID_FILE);
+        }
+    }
+
+    _ctx.putInt("blockTypes", ((flags & BLOCK_TYPES_FLAG) != 0) ? 1 : 0);
+    _ctx.putInt("entropySubStreams", ((flags & SUBSTREAMS_FLAG) != 0) ? 1 : 0);
+
     // Read & verify checksum
     const uint32 cksum1 = uint32(_ibs->readBits(16));
     const uint32 HASH = 0x1E35A7BD;
@@ -310,11 +330,19 @@ void CompressedInputStream::readHeader()
         cksum2 ^= (HASH * uint32(~_outputSize));
     }
 
+    if (bsVersion >= HEADER_FLAGS_VERSION)
+        cksum2 ^= (HASH * uint32(~flags));
+
     cksum2 = (cksum2 >> 23) ^ (cksum2 >> 3);
 
     if (cksum1 != (cksum2 & 0xFFFF))
         throw IOException("Invalid bitstream, corrupted header", Error::ERR_CRC_CHECK);
 
+    if (_parentCtx != nullptr) {
+        _parentCtx->putString("transform", TransformFactory<byte>::getName(_transformType));
+        _parentCtx->putString("entropy", EntropyDecoderFactory::getName(_entropyType));
+    }
+
     if (_listeners.size() > 0) {
         stringstream ss;
         ss << "Bitstream version: " << bsVersion << endl;
@@ -325,6 +353,12 @@ void CompressedInputStream::readHeader()
         string w2 = TransformFactory<byte>::getName(_transformType);
         ss << "Using " << ((w2 == "NONE") ? "no" : w2) << " transform (stage 2)" << endl;
 
+        if ((flags & BLOCK_TYPES_FLAG) != 0)
+            ss << "Transform and entropy codec chosen per block" << endl;
+
+        if ((flags & SUBSTREAMS_FLAG) != 0)
+            ss << "Entropy coded with sub-streams" << endl;
+
         if (szMask != 0) {
             ss << "Original size: " << _outputSize;
             ss << (_outputSize < 2 ? " byte" : " bytes") << endl;
@@ -477,8 +511,8 @@ int CompressedInputStream::processBlock()
             // Create as many tasks as empty buffers to decode
             for (int taskId = 0; taskId < nbTasks; taskId++) {
                 if (_buffers[taskId]->_length < bufSize) {
-                    delete[] _buffers[taskId]->_array;
-                    _buffers[taskId]->_array = new byte[bufSize];
+                    deallocate(_allocator, _buffers[taskId]->_array);
+                    _buffers[taskId]->_array = allocate<byte>(_allocator, bufSize, MemoryUsage::STREAM);
                     _buffers[taskId]->_length = bufSize;
                 }
 
@@ -527,7 +561,13 @@ int CompressedInputStream::processBlock()
                 if (blockListeners.size() > 0) {
                     // Notify after transform ... in block order !
                     Event evt(Event::AFTER_TRANSFORM, res._blockId,
-                        int64(res._decoded), res._checksum, _hasher != nullptr, res._completionTime);
+                        int64(res._decoded), res._checksum, _hasher != nullptr, res._completionTime,
+                        res._completionStamp);
+
+#ifdef MEMORY_TRACKING
+                        if (res._hasMemory == true)
+                            evt.setMemoryUsage(&res._memory);
+#endif
                     CompressedInputStream::notifyListeners(blockListeners, evt);
                 }
             }
@@ -575,7 +615,13 @@ int CompressedInputStream::processBlock()
                         if (blockListeners.size() > 0) {
                            // Notify after transform ... in block order !
                            Event evt(Event::AFTER_TRANSFORM, res._blockId,
-                               int64(res._decoded), res._checksum, _hasher != nullptr, res._completionTime);
+                               int64(res._decoded), res._checksum, _hasher != nullptr, res._completionTime,
+                        res._completionStamp);
+
+#ifdef MEMORY_TRACKING
+                           if (res._hasMemory == true)
+                               evt.setMemoryUsage(&res._memory);
+#endif
                            CompressedInputStream::notifyListeners(blockListeners, evt);
                         }
                     }
@@ -640,8 +686,8 @@ void CompressedInputStream::close()
 
     // Release resources, force error on any subsequent write attempt
     for (int i = 0; i < 2 * _jobs; i++) {
-        delete[] _buffers[i]->_array;
-        _buffers[i]->_array = new byte[0];
+        deallocate(_allocator, _buffers[i]->_array);
+        _buffers[i]->_array = allocate<byte>(_allocator, 0, MemoryUsage::STREAM);
         _buffers[i]->_length = 0;
         _buffers[i]->_index = 0;
     }
@@ -661,6 +707,7 @@ DecodingTask<T>::DecodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
     : _listeners(listeners)
     , _ctx(ctx)
 {
+    _allocator = &Allocator::getAllocator(_ctx);
     _blockLength = blockSize;
     _data = iBuffer;
     _buffer = oBuffer;
@@ -669,6 +716,14 @@ DecodingTask<T>::DecodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
     _processedBlockId = processedBlockId;
 }
 
+// Skip bits up to the provided bitstream position (block padding)
+template <class T>
+void DecodingTask<T>::skipTo(InputBitStream* ibs, uint64 pos)
+{
+    while (ibs->read() < pos)
+        ibs->readBits(uint(min(pos - ibs->read(), uint64(64))));
+}
+
 // Decode mode + transformed entropy coded data
 // mode | 0b10000000 => copy block
 //      | 0b0yy00000 => size(size(block))-1
@@ -678,10 +733,19 @@ DecodingTask<T>::DecodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
 //  case more than 4 transforms
 //      | 0b00000000
 //      then 0byyyyyyyy => transform sequence skip flags (1 means skip)
+//  case block types flag set in the header (not for a copy block)
+//      then 0byyyyyyyy => entropy codec type
+//      then 48 bits => transform types
 template <class T>
 T DecodingTask<T>::run()
 {
     int blockId = _ctx.getInt("blockId");
+    MemoryTracker::BlockScope memScope; // memory allocated for this block
+
+    if (_listeners.size() > 0) {
+        Event evt(Event::BEFORE_WAIT, blockId, int64(0), clock());
+        CompressedInputStream::notifyListeners(_listeners, evt);
+    }
 
     // Lock free synchronization
     while (true) {
@@ -699,6 +763,13 @@ T DecodingTask<T>::run()
         CPU_PAUSE();
     }
 
+    if (_listeners.size() > 0) {
+        Event evt(Event::AFTER_WAIT, blockId, int64(0), clock());
+        CompressedInputStream::notifyListeners(_listeners, evt);
+        Event evt2(Event::BEFORE_READ, blockId, int64(0), clock());
+        CompressedInputStream::notifyListeners(_listeners, evt2);
+    }
+
     uint32 checksum1 = 0;
     EntropyDecoder* ed = nullptr;
     InputBitStream* ibs = nullptr;
@@ -709,8 +780,24 @@ T DecodingTask<T>::run()
 
     try {
         // Read shared bitstream sequentially (each task is gated by _processedBlockId)
-        const uint lr = 3 + uint(_ibs->readBits(5));
-        uint64 read = _ibs->readBits(lr);
+        const bool aligned = _ctx.getInt("bsVersion") >= CompressedInputStream::ALIGNED_BLOCKS_VERSION;
+        uint64 read;
+
+        if (aligned == true) {
+            // Byte aligned frame: size of block size in bytes then block size in bits
+            const uint lr = uint(_ibs->readBits(8));
+
+            if (lr > 5) {
+                _processedBlockId->store(CompressedInputStream::CANCEL_TASKS_ID, memory_order_release);
+                return T(*_data, blockId, 0, 0, Error::ERR_BLOCK_SIZE, "Invalid block size");
+            }
+
+            read = (lr == 0) ? 0 : _ibs->readBits(8 * lr);
+        }
+        else {
+            const uint lr = 3 + uint(_ibs->readBits(5));
+            read = _ibs->readBits(lr);
+        }
 
         if (read == 0) {
             _processedBlockId->store(CompressedInputStream::CANCEL_TASKS_ID, memory_order_release);
@@ -723,12 +810,13 @@ T DecodingTask<T>::run()
         }
 
         const int r = int((read + 7) >> 3);
+        const uint64 blockEnd = _ibs->read() + (uint64(r) << 3);
 
         if (streamPerTask == true) {
             if (_data->_length < max(_blockLength, r)) {
                 _data->_length = max(_blockLength, r);
-                delete[] _data->_array;
-                _data->_array = new byte[_data->_length];
+                deallocate(_allocator, _data->_array);
+                _data->_array = allocate<byte>(_allocator, _data->_length, MemoryUsage::STREAM);
             }
 
             for (int n = 0; read > 0; ) {
@@ -737,12 +825,21 @@ T DecodingTask<T>::run()
                 n += ((chkSize + 7) >> 3);
                 read -= uint64(chkSize);
             }
+
+            // Skip padding of the last byte
+            if (aligned == true)
+                skipTo(_ibs, blockEnd);
         }
 
         // After completion of the bitstream reading, increment the block id.
         // It unblocks the task processing the next block (if any)
         _processedBlockId->store(blockId, memory_order_release);
 
+        if (_listeners.size() > 0) {
+            Event evt(Event::AFTER_READ, blockId, int64(r), clock());
+            CompressedInputStream::notifyListeners(_listeners, evt);
+        }
+
         const int from = _ctx.getInt("from", 1);
         const int to = _ctx.getInt("to", CompressedInputStream::MAX_BLOCK_ID);
 
@@ -751,9 +848,8 @@ T DecodingTask<T>::run()
             return T(*_data, blockId, 0, 0, 0, "Skipped", true);
         }
 
-        istreambuf<char> buf(reinterpret_cast<char*>(&_data->_array[0]), streamsize(r));
-        iostream ios(&buf);
-        ibs = (streamPerTask == true) ? new DefaultInputBitStream(ios) : _ibs;
+        SliceArray<byte> payload(_data->_array, r, 0);
+        ibs = (streamPerTask == true) ? new MemoryInputBitStream(payload, r) : _ibs;
 
         // Extract block header from bitstream
         byte mode = byte(ibs->readBits(8));
@@ -768,6 +864,14 @@ T DecodingTask<T>::run()
                 skipFlags = byte(ibs->readBits(8));
             else
                 skipFlags = (mode << 4) | byte(0x0F);
+
+            if (_ctx.getInt("blockTypes", 0) != 0) {
+                // The transforms and entropy codec select their variant from these
+                eType = short(ibs->readBits(8));
+                tType = ibs->readBits(48);
+                _ctx.putString("entropy", EntropyDecoderFactory::getName(eType));
+                _ctx.putString("transform", TransformFactory<byte>::getName(tType));
+            }
         }
 
         const int dataSize = 1 + (int(mode >> 5) & 0x03);
@@ -811,8 +915,8 @@ T DecodingTask<T>::run()
 
         if (_buffer->_length < bufferSize) {
             _buffer->_length = bufferSize;
-            delete[] _buffer->_array;
-            _buffer->_array = new byte[_buffer->_length];
+            deallocate(_allocator, _buffer->_array);
+            _buffer->_array = allocate<byte>(_allocator, _buffer->_length, MemoryUsage::STREAM);
         }
 
         const int savedIdx = _data->_index;
@@ -839,6 +943,10 @@ T DecodingTask<T>::run()
         delete ed;
         ed = nullptr;
 
+        // Shared bitstream: skip padding of the last byte
+        if ((streamPerTask == false) && (aligned == true))
+            skipTo(_ibs, blockEnd);
+
         if (_listeners.size() > 0) {
             // Notify after entropy (block size set to size in bitstream)
             Event evt(Event::AFTER_ENTROPY, blockId,
@@ -851,12 +959,20 @@ T DecodingTask<T>::run()
             // Notify before transform (block size after entropy decoding)
             Event evt(Event::BEFORE_TRANSFORM, blockId,
                 int64(preTransformLength), checksum1, _hasher != nullptr, clock());
+            evt.setBlockMode(int(skipFlags), (mode & CompressedInputStream::COPY_BLOCK_MASK) != byte(0));
+
+            if (_ctx.getInt("blockTypes", 0) != 0)
+                evt.setBlockTypes(TransformFactory<byte>::getName(tType), EntropyDecoderFactory::getName(eType));
 
             CompressedInputStream::notifyListeners(_listeners, evt);
         }
 
         transform = TransformFactory<byte>::newTransform(_ctx, tType);
         transform->setSkipFlags(skipFlags);
+        transform->setAllocator(_allocator);
+
+        if (_listeners.size() > 0)
+            transform->setListeners(_listeners, blockId);
         _buffer->_index = 0;
 
         // Inverse transform
@@ -20,6 +20,7 @@ limitations under the License.
 #include <cstdio> // definition of EOF
 #include <string>
 #include <vector>
+#include "../Allocator.hpp"
 #include "../concurrent.hpp"
 #include "../Context.hpp"
 #include "../Listener.hpp"
@@ -46,9 +47,13 @@ namespace kanzi
        int _checksum;
        bool _skipped;
        clock_t _completionTime;
+       EventTime _completionStamp; // wall/cpu time and thread of the decoding task
+       MemoryUsage _memory; // memory allocated by the decoding task
+       bool _hasMemory;
 
        DecodingTaskResult()
        {
+           _hasMemory = false;
            _blockId = -1;
            _decoded = 0;
            _data = nullptr;
@@ -69,6 +74,9 @@ namespace kanzi
            , _skipped(skipped)
        {
            _completionTime = clock();
+
+           // Built by the decoding task: capture the usage of its block scope
+           _hasMemory = MemoryTracker::getBlockUsage(_memory);
        }
 
        DecodingTaskResult(const DecodingTaskResult& result)
@@ -80,6 +88,9 @@ namespace kanzi
            , _checksum(result._checksum)
            , _skipped(result._skipped)
            , _completionTime(result._completionTime)
+           , _completionStamp(result._completionStamp)
+           , _memory(result._memory)
+           , _hasMemory(result._hasMemory)
        {
        }
 
@@ -92,7 +103,10 @@ namespace kanzi
            _decoded = result._decoded;
            _checksum = result._checksum;
            _completionTime = result._completionTime;
+           _completionStamp = result._completionStamp;
            _skipped = result._skipped;
+           _memory = result._memory;
+           _hasMemory = result._hasMemory;
            return *this;
        }
 
@@ -112,6 +126,9 @@ namespace kanzi
        ATOMIC_INT* _processedBlockId;
        std::vector<Listener*> _listeners;
        Context _ctx;
+       Allocator* _allocator; // block buffers (_data and _buffer)
+
+       static void skipTo(InputBitStream* ibs, uint64 pos);
 
    public:
        DecodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuffer,
@@ -152,6 +169,7 @@ namespace kanzi
 
       // If headerless == true, the context must contain "entropy", "transform", "checksum" & "blockSize"
       // If "bsVersion" is missing, the current value of BITSTREAM_FORMAT_VERSION is assumed.
+      // If the stream was encoded with "entropySubStreams", the context must contain it too.
 #if __cplusplus >= 201103L
        CompressedInputStream(InputStream& is, Context& ctx, bool headerless = false,
           std::function<InputBitStream*(InputStream&)>* createBitStream = nullptr);
@@ -193,7 +211,11 @@ namespace kanzi
 
    private:
        static const int BITSTREAM_TYPE = 0x4B414E5A; // "KANZ"
-       static const int BITSTREAM_FORMAT_VERSION = 5;
+       static const int BITSTREAM_FORMAT_VERSION = 6;
+       static const int ALIGNED_BLOCKS_VERSION = 6; // first version with byte aligned block frames
+       static const int HEADER_FLAGS_VERSION = 6; // first version with a header flags byte
+       static const int SUBSTREAMS_FLAG = 1; // number of entropy sub-streams stored in each block
+       static const int BLOCK_TYPES_FLAG = 2; // transform and entropy types stored in each block
        static const int DEFAULT_BUFFER_SIZE = 256 * 1024;
        static const int EXTRA_BUFFER_SIZE = 512;
        static const byte COPY_BLOCK_MASK = byte(0x80);
@@ -223,6 +245,7 @@ namespace kanzi
        std::vector<Listener*> _listeners;
        std::streamsize _gcount;
        Context _ctx;
+       Allocator* _allocator; // block buffers (_buffers)
        Context* _parentCtx; // not owner
        bool _headless;
 #ifdef CONCURRENCY_ENABLED
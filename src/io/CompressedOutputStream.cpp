@@ -19,6 +19,7 @@ limitations under the License.
 #include "../Error.hpp"
 #include "../Magic.hpp"
 #include "../bitstream/DefaultOutputBitStream.hpp"
+#include "../bitstream/MemoryOutputBitStream.hpp"
 #include "../entropy/EntropyEncoderFactory.hpp"
 #include "../entropy/EntropyUtils.hpp"
 #include "../transform/TransformFactory.hpp"
@@ -83,21 +84,23 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, const string& e
     _transformType = TransformFactory<byte>::getType(transform.c_str());
     _hasher = (checksum == true) ? new XXHash32(BITSTREAM_TYPE) : nullptr;
     _jobs = tasks;
+    _allocator = &Allocator::getAllocator(_ctx);
     _buffers = new SliceArray<byte>*[2 * _jobs];
     _ctx.putInt("blockSize", _blockSize);
     _ctx.putInt("checksum", (checksum == true) ? 1 : 0);
     _ctx.putString("entropy", entropyCodec);
     _ctx.putString("transform", transform);
     _ctx.putInt("bsVersion", BITSTREAM_FORMAT_VERSION);
+    initAdaptive();
 
     // Allocate first buffer and add padding for incompressible blocks
     const int bufSize = max(_blockSize + (_blockSize >> 6), 65536);
-    _buffers[0] = new SliceArray<byte>(new byte[bufSize], bufSize, 0);
-    _buffers[_jobs] = new SliceArray<byte>(new byte[0], 0, 0);
+    _buffers[0] = new SliceArray<byte>(allocate<byte>(_allocator, bufSize, MemoryUsage::STREAM), bufSize, 0);
+    _buffers[_jobs] = new SliceArray<byte>(allocate<byte>(_allocator, 0, MemoryUsage::STREAM), 0, 0);
 
     for (int i = 1; i < _jobs; i++) {
-       _buffers[i] = new SliceArray<byte>(new byte[0], 0, 0);
-       _buffers[i + _jobs] = new SliceArray<byte>(new byte[0], 0, 0);
+       _buffers[i] = new SliceArray<byte>(allocate<byte>(_allocator, 0, MemoryUsage::STREAM), 0, 0);
+       _buffers[i + _jobs] = new SliceArray<byte>(allocate<byte>(_allocator, 0, MemoryUsage::STREAM), 0, 0);
     }
 }
 
@@ -153,6 +156,11 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx)
     _initialized = false;
     _closed = false;
     _headless = _ctx.getInt("headerless") != 0;
+    string entropyCodec = ctx.getString("entropy");
+    string transform = ctx.getString("transform");
+    _entropyType = EntropyEncoderFactory::getType(entropyCodec.c_str());
+    _transformType = TransformFactory<byte>::getType(transform.c_str());
+    initAdaptive();
 
 #if __cplusplus >= 201103L
     // A hook can be provided by the caller to customize the instantiation of the
@@ -162,23 +170,20 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx)
     _obs = new DefaultOutputBitStream(os, DEFAULT_BUFFER_SIZE);
 #endif
 
-    string entropyCodec = ctx.getString("entropy");
-    string transform = ctx.getString("transform");
-    _entropyType = EntropyEncoderFactory::getType(entropyCodec.c_str());
-    _transformType = TransformFactory<byte>::getType(transform.c_str());
     bool checksum = ctx.getInt("checksum", 0) == 1;
     _hasher = (checksum == true) ? new XXHash32(BITSTREAM_TYPE) : nullptr;
     _ctx.putInt("bsVersion", BITSTREAM_FORMAT_VERSION);
+    _allocator = &Allocator::getAllocator(_ctx);
     _buffers = new SliceArray<byte>*[2 * _jobs];
 
     // Allocate first buffer and add padding for incompressible blocks
     const int bufSize = max(_blockSize + (_blockSize >> 6), 65536);
-    _buffers[0] = new SliceArray<byte>(new byte[bufSize], bufSize, 0);
-    _buffers[_jobs] = new SliceArray<byte>(new byte[0], 0, 0);
+    _buffers[0] = new SliceArray<byte>(allocate<byte>(_allocator, bufSize, MemoryUsage::STREAM), bufSize, 0);
+    _buffers[_jobs] = new SliceArray<byte>(allocate<byte>(_allocator, 0, MemoryUsage::STREAM), 0, 0);
 
     for (int i = 1; i < _jobs; i++) {
-       _buffers[i] = new SliceArray<byte>(new byte[0], 0, 0);
-       _buffers[i + _jobs] = new SliceArray<byte>(new byte[0], 0, 0);
+       _buffers[i] = new SliceArray<byte>(allocate<byte>(_allocator, 0, MemoryUsage::STREAM), 0, 0);
+       _buffers[i + _jobs] = new SliceArray<byte>(allocate<byte>(_allocator, 0, MemoryUsage::STREAM), 0, 0);
     }
 }
 
@@ -192,7 +197,7 @@ CompressedOutputStream::~CompressedOutputStream()
     }
 
     for (int i = 0; i < 2 * _jobs; i++) {
-        delete[] _buffers[i]->_array;
+        deallocate(_allocator, _buffers[i]->_array);
         delete _buffers[i];
     }
 
@@ -205,6 +210,170 @@ CompressedOutputStream::~CompressedOutputStream()
     }
 }
 
+void CompressedOutputStream::initAdaptive()
+{
+    _adaptive = _ctx.has("adaptive");
+    _adaptiveTarget = 0;
+    _level = 0;
+    _minLevel = 0;
+    _maxLevel = 0;
+    _stallTime = 0.0;
+    _adaptiveTime = 0.0;
+
+    for (int i = 0; i <= MAX_LEVEL; i++)
+        _levelThroughput[i] = 0.0;
+
+    if (_adaptive == false)
+        return;
+
+    if (_headless == true)
+        throw invalid_argument("The adaptive mode requires a bitstream header");
+
+    _adaptiveTarget = _ctx.getInt("adaptive", 0);
+
+    if (_adaptiveTarget < 0)
+        throw invalid_argument("The adaptive throughput target must be positive (or 0 to react to output stalls)");
+
+    const int level = _ctx.getInt("level", 3);
+
+    if ((level < 0) || (level > MAX_LEVEL))
+        throw invalid_argument("Invalid compression level");
+
+    // With a throughput target, the level is an upper bound. Otherwise,
+    // it is a lower bound (the level is raised when the output stalls).
+    _minLevel = (_adaptiveTarget > 0) ? 0 : level;
+    _maxLevel = (_adaptiveTarget > 0) ? level : MAX_LEVEL;
+
+    // With a throughput target, start with a fast level: the first blocks
+    // are not slowed down and give the throughput to extrapolate from.
+    _level = (_adaptiveTarget > 0) ? min(level, FIRST_ADAPTIVE_LEVEL) : level;
+
+    // The header records the initial configuration
+    string transform, entropy;
+    getTransformAndCodec(_level, transform, entropy);
+    _entropyType = EntropyEncoderFactory::getType(entropy.c_str());
+    _transformType = TransformFactory<byte>::getType(transform.c_str());
+}
+
+bool CompressedOutputStream::getTransformAndCodec(int level, string& transform, string& entropy)
+{
+    switch (level) {
+    case 0:
+        transform = "NONE";
+        entropy = "NONE";
+        return true;
+
+    case 1:
+        transform = "PACK+LZ";
+        entropy = "NONE";
+        return true;
+
+    case 2:
+        transform = "PACK+LZ";
+        entropy = "HUFFMAN";
+        return true;
+
+    case 3:
+        transform = "TEXT+UTF+PACK+MM+LZX";
+        entropy = "HUFFMAN";
+        return true;
+
+    case 4:
+        transform = "TEXT+UTF+EXE+PACK+MM+ROLZ";
+        entropy = "NONE";
+        return true;
+
+    case 5:
+        transform = "TEXT+UTF+BWT+RANK+ZRLT";
+        entropy = "ANS0";
+        return true;
+
+    case 6:
+        transform = "TEXT+UTF+BWT+SRT+ZRLT";
+        entropy = "FPAQ";
+        return true;
+
+    case 7:
+        transform = "LZP+TEXT+UTF+BWT+LZP";
+        entropy = "CM";
+        return true;
+
+    case 8:
+        transform = "EXE+RLT+TEXT+UTF";
+        entropy = "TPAQ";
+        return true;
+
+    case 9:
+        transform = "EXE+RLT+TEXT+UTF";
+        entropy = "TPAQX";
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Encoding times of silesia.tar (ms) with each level (see README), level 0 estimated
+const int CompressedOutputStream::LEVEL_COSTS[MAX_LEVEL + 1] = {
+    50, 263, 267, 446, 543, 1627, 2312, 2686, 7260, 18990
+};
+
+int CompressedOutputStream::selectLevel(double target, int level, int minLevel, int maxLevel, double throughputs[])
+{
+    const double current = throughputs[level];
+    int res = minLevel;
+
+    for (int l = maxLevel; l >= minLevel; l--) {
+        const double estimate = (throughputs[l] > 0.0) ? throughputs[l]
+            : current * double(LEVEL_COSTS[level]) / double(LEVEL_COSTS[l]);
+
+        if (estimate >= target) {
+            res = l;
+            break;
+        }
+    }
+
+    // Age the measures of the slower levels (the data may have changed)
+    for (int l = res + 1; l <= maxLevel; l++) {
+        if ((l != level) && (throughputs[l] > 0.0))
+            throughputs[l] *= 1.02;
+    }
+
+    return res;
+}
+
+// Choose the level of the next blocks from the processing of the last ones:
+// 'size' bytes encoded in 'elapsed' ns, 'writeTime' ns of which were spent
+// writing to the output stream.
+void CompressedOutputStream::adaptLevel(int64 size, int64 elapsed, int64 writeTime)
+{
+    if (elapsed <= 0)
+        return;
+
+    const double throughput = double(size) * 1e9 / (1024.0 * 1024.0 * double(elapsed));
+    _levelThroughput[_level] = throughput;
+
+    if (_adaptiveTarget > 0) {
+        _level = selectLevel(double(_adaptiveTarget), _level, _minLevel, _maxLevel, _levelThroughput);
+    }
+    else {
+        // Share of the time spent waiting for the output stream. The output is
+        // buffered so the stalls come in bursts: use decaying time sums.
+        _stallTime = 0.75 * _stallTime + double(writeTime);
+        _adaptiveTime = 0.75 * _adaptiveTime + double(elapsed);
+        const double stalls = _stallTime / _adaptiveTime;
+
+        if (stalls > 0.5) {
+            if (_level < _maxLevel)
+                _level++;
+        }
+        else if (stalls < 0.1) {
+            if (_level > _minLevel)
+                _level--;
+        }
+    }
+}
+
 void CompressedOutputStream::writeHeader()
 {
     if (_obs->writeBits(BITSTREAM_TYPE, 32) != 32)
@@ -237,6 +406,14 @@ void CompressedOutputStream::writeHeader()
             throw IOException("Cannot write size of input to header", Error::ERR_WRITE_FILE);
     }
 
+    uint flags = (_adaptive == true) ? BLOCK_TYPES_FLAG : 0;
+
+    if (_ctx.getInt("entropySubStreams", 0) != 0)
+        flags |= SUBSTREAMS_FLAG;
+
+    if (_obs->writeBits(flags, 8) != 8)
+        throw IOException("Cannot write flags to header", Error::ERR_WRITE_FILE);
+
     const uint32 HASH = 0x1E35A7BD;
     uint32 cksum = HASH * BITSTREAM_FORMAT_VERSION;
     cksum ^= (HASH * uint32(~_entropyType));
@@ -249,6 +426,7 @@ void CompressedOutputStream::writeHeader()
         cksum ^= (HASH * uint32(~_inputSize));
     }
 
+    cksum ^= (HASH * uint32(~flags));
     cksum = (cksum >> 23) ^ (cksum >> 3);
 
     if (_obs->writeBits(cksum, 16) != 16)
@@ -301,8 +479,8 @@ ostream& CompressedOutputStream::write(const char* data, streamsize length)
                     const int bufSize = max(_blockSize + (_blockSize >> 6), 65536);
 
                     if (_buffers[_bufferId]->_length == 0) {
-                        delete[] _buffers[_bufferId]->_array;
-                        _buffers[_bufferId]->_array = new byte[bufSize];
+                        deallocate(_allocator, _buffers[_bufferId]->_array);
+                        _buffers[_bufferId]->_array = allocate<byte>(_allocator, bufSize, MemoryUsage::STREAM);
                         _buffers[_bufferId]->_length = bufSize;
                     }
 
@@ -335,8 +513,7 @@ void CompressedOutputStream::close()
 
     try {
         // Write end block of size 0
-        _obs->writeBits(uint64(0), 5); // write length-3 (5 bits max)
-        _obs->writeBits(uint64(0), 3); // write 0 (3 bits)
+        _obs->writeBits(uint64(0), 8);
         _obs->close();
     }
     catch (exception& e) {
@@ -349,8 +526,8 @@ void CompressedOutputStream::close()
 
     // Release resources, force error on any subsequent write attempt
     for (int i = 0; i < 2 * _jobs; i++) {
-        delete[] _buffers[i]->_array;
-        _buffers[i]->_array = new byte[0];
+        deallocate(_allocator, _buffers[i]->_array);
+        _buffers[i]->_array = allocate<byte>(_allocator, 0, MemoryUsage::STREAM);
         _buffers[i]->_length = 0;
         _buffers[i]->_index = 0;
     }
@@ -372,6 +549,9 @@ void CompressedOutputStream::processBlock()
     try {
         int firstBlockId = _blockId.load(memory_order_relaxed);
         int nbTasks = _jobs;
+        const int64 startTime = EventTime::wallTime();
+        int64 blockBytes = 0;
+        int64 writeTime = 0;
         int jobsPerTask[MAX_CONCURRENCY];
 
         // Assign optimal number of tasks and jobs per task (if the number of blocks is available)
@@ -398,9 +578,22 @@ void CompressedOutputStream::processBlock()
             copyCtx.putInt("jobs", jobsPerTask[taskId]);
             copyCtx.putLong("tType", _transformType);
             copyCtx.putInt("eType", _entropyType);
+
+            if (_adaptive == true) {
+                // The transforms and entropy codec select their variant from these
+                string transform, entropy;
+                CompressedOutputStream::getTransformAndCodec(_level, transform, entropy);
+                copyCtx.putInt("blockTypes", 1);
+                copyCtx.putLong("tType", TransformFactory<byte>::getType(transform.c_str()));
+                copyCtx.putInt("eType", EntropyEncoderFactory::getType(entropy.c_str()));
+                copyCtx.putString("transform", transform);
+                copyCtx.putString("entropy", entropy);
+            }
+
             copyCtx.putInt("blockId", firstBlockId + taskId + 1);
             copyCtx.putInt("size", dataLength); // "size" is the actual block size, "blockSize" the provided one
             _buffers[taskId]->_index = 0;
+            blockBytes += dataLength;
 
             EncodingTask<EncodingTaskResult>* task = new EncodingTask<EncodingTaskResult>(_buffers[taskId],
                 _buffers[_jobs + taskId],
@@ -418,6 +611,7 @@ void CompressedOutputStream::processBlock()
             if (res._error != 0)
                 throw IOException(res._msg, res._error); // deallocate in catch block
 
+            writeTime += res._writeTime;
             delete task;
         }
 #ifdef CONCURRENCY_ENABLED
@@ -448,6 +642,7 @@ void CompressedOutputStream::processBlock()
                 // before they are completed.
                 error = res._error;
                 msg = res._msg;
+                writeTime += res._writeTime;
             }
 
             if (error != 0)
@@ -461,6 +656,9 @@ void CompressedOutputStream::processBlock()
 #endif
 
         _bufferId = 0;
+
+        if (_adaptive == true)
+            adaptLevel(blockBytes, EventTime::wallTime() - startTime, writeTime);
     }
     catch (IOException&) {
         for (vector<EncodingTask<EncodingTaskResult>*>::iterator it = tasks.begin(); it != tasks.end(); ++it)
@@ -500,6 +698,7 @@ EncodingTask<T>::EncodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
     , _listeners(listeners)
     , _ctx(ctx)
 {
+    _allocator = &Allocator::getAllocator(_ctx);
     _data = iBuffer;
     _buffer = oBuffer;
     _hasher = hasher;
@@ -515,11 +714,15 @@ EncodingTask<T>::EncodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
 //  case more than 4 transforms
 //      | 0b00000000
 //      then 0byyyyyyyy => transform sequence skip flags (1 means skip)
+//  case block types flag set in the header (not for a copy block)
+//      then 0byyyyyyyy => entropy codec type
+//      then 48 bits => transform types
 template <class T>
 T EncodingTask<T>::run()
 {
     const int blockId = _ctx.getInt("blockId");
     const int blockLength = _ctx.getInt("size");
+    MemoryTracker::BlockScope memScope; // memory allocated for this block
     TransformSequence<byte>* transform = nullptr;
     EntropyEncoder* ee = nullptr;
 
@@ -577,6 +780,11 @@ T EncodingTask<T>::run()
 
         _ctx.putInt("size", blockLength);
         transform = TransformFactory<byte>::newTransform(_ctx, tType);
+        transform->setAllocator(_allocator);
+
+        if (_listeners.size() > 0)
+            transform->setListeners(_listeners, blockId);
+
         const int requiredSize = transform->getMaxEncodedLength(blockLength);
 
         if (blockLength >= 4) {
@@ -591,8 +799,8 @@ T EncodingTask<T>::run()
         }
 
         if (_buffer->_length < requiredSize) {
-            delete[] _buffer->_array;
-            _buffer->_array = new byte[requiredSize];
+            deallocate(_allocator, _buffer->_array);
+            _buffer->_array = allocate<byte>(_allocator, requiredSize, MemoryUsage::STREAM);
             _buffer->_length = requiredSize;
         }
 
@@ -626,6 +834,10 @@ T EncodingTask<T>::run()
             // Notify after transform
             Event evt(Event::AFTER_TRANSFORM, blockId,
                 int64(postTransformLength), checksum, _hasher != nullptr, clock());
+            evt.setBlockMode(int(skipFlags), (mode & CompressedOutputStream::COPY_BLOCK_MASK) != byte(0));
+
+            if (_ctx.getInt("blockTypes", 0) != 0)
+                evt.setBlockTypes(TransformFactory<byte>::getName(tType), EntropyEncoderFactory::getName(eType));
 
             CompressedOutputStream::notifyListeners(_listeners, evt);
         }
@@ -635,15 +847,14 @@ T EncodingTask<T>::run()
         if (_data->_length < bufSize) {
             // Rare case where the transform expanded the input or
             // entropy coder may expand size.
-            delete[] _data->_array;
+            deallocate(_allocator, _data->_array);
             _data->_length = bufSize;
-            _data->_array = new byte[_data->_length];
+            _data->_array = allocate<byte>(_allocator, _data->_length, MemoryUsage::STREAM);
         }
 
+        // Write the block directly to _data (grown if the entropy coder expands the data)
         _data->_index = 0;
-        ostreambuf<char> buf(reinterpret_cast<char*>(&_data->_array[_data->_index]), streamsize(_data->_length));
-        ostream os(&buf);
-        DefaultOutputBitStream obs(os);
+        MemoryOutputBitStream obs(*_data, true, _allocator);
 
         // Write block 'header' (mode + compressed length)
         if (((mode & CompressedOutputStream::COPY_BLOCK_MASK) != byte(0)) || (nbTransforms <= 4)) {
@@ -656,6 +867,12 @@ T EncodingTask<T>::run()
             obs.writeBits(uint64(skipFlags), 8);
         }
 
+        // Write the block types if they may change from block to block
+        if ((_ctx.getInt("blockTypes", 0) != 0) && ((mode & CompressedOutputStream::COPY_BLOCK_MASK) == byte(0))) {
+            obs.writeBits(uint64(eType), 8);
+            obs.writeBits(tType, 48);
+        }
+
         obs.writeBits(postTransformLength, 8 * dataSize);
 
         // Write checksum
@@ -687,6 +904,12 @@ T EncodingTask<T>::run()
         ee = nullptr;
         obs.close();
         uint64 written = obs.written();
+        _data->_index = 0;
+
+        if (_listeners.size() > 0) {
+            Event evt(Event::BEFORE_WAIT, blockId, int64(0), clock());
+            CompressedOutputStream::notifyListeners(_listeners, evt);
+        }
 
         // Lock free synchronization
         while (true) {
@@ -702,20 +925,40 @@ T EncodingTask<T>::run()
             CPU_PAUSE();
         }
 
+        if (_listeners.size() > 0) {
+            Event evt(Event::AFTER_WAIT, blockId, int64(0), clock());
+            CompressedOutputStream::notifyListeners(_listeners, evt);
+        }
+
         if (_listeners.size() > 0) {
             // Notify after entropy
             Event evt(Event::AFTER_ENTROPY, blockId,
                 int64((written + 7) >> 3), checksum, _hasher != nullptr, clock());
 
+#ifdef MEMORY_TRACKING
+            evt.setMemoryUsage(&memScope.getUsage());
+#endif
+
+            CompressedOutputStream::notifyListeners(_listeners, evt);
+        }
+
+        const int64 blockBytes = int64((written + 7) >> 3);
+
+        if (_listeners.size() > 0) {
+            Event evt(Event::BEFORE_WRITE, blockId, blockBytes, clock());
             CompressedOutputStream::notifyListeners(_listeners, evt);
         }
 
-        // Emit block size in bits (max size pre-entropy is 1 GB = 1 << 30 bytes)
-        const uint lw = (written < 8) ? 3 : uint(Global::log2(uint32(written >> 3)) + 4);
-        _obs->writeBits(lw - 3, 5); // write length-3 (5 bits max)
-        _obs->writeBits(written, lw);
+        // Emit block frame: size of block size in bytes (1 byte) then block
+        // size in bits (max size pre-entropy is 1 GB = 1 << 30 bytes).
+        // The frame is byte aligned so that the payload is too.
+        const int64 writeStart = EventTime::wallTime();
+        const uint lw = (Global::log2(written | 1) >> 3) + 1;
+        _obs->writeBits(lw, 8);
+        _obs->writeBits(written, 8 * lw);
+        const uint padding = uint(-written) & 7;
 
-        // Emit data to shared bitstream
+        // Emit data to shared bitstream (byte aligned => plain copy)
         for (int n = 0; written > 0; ) {
             uint chkSize = uint(min(written, uint64(1) << 30));
             _obs->writeBits(&_data->_array[n], chkSize);
@@ -723,11 +966,22 @@ T EncodingTask<T>::run()
             written -= uint64(chkSize);
         }
 
+        // Pad the last byte of the block
+        if (padding != 0)
+            _obs->writeBits(uint64(0), padding);
+
+        if (_listeners.size() > 0) {
+            Event evt(Event::AFTER_WRITE, blockId, blockBytes, clock());
+            CompressedOutputStream::notifyListeners(_listeners, evt);
+        }
+
+        const int64 writeTime = EventTime::wallTime() - writeStart;
+
         // After completion of the entropy coding, increment the block id.
         // It unblocks the task processing the next block (if any).
         _processedBlockId->store(blockId, memory_order_release);
 
-        return T(blockId, 0, "Success");
+        return T(blockId, 0, "Success", writeTime);
     }
     catch (exception& e) {
         // Make sure to unfreeze next block
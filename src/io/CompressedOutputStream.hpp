@@ -20,6 +20,7 @@ limitations under the License.
 
 #include <string>
 #include <vector>
+#include "../Allocator.hpp"
 #include "../concurrent.hpp"
 #include "../Context.hpp"
 #include "../Listener.hpp"
@@ -40,17 +41,20 @@ namespace kanzi {
        int _blockId;
        int _error; // 0 = OK
        std::string _msg;
+       int64 _writeTime; // time spent writing the block to the shared bitstream (ns)
 
        EncodingTaskResult()
        {
            _blockId = -1;
            _error = 0;
+           _writeTime = 0;
        }
 
-       EncodingTaskResult(int blockId, int error, const std::string& msg)
+       EncodingTaskResult(int blockId, int error, const std::string& msg, int64 writeTime = 0)
            : _blockId(blockId)
            , _error(error)
            , _msg(msg)
+           , _writeTime(writeTime)
        {
        }
 
@@ -58,6 +62,7 @@ namespace kanzi {
            : _blockId(result._blockId)
            , _error(result._error)
            , _msg(result._msg)
+           , _writeTime(result._writeTime)
        {
        }
 
@@ -66,6 +71,7 @@ namespace kanzi {
            _msg = result._msg;
            _blockId = result._blockId;
            _error = result._error;
+           _writeTime = result._writeTime;
            return *this;
        }
 
@@ -84,6 +90,7 @@ namespace kanzi {
        ATOMIC_INT* _processedBlockId;
        std::vector<Listener*> _listeners;
        Context _ctx;
+       Allocator* _allocator; // block buffers (_data and _buffer)
 
    public:
        EncodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuffer,
@@ -110,6 +117,12 @@ namespace kanzi {
           uint64 fileSize = 0, bool headerless = false);
 #endif
 
+       // If "adaptive" is set in the context, the transform and entropy codec
+       // of each block are chosen from the compression levels to reach a
+       // throughput of "adaptive" MB/s ("level" is then the highest level).
+       // With "adaptive" = 0, the level is raised when writing to the output
+       // stream stalls ("level" is then the lowest level). The choice is
+       // recorded in each block header. Not available in headerless mode.
 #if __cplusplus >= 201103L
        CompressedOutputStream(OutputStream& os, Context& ctx,
           std::function<OutputBitStream*(OutputStream&)>* createBitStream = nullptr);
@@ -137,6 +150,18 @@ namespace kanzi {
 
        uint64 getWritten() const { return (_obs->written() + 7) >> 3; }
 
+       // Transform and entropy codec of the compression level (0 to 9).
+       // Return false if the level is invalid.
+       static bool getTransformAndCodec(int level, std::string& transform, std::string& entropy);
+
+       // Return the highest level in [minLevel, maxLevel] expected to reach
+       // 'target' MB/s (else minLevel). 'throughputs' holds the last MB/s
+       // measured per level (0 if unknown), including the current 'level'.
+       // The unknown ones are extrapolated from the current level with the
+       // relative costs of the levels. The known ones above the target level
+       // are slowly raised so that they are eventually tried again.
+       static int selectLevel(double target, int level, int minLevel, int maxLevel, double throughputs[]);
+
 
   protected:
 
@@ -145,7 +170,12 @@ namespace kanzi {
 
    private:
        static const int BITSTREAM_TYPE = 0x4B414E5A; // "KANZ"
-       static const int BITSTREAM_FORMAT_VERSION = 5;
+       static const int BITSTREAM_FORMAT_VERSION = 6;
+       static const int SUBSTREAMS_FLAG = 1; // number of entropy sub-streams stored in each block
+       static const int BLOCK_TYPES_FLAG = 2; // transform and entropy types stored in each block
+       static const int MAX_LEVEL = 9;
+       static const int LEVEL_COSTS[MAX_LEVEL + 1]; // relative encoding times of the levels
+       static const int FIRST_ADAPTIVE_LEVEL = 2; // first level with a throughput target
        static const int DEFAULT_BUFFER_SIZE = 256 * 1024;
        static const byte COPY_BLOCK_MASK = byte(0x80);
        static const byte TRANSFORMS_MASK = byte(0x10);
@@ -171,13 +201,26 @@ namespace kanzi {
        ATOMIC_INT _blockId;
        std::vector<Listener*> _listeners;
        Context _ctx;
+       Allocator* _allocator; // block buffers (_buffers)
        bool _headless;
+       bool _adaptive;
+       int _adaptiveTarget; // MB/s, 0 to react to output stalls
+       int _level; // level of the next blocks (adaptive mode)
+       int _minLevel;
+       int _maxLevel;
+       double _levelThroughput[MAX_LEVEL + 1]; // last MB/s measured per level (0 if unknown)
+       double _stallTime; // decaying sum of the output stalls (ns)
+       double _adaptiveTime; // decaying sum of the block processing times (ns)
 #ifdef CONCURRENCY_ENABLED
        ThreadPool* _pool;
 #endif
 
        void processBlock();
 
+       void initAdaptive();
+
+       void adaptLevel(int64 size, int64 elapsed, int64 writeTime);
+
        static void notifyListeners(std::vector<Listener*>& listeners, const Event& evt);
    };
 
@@ -212,8 +255,8 @@ namespace kanzi {
                    const int bufSize = (bSize > 65536) ? bSize : 65536;
 
                    if (_buffers[_bufferId]->_length == 0) {
-                       delete[] _buffers[_bufferId]->_array;
-                       _buffers[_bufferId]->_array = new byte[bufSize];
+                       deallocate(_allocator, _buffers[_bufferId]->_array);
+                       _buffers[_bufferId]->_array = allocate<byte>(_allocator, bufSize, MemoryUsage::STREAM);
                        _buffers[_bufferId]->_length = bufSize;
                    }
 
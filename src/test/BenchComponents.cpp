@@ -0,0 +1,315 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Microbenchmark of each transform and entropy codec on synthetic data.
+// The data is generated from a fixed seed and the results are written as a
+// single JSON document ({"size":..,"results":[...]}, one result per line) so
+// that runs of different versions can be diffed.
+// Throughputs are based on the size of the raw data in both directions.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "../Context.hpp"
+#include "../Event.hpp"
+#include "../SliceArray.hpp"
+#include "../types.hpp"
+#include "../bitstream/MemoryInputBitStream.hpp"
+#include "../bitstream/MemoryOutputBitStream.hpp"
+#include "../entropy/EntropyDecoderFactory.hpp"
+#include "../entropy/EntropyEncoderFactory.hpp"
+#include "../transform/TransformFactory.hpp"
+#include "BenchData.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+   #ifdef _MSC_VER
+      #include <intrin.h>
+   #else
+      #include <x86intrin.h>
+   #endif
+
+   #define BENCH_CYCLES 1
+#endif
+
+using namespace std;
+using namespace kanzi;
+
+// Time stamp counter (0 if not available)
+static inline uint64 cycles()
+{
+#ifdef BENCH_CYCLES
+    return uint64(__rdtsc());
+#else
+    return 0;
+#endif
+}
+
+static const char* TRANSFORMS[] = { "NONE", "TEXT", "BWT", "BWTS", "ROLZ", "ROLZX", "MTFT", "ZRLT",
+    "RLT", "SRT", "RANK", "LZ", "LZX", "LZP", "EXE", "UTF", "PACK", "MM" };
+
+static const char* CODECS[] = { "NONE", "HUFFMAN", "ANS0", "ANS1", "RANGE", "FPAQ", "CM", "TPAQ", "TPAQX" };
+
+static void printTimes(ostream& os, const char* name, int size, vector<int64>& times, vector<int64>& cyc)
+{
+    const int64 t = median(times);
+    os << ",\"" << name << "\":{\"MBps\":";
+    os << ((t > 0) ? double(size) * 1e9 / (1024.0 * 1024.0 * double(t)) : 0.0);
+    os << ",\"cyclesPerByte\":";
+
+#ifdef BENCH_CYCLES
+    os << double(median(cyc)) / double(size);
+#else
+    os << "null";
+#endif
+
+    os << "}";
+}
+
+static int benchTransform(const string& name, const string& dataClass, byte block[], int size, int iter, ostream& os)
+{
+    Context ctx;
+    ctx.putString("transform", name);
+    ctx.putString("entropy", "NONE");
+    ctx.putInt("blockSize", size);
+    ctx.putInt("size", size);
+    TransformSequence<byte>* t = TransformFactory<byte>::newTransform(ctx, TransformFactory<byte>::getType(name.c_str()));
+    const int maxLength = t->getMaxEncodedLength(size);
+    delete t;
+    SliceArray<byte> sa1(block, size, 0);
+    SliceArray<byte> sa2(new byte[maxLength], maxLength, 0);
+    SliceArray<byte> sa3(new byte[size], size, 0);
+    vector<int64> fTimes, iTimes, fCycles, iCycles;
+    int encoded = 0;
+    byte skipFlags = byte(0);
+    int res = 0;
+
+    // The first iteration is a warm-up
+    for (int ii = 0; ii <= iter; ii++) {
+        Context fctx(ctx);
+        TransformSequence<byte>* ft = TransformFactory<byte>::newTransform(fctx, TransformFactory<byte>::getType(name.c_str()));
+        sa1._index = 0;
+        sa2._index = 0;
+        int64 t0 = EventTime::wallTime();
+        uint64 c0 = cycles();
+        ft->forward(sa1, sa2, size);
+        uint64 c1 = cycles();
+        int64 t1 = EventTime::wallTime();
+        encoded = sa2._index;
+        skipFlags = ft->getSkipFlags();
+        delete ft;
+
+        Context ictx(ctx);
+        TransformSequence<byte>* it = TransformFactory<byte>::newTransform(ictx, TransformFactory<byte>::getType(name.c_str()));
+        it->setSkipFlags(skipFlags);
+        sa2._index = 0;
+        sa3._index = 0;
+        int64 t2 = EventTime::wallTime();
+        uint64 c2 = cycles();
+        const bool ok = it->inverse(sa2, sa3, encoded);
+        uint64 c3 = cycles();
+        int64 t3 = EventTime::wallTime();
+        delete it;
+
+        if ((ok == false) || (sa3._index != size) || (memcmp(sa3._array, block, size_t(size)) != 0)) {
+            cerr << "Round trip failure for " << name << " on " << dataClass << endl;
+            res = 1;
+            break;
+        }
+
+        if (ii == 0)
+            continue;
+
+        fTimes.push_back(t1 - t0);
+        iTimes.push_back(t3 - t2);
+        fCycles.push_back(int64(c1 - c0));
+        iCycles.push_back(int64(c3 - c2));
+    }
+
+    if (res == 0) {
+        os << "{\"component\":\"" << name << "\",\"kind\":\"transform\",\"data\":\"" << dataClass << "\"";
+        os << ",\"size\":" << size << ",\"outputSize\":" << encoded;
+        os << ",\"applied\":" << ((skipFlags & byte(0x80)) == byte(0) ? "true" : "false");
+        printTimes(os, "forward", size, fTimes, fCycles);
+        printTimes(os, "inverse", size, iTimes, iCycles);
+        os << "}";
+    }
+
+    delete[] sa2._array;
+    delete[] sa3._array;
+    return res;
+}
+
+static int benchEntropy(const string& name, const string& dataClass, byte block[], int size, int iter, ostream& os)
+{
+    const short type = EntropyEncoderFactory::getType(name.c_str());
+    Context ctx;
+    ctx.putString("entropy", name);
+    ctx.putInt("blockSize", size);
+    ctx.putInt("size", size);
+    const int bufSize = max(512 * 1024, size + (size >> 3));
+    SliceArray<byte> sa1(new byte[bufSize], bufSize, 0);
+    byte* output = new byte[size];
+    vector<int64> fTimes, iTimes, fCycles, iCycles;
+    uint64 encoded = 0;
+    int res = 0;
+
+    // The first iteration is a warm-up
+    for (int ii = 0; ii <= iter; ii++) {
+        Context ectx(ctx);
+        sa1._index = 0;
+        MemoryOutputBitStream obs(sa1, true);
+        EntropyEncoder* ee = EntropyEncoderFactory::newEncoder(obs, ectx, type);
+        int64 t0 = EventTime::wallTime();
+        uint64 c0 = cycles();
+        const int n = ee->encode(block, 0, size);
+        ee->dispose();
+        uint64 c1 = cycles();
+        int64 t1 = EventTime::wallTime();
+        delete ee;
+        obs.close();
+        encoded = (obs.written() + 7) >> 3;
+
+        Context dctx(ctx);
+        sa1._index = 0;
+        MemoryInputBitStream ibs(sa1, int(encoded));
+        EntropyDecoder* ed = EntropyDecoderFactory::newDecoder(ibs, dctx, type);
+        int64 t2 = EventTime::wallTime();
+        uint64 c2 = cycles();
+        const int m = ed->decode(output, 0, size);
+        uint64 c3 = cycles();
+        int64 t3 = EventTime::wallTime();
+        delete ed;
+
+        if ((n != size) || (m != size) || (memcmp(output, block, size_t(size)) != 0)) {
+            cerr << "Round trip failure for " << name << " on " << dataClass << endl;
+            res = 1;
+            break;
+        }
+
+        if (ii == 0)
+            continue;
+
+        fTimes.push_back(t1 - t0);
+        iTimes.push_back(t3 - t2);
+        fCycles.push_back(int64(c1 - c0));
+        iCycles.push_back(int64(c3 - c2));
+    }
+
+    if (res == 0) {
+        os << "{\"component\":\"" << name << "\",\"kind\":\"entropy\",\"data\":\"" << dataClass << "\"";
+        os << ",\"size\":" << size << ",\"outputSize\":" << encoded;
+        printTimes(os, "forward", size, fTimes, fCycles);
+        printTimes(os, "inverse", size, iTimes, iCycles);
+        os << "}";
+    }
+
+    delete[] sa1._array;
+    delete[] output;
+    return res;
+}
+
+#ifdef __GNUG__
+int main(int argc, const char* argv[])
+#else
+int BenchComponents_main(int argc, const char* argv[])
+#endif
+{
+    int size = 1024 * 1024;
+    int iter = 3;
+    string type = "ALL";
+    string data = "ALL";
+
+    for (int i = 1; i < argc; i++) {
+        string str = argv[i];
+
+        if (str.compare(0, 6, "-size=") == 0)
+            size = atoi(str.c_str() + 6);
+        else if (str.compare(0, 6, "-iter=") == 0)
+            iter = atoi(str.c_str() + 6);
+        else if (str.compare(0, 6, "-type=") == 0)
+            type = str.substr(6);
+        else if (str.compare(0, 6, "-data=") == 0)
+            data = str.substr(6);
+        else {
+            cerr << "Usage: benchComponents [-size=<bytes>] [-iter=<iterations>] [-type=<transform|codec>] [-data=<class>]" << endl;
+            cerr << "Data classes: text, random, lowentropy, zeros, binary, dna, utf8" << endl;
+            return 1;
+        }
+    }
+
+    transform(type.begin(), type.end(), type.begin(), ::toupper);
+    transform(data.begin(), data.end(), data.begin(), ::tolower);
+
+    if ((size < 1024) || (size > 256 * 1024 * 1024) || (iter < 1)) {
+        cerr << "Invalid size or number of iterations" << endl;
+        return 1;
+    }
+
+    const int nbTransforms = int(sizeof(TRANSFORMS) / sizeof(TRANSFORMS[0]));
+    const int nbCodecs = int(sizeof(CODECS) / sizeof(CODECS[0]));
+    const int nbClasses = int(sizeof(DATA_CLASSES) / sizeof(DATA_CLASSES[0]));
+    byte* block = new byte[size];
+    int res = 0;
+    bool first = true;
+    cout << fixed << setprecision(3);
+    cout << "{\"size\":" << size << ",\"iterations\":" << iter;
+#ifdef BENCH_CYCLES
+    cout << ",\"cycles\":\"tsc\"";
+#endif
+    cout << ",\"results\":[";
+
+    try {
+        for (int d = 0; d < nbClasses; d++) {
+            if ((data != "all") && (data != DATA_CLASSES[d]))
+                continue;
+
+            generate(DATA_CLASSES[d], block, size);
+
+            for (int i = 0; i < nbTransforms + nbCodecs; i++) {
+                const bool isTransform = i < nbTransforms;
+                const string name = isTransform ? TRANSFORMS[i] : CODECS[i - nbTransforms];
+
+                if ((type != "ALL") && (type != name))
+                    continue;
+
+                stringstream ss;
+                ss << fixed << setprecision(3);
+                const int r = isTransform ? benchTransform(name, DATA_CLASSES[d], block, size, iter, ss) :
+                    benchEntropy(name, DATA_CLASSES[d], block, size, iter, ss);
+
+                if (r != 0) {
+                    res = r;
+                    continue;
+                }
+
+                cout << (first ? "\n" : ",\n") << ss.str();
+                cout.flush();
+                first = false;
+            }
+        }
+    }
+    catch (exception& e) {
+        cerr << e.what() << endl;
+        res = 123;
+    }
+
+    cout << "\n]}" << endl;
+    delete[] block;
+    return res;
+}
@@ -0,0 +1,188 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#ifndef _BenchData_
+#define _BenchData_
+
+// Synthetic data shared by the benchmarks. The data is generated from
+// a fixed seed so that the same bytes are processed by every run.
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../Global.hpp"
+#include "../types.hpp"
+
+namespace kanzi
+{
+
+   const char* const DATA_CLASSES[] = { "text", "random", "lowentropy", "zeros", "binary", "dna", "utf8" };
+
+   // Deterministic generator (xorshift64*), independent of the C library
+   class BenchRandom {
+   public:
+       BenchRandom(uint64 seed) : _state(seed) {}
+
+       uint32 next()
+       {
+           _state ^= _state >> 12;
+           _state ^= _state << 25;
+           _state ^= _state >> 27;
+           return uint32((_state * 0x2545F4914F6CDD1DULL) >> 32);
+       }
+
+   private:
+       uint64 _state;
+   };
+
+   inline void generate(const std::string& dataClass, byte block[], int size, uint64 seed = 0x4B414E5A)
+   {
+       BenchRandom rnd(seed);
+
+       if (dataClass == "zeros") {
+           memset(block, 0, size_t(size));
+           return;
+       }
+
+       if (dataClass == "random") {
+           for (int i = 0; i < size; i++)
+               block[i] = byte(rnd.next() >> 24);
+
+           return;
+       }
+
+       if (dataClass == "lowentropy") {
+           // Few symbols with a skewed distribution and short runs
+           int i = 0;
+
+           while (i < size) {
+               const uint32 r = rnd.next();
+               const byte val = byte(Global::_log2(((r >> 16) & 0xFFFF) | 1) ^ 0x0F);
+               int run = 1 + int(r & 3);
+
+               while ((run-- > 0) && (i < size))
+                   block[i++] = val;
+           }
+
+           return;
+       }
+
+       if (dataClass == "binary") {
+           // Array of records: counter, small value, bit pattern of a float, padding
+           int i = 0;
+           uint32 id = 1000;
+
+           while (i < size) {
+               byte rec[16] = { byte(0) };
+               const uint32 r = rnd.next();
+               id += 1 + (r & 7);
+               const float f = float(r >> 20) * 0.125f;
+               memcpy(&rec[0], &id, 4);
+               rec[4] = byte(r >> 8);
+               rec[5] = byte((r >> 16) & 3);
+               memcpy(&rec[8], &f, 4);
+
+               for (int j = 0; (j < 16) && (i < size); j++)
+                   block[i++] = rec[j];
+           }
+
+           return;
+       }
+
+       if (dataClass == "dna") {
+           // Order 1 Markov chain over ACGT with line breaks
+           const char bases[] = { 'A', 'C', 'G', 'T' };
+           int prev = 0;
+           int i = 0;
+
+           while (i < size) {
+               if ((i % 61) == 60) {
+                   block[i++] = byte('\n');
+                   continue;
+               }
+
+               const uint32 r = rnd.next() >> 24;
+               prev = (r < 128) ? prev : ((r < 192) ? (prev + 1) & 3 : int(r & 3));
+               block[i++] = byte(bases[prev]);
+           }
+
+           return;
+       }
+
+       // Words drawn with a skewed distribution from a small vocabulary
+       static const char* WORDS[] = { "the", "of", "and", "to", "in", "a", "is", "that", "for", "it",
+           "as", "was", "with", "be", "by", "on", "not", "he", "this", "are", "or", "his", "from",
+           "at", "which", "but", "have", "an", "had", "they", "you", "were", "their", "one", "all",
+           "we", "can", "her", "has", "there", "been", "if", "more", "when", "will", "would", "who",
+           "so", "no", "compression", "block", "stream", "transform", "entropy", "data", "time" };
+       static const char* UTF_WORDS[] = { "caf\xC3\xA9", "na\xC3\xAFve", "\xC3\xBC" "ber", "stra\xC3\x9F" "e",
+           "\xD0\xBC\xD0\xB8\xD1\x80", "\xD0\xB4\xD0\xB0\xD0\xBD\xD0\xBD\xD1\x8B\xD0\xB5",
+           "\xE6\x97\xA5\xE6\x9C\xAC", "\xE4\xB8\xAD\xE6\x96\x87", "\xE3\x83\x87\xE3\x83\xBC\xE3\x82\xBF",
+           "\xCE\xBB\xCF\x8C\xCE\xB3\xCE\xBF\xCF\x82", "the", "data", "\xE2\x82\xAC", "\xC2\xA9" };
+       const bool utf8 = dataClass == "utf8";
+       const int nbWords = utf8 ? int(sizeof(UTF_WORDS) / sizeof(UTF_WORDS[0])) : int(sizeof(WORDS) / sizeof(WORDS[0]));
+       int i = 0;
+       int line = 0;
+       bool capitalize = true;
+
+       while (i < size) {
+           const uint32 r = rnd.next();
+           const uint32 u = (r >> 16) & 0xFFFF;
+           const int idx = int((uint64(u) * uint64(u) * uint64(nbWords)) >> 32);
+           const char* w = utf8 ? UTF_WORDS[idx] : WORDS[idx];
+
+           for (int j = 0; (w[j] != 0) && (i < size); j++, line++)
+               block[i++] = byte(((j == 0) && (capitalize == true) && (w[j] >= 'a')) ? w[j] - 32 : w[j]);
+
+           capitalize = (r & 15) == 0;
+           const char sep = (capitalize == true) ? '.' : (((r & 31) == 1) ? ',' : 0);
+
+           if ((sep != 0) && (i < size))
+               block[i++] = byte(sep);
+
+           if (i < size) {
+               block[i++] = byte((line > 72) ? '\n' : ' ');
+               line = (line > 72) ? 0 : line + 1;
+           }
+       }
+   }
+
+   inline int64 median(std::vector<int64>& values)
+   {
+       std::sort(values.begin(), values.end());
+       const size_t n = values.size();
+       return ((n & 1) != 0) ? values[n >> 1] : (values[(n >> 1) - 1] + values[n >> 1]) >> 1;
+   }
+
+   // Mix of all data classes except zeros and random, in chunks of 'chunkSize' bytes
+   inline void generateCorpus(byte block[], int size, int chunkSize)
+   {
+       static const char* CLASSES[] = { "text", "binary", "utf8", "dna", "lowentropy" };
+       byte* chunk = new byte[chunkSize];
+       int n = 0;
+
+       for (int i = 0; n < size; i++) {
+           const int len = std::min(chunkSize, size - n);
+           generate(CLASSES[i % 5], chunk, chunkSize, 0x4B414E5A + uint64(i));
+           memcpy(&block[n], chunk, size_t(len));
+           n += len;
+       }
+
+       delete[] chunk;
+   }
+}
+#endif
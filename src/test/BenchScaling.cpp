@@ -0,0 +1,438 @@
+/*
+Copyright 2011-2024 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Multi-core scaling benchmark: compress and decompress a generated corpus
+// in memory with CompressedOutputStream and CompressedInputStream for each
+// level, block size and number of jobs. Report the throughput, the speedup
+// and the parallel efficiency relative to the smallest number of jobs, plus
+// the share of time spent waiting for the previous block (ordering barrier)
+// and in the serialized block reads and writes on the shared bitstream.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "../concurrent.hpp"
+#include "../Context.hpp"
+#include "../Event.hpp"
+#include "../Listener.hpp"
+#include "../types.hpp"
+#include "../util.hpp"
+#include "../io/CompressedInputStream.hpp"
+#include "../io/CompressedOutputStream.hpp"
+#include "BenchData.hpp"
+
+using namespace std;
+using namespace kanzi;
+
+static const char* LEVELS[] = { "NONE&NONE", "PACK+LZ&NONE", "PACK+LZ&HUFFMAN", "TEXT+UTF+PACK+MM+LZX&HUFFMAN",
+    "TEXT+UTF+EXE+PACK+MM+ROLZ&NONE", "TEXT+UTF+BWT+RANK+ZRLT&ANS0", "TEXT+UTF+BWT+SRT+ZRLT&FPAQ",
+    "LZP+TEXT+UTF+BWT+LZP&CM", "EXE+RLT+TEXT+UTF&TPAQ", "EXE+RLT+TEXT+UTF&TPAQX" };
+
+// Accumulate the time spent waiting for the previous block and the time spent
+// reading or writing blocks on the shared bitstream (serialized sections)
+class ScalingProbe : public Listener {
+public:
+    ScalingProbe() : _waitTime(0), _serialTime(0) {}
+
+    void processEvent(const Event& evt)
+    {
+#ifdef CONCURRENCY_ENABLED
+        static thread_local int64 waitStart = 0;
+        static thread_local int64 serialStart = 0;
+#else
+        static int64 waitStart = 0;
+        static int64 serialStart = 0;
+#endif
+
+        switch (evt.getType()) {
+        case Event::BEFORE_WAIT:
+            waitStart = evt.getWallTime();
+            break;
+
+        case Event::AFTER_WAIT:
+            add(_waitTime, evt.getWallTime() - waitStart);
+            break;
+
+        case Event::BEFORE_READ:
+        case Event::BEFORE_WRITE:
+            serialStart = evt.getWallTime();
+            break;
+
+        case Event::AFTER_READ:
+        case Event::AFTER_WRITE:
+            add(_serialTime, evt.getWallTime() - serialStart);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    void reset()
+    {
+        _waitTime = 0;
+        _serialTime = 0;
+    }
+
+    int64 _waitTime;
+    int64 _serialTime;
+
+private:
+#ifdef CONCURRENCY_ENABLED
+    mutex _mutex;
+#endif
+
+    void add(int64& total, int64 delta)
+    {
+#ifdef CONCURRENCY_ENABLED
+        lock_guard<mutex> lock(_mutex);
+#endif
+        total += delta;
+    }
+};
+
+class ScalingResult {
+public:
+    int64 _time; // median in ns
+    int64 _waitTime; // over all jobs, for the median run
+    int64 _serialTime;
+
+    ScalingResult() : _time(0), _waitTime(0), _serialTime(0) {}
+};
+
+static bool parseList(const string& s, vector<int>& values)
+{
+    size_t start = 0;
+
+    while (start < s.length()) {
+        size_t end = s.find(',', start);
+
+        if (end == string::npos)
+            end = s.length();
+
+        string token = s.substr(start, end - start);
+        int scale = 1;
+
+        if ((token.length() > 0) && ((token[token.length() - 1] == 'K') || (token[token.length() - 1] == 'k')))
+            scale = 1024;
+        else if ((token.length() > 0) && ((token[token.length() - 1] == 'M') || (token[token.length() - 1] == 'm')))
+            scale = 1024 * 1024;
+
+        const int val = atoi(token.c_str());
+
+        if (val < 0)
+            return false;
+
+        values.push_back(val * scale);
+        start = end + 1;
+    }
+
+    return values.size() > 0;
+}
+
+// Run one compression and one decompression. Return false on error.
+static bool runOnce(int level, int blockSize, int jobs, byte input[], int size, byte cBuffer[], int cSize,
+    byte dBuffer[], ScalingProbe& probe, ScalingResult& cRes, ScalingResult& dRes, int& compressed)
+{
+    string tc = LEVELS[level];
+    const size_t idx = tc.find('&');
+
+#ifdef CONCURRENCY_ENABLED
+    ThreadPool pool(jobs);
+    Context ctx(&pool);
+#else
+    Context ctx;
+#endif
+    ctx.putString("transform", tc.substr(0, idx));
+    ctx.putString("entropy", tc.substr(idx + 1));
+    ctx.putInt("blockSize", blockSize);
+    ctx.putLong("fileSize", size);
+    ctx.putInt("jobs", jobs);
+
+    try {
+        ostreambuf<char> obuf(reinterpret_cast<char*>(cBuffer), streamsize(cSize));
+        ostream os(&obuf);
+        CompressedOutputStream cos(os, ctx);
+        cos.addListener(probe);
+        probe.reset();
+        const int64 before = EventTime::wallTime();
+        cos.write(reinterpret_cast<const char*>(input), streamsize(size));
+        cos.close();
+        cRes._time = EventTime::wallTime() - before;
+        cRes._waitTime = probe._waitTime;
+        cRes._serialTime = probe._serialTime;
+        compressed = int(cos.getWritten());
+    }
+    catch (exception& e) {
+        cerr << "Compression failed: " << e.what() << endl;
+        return false;
+    }
+
+    int decoded = 0;
+
+    try {
+        istreambuf<char> ibuf(reinterpret_cast<char*>(cBuffer), streamsize(compressed));
+        istream is(&ibuf);
+        CompressedInputStream cis(is, ctx);
+        cis.addListener(probe);
+        probe.reset();
+        const int64 before = EventTime::wallTime();
+
+        while (decoded <= size) {
+            cis.read(reinterpret_cast<char*>(&dBuffer[decoded]), streamsize(size + 1 - decoded));
+
+            if (cis.gcount() <= 0)
+                break;
+
+            decoded += int(cis.gcount());
+        }
+
+        cis.close();
+        dRes._time = EventTime::wallTime() - before;
+        dRes._waitTime = probe._waitTime;
+        dRes._serialTime = probe._serialTime;
+    }
+    catch (exception& e) {
+        cerr << "Decompression failed: " << e.what() << endl;
+        return false;
+    }
+
+    if ((decoded != size) || (memcmp(input, dBuffer, size_t(size)) != 0)) {
+        cerr << "Round trip failure (level " << level << ", block size " << blockSize << ", jobs " << jobs << ")" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Keep the run with the median time
+static void selectMedian(vector<ScalingResult>& runs, ScalingResult& res)
+{
+    vector<int64> times;
+
+    for (size_t i = 0; i < runs.size(); i++)
+        times.push_back(runs[i]._time);
+
+    const int64 t = median(times);
+    res = runs[0];
+
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (llabs(runs[i]._time - t) < llabs(res._time - t))
+            res = runs[i];
+    }
+
+    res._time = t;
+}
+
+static void printCells(stringstream& ss, double throughput, double speedup, double efficiency,
+    const ScalingResult& res, int jobs)
+{
+    const double t = double(max(res._time, int64(1)));
+    ss << setw(12) << setprecision(1) << throughput;
+    ss << setw(8) << setprecision(2) << speedup << setw(6) << efficiency;
+    ss << setw(7) << setprecision(1) << (100.0 * double(res._waitTime) / (t * double(jobs)));
+    ss << setw(8) << (100.0 * double(res._serialTime) / t);
+}
+
+#ifdef __GNUG__
+int main(int argc, const char* argv[])
+#else
+int BenchScaling_main(int argc, const char* argv[])
+#endif
+{
+    int size = 32 * 1024 * 1024;
+    int iter = 3;
+    vector<int> levels;
+    vector<int> blockSizes;
+    vector<int> jobs;
+
+    for (int i = 1; i < argc; i++) {
+        string str = argv[i];
+        bool valid = true;
+
+        if (str.compare(0, 6, "-size=") == 0) {
+            vector<int> v;
+            valid = parseList(str.substr(6), v);
+            size = valid ? v[0] : 0;
+        }
+        else if (str.compare(0, 6, "-iter=") == 0)
+            iter = atoi(str.c_str() + 6);
+        else if (str.compare(0, 8, "-levels=") == 0)
+            valid = parseList(str.substr(8), levels);
+        else if (str.compare(0, 8, "-blocks=") == 0)
+            valid = parseList(str.substr(8), blockSizes);
+        else if (str.compare(0, 6, "-jobs=") == 0)
+            valid = parseList(str.substr(6), jobs);
+        else
+            valid = false;
+
+        if (valid == false) {
+            cerr << "Usage: benchScaling [-size=<bytes>] [-iter=<iterations>] [-levels=<l1,l2,...>]" << endl;
+            cerr << "                    [-blocks=<size1,size2,...>] [-jobs=<j1,j2,...>]" << endl;
+            cerr << "EG. benchScaling -size=64m -levels=2,5 -blocks=1m,4m -jobs=1,2,4,8" << endl;
+            return 1;
+        }
+    }
+
+    if (levels.size() == 0) {
+        levels.push_back(2);
+        levels.push_back(5);
+    }
+
+    if (blockSizes.size() == 0) {
+        blockSizes.push_back(1024 * 1024);
+        blockSizes.push_back(4 * 1024 * 1024);
+    }
+
+    if (jobs.size() == 0) {
+#ifdef CONCURRENCY_ENABLED
+        const int cores = min(max(int(thread::hardware_concurrency()), 1), 64);
+
+        for (int j = 1; j < cores; j <<= 1)
+            jobs.push_back(j);
+
+        jobs.push_back(cores);
+#else
+        jobs.push_back(1);
+#endif
+    }
+
+    sort(jobs.begin(), jobs.end());
+
+    if ((size < 1024) || (iter < 1) || (jobs[0] < 1) || (jobs[jobs.size() - 1] > 64)) {
+        cerr << "Invalid size, number of iterations or number of jobs" << endl;
+        return 1;
+    }
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        if (levels[i] > 9) {
+            cerr << "Invalid level: " << levels[i] << endl;
+            return 1;
+        }
+    }
+
+    for (size_t i = 0; i < blockSizes.size(); i++) {
+        if ((blockSizes[i] < 1024) || ((blockSizes[i] & 15) != 0)) {
+            cerr << "Invalid block size (must be at least 1024 and a multiple of 16): " << blockSizes[i] << endl;
+            return 1;
+        }
+    }
+
+    const int cSize = size + (size >> 4) + 1024 * 1024;
+    byte* input = new byte[size];
+    byte* cBuffer = new byte[cSize];
+    byte* dBuffer = new byte[size + 1];
+    generateCorpus(input, size, 1024 * 1024);
+    memset(cBuffer, 0, size_t(cSize));
+    memset(dBuffer, 0, size_t(size + 1));
+    ScalingProbe probe;
+    int res = 0;
+
+    cout << "Corpus: " << size << " bytes (text, binary, utf8, dna, lowentropy chunks)" << endl;
+    cout << "Iterations: " << iter << " (+1 warm-up), median reported" << endl;
+    cout << "Speedup and efficiency are relative to " << jobs[0] << (jobs[0] > 1 ? " jobs" : " job") << endl;
+    cout << "Wait%: time spent by the jobs waiting for the previous block" << endl;
+    cout << "Serial%: time spent in block reads/writes on the shared bitstream" << endl;
+    cout << endl;
+    cout << fixed;
+    cout << "Level   Block Blocks Jobs |   Comp MB/s Speedup   Eff  Wait% Serial% ";
+    cout << "| Decomp MB/s Speedup   Eff  Wait% Serial%" << endl;
+
+    for (size_t l = 0; (l < levels.size()) && (res == 0); l++) {
+        for (size_t b = 0; (b < blockSizes.size()) && (res == 0); b++) {
+            const int level = levels[l];
+            const int blockSize = blockSizes[b];
+            double cBase = 0, dBase = 0;
+            double cPrev = 0, dPrev = 0;
+            int cPlateau = 0, dPlateau = 0;
+            int compressed = 0;
+
+            for (size_t j = 0; j < jobs.size(); j++) {
+                vector<ScalingResult> cRuns, dRuns;
+
+                for (int ii = 0; ii <= iter; ii++) {
+                    ScalingResult cr, dr;
+
+                    if (runOnce(level, blockSize, jobs[j], input, size, cBuffer, cSize, dBuffer,
+                           probe, cr, dr, compressed) == false) {
+                        res = 1;
+                        break;
+                    }
+
+                    // The first iteration is a warm-up
+                    if (ii == 0)
+                        continue;
+
+                    cRuns.push_back(cr);
+                    dRuns.push_back(dr);
+                }
+
+                if (res != 0)
+                    break;
+
+                ScalingResult cRes, dRes;
+                selectMedian(cRuns, cRes);
+                selectMedian(dRuns, dRes);
+                const double cMBps = double(size) * 1e9 / (1024.0 * 1024.0 * double(max(cRes._time, int64(1))));
+                const double dMBps = double(size) * 1e9 / (1024.0 * 1024.0 * double(max(dRes._time, int64(1))));
+
+                if (j == 0) {
+                    cBase = cMBps;
+                    dBase = dMBps;
+                }
+
+                // Plateau: first number of jobs after which the throughput grows by less than 10%
+                if ((j > 0) && (cPlateau == 0) && (cMBps < cPrev * 1.1))
+                    cPlateau = jobs[j - 1];
+
+                if ((j > 0) && (dPlateau == 0) && (dMBps < dPrev * 1.1))
+                    dPlateau = jobs[j - 1];
+
+                cPrev = cMBps;
+                dPrev = dMBps;
+                const double cSpeedup = cMBps / cBase;
+                const double dSpeedup = dMBps / dBase;
+                const double scale = double(jobs[0]) / double(jobs[j]);
+                stringstream ss;
+                ss << fixed << setw(5) << level << setw(6) << (blockSize >> 10) << "K";
+                ss << setw(7) << ((size + blockSize - 1) / blockSize) << setw(5) << jobs[j] << " |";
+                printCells(ss, cMBps, cSpeedup, cSpeedup * scale, cRes, jobs[j]);
+                ss << " |";
+                printCells(ss, dMBps, dSpeedup, dSpeedup * scale, dRes, jobs[j]);
+                cout << ss.str() << endl;
+            }
+
+            if (res != 0)
+                break;
+
+            cout << "Level " << level << ", " << (blockSize >> 10) << "K blocks: ratio ";
+            cout << setprecision(3) << (double(compressed) / double(size));
+            cout << ", compression plateau at ";
+            cout << ((cPlateau == 0) ? "> " : "") << ((cPlateau == 0) ? jobs[jobs.size() - 1] : cPlateau);
+            cout << " jobs, decompression plateau at ";
+            cout << ((dPlateau == 0) ? "> " : "") << ((dPlateau == 0) ? jobs[jobs.size() - 1] : dPlateau);
+            cout << " jobs" << endl << endl;
+        }
+    }
+
+    delete[] input;
+    delete[] cBuffer;
+    delete[] dBuffer;
+    return res;
+}
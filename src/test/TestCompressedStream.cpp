@@ -14,6 +14,7 @@ limitations under the License.
 */
 
 #include <iostream>
+#include "../Event.hpp"
 #include "../io/CompressedInputStream.hpp"
 #include "../io/CompressedOutputStream.hpp"
 
@@ -246,11 +247,199 @@ int testCorrectness(int, const char*[])
     return (res == true) ? 0 : 1;
 }
 
+// Simulate the adaptive mode: each level has a fixed throughput. Check that
+// the level converges quickly to the highest level reaching the target and
+// stays there most of the time (the slower levels are tried again now and then).
+int testAdaptiveLevels()
+{
+    cout << endl << "Adaptive Level Test" << endl;
+    // MB/s per level: two profiles, close to and far from the level costs
+    const double speeds[2][10] = {
+        { 900.0, 200.0, 190.0, 120.0, 95.0, 32.0, 23.0, 19.0, 7.0, 2.7 },
+        { 2000.0, 300.0, 250.0, 150.0, 60.0, 45.0, 40.0, 12.0, 9.0, 6.0 }
+    };
+    const double targets[] = { 1.0, 5.0, 20.0, 50.0, 100.0, 500.0, 5000.0 };
+    bool res = true;
+
+    for (int p = 0; p < 2; p++) {
+        for (int t = 0; t < 7; t++) {
+            const double target = targets[t];
+
+            for (int maxLevel = 3; maxLevel <= 9; maxLevel += 3) {
+                // Highest level that reaches the target
+                int expected = 0;
+
+                for (int l = maxLevel; l > 0; l--) {
+                    if (speeds[p][l] >= target) {
+                        expected = l;
+                        break;
+                    }
+                }
+
+                double throughputs[10] = { 0.0 };
+                int level = maxLevel;
+                int rounds = -1;
+                int hits = 0;
+
+                for (int n = 0; n < 100; n++) {
+                    throughputs[level] = speeds[p][level];
+                    level = CompressedOutputStream::selectLevel(target, level, 0, maxLevel, throughputs);
+
+                    if (level == expected) {
+                        hits++;
+
+                        if (rounds < 0)
+                            rounds = n + 1;
+                    }
+                }
+
+                cout << "Profile " << p << ", target " << target << " MB/s, max level " << maxLevel;
+                cout << ": level " << expected << " after " << rounds << " round(s), ";
+                cout << hits << "% of the rounds" << endl;
+
+                if ((rounds < 0) || (rounds > 4) || (hits < 75)) {
+                    cout << "Failure" << endl;
+                    res = false;
+                }
+            }
+        }
+    }
+
+    cout << ((res == true) ? "Success" : "Failure") << endl;
+    return (res == true) ? 0 : 1;
+}
+
+// Output buffer draining slowly ('nsPerByte' ns per byte written) to make
+// the compressor stall on writes.
+class SlowStringBuffer : public stringbuf
+{
+public:
+    SlowStringBuffer(int nsPerByte) : _nsPerByte(nsPerByte) {}
+
+protected:
+    streamsize xsputn(const char* s, streamsize n)
+    {
+        wait(n);
+        return stringbuf::xsputn(s, n);
+    }
+
+    int_type overflow(int_type c)
+    {
+        wait(1);
+        return stringbuf::overflow(c);
+    }
+
+private:
+    void wait(streamsize n) const
+    {
+        const int64 end = EventTime::wallTime() + int64(n) * _nsPerByte;
+
+        while (EventTime::wallTime() < end) {
+        }
+    }
+
+    int _nsPerByte;
+};
+
+// Compress in adaptive mode with several jobs (the level changes between
+// blocks) then decompress and compare.
+uint64 compressAdaptive(byte block[], uint length, int target, int level, int nsPerByte)
+{
+    int jobs;
+
+#ifdef CONCURRENCY_ENABLED
+    jobs = 4;
+#else
+    jobs = 1;
+#endif
+
+    cout << "Test - adaptive, " << jobs << " job(s), ";
+
+    if (target > 0)
+        cout << "target " << target << " MB/s, max level " << level << endl;
+    else
+        cout << "output stalls, min level " << level << endl;
+
+    byte* buf = new byte[length];
+    memcpy(&buf[0], &block[0], size_t(length));
+    SlowStringBuffer buffer(nsPerByte);
+    iostream ios(&buffer);
+    Context ctx;
+    ctx.putString("entropy", "NONE");
+    ctx.putString("transform", "NONE");
+    ctx.putInt("blockSize", 64 * 1024);
+    ctx.putInt("jobs", jobs);
+    ctx.putInt("checksum", 1);
+    ctx.putInt("level", level);
+    ctx.putInt("adaptive", target);
+    CompressedOutputStream* cos = new CompressedOutputStream(ios, ctx);
+    cos->write((const char*)block, length);
+    cos->close();
+    uint64 written = cos->getWritten();
+    ios.seekg(0);
+    memset(&block[0], 0, size_t(length));
+    CompressedInputStream* cis = new CompressedInputStream(ios, jobs);
+
+    while (true) {
+       cis->read((char*)block, length);
+
+       if (cis->gcount() != length)
+          break;
+    }
+
+    cis->close();
+    uint64 read = cis->getRead();
+    delete cos;
+    delete cis;
+
+    if (memcmp(&buf[0], &block[0], length) != 0) {
+       delete[] buf;
+       return 3;
+    }
+
+    delete[] buf;
+    return read ^ written;
+}
+
+int testAdaptiveCorrectness()
+{
+    cout << endl << "Adaptive Correctness Test" << endl;
+    const int length = 4 * 1024 * 1024;
+    byte* values = new byte[length];
+    bool res = true;
+    srand((uint)time(nullptr));
+
+    for (int i = 0; i < length; i++)
+        values[i] = byte(65 + (rand() % (1 + ((i >> 12) & 31))));
+
+    // Throughput targets: too high for the max level, reachable, too low
+    const int targets[] = { 5000, 50, 1 };
+
+    for (int t = 0; t < 3; t++) {
+        const uint64 cres = compressAdaptive(values, length, targets[t], 9, 0);
+        cout << ((cres == 0) ? "Success" : "Failure") << endl;
+        res &= (cres == 0);
+    }
+
+    // Stall mode: a fast output keeps the lowest level, a slow one raises it
+    for (int ns = 0; ns <= 50; ns += 50) {
+        const uint64 cres = compressAdaptive(values, length, 0, 1, ns);
+        cout << ((cres == 0) ? "Success" : "Failure") << endl;
+        res &= (cres == 0);
+    }
+
+    delete[] values;
+    return (res == true) ? 0 : 1;
+}
+
 #ifdef __GNUG__
 int main(int argc, const char* argv[])
 #else
 int TestCompressedStream_main(int argc, const char* argv[])
 #endif
 {
-    return testCorrectness(argc, argv);
+    int res = testCorrectness(argc, argv);
+    res |= testAdaptiveLevels();
+    res |= testAdaptiveCorrectness();
+    return res;
 }
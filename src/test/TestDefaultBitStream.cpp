@@ -20,6 +20,8 @@ limitations under the License.
 #include "../bitstream/DebugOutputBitStream.hpp"
 #include "../bitstream/DefaultInputBitStream.hpp"
 #include "../bitstream/DefaultOutputBitStream.hpp"
+#include "../bitstream/MemoryInputBitStream.hpp"
+#include "../bitstream/MemoryOutputBitStream.hpp"
 
 using namespace std;
 using namespace kanzi;
@@ -305,6 +307,149 @@ int testBitStreamSpeed1(const string& fileName)
     return 0;
 }
 
+int testMemoryBitStreamCorrectness()
+{
+    // Test correctness of memory bitstreams against default bitstreams
+    cout << "\nCorrectness Test - memory bitstreams" << endl;
+    srand((uint)time(nullptr));
+    const int length = 10000;
+    uint64* values = new uint64[length];
+    uint* sizes = new uint[length];
+    byte* bytes = new byte[length];
+    int res = 0;
+
+    for (int i = 0; i < length; i++)
+        bytes[i] = byte(rand());
+
+    for (int test = 1; test <= 20; test++) {
+        for (int i = 0; i < length; i++) {
+            sizes[i] = 1 + (rand() & 63);
+            values[i] = ((uint64(rand()) << 42) ^ (uint64(rand()) << 21) ^ uint64(rand())) & (uint64(-1) >> (64 - sizes[i]));
+        }
+
+        // Write the same bits with both implementations
+        const uint nbArrayBits = uint(8 * (length - 1) + (rand() & 7) + 1);
+        const int offset = rand() & 3;
+        stringbuf buffer;
+        iostream ios(&buffer);
+        DefaultOutputBitStream dobs(ios, 16384);
+        SliceArray<byte> sa1(new byte[1024], 1024, offset); // small on purpose (must grow)
+        MemoryOutputBitStream mobs(sa1, true);
+
+        for (int i = 0; i < length; i++) {
+            dobs.writeBits(values[i], sizes[i]);
+            mobs.writeBits(values[i], sizes[i]);
+
+            if ((i % 1000) == 999) {
+                // Test both byte aligned and misaligned array writes
+                dobs.writeBits(bytes, nbArrayBits);
+                mobs.writeBits(bytes, nbArrayBits);
+            }
+        }
+
+        dobs.close();
+        mobs.close();
+        const string str = buffer.str();
+        bool ok = (dobs.written() == mobs.written()) && (sa1._index == offset + int(str.size()));
+        ok &= memcmp(str.data(), &sa1._array[offset], str.size()) == 0;
+
+        if (ok == true) {
+            // Read the bits back
+            SliceArray<byte> sa2(sa1._array, sa1._length, offset);
+            MemoryInputBitStream mibs(sa2, int(str.size()));
+            byte* bytes2 = new byte[length];
+
+            for (int i = 0; (i < length) && (ok == true); i++) {
+                ok &= mibs.readBits(sizes[i]) == values[i];
+
+                if ((i % 1000) == 999) {
+                    memset(bytes2, 0, length);
+                    mibs.readBits(bytes2, nbArrayBits);
+                    const int n = int(nbArrayBits >> 3);
+                    ok &= memcmp(bytes, bytes2, n) == 0;
+
+                    if ((nbArrayBits & 7) != 0) {
+                        const int mask = (0xFF << (8 - (nbArrayBits & 7))) & 0xFF;
+                        ok &= (int(bytes2[n]) & mask) == (int(bytes[n]) & mask);
+                    }
+                }
+            }
+
+            ok &= mibs.read() == mobs.written();
+            mibs.close();
+            ok &= sa2._index == sa1._index;
+            delete[] bytes2;
+        }
+
+        delete[] sa1._array;
+        cout << "Test " << test << ": " << ((ok == true) ? "Success" : "Failure") << endl;
+
+        if (ok == false)
+            res = 1;
+    }
+
+    delete[] bytes;
+    delete[] sizes;
+    delete[] values;
+    return res;
+}
+
+int testMemoryBitStreamSpeed1()
+{
+    // Test speed
+    cout << "\nSpeed Test1 (memory bitstreams)" << endl;
+
+    int values[] = { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3,
+        31, 14, 41, 15, 59, 92, 26, 65, 53, 35, 58, 89, 97, 79, 93, 32 };
+
+    int iter = 150;
+    uint64 written = 0;
+    uint64 read = 0;
+    double delta1 = 0, delta2 = 0;
+    int nn = 100000 * 32;
+    const int size = nn * 5;
+    byte* buf = new byte[size];
+
+    for (int test = 1; test <= iter; test++) {
+        SliceArray<byte> sa1(buf, size, 0);
+        MemoryOutputBitStream obs(sa1);
+        clock_t before = clock();
+
+        for (int i = 0; i < nn; i++) {
+            obs.writeBits((uint64)values[i % 32], 1 + (i & 63));
+        }
+
+        obs.close();
+        clock_t after = clock();
+        delta1 += (after - before);
+        written += obs.written();
+
+        SliceArray<byte> sa2(buf, size, 0);
+        MemoryInputBitStream ibs(sa2, sa1._index);
+        before = clock();
+
+        for (int i = 0; i < nn; i++) {
+            ibs.readBits(1 + (i & 63));
+        }
+
+        ibs.close();
+        after = clock();
+        delta2 += (after - before);
+        read += ibs.read();
+    }
+
+    double d = 1024.0 * 8192.0;
+    cout << written << " bits written (" << (written / 1024 / 1024 / 8) << " MB)" << endl;
+    cout << read << " bits read (" << (read / 1024 / 1024 / 8) << " MB)" << endl;
+    cout << endl;
+    cout << "Write [ms]        : " << (int)(delta1 / CLOCKS_PER_SEC * 1000) << endl;
+    cout << "Throughput [MB/s] : " << (int)((double)written / d / (delta1 / CLOCKS_PER_SEC)) << endl;
+    cout << "Read [ms]         : " << (int)(delta2 / CLOCKS_PER_SEC * 1000) << endl;
+    cout << "Throughput [MB/s] : " << (int)((double)read / d / (delta2 / CLOCKS_PER_SEC)) << endl;
+    delete[] buf;
+    return 0;
+}
+
 int testBitStreamCorrectnessAligned2()
 {
     // Test correctness (byte aligned)
@@ -553,6 +698,68 @@ int testBitStreamSpeed2(const string& fileName)
     return 0;
 }
 
+int testMemoryBitStreamSpeed2()
+{
+    // Test speed
+    cout << "\nSpeed Test2 (memory bitstreams)" << endl;
+
+    byte values[] = { (byte)3, (byte)1, (byte)4, (byte)1, (byte)5,(byte) 9, (byte)2, (byte)6,
+        (byte)5, (byte)3, (byte)5, (byte)8, (byte)9, (byte)7, (byte)9, (byte)3,
+        (byte)31, (byte)14, (byte)41, (byte)15, (byte)59, (byte)92, (byte)26, (byte)65,
+        (byte)53, (byte)35, (byte)58, (byte)89, (byte)97, (byte)79, (byte)93, (byte)32 };
+
+    int iter = 150;
+    uint64 written = 0;
+    uint64 read = 0;
+    double delta1 = 0, delta2 = 0;
+    const int size = 3250000 * 32;
+    byte* input = new byte[size];
+    byte* output = new byte[size];
+    byte* buf = new byte[size + 16];
+
+    for (int i = 0; i < 3250000; i++) {
+        memcpy(&input[i*32], &values[0], 32);
+    }
+
+    for (int test = 1; test <= iter; test++) {
+        SliceArray<byte> sa1(buf, size + 16, 0);
+        MemoryOutputBitStream obs(sa1);
+        clock_t before = clock();
+
+        obs.writeBits(input, 3250000*32);
+
+        obs.close();
+        clock_t after = clock();
+        delta1 += (after - before);
+        written += obs.written();
+
+        SliceArray<byte> sa2(buf, size + 16, 0);
+        MemoryInputBitStream ibs(sa2, sa1._index);
+        before = clock();
+
+        ibs.readBits(output, 3250000*32);
+
+        ibs.close();
+        after = clock();
+        delta2 += (after - before);
+        read += ibs.read();
+    }
+
+    double d = 1024.0 * 8192.0;
+    cout << written << " bits written (" << (written / 1024 / 1024 / 8) << " MB)" << endl;
+    cout << read << " bits read (" << (read / 1024 / 1024 / 8) << " MB)" << endl;
+    cout << endl;
+    cout << "Write [ms]        : " << (int)(delta1 / CLOCKS_PER_SEC * 1000) << endl;
+    cout << "Throughput [MB/s] : " << (int)((double)written / d / (delta1 / CLOCKS_PER_SEC)) << endl;
+    cout << "Read [ms]         : " << (int)(delta2 / CLOCKS_PER_SEC * 1000) << endl;
+    cout << "Throughput [MB/s] : " << (int)((double)read / d / (delta2 / CLOCKS_PER_SEC)) << endl;
+
+    delete[] input;
+    delete[] output;
+    delete[] buf;
+    return 0;
+}
+
 
 #ifdef __GNUG__
 int main(int argc, const char* argv[])
@@ -579,10 +786,13 @@ int TestDefaultBitStream_main(int argc, const char* argv[])
     res |= testBitStreamCorrectnessAligned2();
     res |= testBitStreamCorrectnessMisaligned1();
     res |= testBitStreamCorrectnessMisaligned2();
+    res |= testMemoryBitStreamCorrectness();
 
     if (doPerf == true) {
        res |= testBitStreamSpeed1(fileName);
        res |= testBitStreamSpeed2(fileName);
+       res |= testMemoryBitStreamSpeed1();
+       res |= testMemoryBitStreamSpeed2();
     }
 
     return res;
@@ -34,6 +34,8 @@ limitations under the License.
 #include "../entropy/FPAQDecoder.hpp"
 #include "../entropy/CMPredictor.hpp"
 #include "../entropy/TPAQPredictor.hpp"
+#include "../entropy/EntropyEncoderFactory.hpp"
+#include "../entropy/EntropyDecoderFactory.hpp"
 
 using namespace kanzi;
 using namespace std;
@@ -222,6 +224,106 @@ int testEntropyCodecCorrectness(const string& name)
     return res;
 }
 
+// Deterministic block: a run of one symbol, then symbols with a skewed
+// distribution that changes every 16 KB (so that chunks differ)
+static void fillBlock(byte block[], int size)
+{
+    uint seed = 12345;
+
+    for (int i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        const uint range = (i < 65536) ? 1 : 2 + ((i >> 14) & 63);
+        block[i] = byte(32 + (seed >> 16) % range);
+    }
+}
+
+static string encodeWithContext(short type, Context& ctx, const byte block[], int size)
+{
+    stringbuf buffer;
+    iostream ios(&buffer);
+    DefaultOutputBitStream obs(ios);
+    EntropyEncoder* ec = EntropyEncoderFactory::newEncoder(obs, ctx, type);
+    ec->encode(block, 0, size);
+    ec->dispose();
+    delete ec;
+    obs.close();
+    return buffer.str();
+}
+
+static bool decodeWithContext(short type, Context& ctx, const string& encoded, const byte block[], int size)
+{
+    stringbuf buffer(encoded);
+    iostream ios(&buffer);
+    DefaultInputBitStream ibs(ios);
+    EntropyDecoder* ed = EntropyDecoderFactory::newDecoder(ibs, ctx, type);
+    byte* values = new byte[size];
+    const int decoded = ed->decode(values, 0, size);
+    ed->dispose();
+    delete ed;
+    ibs.close();
+    const bool ok = (decoded == size) && (memcmp(values, block, size_t(size)) == 0);
+    delete[] values;
+    return ok;
+}
+
+// Encode and decode a block big enough for several concurrent tasks (4 x 256 KB)
+// with 1 and 4 jobs. The output must not depend on the number of jobs.
+// CM and TPAQ use a block split into sub-streams (2 x 4.5 MB) instead: the
+// encoded data depends on the number of sub-streams, the decoded data must not.
+int testEntropyCodecJobs(const string& name)
+{
+    cout << endl
+         << endl
+         << "=== Concurrency test for " << name << " ===" << endl;
+    const short type = EntropyEncoderFactory::getType(name.c_str());
+    const bool subStreams = (name == "CM") || (name == "TPAQ") || (name == "TPAQX");
+    const int size = (subStreams == true) ? 9 << 20 : (1 << 20) + 12345;
+    byte* block = new byte[size];
+    fillBlock(block, size);
+    Context ctx1;
+    ctx1.putInt("blockSize", size);
+    ctx1.putInt("jobs", 1);
+
+    if (subStreams == true)
+        ctx1.putInt("entropySubStreams", 1);
+
+    Context ctx4(ctx1);
+    ctx4.putInt("jobs", 4);
+    int res = 0;
+    const string encoded4 = encodeWithContext(type, ctx4, block, size);
+
+    if (subStreams == false) {
+        const string encoded1 = encodeWithContext(type, ctx1, block, size);
+
+        if (encoded1 != encoded4) {
+            cout << "Encoded data differs with 4 jobs" << endl;
+            res = 1;
+        }
+
+        if ((decodeWithContext(type, ctx1, encoded1, block, size) == false)
+            || (decodeWithContext(type, ctx4, encoded1, block, size) == false)) {
+            cout << "Decoded data differs" << endl;
+            res = 1;
+        }
+    }
+    else if (encoded4[0] == 0) {
+        // The data starts with the number of sub-streams - 1
+        cout << "No sub-streams with 4 jobs" << endl;
+        res = 1;
+    }
+
+    if ((decodeWithContext(type, ctx4, encoded4, block, size) == false)
+        || (decodeWithContext(type, ctx1, encoded4, block, size) == false)) {
+        cout << "Decoded data differs" << endl;
+        res = 1;
+    }
+
+    cout << "Encoded " << size << " bytes into " << encoded4.size() << " bytes";
+    cout << ((res == 0) ? ": identical with 1 and 4 jobs" : "") << endl;
+    delete[] block;
+    return res;
+}
+
 int testEntropyCodecSpeed(const string& name)
 {
     // Test speed
@@ -328,6 +430,61 @@ int testEntropyCodecSpeed(const string& name)
     return res;
 }
 
+// Measure the throughput of the predictor alone (no arithmetic coding, no IO)
+int testPredictorSpeed(const string& name)
+{
+    cout << endl
+         << endl
+         << "=== Predictor speed test for " << name << " ===" << endl;
+    const int size = 1000000;
+    const int iter = 3;
+    byte* values = new byte[size];
+    srand((uint)time(nullptr));
+
+    // Mix of short random runs and repeated sequences (so that matches are found)
+    for (int i = 0; i < size; i++) {
+        if ((i >= 4096) && ((rand() & 3) == 0))
+            values[i] = values[i - 4096 + (rand() & 3)];
+        else
+            values[i] = byte(32 + (rand() % 64));
+    }
+
+    Predictor* predictor = getPredictor(name);
+
+    if (predictor == nullptr) {
+        delete[] values;
+        return 1;
+    }
+
+    double delta = 0;
+    int sum = 0;
+
+    for (int ii = 0; ii < iter; ii++) {
+        clock_t before = clock();
+
+        for (int i = 0; i < size; i++) {
+            const int val = int(values[i]);
+
+            for (int shift = 7; shift >= 0; shift--) {
+                sum += predictor->get();
+                predictor->update((val >> shift) & 1);
+            }
+        }
+
+        clock_t after = clock();
+        delta += (after - before);
+    }
+
+    double prod = double(iter) * double(size);
+    double b2KB = double(1) / double(1024);
+    double d_sec = delta / CLOCKS_PER_SEC;
+    cout << "Predict [ms]      : " << (int)(d_sec * 1000) << " (checksum " << (sum & 0xFFFF) << ")" << endl;
+    cout << "Throughput [KB/s] : " << (int)(prod * b2KB / d_sec) << endl;
+    delete predictor;
+    delete[] values;
+    return 0;
+}
+
 #ifdef __GNUG__
 int main(int argc, const char* argv[])
 #else
@@ -381,8 +538,20 @@ int TestEntropyCodec_main(int argc, const char* argv[])
                  << "Test" << *it << endl;
             res |= testEntropyCodecCorrectness(*it);
 
-        if (doPerf == true)
+            // Codecs with chunks or sub-streams encoded and decoded concurrently
+            if ((*it == "HUFFMAN") || (*it == "ANS0") || (*it == "ANS1") || (*it == "RANGE")
+                || (*it == "CM") || (*it == "TPAQ"))
+                res |= testEntropyCodecJobs(*it);
+
+        if (doPerf == true) {
                res |= testEntropyCodecSpeed(*it);
+
+               if ((*it == "CM") || (*it == "TPAQ"))
+                  res |= testPredictorSpeed(*it);
+
+               if (*it == "TPAQ")
+                  res |= testPredictorSpeed("TPAQX");
+            }
         }
     }
     catch (exception& e) {
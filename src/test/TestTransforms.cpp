@@ -18,6 +18,7 @@ limitations under the License.
 #include <time.h>
 #include "../types.hpp"
 #include "../transform/AliasCodec.hpp"
+#include "../transform/BWT.hpp"
 #include "../transform/FSDCodec.hpp"
 #include "../transform/LZCodec.hpp"
 #include "../transform/NullTransform.hpp"
@@ -25,6 +26,7 @@ limitations under the License.
 #include "../transform/ROLZCodec.hpp"
 #include "../transform/SBRT.hpp"
 #include "../transform/SRT.hpp"
+#include "../transform/TextCodec.hpp"
 #include "../transform/TransformFactory.hpp"
 #include "../transform/ZRLT.hpp"
 
@@ -80,6 +82,27 @@ static Transform<byte>* getByteTransform(string name, Context& ctx)
     return nullptr;
 }
 
+// Generate text-like data: words with some random noise (on average, one
+// token in 'noise' is a random character instead of a word)
+static void generateText(byte block[], int size, int noise)
+{
+    static const char* words[] = { "the ", "compression ", "of ", "small ", "blocks ",
+        "is ", "dominated ", "by ", "table ", "resets ", "and ", "hash ", "lookups ", "\n" };
+    int n = 0;
+
+    while (n < size) {
+        const char* w = ((rand() % noise) == 0) ? nullptr : words[rand() % 14];
+
+        if (w == nullptr) {
+            block[n++] = byte(32 + (rand() % 90));
+            continue;
+        }
+
+        while ((*w != 0) && (n < size))
+            block[n++] = byte(*w++);
+    }
+}
+
 int testTransformsCorrectness(const string& name)
 {
     srand((uint)time(nullptr));
@@ -464,6 +487,289 @@ int testTransformsSpeed(const string& name)
     return res;
 }
 
+static bool forwardWithContext(const string& name, Context& ctx, byte input[], int size, string& encoded)
+{
+    Transform<byte>* t = getByteTransform(name, ctx);
+    const int outSize = t->getMaxEncodedLength(size);
+    byte* output = new byte[outSize];
+    SliceArray<byte> sa1(input, size, 0);
+    SliceArray<byte> sa2(output, outSize, 0);
+    const bool ok = t->forward(sa1, sa2, size);
+    encoded.assign(reinterpret_cast<char*>(output), size_t(sa2._index));
+    delete t;
+    delete[] output;
+    return ok;
+}
+
+static bool inverseWithContext(const string& name, Context& ctx, const string& encoded, byte input[], int size)
+{
+    Transform<byte>* t = getByteTransform(name, ctx);
+    byte* data = new byte[encoded.size()];
+    byte* reverse = new byte[size];
+    memcpy(data, encoded.data(), encoded.size());
+    SliceArray<byte> sa1(data, int(encoded.size()), 0);
+    SliceArray<byte> sa2(reverse, size, 0);
+    const bool ok = t->inverse(sa1, sa2, int(encoded.size()))
+        && (sa2._index == size) && (memcmp(input, reverse, size_t(size)) == 0);
+    delete t;
+    delete[] data;
+    delete[] reverse;
+    return ok;
+}
+
+// Round trip of a block spanning 3 ROLZ chunks (16 MB each) with 1 and 4 jobs.
+// The chunks are then processed concurrently and the output must not depend
+// on the number of jobs.
+int testTransformsJobs(const string& name)
+{
+    cout << endl
+         << endl
+         << "Concurrency test for " << name << endl;
+    const int size = (2 * 16 + 5) * 1024 * 1024;
+    byte* input = new byte[size];
+    srand(12345); // deterministic input
+    generateText(input, size, 16);
+    Context ctx1;
+    ctx1.putString("transform", name);
+    ctx1.putInt("blockSize", size);
+    ctx1.putInt("jobs", 1);
+    Context ctx4(ctx1);
+    ctx4.putInt("jobs", 4);
+    string encoded1, encoded4;
+    int res = 0;
+
+    if ((forwardWithContext(name, ctx1, input, size, encoded1) == false)
+        || (forwardWithContext(name, ctx4, input, size, encoded4) == false)) {
+        cout << "Encoding error" << endl;
+        res = 1;
+    }
+    else if (encoded1 != encoded4) {
+        cout << "Encoded data differs with 4 jobs" << endl;
+        res = 1;
+    }
+    else if ((inverseWithContext(name, ctx1, encoded1, input, size) == false)
+        || (inverseWithContext(name, ctx4, encoded4, input, size) == false)) {
+        cout << "Decoding error or different output" << endl;
+        res = 1;
+    }
+    else {
+        cout << "Encoded " << size << " bytes into " << encoded4.size();
+        cout << " bytes: identical with 1 and 4 jobs" << endl;
+    }
+
+    delete[] input;
+    return res;
+}
+
+static Transform<byte>* newBlockTransform(const string& name, Context& ctx)
+{
+    return (name == "TEXT") ? new TextCodec(ctx) : getByteTransform(name, ctx);
+}
+
+// Speed test on small blocks, first with new transform instances for each
+// block (as in the stream pipeline: the hash tables are allocated and cleared
+// for every block), then with instances reused across blocks (no table clear)
+int testTransformsBlockSpeed(const string& name)
+{
+    const int sizes[] = { 64 * 1024, 256 * 1024, 1024 * 1024 };
+    const int maxSize = sizes[2];
+    int res = 0;
+    srand((uint)time(nullptr));
+
+    cout << endl
+         << endl
+         << "Block speed test for " << name << endl;
+
+    byte* input = new byte[maxSize];
+    generateText(input, maxSize, 16);
+
+    Context ctx;
+    ctx.putString("transform", name);
+    ctx.putInt("blockSize", maxSize);
+    Transform<byte>* ff = newBlockTransform(name, ctx);
+    Transform<byte>* fi = newBlockTransform(name, ctx);
+
+    if ((ff == nullptr) || (fi == nullptr)) {
+        delete ff;
+        delete fi;
+        delete[] input;
+        return 1;
+    }
+
+    const int outSize = ff->getMaxEncodedLength(maxSize);
+    byte* output = new byte[outSize];
+    byte* reverse = new byte[maxSize];
+
+    for (int reuse = 0; (reuse < 2) && (res == 0); reuse++) {
+        cout << endl << ((reuse == 0) ? "New instances per block" : "Reused instances") << endl;
+
+        for (int s = 0; s < 3; s++) {
+            const int size = sizes[s];
+            const int iter = (64 * 1024 * 1024) / size;
+            const int nbBlocks = maxSize / size;
+            clock_t before, after;
+            double delta1 = 0;
+            double delta2 = 0;
+
+            for (int ii = 0; ii < iter; ii++) {
+                SliceArray<byte> iba1(&input[(ii % nbBlocks) * size], size, 0);
+                SliceArray<byte> iba2(output, outSize, 0);
+                SliceArray<byte> iba3(reverse, size, 0);
+                before = clock();
+                Transform<byte>* f = (reuse == 0) ? newBlockTransform(name, ctx) : ff;
+                const bool ok = f->forward(iba1, iba2, size);
+
+                if (reuse == 0)
+                    delete f;
+
+                after = clock();
+                delta1 += (after - before);
+
+                if (ok == false) {
+                    cout << "Encoding error" << endl;
+                    res = 1;
+                    break;
+                }
+
+                const int count = iba2._index;
+                iba2._index = 0;
+                before = clock();
+                Transform<byte>* g = (reuse == 0) ? newBlockTransform(name, ctx) : fi;
+                const bool ok2 = g->inverse(iba2, iba3, count);
+
+                if (reuse == 0)
+                    delete g;
+
+                after = clock();
+                delta2 += (after - before);
+
+                if (ok2 == false) {
+                    cout << "Decoding error" << endl;
+                    res = 1;
+                    break;
+                }
+
+                if ((iba3._index != size) || (memcmp(iba1._array, reverse, size) != 0)) {
+                    cout << "Failure: different output" << endl;
+                    res = 1;
+                    break;
+                }
+            }
+
+            if (res != 0)
+                break;
+
+            double prod = double(iter) * double(size);
+            double b2MB = double(1) / double(1024 * 1024);
+            double d1_sec = delta1 / CLOCKS_PER_SEC;
+            double d2_sec = delta2 / CLOCKS_PER_SEC;
+            cout << "Block size: " << (size >> 10) << " KB" << endl;
+            cout << name << " encoding [ms]: " << (int)(d1_sec * 1000) << endl;
+            cout << "Throughput [MB/s]: " << (int)(prod * b2MB / d1_sec) << endl;
+            cout << name << " decoding [ms]: " << (int)(d2_sec * 1000) << endl;
+            cout << "Throughput [MB/s]: " << (int)(prod * b2MB / d2_sec) << endl;
+        }
+    }
+
+    delete ff;
+    delete fi;
+    delete[] input;
+    delete[] output;
+    delete[] reverse;
+    return res;
+}
+
+// Speed test of the rank transforms (MTFT, RANK, SRT) on BWT output, their
+// typical input (mostly small ranks, occasional symbols far down the list)
+int testRankTransformsSpeed(const string& name)
+{
+    const int size = 1024 * 1024;
+    const int iter = 32;
+    int res = 0;
+    srand((uint)time(nullptr));
+
+    cout << endl
+         << endl
+         << "Speed test for " << name << " (BWT output)" << endl;
+
+    // Generate text-like data, then apply BWT
+    byte* text = new byte[size];
+    byte* input = new byte[size];
+    generateText(text, size, 8);
+
+    {
+        BWT bwt;
+        SliceArray<byte> sa1(text, size, 0);
+        SliceArray<byte> sa2(input, size, 0);
+        bwt.forward(sa1, sa2, size);
+    }
+
+    Context ctx;
+    Transform<byte>* ff = getByteTransform(name, ctx);
+    const int outSize = ff->getMaxEncodedLength(size);
+    byte* output = new byte[outSize];
+    byte* reverse = new byte[size];
+    clock_t before, after;
+    double delta1 = 0;
+    double delta2 = 0;
+
+    for (int ii = 0; ii < iter; ii++) {
+        Transform<byte>* fi = getByteTransform(name, ctx);
+        SliceArray<byte> iba1(input, size, 0);
+        SliceArray<byte> iba2(output, outSize, 0);
+        SliceArray<byte> iba3(reverse, size, 0);
+        before = clock();
+
+        if (ff->forward(iba1, iba2, size) == false) {
+            cout << "Encoding error" << endl;
+            res = 1;
+            delete fi;
+            break;
+        }
+
+        after = clock();
+        delta1 += (after - before);
+        const int count = iba2._index;
+        iba2._index = 0;
+        before = clock();
+
+        if (fi->inverse(iba2, iba3, count) == false) {
+            cout << "Decoding error" << endl;
+            res = 1;
+            delete fi;
+            break;
+        }
+
+        after = clock();
+        delta2 += (after - before);
+        delete fi;
+
+        if (memcmp(input, reverse, size) != 0) {
+            cout << "Failure: different output" << endl;
+            res = 1;
+            break;
+        }
+    }
+
+    if (res == 0) {
+        double prod = double(iter) * double(size);
+        double b2MB = double(1) / double(1024 * 1024);
+        double d1_sec = delta1 / CLOCKS_PER_SEC;
+        double d2_sec = delta2 / CLOCKS_PER_SEC;
+        cout << name << " encoding [ms]: " << (int)(d1_sec * 1000) << endl;
+        cout << "Throughput [MB/s]: " << (int)(prod * b2MB / d1_sec) << endl;
+        cout << name << " decoding [ms]: " << (int)(d2_sec * 1000) << endl;
+        cout << "Throughput [MB/s]: " << (int)(prod * b2MB / d2_sec) << endl;
+    }
+
+    delete ff;
+    delete[] text;
+    delete[] input;
+    delete[] output;
+    delete[] reverse;
+    return res;
+}
+
 #ifdef __GNUG__
 int main(int argc, const char* argv[])
 #else
@@ -517,9 +823,22 @@ int TestTransforms_main(int argc, const char* argv[])
                 << "Test" << *it << endl;
             res |= testTransformsCorrectness(*it);
 
+            // Codecs with chunks encoded and decoded concurrently
+            if ((*it == "ROLZ") || (*it == "ROLZX"))
+               res |= testTransformsJobs(*it);
+
             if ((doPerf == true) && (*it != "LZP") && (*it != "MM")) // skip codecs with no good data
                res |= testTransformsSpeed(*it);
+
+            if ((doPerf == true) && ((*it == "LZX") || (*it == "ROLZ") || (*it == "ROLZX")))
+               res |= testTransformsBlockSpeed(*it);
+
+            if ((doPerf == true) && ((*it == "RANK") || (*it == "MTFT") || (*it == "SRT")))
+               res |= testRankTransformsSpeed(*it);
         }
+
+        if ((doPerf == true) && (codecs.size() > 1))
+            res |= testTransformsBlockSpeed("TEXT");
     
     }
     catch (exception& e) {
@@ -17,6 +17,7 @@ limitations under the License.
 #include <vector>
 
 #include "AliasCodec.hpp"
+#include "../Allocator.hpp"
 #include "../Global.hpp"
 #include "../Memory.hpp"
 
@@ -147,7 +148,7 @@ bool AliasCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
         
         {
             // Find missing 2-byte symbols
-            uint* freqs1 = new uint[65536];
+            uint* freqs1 = allocate<uint>(65536, MemoryUsage::TRANSFORM);
             memset(freqs1, 0, 65536 * sizeof(uint));
             Global::computeHistogram(&src[0], count, freqs1, false);
             int n1 = 0;
@@ -166,7 +167,7 @@ bool AliasCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
                 n1++;
             }
 
-            delete[] freqs1;
+            deallocate(freqs1);
 
             if (n1 < n0) {
                 // Fewer distinct 2-byte symbols than 1-byte symbols
@@ -28,8 +28,9 @@ using namespace std;
 
 BWT::BWT(int jobs)
 {
-    _buffer = new uint[0];
-    _sa = new int[0];
+    _allocator = &Allocator::getDefault();
+    _buffer = allocate<uint>(_allocator, 0, MemoryUsage::TRANSFORM);
+    _sa = allocate<int>(_allocator, 0, MemoryUsage::TRANSFORM);
     _bufferSize = 0;
     _saSize = 0;
 
@@ -50,8 +51,9 @@ BWT::BWT(int jobs)
 
 BWT::BWT(Context& ctx)
 {
-    _buffer = new uint[0];
-    _sa = new int[0];
+    _allocator = &Allocator::getAllocator(ctx);
+    _buffer = allocate<uint>(_allocator, 0, MemoryUsage::TRANSFORM);
+    _sa = allocate<int>(_allocator, 0, MemoryUsage::TRANSFORM);
     _bufferSize = 0;
     _saSize = 0;
     int jobs = ctx.getInt("jobs", 1);
@@ -103,9 +105,9 @@ bool BWT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 
     // Lazy dynamic memory allocation
     if (_saSize < count) {
-         delete[] _sa;
+         deallocate(_allocator, _sa);
          _saSize = count;
-         _sa = new int[_saSize];
+         _sa = allocate<int>(_allocator, _saSize, MemoryUsage::TRANSFORM);
     }
 
     _saAlgo.computeBWT(src, dst, _sa, count, _primaryIndexes, getBWTChunks(count));
@@ -142,9 +144,9 @@ bool BWT::inverseMergeTPSI(SliceArray<byte>& input, SliceArray<byte>& output, in
 {
     // Lazy dynamic memory allocation
     if (_bufferSize < count) {
-        delete[] _buffer;
+        deallocate(_allocator, _buffer);
         _bufferSize = max(count, 256);
-        _buffer = new uint[_bufferSize];
+        _buffer = allocate<uint>(_allocator, _bufferSize, MemoryUsage::TRANSFORM);
     }
 
     const int pIdx = getPrimaryIndex(0);
@@ -248,9 +250,9 @@ bool BWT::inverseBiPSIv2(SliceArray<byte>& input, SliceArray<byte>& output, int
 {
     // Lazy dynamic memory allocations
     if (_bufferSize < count + 1) {
-        delete[] _buffer;
+        deallocate(_allocator, _buffer);
         _bufferSize = max(count + 1, 256);
-        _buffer = new uint[_bufferSize];
+        _buffer = allocate<uint>(_allocator, _bufferSize, MemoryUsage::TRANSFORM);
     }
 
     const byte* src = &input._array[input._index];
@@ -260,7 +262,7 @@ bool BWT::inverseBiPSIv2(SliceArray<byte>& input, SliceArray<byte>& output, int
     if ((pIdx < 0) || (pIdx > count))
         return false;
 
-    uint* buckets = new uint[65536];
+    uint* buckets = allocate<uint>(65536, MemoryUsage::TRANSFORM);
     memset(&_buffer[0], 0, _bufferSize * sizeof(uint));
     memset(&buckets[0], 0, 65536 * sizeof(uint));
     uint freqs[256] = { 0 };
@@ -286,7 +288,7 @@ bool BWT::inverseBiPSIv2(SliceArray<byte>& input, SliceArray<byte>& output, int
     }
 
     const int lastc = int(src[0]);
-    uint16* fastBits = new uint16[MASK_FASTBITS + 1];
+    uint16* fastBits = allocate<uint16>(MASK_FASTBITS + 1, MemoryUsage::TRANSFORM);
     memset(&fastBits[0], 0, size_t(MASK_FASTBITS + 1) * sizeof(uint16));
     int shift = 0;
 
@@ -391,15 +393,15 @@ bool BWT::inverseBiPSIv2(SliceArray<byte>& input, SliceArray<byte>& output, int
             delete task;
 #else
         // nbTasks > 1 but concurrency is not enabled (should never happen)
-        delete[] fastBits;
-        delete[] buckets;
+        deallocate(fastBits);
+        deallocate(buckets);
         throw invalid_argument("Error during BWT inverse: concurrency not supported");
 #endif
     }
 
     dst[count - 1] = byte(lastc);
-    delete[] fastBits;
-    delete[] buckets;
+    deallocate(fastBits);
+    deallocate(buckets);
     input._index += count;
     output._index += count;
     return true;
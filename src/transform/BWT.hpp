@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef _BWT_
 #define _BWT_
 
+#include "../Allocator.hpp"
 #include "../concurrent.hpp"
 #include "../Context.hpp"
 #include "../Transform.hpp"
@@ -91,6 +92,7 @@ namespace kanzi {
 
        uint* _buffer;
        int* _sa;
+       Allocator* _allocator; // _buffer and _sa
        int _bufferSize;
        int _saSize;
        int _primaryIndexes[8];
@@ -111,7 +113,7 @@ namespace kanzi {
 
        BWT(Context& ctx);
 
-       ~BWT() { delete[] _buffer; delete[] _sa; }
+       ~BWT() { deallocate(_allocator, _buffer); deallocate(_allocator, _sa); }
 
        bool forward(SliceArray<byte>& input, SliceArray<byte>& output, int length);
 
@@ -51,10 +51,10 @@ bool BWTS::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     // Lazy dynamic memory allocation
     if (_bufferSize < count) {
         _bufferSize = count;
-        delete[] _buffer1;
-        _buffer1 = new int[_bufferSize];
-        delete[] _buffer2;
-        _buffer2 = new int[_bufferSize];
+        deallocate(_allocator, _buffer1);
+        _buffer1 = allocate<int>(_allocator, _bufferSize, MemoryUsage::TRANSFORM);
+        deallocate(_allocator, _buffer2);
+        _buffer2 = allocate<int>(_allocator, _bufferSize, MemoryUsage::TRANSFORM);
     }
 
     // Aliasing
@@ -180,8 +180,8 @@ bool BWTS::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     // Lazy dynamic memory allocation
     if (_bufferSize < count) {
         _bufferSize = count;
-        delete[] _buffer1;
-        _buffer1 = new int[_bufferSize];
+        deallocate(_allocator, _buffer1);
+        _buffer1 = allocate<int>(_allocator, _bufferSize, MemoryUsage::TRANSFORM);
     }
 
     // Initialize histogram
@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef _BWTS_
 #define _BWTS_
 
+#include "../Allocator.hpp"
 #include "../Context.hpp"
 #include "../Transform.hpp"
 #include "DivSufSort.hpp"
@@ -39,6 +40,7 @@ namespace kanzi
        int* _buffer1;
        int* _buffer2;
        int _bufferSize;
+       Allocator* _allocator; // _buffer1 and _buffer2
        DivSufSort _saAlgo;
 
        int moveLyndonWordHead(int sa[], int isa[], const byte data[],
@@ -47,22 +49,24 @@ namespace kanzi
    public:
        BWTS()
        {
-           _buffer1 = new int[0];
-           _buffer2 = new int[0];
+           _allocator = &Allocator::getDefault();
+           _buffer1 = allocate<int>(_allocator, 0, MemoryUsage::TRANSFORM);
+           _buffer2 = allocate<int>(_allocator, 0, MemoryUsage::TRANSFORM);
            _bufferSize = 0;
        }
 
-       BWTS(Context&)
+       BWTS(Context& ctx)
        {
-           _buffer1 = new int[0];
-           _buffer2 = new int[0];
+           _allocator = &Allocator::getAllocator(ctx);
+           _buffer1 = allocate<int>(_allocator, 0, MemoryUsage::TRANSFORM);
+           _buffer2 = allocate<int>(_allocator, 0, MemoryUsage::TRANSFORM);
            _bufferSize = 0;
        }
 
        ~BWTS()
        {
-          delete[] _buffer1;
-          delete[] _buffer2;
+          deallocate(_allocator, _buffer1);
+          deallocate(_allocator, _buffer2);
        }
 
        bool forward(SliceArray<byte>& input, SliceArray<byte>& output, int length);
@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef _DivSufSort_
 #define _DivSufSort_
 
+#include "../Allocator.hpp"
 #include "../types.hpp"
 
 #if __cplusplus >= 201103L
@@ -52,11 +53,11 @@ namespace kanzi
 
        Stack(int size)
        {
-           _arr = new StackElement[size];
+           _arr = allocate<StackElement>(size, MemoryUsage::TRANSFORM);
            _index = 0;
        }
 
-       ~Stack() { delete[] _arr; }
+       ~Stack() { deallocate(_arr); }
 
        StackElement* get(int idx) const { return &_arr[idx]; }
 
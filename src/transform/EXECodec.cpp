@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+#include <cstring>
 #include "../Global.hpp"
 #include "../Magic.hpp"
 #include "EXECodec.hpp"
@@ -20,6 +22,35 @@ limitations under the License.
 using namespace kanzi;
 using namespace std;
 
+#if defined(__SSE2__)
+// Bit mask of the bytes in src[0..15] that may start an x86 relative jump or
+// call (0x0F 0x8X, 0xE8, 0xE9) or must be escaped (0x9B). All other bytes are
+// copied verbatim by the codec.
+int EXECodec::x86Candidates(const byte src[])
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[0]));
+    const __m128i m1 = _mm_cmpeq_epi8(v, _mm_set1_epi8(char(X86_TWO_BYTE_PREFIX)));
+    const __m128i m2 = _mm_cmpeq_epi8(_mm_and_si128(v, _mm_set1_epi8(char(X86_MASK_JUMP))),
+                                      _mm_set1_epi8(char(X86_INSTRUCTION_JUMP)));
+    const __m128i m3 = _mm_cmpeq_epi8(v, _mm_set1_epi8(char(X86_ESCAPE)));
+    return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(m1, m2), m3));
+}
+
+// Bit mask of the 32-bit words in src[0..15] that are ARM64 B, BL, CBZ or CBNZ
+// instructions (as counted by detectType).
+int EXECodec::armJumps(const byte src[])
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[0]));
+    const __m128i op1 = _mm_and_si128(v, _mm_set1_epi32(ARM_B_OPCODE_MASK));
+    const __m128i op2 = _mm_and_si128(v, _mm_set1_epi32(ARM_CB_OPCODE_MASK));
+    const __m128i m1 = _mm_or_si128(_mm_cmpeq_epi32(op1, _mm_set1_epi32(ARM_OPCODE_B)),
+                                    _mm_cmpeq_epi32(op1, _mm_set1_epi32(ARM_OPCODE_BL)));
+    const __m128i m2 = _mm_or_si128(_mm_cmpeq_epi32(op2, _mm_set1_epi32(ARM_OPCODE_CBZ)),
+                                    _mm_cmpeq_epi32(op2, _mm_set1_epi32(ARM_OPCODE_CBNZ)));
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(m1, m2)));
+}
+#endif
+
 bool EXECodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 {
     if (count == 0)
@@ -78,6 +109,9 @@ bool EXECodec::forwardX86(SliceArray<byte>& input, SliceArray<byte>& output, int
     int dstIdx = 9;
     int matches = 0;
     const int dstEnd = output._length - 5;
+#if defined(__SSE2__)
+    const int dstEnd16 = min(dstEnd, output._length - output._index) - 16;
+#endif
 
     if (codeStart > 0) {
         memcpy(&dst[dstIdx], &src[0], codeStart);
@@ -85,6 +119,24 @@ bool EXECodec::forwardX86(SliceArray<byte>& input, SliceArray<byte>& output, int
     }
 
     while ((srcIdx < codeEnd) && (dstIdx < dstEnd)) {
+#if defined(__SSE2__)
+        if ((srcIdx + 16 <= codeEnd) && (dstIdx <= dstEnd16)) {
+            // Bulk copy the bytes preceding the next candidate opcode
+            const int mask = x86Candidates(&src[srcIdx]);
+            memcpy(&dst[dstIdx], &src[srcIdx], 16);
+
+            if (mask == 0) {
+                srcIdx += 16;
+                dstIdx += 16;
+                continue;
+            }
+
+            const int n = Global::trailingZeros(uint32(mask));
+            srcIdx += n;
+            dstIdx += n;
+        }
+#endif
+
         if (src[srcIdx] == X86_TWO_BYTE_PREFIX) {
             dst[dstIdx++] = src[srcIdx++];
 
@@ -264,6 +316,9 @@ bool EXECodec::inverseX86(SliceArray<byte>& input, SliceArray<byte>& output, int
     int dstIdx = 0;
     const int codeStart = LittleEndian::readInt32(&src[1]);
     const int codeEnd = LittleEndian::readInt32(&src[5]);
+#if defined(__SSE2__)
+    const int dstEnd16 = output._length - output._index - 16;
+#endif
 
     if (codeStart > 0) {
         memcpy(&dst[dstIdx], &src[9], codeStart);
@@ -272,6 +327,24 @@ bool EXECodec::inverseX86(SliceArray<byte>& input, SliceArray<byte>& output, int
     }
 
     while (srcIdx < codeEnd) {
+#if defined(__SSE2__)
+        if ((srcIdx + 16 <= codeEnd) && (dstIdx <= dstEnd16)) {
+            // Bulk copy the bytes preceding the next candidate opcode
+            const int mask = x86Candidates(&src[srcIdx]);
+            memcpy(&dst[dstIdx], &src[srcIdx], 16);
+
+            if (mask == 0) {
+                srcIdx += 16;
+                dstIdx += 16;
+                continue;
+            }
+
+            const int n = Global::trailingZeros(uint32(mask));
+            srcIdx += n;
+            dstIdx += n;
+        }
+#endif
+
         if (src[srcIdx] == X86_TWO_BYTE_PREFIX) {
             dst[dstIdx++] = src[srcIdx++];
 
@@ -401,6 +474,33 @@ byte EXECodec::detectType(byte src[], int count, int& codeStart, int& codeEnd)
     uint histo[256] = { 0 };
 
     for (int i = codeStart; i < codeEnd; i++) {
+#if defined(__SSE2__)
+        if (i + 20 <= codeEnd) {
+            // Process the bytes preceding the next candidate x86 opcode:
+            // update the histogram and look for ARM jumps only
+            const int mask = x86Candidates(&src[i]);
+            const int n = (mask == 0) ? 16 : Global::trailingZeros(uint32(mask));
+
+            if (n != 0) {
+                const int end = i + n;
+
+                for (int j = i; j < end; j++)
+                    histo[int(src[j])]++;
+
+                // ARM jumps at the aligned positions in [i, end) (at most 4)
+                const int a = (i + 3) & -4;
+
+                if (a < end) {
+                    const int nbWords = (end - a + 3) >> 2;
+                    jumpsARM64 += popcount(uint(armJumps(&src[a]) & ((1 << nbWords) - 1)));
+                }
+
+                i = end - 1;
+                continue;
+            }
+        }
+#endif
+
         histo[int(src[i])]++;
 
         // X86
@@ -86,6 +86,12 @@ namespace kanzi
        bool inverseX86(SliceArray<byte>& source, SliceArray<byte>& destination, int length);
 
        static byte detectType(byte src[], int count, int& codeStart, int& codeEnd);
+
+#if defined(__SSE2__)
+       static int x86Candidates(const byte src[]);
+
+       static int armJumps(const byte src[]);
+#endif
        
        static bool parseHeader(const byte src[], int count, uint magic, int& arch, int& codeStart, int& codeEnd);
 
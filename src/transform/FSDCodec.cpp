@@ -91,6 +91,135 @@ const int8 FSDCodec::ZIGZAG2[256] = {
            124,  -125,   125,  -126,   126,   -127,  127,  -128,
 };
 
+#if defined(__SSSE3__)
+// Apply x[i] = x[i] op x[i - DIST] from the first byte to the last one (prefix
+// sum or xor with a stride of DIST bytes) in a 16 byte vector
+template <int DIST, bool XOR, bool DONE = (DIST >= 16)>
+struct StridePrefix {
+    static inline __m128i apply(__m128i x)
+    {
+        const __m128i y = _mm_slli_si128(x, DIST);
+        x = (XOR == true) ? _mm_xor_si128(x, y) : _mm_add_epi8(x, y);
+        return StridePrefix<2 * DIST, XOR>::apply(x);
+    }
+};
+
+template <int DIST, bool XOR>
+struct StridePrefix<DIST, XOR, true> {
+    static inline __m128i apply(__m128i x) { return x; }
+};
+#endif
+
+// Recover the original bytes from residuals with a distance of DIST bytes
+template <int DIST>
+static void inverseStride(const byte src[], byte dst[], int& srcIdx, int& dstIdx, int srcEnd, int dstEnd, bool isDelta, const int8 zigzag[], byte escape)
+{
+#if defined(__SSSE3__)
+    // Repeat the last DIST bytes over the vector
+    const __m128i pattern = _mm_setr_epi8(0 % DIST, 1 % DIST, 2 % DIST, 3 % DIST,
+        4 % DIST, 5 % DIST, 6 % DIST, 7 % DIST, 8 % DIST, 9 % DIST, 10 % DIST,
+        11 % DIST, 12 % DIST, 13 % DIST, 14 % DIST, 15 % DIST);
+    const __m128i esc = _mm_set1_epi8(char(escape));
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i mask7F = _mm_set1_epi8(0x7F);
+#endif
+
+    if (isDelta == true) {
+        while ((srcIdx < srcEnd) && (dstIdx < dstEnd)) {
+#if defined(__SSSE3__)
+            if ((srcIdx + 16 <= srcEnd) && (dstIdx + 16 <= dstEnd)) {
+                // Decode the residuals up to the first escape (16 max)
+                const __m128i z = _mm_loadu_si128((const __m128i*) &src[srcIdx]);
+                const int n = Global::trailingZeros(uint32(_mm_movemask_epi8(_mm_cmpeq_epi8(z, esc))) | 0x10000);
+
+                if (n != 0) {
+                    // Zigzag decoding: (z >> 1) ^ -(z & 1)
+                    const __m128i half = _mm_and_si128(_mm_srli_epi16(z, 1), mask7F);
+                    const __m128i neg = _mm_cmpeq_epi8(_mm_and_si128(z, one), one);
+                    const __m128i d = StridePrefix<DIST, false>::apply(_mm_xor_si128(half, neg));
+                    const __m128i prv = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) &dst[dstIdx - DIST]), pattern);
+                    _mm_storeu_si128((__m128i*) &dst[dstIdx], _mm_add_epi8(prv, d));
+                    srcIdx += n;
+                    dstIdx += n;
+                    continue;
+                }
+            }
+#endif
+
+            if (src[srcIdx] != escape) {
+                dst[dstIdx] = byte(int(dst[dstIdx - DIST]) + zigzag[int(src[srcIdx])]);
+                srcIdx++;
+                dstIdx++;
+                continue;
+            }
+
+            srcIdx++;
+
+            if (srcIdx == srcEnd)
+                break;
+
+            dst[dstIdx] = src[srcIdx] ^ dst[dstIdx - DIST];
+            srcIdx++;
+            dstIdx++;
+        }
+    }
+    else {
+#if defined(__SSSE3__)
+        while ((srcIdx + 16 <= srcEnd) && (dstIdx + 16 <= dstEnd)) {
+            const __m128i x = StridePrefix<DIST, true>::apply(_mm_loadu_si128((const __m128i*) &src[srcIdx]));
+            const __m128i prv = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) &dst[dstIdx - DIST]), pattern);
+            _mm_storeu_si128((__m128i*) &dst[dstIdx], _mm_xor_si128(prv, x));
+            srcIdx += 16;
+            dstIdx += 16;
+        }
+#endif
+
+        while (srcIdx < srcEnd) {
+            dst[dstIdx] = src[srcIdx] ^ dst[dstIdx - DIST];
+            srcIdx++;
+            dstIdx++;
+        }
+    }
+}
+
+// Update the histograms of the residuals (xor) for all the step values
+// in block[start..end-1]. The residuals are computed 16 bytes at a time.
+void FSDCodec::computeHistograms(const byte block[], int start, int end, uint histo[][256])
+{
+    int i = start;
+
+#if defined(__SSE2__)
+    uint8 res[7][16];
+
+    for (; i + 16 <= end; i += 16) {
+        const __m128i b = _mm_loadu_si128((const __m128i*) &block[i]);
+        _mm_storeu_si128((__m128i*) res[0], b);
+        _mm_storeu_si128((__m128i*) res[1], _mm_xor_si128(b, _mm_loadu_si128((const __m128i*) &block[i - 1])));
+        _mm_storeu_si128((__m128i*) res[2], _mm_xor_si128(b, _mm_loadu_si128((const __m128i*) &block[i - 2])));
+        _mm_storeu_si128((__m128i*) res[3], _mm_xor_si128(b, _mm_loadu_si128((const __m128i*) &block[i - 3])));
+        _mm_storeu_si128((__m128i*) res[4], _mm_xor_si128(b, _mm_loadu_si128((const __m128i*) &block[i - 4])));
+        _mm_storeu_si128((__m128i*) res[5], _mm_xor_si128(b, _mm_loadu_si128((const __m128i*) &block[i - 8])));
+        _mm_storeu_si128((__m128i*) res[6], _mm_xor_si128(b, _mm_loadu_si128((const __m128i*) &block[i - 16])));
+
+        for (int k = 0; k < 7; k++) {
+            for (int j = 0; j < 16; j++)
+                histo[k][res[k][j]]++;
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        const byte b = block[i];
+        histo[0][int(b)]++;
+        histo[1][int(b ^ block[i - 1])]++;
+        histo[2][int(b ^ block[i - 2])]++;
+        histo[3][int(b ^ block[i - 3])]++;
+        histo[4][int(b ^ block[i - 4])]++;
+        histo[5][int(b ^ block[i - 8])]++;
+        histo[6][int(b ^ block[i - 16])]++;
+    }
+}
+
 bool FSDCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 {
     if (count == 0)
@@ -144,36 +273,9 @@ bool FSDCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int co
     memset(&histo[0][0], 0, sizeof(histo));
 
     // Check several step values on a few sub-blocks (no memory allocation)
-    const byte* in0 = &src[count5 * 0];
-    const byte* in1 = &src[count5 * 2];
-    const byte* in2 = &src[count5 * 4];
-
-    for (int i = count10; i < count5; i++) {
-        const byte b0 = in0[i];
-        histo[0][int(b0)]++;
-        histo[1][int(b0 ^ in0[i - 1])]++;
-        histo[2][int(b0 ^ in0[i - 2])]++;
-        histo[3][int(b0 ^ in0[i - 3])]++;
-        histo[4][int(b0 ^ in0[i - 4])]++;
-        histo[5][int(b0 ^ in0[i - 8])]++;
-        histo[6][int(b0 ^ in0[i - 16])]++;       
-        const byte b1 = in1[i];
-        histo[0][int(b1)]++;
-        histo[1][int(b1 ^ in1[i - 1])]++;
-        histo[2][int(b1 ^ in1[i - 2])]++;
-        histo[3][int(b1 ^ in1[i - 3])]++;
-        histo[4][int(b1 ^ in1[i - 4])]++;
-        histo[5][int(b1 ^ in1[i - 8])]++;
-        histo[6][int(b1 ^ in1[i - 16])]++;
-        const byte b2 = in2[i];
-        histo[0][int(b2)]++;
-        histo[1][int(b2 ^ in2[i - 1])]++;
-        histo[2][int(b2 ^ in2[i - 2])]++;
-        histo[3][int(b2 ^ in2[i - 3])]++;
-        histo[4][int(b2 ^ in2[i - 4])]++;
-        histo[5][int(b2 ^ in2[i - 8])]++;
-        histo[6][int(b2 ^ in2[i - 16])]++;
-    }
+    computeHistograms(&src[count5 * 0], count10, count5, histo);
+    computeHistograms(&src[count5 * 2], count10, count5, histo);
+    computeHistograms(&src[count5 * 4], count10, count5, histo);
 
     // Find if entropy is lower post transform
     int minIdx = 0;
@@ -224,6 +326,27 @@ bool FSDCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int co
     // Emit modified bytes
     if (mode == DELTA_CODING) {
         while ((srcIdx < srcEnd) && (dstIdx < dstEnd - 1)) {
+#if defined(__SSE2__)
+            if ((srcIdx + 16 <= srcEnd) && (dstIdx + 16 < dstEnd)) {
+                // Zigzag encode the deltas in [-127..127] (16 max, stop at first escape)
+                const __m128i cur = _mm_loadu_si128((const __m128i*) &src[srcIdx]);
+                const __m128i prv = _mm_loadu_si128((const __m128i*) &src[srcIdx - dist]);
+                const __m128i pos = _mm_subs_epu8(cur, prv);
+                const __m128i neg = _mm_subs_epu8(prv, cur);
+                const __m128i abs = _mm_or_si128(pos, neg);
+                const int n = Global::trailingZeros(uint32(_mm_movemask_epi8(abs)) | 0x10000);
+
+                if (n != 0) {
+                    // 2 * |delta| - (delta < 0)
+                    const __m128i sign = _mm_andnot_si128(_mm_cmpeq_epi8(neg, _mm_setzero_si128()), _mm_set1_epi8(char(0xFF)));
+                    _mm_storeu_si128((__m128i*) &dst[dstIdx], _mm_add_epi8(_mm_add_epi8(abs, abs), sign));
+                    srcIdx += n;
+                    dstIdx += n;
+                    continue;
+                }
+            }
+#endif
+
             const int delta = 127 + int(src[srcIdx]) - int(src[srcIdx - dist]);
 
             if ((delta >= 0) && (delta < 255)) {
@@ -239,6 +362,16 @@ bool FSDCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int co
         }
     }
     else { // mode == XOR_CODING
+#if defined(__SSE2__)
+        while (srcIdx + 16 <= srcEnd) {
+            const __m128i cur = _mm_loadu_si128((const __m128i*) &src[srcIdx]);
+            const __m128i prv = _mm_loadu_si128((const __m128i*) &src[srcIdx - dist]);
+            _mm_storeu_si128((__m128i*) &dst[dstIdx], _mm_xor_si128(cur, prv));
+            srcIdx += 16;
+            dstIdx += 16;
+        }
+#endif
+
         while (srcIdx < srcEnd) {
             dst[dstIdx++] = src[srcIdx] ^ src[srcIdx - dist];
             srcIdx++;
@@ -304,31 +437,27 @@ bool FSDCodec::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int co
     int dstIdx = dist;
 
     // Recover original bytes
-    if (mode == DELTA_CODING) {
-        while ((srcIdx < srcEnd) && (dstIdx < dstEnd)) {
-            if (src[srcIdx] != ESCAPE_TOKEN) {
-                dst[dstIdx] = byte(int(dst[dstIdx - dist]) + ZIGZAG2[int(src[srcIdx])]);
-                srcIdx++;
-                dstIdx++;
-                continue;
-            }
-
-            srcIdx++;
-
-            if (srcIdx == srcEnd)
-                break;
+    const bool isDelta = mode == DELTA_CODING;
 
-            dst[dstIdx] = src[srcIdx] ^ dst[dstIdx - dist];
-            srcIdx++;
-            dstIdx++;
-        }
-    }
-    else { // mode == XOR_CODING
-        while (srcIdx < srcEnd) {
-            dst[dstIdx] = src[srcIdx] ^ dst[dstIdx - dist];
-            srcIdx++;
-            dstIdx++;
-        }
+    switch (dist) {
+       case 1:
+           inverseStride<1>(src, dst, srcIdx, dstIdx, srcEnd, dstEnd, isDelta, ZIGZAG2, ESCAPE_TOKEN);
+           break;
+       case 2:
+           inverseStride<2>(src, dst, srcIdx, dstIdx, srcEnd, dstEnd, isDelta, ZIGZAG2, ESCAPE_TOKEN);
+           break;
+       case 3:
+           inverseStride<3>(src, dst, srcIdx, dstIdx, srcEnd, dstEnd, isDelta, ZIGZAG2, ESCAPE_TOKEN);
+           break;
+       case 4:
+           inverseStride<4>(src, dst, srcIdx, dstIdx, srcEnd, dstEnd, isDelta, ZIGZAG2, ESCAPE_TOKEN);
+           break;
+       case 8:
+           inverseStride<8>(src, dst, srcIdx, dstIdx, srcEnd, dstEnd, isDelta, ZIGZAG2, ESCAPE_TOKEN);
+           break;
+       default:
+           inverseStride<16>(src, dst, srcIdx, dstIdx, srcEnd, dstEnd, isDelta, ZIGZAG2, ESCAPE_TOKEN);
+           break;
     }
 
     input._index += srcIdx;
@@ -52,6 +52,8 @@ namespace kanzi {
        static const uint8 ZIGZAG1[256];
        static const int8 ZIGZAG2[256];
 
+       static void computeHistograms(const byte block[], int start, int end, uint histo[][256]);
+
        Context* _pCtx;
    };
 }
@@ -84,21 +84,33 @@ bool LZXCodec<T>::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
 
     if (_hashSize == 0) {
         _hashSize = (T == true) ? 1 << HASH_LOG2 : 1 << HASH_LOG1;
-        delete[] _hashes;
-        _hashes = new int32[_hashSize];
+        deallocate(_allocator, _hashes);
+        _hashes = allocate<int32>(_allocator, _hashSize, MemoryUsage::TRANSFORM);
+        memset(_hashes, 0, sizeof(int32) * _hashSize);
+        _base = 0;
     }
+    else if (_base > 0x7FFFFFFF - count) {
+        memset(_hashes, 0, sizeof(int32) * _hashSize);
+        _base = 0;
+    }
+
+    // A reused instance does not clear the table between blocks: positions
+    // are stored with an offset (base) that grows with each block. Entries
+    // from previous blocks yield negative positions which are rejected like
+    // empty slots.
+    const int base = _base;
+    _base += count;
 
     if (_bufferSize < max(count / 5, 256)) {
         _bufferSize = max(count / 5, 256);
-        delete[] _mLenBuf;
-        _mLenBuf = new byte[_bufferSize];
-        delete[] _mBuf;
-        _mBuf = new byte[_bufferSize];
-        delete[] _tkBuf;
-        _tkBuf = new byte[_bufferSize];
+        deallocate(_allocator, _mLenBuf);
+        _mLenBuf = allocate<byte>(_allocator, _bufferSize, MemoryUsage::TRANSFORM);
+        deallocate(_allocator, _mBuf);
+        _mBuf = allocate<byte>(_allocator, _bufferSize, MemoryUsage::TRANSFORM);
+        deallocate(_allocator, _tkBuf);
+        _tkBuf = allocate<byte>(_allocator, _bufferSize, MemoryUsage::TRANSFORM);
     }
 
-    memset(_hashes, 0, sizeof(int32) * _hashSize);
     const int srcEnd = count - 16 - 1;
     const byte* src = &input._array[input._index];
     byte* dst = &output._array[output._index];
@@ -119,6 +131,20 @@ bool LZXCodec<T>::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
         }
     }
 
+    if (_searchDepth > 1) {
+        // The hash chain only needs to cover the match window
+        const int window = min(count, maxDist + 2);
+        const int chainSize = 1 << (Global::log2(uint32(window - 1)) + 1);
+
+        if (_chainSize < chainSize) {
+            _chainSize = chainSize;
+            deallocate(_allocator, _chain);
+            _chain = allocate<int32>(_allocator, _chainSize, MemoryUsage::TRANSFORM);
+        }
+
+        _insertIdx = 0;
+    }
+
     const int minMatch = mm;
     const int dThreshold = (maxDist == MAX_DISTANCE1) ? 1 << 8 : 1 << 16;
     int srcIdx = 0;
@@ -151,13 +177,19 @@ bool LZXCodec<T>::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
         }
 
         if (bestLen < minMatch) {
-            // Check match at position in hash table
-            const int32 h0 = hash(&src[srcIdx]);
-            ref = _hashes[h0];
-            _hashes[h0] = srcIdx;
+            if (_searchDepth > 1) {
+                // Check the candidates in the hash chain
+                bestLen = findChainMatch(src, srcIdx, minRef, min(srcEnd - srcIdx, MAX_MATCH), base, ref);
+            }
+            else {
+                // Check match at position in hash table
+                const int32 h0 = hash(&src[srcIdx]);
+                ref = _hashes[h0] - base;
+                _hashes[h0] = srcIdx + base;
 
-            if ((ref > minRef) && (memcmp(&src[srcIdx], &src[ref], 4) == 0)) {
-                bestLen = findMatch(src, srcIdx, ref, min(srcEnd - srcIdx, MAX_MATCH));
+                if ((ref > minRef) && (memcmp(&src[srcIdx], &src[ref], 4) == 0)) {
+                    bestLen = findMatch(src, srcIdx, ref, min(srcEnd - srcIdx, MAX_MATCH));
+                }
             }
 
             // No good match ?
@@ -169,11 +201,37 @@ bool LZXCodec<T>::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
                 continue;
             }
 
-            if ((ref != srcIdx - repd[0]) && (ref != srcIdx - repd[1])) {
+            if ((_searchDepth > 1) && (ref != srcIdx - repd[0]) && (ref != srcIdx - repd[1])) {
+                // Lazy matching: move forward while the next position yields a
+                // longer match (up to 2 positions for deep searches)
+                const int steps = (_searchDepth >= LAZY2_SEARCH_DEPTH) ? 2 : 1;
+
+                for (int i = 0; (i < steps) && (srcIdx + 1 < srcEnd); i++) {
+                    const int srcIdx1 = srcIdx + 1;
+                    int ref1 = 0;
+                    const int bestLen1 = findChainMatch(src, srcIdx1, max(srcIdx1 - maxDist, 0),
+                        min(srcEnd - srcIdx1, MAX_MATCH), base, ref1);
+
+                    if (bestLen1 <= bestLen)
+                        break;
+
+                    if ((bestLen1 < MAX_MATCH) && (ref1 - 1 > minRef) && (src[srcIdx] == src[ref1 - 1])) {
+                        // Extend the new match backward (no extra literal)
+                        ref = ref1 - 1;
+                        bestLen = bestLen1 + 1;
+                        break;
+                    }
+
+                    ref = ref1;
+                    bestLen = bestLen1;
+                    srcIdx++;
+                }
+            }
+            else if ((ref != srcIdx - repd[0]) && (ref != srcIdx - repd[1])) {
                 // Check if better match at next position
                 const int32 h1 = hash(&src[srcIdx1]);
-                const int ref1 = _hashes[h1];
-                _hashes[h1] = srcIdx1;
+                const int ref1 = _hashes[h1] - base;
+                _hashes[h1] = srcIdx1 + base;
 
                 if ((ref1 > minRef + 1) && (memcmp(&src[srcIdx1 + bestLen - 3], &src[ref1 + bestLen - 3], 4) == 0)) {
                     const int bestLen1 = findMatch(src, srcIdx1, ref1, min(srcEnd - srcIdx1, MAX_MATCH));
@@ -194,13 +252,11 @@ bool LZXCodec<T>::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
             }
         }
         else {
-            const int32 h0 = hash(&src[srcIdx]);
-            _hashes[h0] = srcIdx;
+            insert(src, srcIdx, base);
 
             if ((bestLen >= MAX_MATCH) || (src[srcIdx] != src[ref - 1])) {
                 srcIdx++;
-                const int32 h1 = hash(&src[srcIdx]);
-                _hashes[h1] = srcIdx;
+                insert(src, srcIdx, base);
             }
             else {
                 bestLen++;
@@ -290,15 +346,15 @@ bool LZXCodec<T>::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
 
         if (mIdx >= _bufferSize - 8) {
             // Expand match buffer
-            byte* mBuf = new byte[(_bufferSize * 3) / 2];
+            byte* mBuf = allocate<byte>(_allocator, (_bufferSize * 3) / 2, MemoryUsage::TRANSFORM);
             memcpy(&mBuf[0], &_mBuf[0], _bufferSize);
-            delete[] _mBuf;
+            deallocate(_allocator, _mBuf);
             _mBuf = mBuf;
 
             if (mLenIdx >= _bufferSize - 8) {
-                byte* mLenBuf = new byte[(_bufferSize * 3) / 2];
+                byte* mLenBuf = allocate<byte>(_allocator, (_bufferSize * 3) / 2, MemoryUsage::TRANSFORM);
                 memcpy(&mLenBuf[0], &_mLenBuf[0], _bufferSize);
-                delete[] _mLenBuf;
+                deallocate(_allocator, _mLenBuf);
                 _mLenBuf = mLenBuf;
             }
 
@@ -309,10 +365,8 @@ bool LZXCodec<T>::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
         anchor = srcIdx + bestLen;
         prefetchRead(&src[anchor + 64]);
 
-        while (++srcIdx < anchor) {
-            const int32 h = hash(&src[srcIdx]);
-            _hashes[h] = srcIdx;
-        }
+        while (++srcIdx < anchor)
+            insert(src, srcIdx, base);
 
     }
 
@@ -348,6 +402,55 @@ bool LZXCodec<T>::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
     return true;
 }
 
+// Check up to _searchDepth previous positions with the same hash (closest
+// first) and return the length of the longest match (ref is updated).
+// The current position is registered in the hash chain.
+template <bool T>
+int LZXCodec<T>::findChainMatch(const byte src[], int srcIdx, int minRef, int maxMatch, int base, int& ref)
+{
+    const int mask = _chainSize - 1;
+    int cand;
+
+    if (srcIdx >= _insertIdx) {
+        const int32 h = hash(&src[srcIdx]);
+        cand = _hashes[h] - base;
+        _chain[srcIdx & mask] = _hashes[h];
+        _hashes[h] = srcIdx + base;
+        _insertIdx = srcIdx + 1;
+    }
+    else {
+        // Already registered: start from the previous position
+        cand = _chain[srcIdx & mask] - base;
+    }
+
+    int bestLen = 0;
+
+    for (int n = _searchDepth; (n > 0) && (cand > minRef); n--) {
+        // A candidate must at least match the byte following the best match
+        if ((src[cand + bestLen] == src[srcIdx + bestLen]) && (memcmp(&src[srcIdx], &src[cand], 4) == 0)) {
+            const int len = findMatch(src, srcIdx, cand, maxMatch);
+
+            if (len > bestLen) {
+                bestLen = len;
+                ref = cand;
+
+                if (len + 4 > maxMatch)
+                    break;
+            }
+        }
+
+        const int next = _chain[cand & mask] - base;
+
+        // Positions decrease along a chain (else stale entry)
+        if (next >= cand)
+            break;
+
+        cand = next;
+    }
+
+    return bestLen;
+}
+
 template <bool T>
 bool LZXCodec<T>::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 {
@@ -364,6 +467,7 @@ bool LZXCodec<T>::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int
         throw invalid_argument("LZ codec: Invalid output block");
 
     const int dstEnd = output._length;
+    const int dstCap = output._length - output._index;
     byte* dst = &output._array[output._index];
     byte* src = &input._array[input._index];
 
@@ -450,23 +554,11 @@ bool LZXCodec<T>::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int
         prefetchRead(&src[mLenIdx]);
 
         // Copy match
-        if (dist >= 16) {
-            do {
-                // No overlap
-                memcpy(&dst[dstIdx], &dst[ref], 16);
-                ref += 16;
-                dstIdx += 16;
-            } while (dstIdx < mEnd);
-        }
-        else if (dist >= 4) {
-            do {
-                // No overlap
-                memcpy(&dst[dstIdx], &dst[ref], 4);
-                ref += 4;
-                dstIdx += 4;
-            } while (dstIdx < mEnd);
+        if (mEnd + MATCH_COPY_SLACK <= dstCap) {
+            copyMatch(&dst[dstIdx], dist, mLen);
         }
         else {
+            // Close to the end of the buffer: exact copy
             for (int i = 0; i < mLen; i++)
                 dst[dstIdx + i] = dst[ref + i];
         }
@@ -508,8 +600,8 @@ bool LZPCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int co
 
     if (_hashSize == 0) {
         _hashSize = 1 << HASH_LOG;
-        delete[] _hashes;
-        _hashes = new int32[_hashSize];
+        deallocate(_allocator, _hashes);
+        _hashes = allocate<int32>(_allocator, _hashSize, MemoryUsage::TRANSFORM);
     }
 
     memset(_hashes, 0, sizeof(int32) * _hashSize);
@@ -594,13 +686,14 @@ bool LZPCodec::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int co
         return false;
 
     const int srcEnd = count;
+    const int dstCap = output._length - output._index;
     const byte* src = &input._array[input._index];
     byte* dst = &output._array[output._index];
 
     if (_hashSize == 0) {
         _hashSize = 1 << HASH_LOG;
-        delete[] _hashes;
-        _hashes = new int32[_hashSize];
+        deallocate(_allocator, _hashes);
+        _hashes = allocate<int32>(_allocator, _hashSize, MemoryUsage::TRANSFORM);
     }
 
     memset(_hashes, 0, sizeof(int32) * _hashSize);
@@ -645,15 +738,11 @@ bool LZPCodec::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int co
         mLen += int(src[srcIdx++]);
         const int mEnd = dstIdx + mLen;
 
-        if (dstIdx >= ref + 8) {
-            do {
-                // No overlap
-                memcpy(&dst[dstIdx], &dst[ref], 8);
-                ref += 8;
-                dstIdx += 8;
-            } while (dstIdx < mEnd);
+        if (mEnd + MATCH_COPY_SLACK <= dstCap) {
+            copyMatch(&dst[dstIdx], dstIdx - ref, mLen);
         }
         else {
+            // Close to the end of the buffer: exact copy
             for (int i = 0; i < mLen; i++)
                 dst[dstIdx + i] = dst[ref + i];
         }
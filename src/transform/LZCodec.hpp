@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef _LZCodec_
 #define _LZCodec_
 
+#include "../Allocator.hpp"
 #include "../Context.hpp"
 #include "../Global.hpp"
 #include "../Transform.hpp"
@@ -53,34 +54,50 @@ namespace kanzi {
     public:
         LZXCodec()
         {
-            _hashes = new int32[0];
+            _allocator = &Allocator::getDefault();
+            _hashes = allocate<int32>(_allocator, 0, MemoryUsage::TRANSFORM);
             _hashSize = 0;
-            _tkBuf = new byte[0];
-            _mLenBuf = new byte[0];
-            _mBuf = new byte[0];
+            _base = 0;
+            _tkBuf = allocate<byte>(_allocator, 0, MemoryUsage::TRANSFORM);
+            _mLenBuf = allocate<byte>(_allocator, 0, MemoryUsage::TRANSFORM);
+            _mBuf = allocate<byte>(_allocator, 0, MemoryUsage::TRANSFORM);
             _bufferSize = 0;
+            _chain = allocate<int32>(_allocator, 0, MemoryUsage::TRANSFORM);
+            _chainSize = 0;
+            _searchDepth = 1;
+            _insertIdx = 0;
             _pCtx = nullptr;
         }
 
         LZXCodec(Context& ctx) :
             _pCtx(&ctx)
         {
-            _hashes = new int32[0];
+            _allocator = &Allocator::getAllocator(ctx);
+            _hashes = allocate<int32>(_allocator, 0, MemoryUsage::TRANSFORM);
             _hashSize = 0;
-            _tkBuf = new byte[0];
-            _mLenBuf = new byte[0];
-            _mBuf = new byte[0];
+            _base = 0;
+            _tkBuf = allocate<byte>(_allocator, 0, MemoryUsage::TRANSFORM);
+            _mLenBuf = allocate<byte>(_allocator, 0, MemoryUsage::TRANSFORM);
+            _mBuf = allocate<byte>(_allocator, 0, MemoryUsage::TRANSFORM);
             _bufferSize = 0;
+            _chain = allocate<int32>(_allocator, 0, MemoryUsage::TRANSFORM);
+            _chainSize = 0;
+            _insertIdx = 0;
+
+            // Number of candidates checked by the match finder (encoder only)
+            const int depth = ctx.getInt("lzSearchDepth", 1);
+            _searchDepth = (depth < 1) ? 1 : ((depth > MAX_SEARCH_DEPTH) ? MAX_SEARCH_DEPTH : depth);
         }
 
         ~LZXCodec()
         {
             _bufferSize = 0;
             _hashSize = 0;
-            delete[] _hashes;
-            delete[] _mLenBuf;
-            delete[] _mBuf;
-            delete[] _tkBuf;
+            deallocate(_allocator, _hashes);
+            deallocate(_allocator, _mLenBuf);
+            deallocate(_allocator, _mBuf);
+            deallocate(_allocator, _tkBuf);
+            deallocate(_allocator, _chain);
         }
 
         bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
@@ -107,14 +124,22 @@ namespace kanzi {
         static const int MIN_MATCH9 = 9;
         static const int MAX_MATCH = 65535 + 254 + 15 + MIN_MATCH4;
         static const int MIN_BLOCK_LENGTH = 24;
+        static const int MAX_SEARCH_DEPTH = 4096;
+        static const int LAZY2_SEARCH_DEPTH = 16; // from this depth, look 2 positions ahead
 
-        int32* _hashes;
+        int32* _hashes; // positions + _base
         int _hashSize;
+        int _base; // positions of previous blocks are below _base (stale)
         byte* _mLenBuf;
         byte* _mBuf;
         byte* _tkBuf;
         int _bufferSize;
+        int32* _chain; // previous position with same hash (+ _base), indexed by position & (_chainSize - 1)
+        int _chainSize;
+        int _searchDepth; // 1 means single slot hash table (no chain)
+        int _insertIdx; // next position to register in the hash chain
         Context* _pCtx;
+        Allocator* _allocator; // hash tables and match buffers
 
         static int emitLength(byte block[], int len);
 
@@ -125,25 +150,31 @@ namespace kanzi {
         static int readLength(const byte block[], int& pos);
 
         static int32 hash(const byte* p);
+
+        void insert(const byte src[], int srcIdx, int base);
+
+        int findChainMatch(const byte src[], int srcIdx, int minRef, int maxMatch, int base, int& ref);
     };
 
     class LZPCodec FINAL : public Transform<byte> {
     public:
         LZPCodec()
         {
-            _hashes = new int32[0];
+            _allocator = &Allocator::getDefault();
+            _hashes = allocate<int32>(_allocator, 0, MemoryUsage::TRANSFORM);
             _hashSize = 0;
         }
 
-        LZPCodec(Context&)
+        LZPCodec(Context& ctx)
         {
-            _hashes = new int32[0];
+            _allocator = &Allocator::getAllocator(ctx);
+            _hashes = allocate<int32>(_allocator, 0, MemoryUsage::TRANSFORM);
             _hashSize = 0;
         }
 
         ~LZPCodec()
         {
-            delete[] _hashes;
+            deallocate(_allocator, _hashes);
         }
 
         bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
@@ -166,6 +197,7 @@ namespace kanzi {
 
         int32* _hashes;
         int _hashSize;
+        Allocator* _allocator;
 
         static int findMatch(const byte block[], const int pos, const int ref, const int maxMatch);
     };
@@ -184,6 +216,25 @@ namespace kanzi {
             ((LittleEndian::readLong64(p) * HASH_SEED) >> HASH_SHIFT1) & HASH_MASK1;
     }
 
+    // Register the position in the hash table (and the hash chain if enabled)
+    template <bool T>
+    inline void LZXCodec<T>::insert(const byte src[], int srcIdx, int base)
+    {
+        if (_searchDepth > 1) {
+            // Positions may be visited twice (lazy matching): register each one once
+            if (srcIdx < _insertIdx)
+                return;
+
+            const int32 h = hash(&src[srcIdx]);
+            _chain[srcIdx & (_chainSize - 1)] = _hashes[h];
+            _hashes[h] = srcIdx + base;
+            _insertIdx = srcIdx + 1;
+            return;
+        }
+
+        _hashes[hash(&src[srcIdx])] = srcIdx + base;
+    }
+
     template <bool T>
     inline int LZXCodec<T>::emitLength(byte block[], int length)
     {
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "RLT.hpp"
 #include "../Global.hpp"
+#include "../Memory.hpp"
 
 
 using namespace kanzi;
@@ -108,29 +109,33 @@ bool RLT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 
     // Main loop
     while (true) {
-        if (prev == src[srcIdx]) {
-            const uint32 v = 0x01010101 * uint32(prev);
-
-            if (memcmp(&v, &src[srcIdx], 4) == 0) {
-                srcIdx += 4; run += 4;
-
-                if ((run < MAX_RUN4) && (srcIdx < srcEnd4))
-                    continue;
+#if defined(__SSE2__)
+        if ((run == 1) && (srcIdx + 16 < srcEnd4) && (dstIdx + 16 < dstEnd)) {
+            // Fast path: emit the pending literal ('prev') and the following
+            // bytes up to the first escape or start of run in one store
+            const __m128i x = _mm_loadu_si128((const __m128i*) &src[srcIdx - 1]);
+            const __m128i y = _mm_loadu_si128((const __m128i*) &src[srcIdx]);
+            const __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(x, y), _mm_cmpeq_epi8(x, _mm_set1_epi8(char(escape))));
+            const int n = Global::trailingZeros(uint32(_mm_movemask_epi8(stop)) | 0x10000); // leading literals
+
+            if (n != 0) {
+                _mm_storeu_si128((__m128i*) &dst[dstIdx], x);
+                dstIdx += n;
+                srcIdx += n;
+                prev = src[srcIdx - 1];
+                continue;
             }
-            else if (prev == src[srcIdx]) {
-                srcIdx++; run++;
-
-                if (prev == src[srcIdx]) {
-                    srcIdx++; run++;
-
-                    if (prev == src[srcIdx]) {
-                        srcIdx++; run++;
+        }
+#endif
 
-                        if ((run < MAX_RUN4) && (srcIdx < srcEnd4))
-                            continue;
-                    }
-                }
-            }
+        if (prev == src[srcIdx]) {
+            // Extend the run. The run is split as if scanned by steps of 4
+            // bytes, checking the limits (run length, end of block) after
+            // each step.
+            const int maxRun = ((min(MAX_RUN4 - run, srcEnd4 - srcIdx) + 3) >> 2) << 2;
+            const int n = countRun(&src[srcIdx], maxRun, prev);
+            srcIdx += n;
+            run += n;
         }
 
         if (run > RUN_THRESHOLD) {
@@ -273,6 +278,19 @@ bool RLT::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     // Main loop
     while (srcIdx < srcEnd) {
         if (src[srcIdx] != escape) {
+#if defined(__SSE2__)
+            if ((srcIdx + 16 <= srcEnd) && (dstIdx + 16 <= dstEnd)) {
+                // Copy the literals up to the next escape (16 max)
+                const __m128i x = _mm_loadu_si128((const __m128i*) &src[srcIdx]);
+                const uint32 m = uint32(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(char(escape)))));
+                _mm_storeu_si128((__m128i*) &dst[dstIdx], x);
+                const int n = Global::trailingZeros(m | 0x10000);
+                srcIdx += n;
+                dstIdx += n;
+                continue;
+            }
+#endif
+
             // Literal
             if (dstIdx >= dstEnd) {
                 res = false;
@@ -20,11 +20,15 @@ limitations under the License.
 #include "ROLZCodec.hpp"
 #include "../Global.hpp"
 #include "../Memory.hpp"
-#include "../bitstream/DefaultInputBitStream.hpp"
-#include "../bitstream/DefaultOutputBitStream.hpp"
+#include "../bitstream/MemoryInputBitStream.hpp"
+#include "../bitstream/MemoryOutputBitStream.hpp"
 #include "../entropy/ANSRangeDecoder.hpp"
 #include "../entropy/ANSRangeEncoder.hpp"
 
+#ifdef CONCURRENCY_ENABLED
+#include <future>
+#endif
+
 using namespace kanzi;
 using namespace std;
 
@@ -83,9 +87,80 @@ bool ROLZCodec::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int c
     return _delegate->inverse(input, output, count);
 }
 
+template <class T, class C>
+ROLZTask<T, C>::ROLZTask(const C& parent, vector<ROLZChunk>& chunks, int firstChunk, int lastChunk, bool forward)
+    : _codec(parent)
+    , _chunks(chunks)
+    , _firstChunk(firstChunk)
+    , _lastChunk(lastChunk)
+    , _forward(forward)
+    , _memScope(MemoryTracker::getBlockScope())
+{
+}
+
+template <class T, class C>
+T ROLZTask<T, C>::run()
+{
+    MemoryTracker::TaskScope memScope(_memScope); // may run in another thread
+
+    try {
+        for (int i = _firstChunk; i < _lastChunk; i++) {
+            const bool res = (_forward == true) ? _codec.encodeChunk(_chunks[i]) : _codec.decodeChunk(_chunks[i]);
+
+            if (res == false)
+                return T(1);
+        }
+    }
+    catch (exception&) {
+        return T(1);
+    }
+
+    return T(0);
+}
+
+#ifdef CONCURRENCY_ENABLED
+// Encode or decode the chunks with several concurrent tasks. Each task
+// processes a range of consecutive chunks.
+template <class C>
+static bool runChunkTasks(const C& parent, vector<ROLZChunk>& chunks, bool forward, int nbTasks, ThreadPool* pool)
+{
+    const int MAX_CONCURRENCY = 64;
+    int chunksPerTask[MAX_CONCURRENCY];
+    nbTasks = min(nbTasks, MAX_CONCURRENCY);
+    Global::computeJobsPerTask(chunksPerTask, int(chunks.size()), nbTasks);
+    vector<ROLZTask<int, C>*> tasks;
+    vector<future<int> > futures;
+
+    for (int i = 0, c = 0; i < nbTasks; i++) {
+        ROLZTask<int, C>* task = new ROLZTask<int, C>(parent, chunks, c, c + chunksPerTask[i], forward);
+        tasks.push_back(task);
+
+        if (pool == nullptr)
+            futures.push_back(async(launch::async, &ROLZTask<int, C>::run, task));
+        else
+            futures.push_back(pool->schedule(&ROLZTask<int, C>::run, task));
+
+        c += chunksPerTask[i];
+    }
+
+    int res = 0;
+
+    // Wait for completion of all concurrent tasks
+    for (int i = 0; i < nbTasks; i++)
+        res |= futures[i].get();
+
+    for (int i = 0; i < nbTasks; i++)
+        delete tasks[i];
+
+    return res == 0;
+}
+#endif
+
+
 ROLZCodec1::ROLZCodec1(uint logPosChecks) :
     _logPosChecks(logPosChecks)
 {
+    _allocator = &Allocator::getDefault();
     if ((logPosChecks < 2) || (logPosChecks > 8)) {
         stringstream ss;
         ss << "ROLZ codec: Invalid logPosChecks parameter: " << logPosChecks << " (must be in [2..8])";
@@ -96,19 +171,63 @@ ROLZCodec1::ROLZCodec1(uint logPosChecks) :
     _posChecks = 1 << _logPosChecks;
     _maskChecks = uint8(_posChecks - 1);
     _minMatch = MIN_MATCH3;
-    _matches = new int32[ROLZCodec::HASH_SIZE << _logPosChecks];
+    _delta = 2;
+    _litOrder = 0;
+    _matches = allocate<int32>(_allocator, ROLZCodec::HASH_SIZE << _logPosChecks, MemoryUsage::TRANSFORM);
     memset(&_counters[0], 0, sizeof(_counters));
+    memset(&_keyGens[0], 0, sizeof(_keyGens));
+    _gen = 0;
+    _bsVersion = ROLZCodec::CHUNK_SIZES_VERSION;
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
 }
 
+// The number of jobs available to process the block is provided by the context.
+// Chunks may be encoded and decoded concurrently if several jobs are available.
 ROLZCodec1::ROLZCodec1(Context& ctx) :
     _pCtx(&ctx)
 {
+    _allocator = &Allocator::getAllocator(ctx);
     _logPosChecks = LOG_POS_CHECKS;
     _posChecks = 1 << _logPosChecks;
     _maskChecks = uint8(_posChecks - 1);
     _minMatch = MIN_MATCH3;
-    _matches = new int32[ROLZCodec::HASH_SIZE << _logPosChecks];
+    _delta = 2;
+    _litOrder = 0;
+    _matches = allocate<int32>(_allocator, ROLZCodec::HASH_SIZE << _logPosChecks, MemoryUsage::TRANSFORM);
+    memset(&_counters[0], 0, sizeof(_counters));
+    memset(&_keyGens[0], 0, sizeof(_keyGens));
+    _gen = 0;
+    _bsVersion = ctx.getInt("bsVersion", ROLZCodec::CHUNK_SIZES_VERSION);
+    _jobs = ctx.getInt("jobs", 1);
+#ifdef CONCURRENCY_ENABLED
+    _pool = ctx.getPool(); // can be null
+#else
+    _jobs = 1;
+#endif
+}
+
+ROLZCodec1::ROLZCodec1(const ROLZCodec1& parent) :
+    _logPosChecks(parent._logPosChecks)
+{
+    _allocator = parent._allocator;
+    _pCtx = nullptr;
+    _posChecks = 1 << _logPosChecks;
+    _maskChecks = uint8(_posChecks - 1);
+    _minMatch = parent._minMatch;
+    _delta = parent._delta;
+    _litOrder = parent._litOrder;
+    _matches = allocate<int32>(_allocator, ROLZCodec::HASH_SIZE << _logPosChecks, MemoryUsage::TRANSFORM);
     memset(&_counters[0], 0, sizeof(_counters));
+    memset(&_keyGens[0], 0, sizeof(_keyGens));
+    _gen = 0;
+    _bsVersion = parent._bsVersion;
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
 }
 
 
@@ -167,24 +286,14 @@ bool ROLZCodec1::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
         return false;
 
     const int srcEnd = count - 4;
-    const byte* src = &input._array[input._index];
+    byte* src = &input._array[input._index];
     byte* dst = &output._array[output._index];
+    const int dstEnd = output._length - output._index;
     BigEndian::writeInt32(&dst[0], count);
-    int dstIdx = 5;
-    int sizeChunk = min(count, ROLZCodec::CHUNK_SIZE);
-    int startChunk = 0;
-    SliceArray<byte> litBuf(new byte[getMaxEncodedLength(sizeChunk)], getMaxEncodedLength(sizeChunk));
-    SliceArray<byte> lenBuf(new byte[sizeChunk / 5], sizeChunk / 5);
-    SliceArray<byte> mIdxBuf(new byte[sizeChunk / 4], sizeChunk / 4);
-    SliceArray<byte> tkBuf(new byte[sizeChunk / 4], sizeChunk / 4);
-    memset(&_counters[0], 0, sizeof(_counters));
-    bool success = true;
-    const int litOrder = (count < (1 << 17)) ? 0 : 1;
-    int flags = litOrder;
-    stringbuf buffer;
-    iostream ios(&buffer);
+    _litOrder = (count < (1 << 17)) ? 0 : 1;
+    int flags = _litOrder;
     _minMatch = MIN_MATCH3;
-    int delta = 2;
+    _delta = 2;
 
     if (_pCtx != nullptr) {
         Global::DataType dt = (Global::DataType) _pCtx->getInt("dataType", Global::UNDEFINED);
@@ -199,14 +308,14 @@ bool ROLZCodec1::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
         }
 
         if (dt == Global::EXE) {
-            delta = 3;
+            _delta = 3;
             flags |= 8;
         } else if (dt == Global::DNA) {
-            delta = 8;
+            _delta = 8;
             _minMatch = MIN_MATCH7;
             flags |= 4;
         } else if (dt == Global::MULTIMEDIA) {
-            delta = 8;
+            _delta = 8;
             _minMatch = MIN_MATCH4;
             flags |= 2;
         }
@@ -214,120 +323,201 @@ bool ROLZCodec1::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
 
     flags |= (_logPosChecks << 4);
     dst[4] = byte(flags);
-    const int mm = _minMatch;
-    const int dt = delta;
-	
-    // Main loop
-    while (startChunk < srcEnd) {
-        litBuf._index = 0;
-        lenBuf._index = 0;
-        mIdxBuf._index = 0;
-        tkBuf._index = 0;
-
-        memset(&_matches[0], 0, sizeof(int32) * size_t(ROLZCodec::HASH_SIZE << _logPosChecks));
-        const int endChunk = min(startChunk + sizeChunk, srcEnd);
-        sizeChunk = endChunk - startChunk;
-        const byte* buf = &src[startChunk];
-        int srcIdx = 0;
-        const int n = min(srcEnd - startChunk, 8);
+    int dstIdx = 5;
 
-        for (int j = 0; j < n; j++)
-            litBuf._array[litBuf._index++] = buf[srcIdx++];
+    // Each chunk is emitted after its compressed size (except in older streams)
+    const int hdr = (_bsVersion >= ROLZCodec::CHUNK_SIZES_VERSION) ? 4 : 0;
+    const int nbChunks = (srcEnd + ROLZCodec::CHUNK_SIZE - 1) / ROLZCodec::CHUNK_SIZE;
+    const int nbTasks = min(_jobs, nbChunks);
+    vector<ROLZChunk> chunks(nbChunks);
+
+    for (int i = 0; i < nbChunks; i++) {
+        const int startChunk = i * ROLZCodec::CHUNK_SIZE;
+        chunks[i]._data = &src[startChunk];
+        chunks[i]._size = min(srcEnd - startChunk, ROLZCodec::CHUNK_SIZE);
+        chunks[i]._capacity = 0;
+        chunks[i]._last = i == nbChunks - 1;
+    }
 
-        int firstLitIdx = srcIdx;
-        int srcInc = 0;
+    if (nbTasks <= 1) {
+        // Encode the chunks directly to the output
+        for (int i = 0; i < nbChunks; i++) {
+            if (dstIdx + hdr > dstEnd)
+                return false;
 
-        while (srcIdx < sizeChunk) {
-            const uint32 key = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&buf[srcIdx - dt]): ROLZCodec::getKey2(&buf[srcIdx - dt]);
-            uint8* counter = &_counters[key];
-            int32* matches = &_matches[key << _logPosChecks];
-            int32 hash32 = ROLZCodec::hash(&buf[srcIdx]);
-            int match = findMatch(buf, srcIdx, sizeChunk, hash32, matches, counter);
+            chunks[i]._buf = &dst[dstIdx + hdr];
+            chunks[i]._bufSize = dstEnd - dstIdx - hdr;
 
-            // Register current position
-            *counter = (*counter + 1) & _maskChecks;
-            matches[*counter] = hash32 | int32(srcIdx);
+            if (encodeChunk(chunks[i]) == false)
+                return false;
 
-            if (match < 0) {
-                srcIdx++;
-                srcIdx += (srcInc >> 6);
-                srcInc++;
-                continue;
-            }
+            if (hdr != 0)
+                BigEndian::writeInt32(&dst[dstIdx], chunks[i]._encodedSize);
 
-            {
-                // Check if better match at next position
-                const uint32 key2 = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&buf[srcIdx + 1 - dt]) : ROLZCodec::getKey2(&buf[srcIdx + 1 - dt]);
-                counter = &_counters[key2];
-                matches = &_matches[key2 << _logPosChecks];
-                hash32 = ROLZCodec::hash(&buf[srcIdx + 1]);
-                int match2 = findMatch(buf, srcIdx + 1, sizeChunk, hash32, matches, counter);
+            dstIdx += (hdr + chunks[i]._encodedSize);
+        }
+    }
+    else {
+#ifdef CONCURRENCY_ENABLED
+        // Encode the chunks concurrently to private buffers, then copy them
+        // in order. The output does not depend on the number of jobs.
+        for (int i = 0; i < nbChunks; i++) {
+            chunks[i]._bufSize = chunks[i]._size + 1024;
+            chunks[i]._buf = allocate<byte>(_allocator, chunks[i]._bufSize, MemoryUsage::TRANSFORM);
+        }
 
-                if ((match2 >= 0) && ((match2 & 0xFFFF) > (match & 0xFFFF))) {
-                    // New match is better
-                    match = match2;
-                    srcIdx++;
+        bool res = runChunkTasks(*this, chunks, true, nbTasks, _pool);
 
-                    // Register current position
-                    *counter = (*counter + 1) & _maskChecks;
-                    matches[*counter] = hash32 | int32(srcIdx);
-                }
-            }
-            
-            // mode LLLLLMMM -> L lit length, M match length
-            const int litLen = srcIdx - firstLitIdx;
-            const int mode = (litLen < 31) ? (litLen << 3) : 0xF8;
-            const int mLen = match & 0xFFFF;
-
-            if (mLen >= 7) {
-                tkBuf._array[tkBuf._index++] = byte(mode | 0x07);
-                lenBuf._index += emitLength(&lenBuf._array[lenBuf._index], mLen - 7);
+        for (int i = 0; i < nbChunks; i++) {
+            if ((res == true) && (dstIdx + hdr + chunks[i]._encodedSize <= dstEnd)) {
+                if (hdr != 0)
+                    BigEndian::writeInt32(&dst[dstIdx], chunks[i]._encodedSize);
+
+                memcpy(&dst[dstIdx + hdr], chunks[i]._buf, chunks[i]._encodedSize);
+                dstIdx += (hdr + chunks[i]._encodedSize);
             }
             else {
-                tkBuf._array[tkBuf._index++] = byte(mode | mLen);
+                res = false;
             }
 
-            // Emit literals
-            if (litLen > 0) {
-                if (litLen >= 31)
-                    lenBuf._index += emitLength(&lenBuf._array[lenBuf._index], litLen - 31);
+            deallocate(_allocator, chunks[i]._buf);
+        }
 
-                memcpy(&litBuf._array[litBuf._index], &buf[firstLitIdx], litLen);
-                litBuf._index += litLen;
-            }
+        if (res == false)
+            return false;
+#endif
+    }
+
+    if (dstIdx + 4 > dstEnd)
+        return false;
+
+    // Emit last literals
+    memcpy(&dst[dstIdx], &src[srcEnd], 4);
+    dstIdx += 4;
+    input._index += count;
+    output._index += dstIdx;
+    return dstIdx < count;
+}
+
+
+// Encode the chunk to chunk._buf. Return false if the buffer is too small.
+bool ROLZCodec1::encodeChunk(ROLZChunk& chunk)
+{
+    const byte* buf = chunk._data;
+    const int sizeChunk = chunk._size;
+    const int mm = _minMatch;
+    const int dt = _delta;
+    const int tkSize = sizeChunk / 3 + 16;
+    const int lenSize = sizeChunk / 5 + 16;
+    SliceArray<byte> litBuf(allocate<byte>(_allocator, getMaxEncodedLength(sizeChunk), MemoryUsage::TRANSFORM), getMaxEncodedLength(sizeChunk));
+    SliceArray<byte> lenBuf(allocate<byte>(_allocator, lenSize, MemoryUsage::TRANSFORM), lenSize);
+    SliceArray<byte> mIdxBuf(allocate<byte>(_allocator, tkSize, MemoryUsage::TRANSFORM), tkSize);
+    SliceArray<byte> tkBuf(allocate<byte>(_allocator, tkSize, MemoryUsage::TRANSFORM), tkSize);
+    bool success = true;
+    nextChunk();
+    int srcIdx = 0;
+    const int n = min(sizeChunk, 8);
+
+    for (int j = 0; j < n; j++)
+        litBuf._array[litBuf._index++] = buf[srcIdx++];
+
+    int firstLitIdx = srcIdx;
+    int srcInc = 0;
+
+    while (srcIdx < sizeChunk) {
+        const uint32 key = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&buf[srcIdx - dt]): ROLZCodec::getKey2(&buf[srcIdx - dt]);
+        int32* matches = getMatches(key);
+        uint8* counter = &_counters[key];
+        int32 hash32 = ROLZCodec::hash(&buf[srcIdx]);
+        int match = findMatch(buf, srcIdx, sizeChunk, hash32, matches, counter);
+
+        // Register current position
+        *counter = (*counter + 1) & _maskChecks;
+        matches[*counter] = hash32 | int32(srcIdx);
+
+        if (match < 0) {
+            srcIdx++;
+            srcIdx += (srcInc >> 6);
+            srcInc++;
+            continue;
+        }
+
+        {
+            // Check if better match at next position
+            const uint32 key2 = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&buf[srcIdx + 1 - dt]) : ROLZCodec::getKey2(&buf[srcIdx + 1 - dt]);
+            matches = getMatches(key2);
+            counter = &_counters[key2];
+            hash32 = ROLZCodec::hash(&buf[srcIdx + 1]);
+            int match2 = findMatch(buf, srcIdx + 1, sizeChunk, hash32, matches, counter);
+
+            if ((match2 >= 0) && ((match2 & 0xFFFF) > (match & 0xFFFF))) {
+                // New match is better
+                match = match2;
+                srcIdx++;
 
-            // Emit match index
-            mIdxBuf._array[mIdxBuf._index++] = byte(match >> 16);
-            srcIdx += (mLen + _minMatch);
-            firstLitIdx = srcIdx;
-            srcInc = 0;
+                // Register current position
+                *counter = (*counter + 1) & _maskChecks;
+                matches[*counter] = hash32 | int32(srcIdx);
+            }
         }
 
-        // Emit last chunk literals
-        srcIdx = sizeChunk;
+        // mode LLLLLMMM -> L lit length, M match length
         const int litLen = srcIdx - firstLitIdx;
+        const int mode = (litLen < 31) ? (litLen << 3) : 0xF8;
+        const int mLen = match & 0xFFFF;
+
+        if (mLen >= 7) {
+            tkBuf._array[tkBuf._index++] = byte(mode | 0x07);
+            lenBuf._index += emitLength(&lenBuf._array[lenBuf._index], mLen - 7);
+        }
+        else {
+            tkBuf._array[tkBuf._index++] = byte(mode | mLen);
+        }
+
+        // Emit literals
+        if (litLen > 0) {
+            if (litLen >= 31)
+                lenBuf._index += emitLength(&lenBuf._array[lenBuf._index], litLen - 31);
 
-        if (tkBuf._index != 0) {
-           // At least one match to emit
-           const int mode = (litLen < 31) ? (litLen << 3) : 0xF8;
-           tkBuf._array[tkBuf._index++] = byte(mode);
+            memcpy(&litBuf._array[litBuf._index], &buf[firstLitIdx], litLen);
+            litBuf._index += litLen;
         }
 
-        if (litLen >= 31)
-            lenBuf._index += emitLength(&lenBuf._array[lenBuf._index], litLen - 31);
+        // Emit match index
+        mIdxBuf._array[mIdxBuf._index++] = byte(match >> 16);
+        srcIdx += (mLen + mm);
+        firstLitIdx = srcIdx;
+        srcInc = 0;
+    }
 
-        memcpy(&litBuf._array[litBuf._index], &buf[firstLitIdx], litLen);
-        litBuf._index += litLen;
+    // Emit last chunk literals
+    srcIdx = sizeChunk;
+    const int litLen = srcIdx - firstLitIdx;
 
-        // Scope to deallocate resources early
-        {
-            // Encode literal, match length and match index buffers
-            DefaultOutputBitStream obs(ios, 65536);
+    if (tkBuf._index != 0) {
+       // At least one match to emit
+       const int mode = (litLen < 31) ? (litLen << 3) : 0xF8;
+       tkBuf._array[tkBuf._index++] = byte(mode);
+    }
+
+    if (litLen >= 31)
+        lenBuf._index += emitLength(&lenBuf._array[lenBuf._index], litLen - 31);
+
+    memcpy(&litBuf._array[litBuf._index], &buf[firstLitIdx], litLen);
+    litBuf._index += litLen;
+
+    // Scope to deallocate resources early
+    {
+        // Encode literal, match length and match index buffers
+        SliceArray<byte> sa(chunk._buf, chunk._bufSize, 0);
+
+        try {
+            MemoryOutputBitStream obs(sa);
             obs.writeBits(litBuf._index, 32);
             obs.writeBits(tkBuf._index, 32);
             obs.writeBits(lenBuf._index, 32);
             obs.writeBits(mIdxBuf._index, 32);
-            ANSRangeEncoder litEnc(obs, litOrder);
+            ANSRangeEncoder litEnc(obs, _litOrder);
             litEnc.encode(litBuf._array, 0, litBuf._index);
             litEnc.dispose();
             ANSRangeEncoder mEnc(obs, 0, 32768);
@@ -335,233 +525,273 @@ bool ROLZCodec1::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
             mEnc.encode(lenBuf._array, 0, lenBuf._index);
             mEnc.encode(mIdxBuf._array, 0, mIdxBuf._index);
             mEnc.dispose();
+            obs.close();
         }
-
-        // Copy bitstream array to output
-        const int bufSize = int(ios.tellp());
-
-        if (dstIdx + bufSize > output._length) {
-            input._index = startChunk + srcIdx;
+        catch (BitStreamException&) {
+            // Output buffer full
             success = false;
-            goto End;
         }
 
-        buffer.pubseekpos(0);
-        ios.read(reinterpret_cast<char*>(&dst[dstIdx]), bufSize);
-        dstIdx += bufSize;
-        startChunk = endChunk;
+        chunk._encodedSize = sa._index;
     }
 
-End:
-    if (success == true) {
-        if (dstIdx + 4 > output._length) {
-            input._index = srcEnd;
-        }
-        else {
-            // Emit last literals
-            memcpy(&dst[dstIdx], &src[srcEnd], 4);
-            dstIdx += 4;
-            input._index = srcEnd + 4;
-        }
-    }
-
-    output._index += dstIdx;
-    delete[] litBuf._array;
-    delete[] lenBuf._array;
-    delete[] mIdxBuf._array;
-    delete[] tkBuf._array;
-    return (input._index == count) && (output._index < count);
+    deallocate(_allocator, litBuf._array);
+    deallocate(_allocator, lenBuf._array);
+    deallocate(_allocator, mIdxBuf._array);
+    deallocate(_allocator, tkBuf._array);
+    return success;
 }
 
 
 bool ROLZCodec1::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 {
+    if (count < 9)
+        return false;
+
     byte* src = &input._array[input._index];
     byte* dst = &output._array[output._index];
     const int dstEnd = BigEndian::readInt32(&src[0]) - 4;
 
-    if ((dstEnd <= 0) || (dstEnd > output._length - output._index))
+    if ((dstEnd <= 0) || (dstEnd > output._length - output._index - 4))
         return false;
 
-    int srcIdx = 5;
-    int sizeChunk = min(dstEnd, ROLZCodec::CHUNK_SIZE);
-    int startChunk = 0;
     const int flags = int(src[4]);
-    const int litOrder = flags & 1;
-    _logPosChecks = flags >> 4;
+    const int logPosChecks = flags >> 4;
+
+    if (logPosChecks != _logPosChecks) {
+        if ((logPosChecks < 2) || (logPosChecks > 8))
+            return false;
+
+        _logPosChecks = logPosChecks;
+        _posChecks = 1 << _logPosChecks;
+        _maskChecks = uint8(_posChecks - 1);
+        deallocate(_allocator, _matches);
+        _matches = allocate<int32>(_allocator, ROLZCodec::HASH_SIZE << _logPosChecks, MemoryUsage::TRANSFORM);
+    }
+
+    _litOrder = flags & 1;
     _minMatch = MIN_MATCH3;
-    int delta = 2;
-	
+    _delta = 2;
+
     if ((flags & 0x0E) == 2) {
         _minMatch = MIN_MATCH4;
-        delta = 8;
+        _delta = 8;
     } else if ((flags & 0x0E) == 4) {
         _minMatch = MIN_MATCH7;
-        delta = 8;
+        _delta = 8;
     } else if ((flags & 0x0E) == 8) {
-        delta = 3;
+        _delta = 3;
     }
 
-    const int mm = _minMatch;
-    const int dt = delta;
-    SliceArray<byte> litBuf(new byte[sizeChunk], sizeChunk);
-    SliceArray<byte> lenBuf(new byte[sizeChunk / 5], sizeChunk / 5);
-    SliceArray<byte> mIdxBuf(new byte[sizeChunk / 4], sizeChunk / 4);
-    SliceArray<byte> tkBuf(new byte[sizeChunk / 4], sizeChunk / 4);
-    memset(&_counters[0], 0, sizeof(_counters));
-    bool success = true;
+    const int nbChunks = (dstEnd + ROLZCodec::CHUNK_SIZE - 1) / ROLZCodec::CHUNK_SIZE;
+    vector<ROLZChunk> chunks(nbChunks);
+    int srcIdx = 5;
 
-    // Main loop
-    while (startChunk < dstEnd) {
-        litBuf._index = 0;
-        lenBuf._index = 0;
-        mIdxBuf._index = 0;
-        tkBuf._index = 0;
-        memset(&_matches[0], 0, sizeof(int32) * size_t(ROLZCodec::HASH_SIZE << _logPosChecks));
-        const int endChunk = min(startChunk + sizeChunk, dstEnd);
-        sizeChunk = endChunk - startChunk;
-        bool onlyLiterals = false;
-
-        // Scope to deallocate resources early
-        {
-            // Decode literal, length and match index buffers
-            istreambuf<char> buffer(reinterpret_cast<char*>(&src[srcIdx]), min(count - srcIdx, sizeChunk + 16));
-            istream is(&buffer);
-            DefaultInputBitStream ibs(is, 65536);
-            const int litLen = int(ibs.readBits(32));
-            const int tkLen = int(ibs.readBits(32));
-            const int mLenLen = int(ibs.readBits(32));
-            const int mIdxLen = int(ibs.readBits(32));
-
-            if ((litLen < 0) || (tkLen < 0) || (mLenLen < 0) || (mIdxLen < 0)) {
-                input._index += srcIdx;
-                output._index += startChunk;
-                success = false;
-                goto End;
-            }
+    for (int i = 0; i < nbChunks; i++) {
+        const int startChunk = i * ROLZCodec::CHUNK_SIZE;
+        chunks[i]._data = &dst[startChunk];
+        chunks[i]._size = min(dstEnd - startChunk, ROLZCodec::CHUNK_SIZE);
+        chunks[i]._last = i == nbChunks - 1;
 
-            if ((litLen > sizeChunk) || (tkLen > sizeChunk) || (mLenLen > sizeChunk) || (mIdxLen > sizeChunk)) {
-                input._index += srcIdx;
-                output._index += startChunk;
-                success = false;
-                goto End;
+        // Do not let fast copies spill into the next chunk (may be decoded concurrently)
+        chunks[i]._capacity = (chunks[i]._last == true) ? output._length - output._index - startChunk : chunks[i]._size;
+    }
+
+    if (_bsVersion < ROLZCodec::CHUNK_SIZES_VERSION) {
+        // Older streams: the location of a chunk is only known once the
+        // previous chunk has been decoded
+        for (int i = 0; i < nbChunks; i++) {
+            chunks[i]._buf = &src[srcIdx];
+            chunks[i]._bufSize = count - srcIdx;
+
+            if (decodeChunk(chunks[i]) == false)
+                return false;
+
+            srcIdx += chunks[i]._encodedSize;
+        }
+    }
+    else {
+        // Locate the chunks
+        for (int i = 0; i < nbChunks; i++) {
+            if (srcIdx + 4 > count)
+                return false;
+
+            const int size = BigEndian::readInt32(&src[srcIdx]);
+            srcIdx += 4;
+
+            if ((size <= 0) || (size > count - srcIdx))
+                return false;
+
+            chunks[i]._buf = &src[srcIdx];
+            chunks[i]._bufSize = size;
+            srcIdx += size;
+        }
+
+        const int nbTasks = min(_jobs, nbChunks);
+
+        if (nbTasks <= 1) {
+            for (int i = 0; i < nbChunks; i++) {
+                if (decodeChunk(chunks[i]) == false)
+                    return false;
             }
+        }
+        else {
+#ifdef CONCURRENCY_ENABLED
+            if (runChunkTasks(*this, chunks, false, nbTasks, _pool) == false)
+                return false;
+#endif
+        }
+    }
+
+    if (srcIdx + 4 > count)
+        return false;
 
-            ANSRangeDecoder litDec(ibs, litOrder);
-            litDec.decode(litBuf._array, 0, litLen);
-            litDec.dispose();
-            ANSRangeDecoder mDec(ibs, 0, 32768);
-            mDec.decode(tkBuf._array, 0, tkLen);
-            mDec.decode(lenBuf._array, 0, mLenLen);
-            mDec.decode(mIdxBuf._array, 0, mIdxLen);
-            mDec.dispose();
+    // Emit last literals
+    memcpy(&dst[dstEnd], &src[srcIdx], 4);
+    srcIdx += 4;
+    input._index += srcIdx;
+    output._index += (dstEnd + 4);
+    return srcIdx == count;
+}
 
-            onlyLiterals = tkLen == 0;
-            srcIdx += int((ibs.read() + 7) >> 3);
+
+// Decode chunk._size bytes to chunk._data. Return false if the data is invalid.
+bool ROLZCodec1::decodeChunk(ROLZChunk& chunk)
+{
+    byte* buf = chunk._data;
+    const int sizeChunk = chunk._size;
+    const int mm = _minMatch;
+    const int dt = _delta;
+    const int tkSize = sizeChunk / 3 + 16;
+    const int lenSize = sizeChunk / 5 + 16;
+    SliceArray<byte> litBuf(allocate<byte>(_allocator, sizeChunk, MemoryUsage::TRANSFORM), sizeChunk);
+    SliceArray<byte> lenBuf(allocate<byte>(_allocator, lenSize, MemoryUsage::TRANSFORM), lenSize);
+    SliceArray<byte> mIdxBuf(allocate<byte>(_allocator, tkSize, MemoryUsage::TRANSFORM), tkSize);
+    SliceArray<byte> tkBuf(allocate<byte>(_allocator, tkSize, MemoryUsage::TRANSFORM), tkSize);
+    bool success = true;
+    bool onlyLiterals = false;
+    int dstIdx = 0;
+    nextChunk();
+
+    // Scope to deallocate resources early
+    {
+        // Decode literal, length and match index buffers
+        SliceArray<byte> sa(chunk._buf, chunk._bufSize, 0);
+        MemoryInputBitStream ibs(sa, chunk._bufSize);
+        const int litLen = int(ibs.readBits(32));
+        const int tkLen = int(ibs.readBits(32));
+        const int mLenLen = int(ibs.readBits(32));
+        const int mIdxLen = int(ibs.readBits(32));
+
+        if ((litLen < 0) || (tkLen < 0) || (mLenLen < 0) || (mIdxLen < 0)) {
+            success = false;
+            goto End;
         }
 
-        if (onlyLiterals == true) {
-            // Shortcut when no match
-            memcpy(&output._array[output._index], &litBuf._array[0], sizeChunk);
-            startChunk = endChunk;
-            output._index += sizeChunk;
-            continue;
+        if ((litLen > sizeChunk) || (tkLen > tkSize) || (mLenLen > lenSize) || (mIdxLen > tkSize)) {
+            success = false;
+            goto End;
         }
 
-        byte* buf = &output._array[output._index];
-        int dstIdx = 0;
-        const int n = min(dstEnd - output._index, 8);
+        ANSRangeDecoder litDec(ibs, _litOrder);
+        litDec.decode(litBuf._array, 0, litLen);
+        litDec.dispose();
+        ANSRangeDecoder mDec(ibs, 0, 32768);
+        mDec.decode(tkBuf._array, 0, tkLen);
+        mDec.decode(lenBuf._array, 0, mLenLen);
+        mDec.decode(mIdxBuf._array, 0, mIdxLen);
+        mDec.dispose();
+
+        onlyLiterals = tkLen == 0;
+        chunk._encodedSize = int((ibs.read() + 7) >> 3);
+    }
+
+    if (onlyLiterals == true) {
+        // Shortcut when no match
+        memcpy(&buf[0], &litBuf._array[0], sizeChunk);
+        goto End;
+    }
+
+    {
+        const int n = min(sizeChunk, 8);
 
         for (int j = 0; j < n; j++)
             buf[dstIdx++] = litBuf._array[litBuf._index++];
+    }
 
-        // Next chunk
-        while (dstIdx < sizeChunk) {
-            // mode LLLLLMMM -> L lit length, M match length
-            const int mode = int(tkBuf._array[tkBuf._index++]);
-            int matchLen = mode & 0x07;
-
-            if (matchLen == 7)
-                matchLen += readLength(lenBuf._array, lenBuf._index);
-
-            // Emit literals
-            const int litLen = (mode < 0xF8) ? mode >> 3 : readLength(lenBuf._array, lenBuf._index) + 31;
-
-            if (litLen > 0) {
-                memcpy(&buf[dstIdx], &litBuf._array[litBuf._index], litLen);
-                int srcInc = 0;
-
-                if (mm == MIN_MATCH3) {
-                     for (int k = 0; k < litLen; k++) {
-                        const uint32 key = ROLZCodec::getKey1(&buf[dstIdx + k - dt]);
-                        uint8* counter = &_counters[key];
-                        int32* matches = &_matches[key << _logPosChecks];
-                        *counter = (*counter + 1) & _maskChecks;
-                        matches[*counter] = dstIdx + k;
-                        k += (srcInc >> 6);
-                        srcInc++;
-                    }
-                } else {
-                     for (int k = 0; k < litLen; k++) {
-                        const uint32 key = ROLZCodec::getKey2(&buf[dstIdx + k - dt]);
-                        uint8* counter = &_counters[key];
-                        int32* matches = &_matches[key << _logPosChecks];
-                        *counter = (*counter + 1) & _maskChecks;
-                        matches[*counter] = dstIdx + k;
-                        k += (srcInc >> 6);
-                        srcInc++;
-                    }
-                }
-
-                litBuf._index += litLen;
-                dstIdx += litLen;
-                prefetchRead(&litBuf._array[litBuf._index]);
+    while (dstIdx < sizeChunk) {
+        // mode LLLLLMMM -> L lit length, M match length
+        const int mode = int(tkBuf._array[tkBuf._index++]);
+        int matchLen = mode & 0x07;
 
-                if (dstIdx >= sizeChunk) {
-                    // Last chunk literals not followed by match
-                    if (dstIdx == sizeChunk)
-                        break;
+        if (matchLen == 7)
+            matchLen += readLength(lenBuf._array, lenBuf._index);
 
-                    output._index += dstIdx;
-                    success = false;
-                    goto End;
-                }
-            }
+        // Emit literals
+        const int litLen = (mode < 0xF8) ? mode >> 3 : readLength(lenBuf._array, lenBuf._index) + 31;
 
+        if (litLen > 0) {
             // Sanity check
-            if (output._index + dstIdx + matchLen + _minMatch > dstEnd) {
+            if (dstIdx + litLen > sizeChunk) {
                 success = false;
                 goto End;
             }
 
-            const uint8 matchIdx = uint8(mIdxBuf._array[mIdxBuf._index++]);
-            const uint32 key = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&buf[dstIdx - dt]) : ROLZCodec::getKey2(&buf[dstIdx - dt]);
-            int32* matches = &_matches[key << _logPosChecks];
-            const int32 ref = matches[(_counters[key] - matchIdx) & _maskChecks];
-            _counters[key] = (_counters[key] + 1) & _maskChecks;
-            matches[_counters[key]] = dstIdx;
-            dstIdx = ROLZCodec::emitCopy(buf, dstIdx, ref, matchLen + _minMatch);
+            memcpy(&buf[dstIdx], &litBuf._array[litBuf._index], litLen);
+            int srcInc = 0;
+
+            if (mm == MIN_MATCH3) {
+                 for (int k = 0; k < litLen; k++) {
+                    const uint32 key = ROLZCodec::getKey1(&buf[dstIdx + k - dt]);
+                    int32* matches = getMatches(key);
+                    uint8* counter = &_counters[key];
+                    *counter = (*counter + 1) & _maskChecks;
+                    matches[*counter] = dstIdx + k;
+                    k += (srcInc >> 6);
+                    srcInc++;
+                }
+            } else {
+                 for (int k = 0; k < litLen; k++) {
+                    const uint32 key = ROLZCodec::getKey2(&buf[dstIdx + k - dt]);
+                    int32* matches = getMatches(key);
+                    uint8* counter = &_counters[key];
+                    *counter = (*counter + 1) & _maskChecks;
+                    matches[*counter] = dstIdx + k;
+                    k += (srcInc >> 6);
+                    srcInc++;
+                }
+            }
+
+            litBuf._index += litLen;
+            dstIdx += litLen;
+            prefetchRead(&litBuf._array[litBuf._index]);
+
+            // Last chunk literals not followed by match
+            if (dstIdx == sizeChunk)
+                break;
         }
 
-        startChunk = endChunk;
-        output._index += dstIdx;
-    }
+        // Sanity check
+        if (dstIdx + matchLen + mm > sizeChunk) {
+            success = false;
+            goto End;
+        }
 
-End:
-    if (success == true) {
-        // Emit last chunk literals
-        dst[output._index++] = src[srcIdx++];
-        dst[output._index++] = src[srcIdx++];
-        dst[output._index++] = src[srcIdx++];
-        dst[output._index++] = src[srcIdx++];
+        const uint8 matchIdx = uint8(mIdxBuf._array[mIdxBuf._index++]);
+        const uint32 key = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&buf[dstIdx - dt]) : ROLZCodec::getKey2(&buf[dstIdx - dt]);
+        int32* matches = getMatches(key);
+        const int32 ref = matches[(_counters[key] - matchIdx) & _maskChecks];
+        _counters[key] = (_counters[key] + 1) & _maskChecks;
+        matches[_counters[key]] = dstIdx;
+        dstIdx = ROLZCodec::emitCopy(buf, dstIdx, ref, matchLen + mm, chunk._capacity);
     }
 
-    input._index += srcIdx;
-    delete[] litBuf._array;
-    delete[] lenBuf._array;
-    delete[] mIdxBuf._array;
-    delete[] tkBuf._array;
-    return srcIdx == count;
+End:
+    deallocate(_allocator, litBuf._array);
+    deallocate(_allocator, lenBuf._array);
+    deallocate(_allocator, mIdxBuf._array);
+    deallocate(_allocator, tkBuf._array);
+    return success;
 }
 
 ROLZEncoder::ROLZEncoder(uint litLogSize, uint mLogSize, byte buf[], int& idx)
@@ -575,8 +805,8 @@ ROLZEncoder::ROLZEncoder(uint litLogSize, uint mLogSize, byte buf[], int& idx)
     _buf = buf;
     _logSizes[MATCH_FLAG] = mLogSize;
     _logSizes[LITERAL_FLAG] = litLogSize;
-    _probs[MATCH_FLAG] = new uint16[256 << mLogSize];
-    _probs[LITERAL_FLAG] = new uint16[256 << litLogSize];
+    _probs[MATCH_FLAG] = allocate<uint16>(256 << mLogSize, MemoryUsage::TRANSFORM);
+    _probs[LITERAL_FLAG] = allocate<uint16>(256 << litLogSize, MemoryUsage::TRANSFORM);
     reset();
 }
 
@@ -643,8 +873,8 @@ ROLZDecoder::ROLZDecoder(uint litLogSize, uint mLogSize, byte buf[], int& idx)
     _idx += 8;
     _logSizes[MATCH_FLAG] = mLogSize;
     _logSizes[LITERAL_FLAG] = litLogSize;
-    _probs[MATCH_FLAG] = new uint16[256 << mLogSize];
-    _probs[LITERAL_FLAG] = new uint16[256 << litLogSize];
+    _probs[MATCH_FLAG] = allocate<uint16>(256 << mLogSize, MemoryUsage::TRANSFORM);
+    _probs[LITERAL_FLAG] = allocate<uint16>(256 << litLogSize, MemoryUsage::TRANSFORM);
     reset();
 }
 
@@ -692,6 +922,7 @@ int ROLZDecoder::decode9Bits()
 ROLZCodec2::ROLZCodec2(uint logPosChecks) :
     _logPosChecks(logPosChecks)
 {
+    _allocator = &Allocator::getDefault();
     if ((logPosChecks < 2) || (logPosChecks > 8)) {
         stringstream ss;
         ss << "ROLZX codec: Invalid logPosChecks parameter: " << logPosChecks << " (must be in [2..8])";
@@ -702,26 +933,67 @@ ROLZCodec2::ROLZCodec2(uint logPosChecks) :
     _posChecks = 1 << _logPosChecks;
     _maskChecks = uint8(_posChecks - 1);
     _minMatch = MIN_MATCH3;
-    _matches = new int32[ROLZCodec::HASH_SIZE << _logPosChecks];
+    _delta = 2;
+    _matches = allocate<int32>(_allocator, ROLZCodec::HASH_SIZE << _logPosChecks, MemoryUsage::TRANSFORM);
     memset(&_counters[0], 0, sizeof(_counters));
+    memset(&_keyGens[0], 0, sizeof(_keyGens));
+    _gen = 0;
+    _bsVersion = ROLZCodec::CHUNK_SIZES_VERSION;
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
 }
 
+// The number of jobs available to process the block is provided by the context.
+// Chunks may be encoded and decoded concurrently if several jobs are available.
 ROLZCodec2::ROLZCodec2(Context& ctx) :
     _pCtx(&ctx)
 {
+    _allocator = &Allocator::getAllocator(ctx);
     _logPosChecks = LOG_POS_CHECKS;
     _posChecks = 1 << _logPosChecks;
     _maskChecks = uint8(_posChecks - 1);
     _minMatch = MIN_MATCH3;
-    _matches = new int32[ROLZCodec::HASH_SIZE << _logPosChecks];
+    _delta = 2;
+    _matches = allocate<int32>(_allocator, ROLZCodec::HASH_SIZE << _logPosChecks, MemoryUsage::TRANSFORM);
     memset(&_counters[0], 0, sizeof(_counters));
+    memset(&_keyGens[0], 0, sizeof(_keyGens));
+    _gen = 0;
+    _bsVersion = ctx.getInt("bsVersion", ROLZCodec::CHUNK_SIZES_VERSION);
+    _jobs = ctx.getInt("jobs", 1);
+#ifdef CONCURRENCY_ENABLED
+    _pool = ctx.getPool(); // can be null
+#else
+    _jobs = 1;
+#endif
+}
+
+ROLZCodec2::ROLZCodec2(const ROLZCodec2& parent) :
+    _logPosChecks(parent._logPosChecks)
+{
+    _allocator = parent._allocator;
+    _pCtx = nullptr;
+    _posChecks = 1 << _logPosChecks;
+    _maskChecks = uint8(_posChecks - 1);
+    _minMatch = parent._minMatch;
+    _delta = parent._delta;
+    _matches = allocate<int32>(_allocator, ROLZCodec::HASH_SIZE << _logPosChecks, MemoryUsage::TRANSFORM);
+    memset(&_counters[0], 0, sizeof(_counters));
+    memset(&_keyGens[0], 0, sizeof(_keyGens));
+    _gen = 0;
+    _bsVersion = parent._bsVersion;
+    _jobs = 1;
+#ifdef CONCURRENCY_ENABLED
+    _pool = nullptr;
+#endif
 }
 
 // return position index (_logPosChecks bits) + length (16 bits) or -1
 int ROLZCodec2::findMatch(const byte buf[], int pos, int end, uint32 key)
 {
+    int32* matches = getMatches(key);
     const int counter = _counters[key];
-    int32* matches = &_matches[key << _logPosChecks];
     prefetchRead(matches);
     const byte* curBuf = &buf[pos];
     const int32 hash32 = ROLZCodec::hash(curBuf);
@@ -778,10 +1050,11 @@ bool ROLZCodec2::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
     const int srcEnd = count - 4;
     byte* src = &input._array[input._index];
     byte* dst = &output._array[output._index];
+    const int dstEnd = output._length - output._index;
     BigEndian::writeInt32(&dst[0], count);
     _minMatch = MIN_MATCH3;
+    _delta = 2;
     int flags = 0;
-    int delta = 2;
 
     if (_pCtx != nullptr) {
         Global::DataType dt = (Global::DataType) _pCtx->getInt("dataType", Global::UNDEFINED);
@@ -796,78 +1069,154 @@ bool ROLZCodec2::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
         }
 
         if (dt == Global::EXE) {
-            delta = 3;
+            _delta = 3;
             flags |= 8;
         } else if (dt == Global::DNA) {
-            delta = 8;
+            _delta = 8;
             _minMatch = MIN_MATCH7;
             flags |= 4;
         }
     }
-	
-    const int mm = _minMatch;
-    const int dt = delta;
+
     dst[4] = byte(flags);
-    int srcIdx = 0;
     int dstIdx = 5;
-    int sizeChunk = min(count, ROLZCodec::CHUNK_SIZE);
-    int startChunk = 0;
-    ROLZEncoder re(9, _logPosChecks, &dst[0], dstIdx);
-    memset(&_counters[0], 0, sizeof(_counters));
 
-    while (startChunk < srcEnd) {
-        memset(&_matches[0], 0, sizeof(int32) * size_t(ROLZCodec::HASH_SIZE << _logPosChecks));
-        const int endChunk = min(startChunk + sizeChunk, srcEnd);
-        sizeChunk = endChunk - startChunk;
-        re.reset();
-        src = &input._array[startChunk];
-        srcIdx = 0;
+    // Each chunk is encoded with its own range coder and emitted after
+    // its compressed size
+    const int nbChunks = (srcEnd + ROLZCodec::CHUNK_SIZE - 1) / ROLZCodec::CHUNK_SIZE;
+    const int nbTasks = min(_jobs, nbChunks);
+    vector<ROLZChunk> chunks(nbChunks);
+
+    for (int i = 0; i < nbChunks; i++) {
+        const int startChunk = i * ROLZCodec::CHUNK_SIZE;
+        chunks[i]._data = &src[startChunk];
+        chunks[i]._size = min(srcEnd - startChunk, ROLZCodec::CHUNK_SIZE);
+        chunks[i]._capacity = 0;
+        chunks[i]._last = i == nbChunks - 1;
+    }
 
-        // First literals
-        const int n = min(srcEnd - startChunk, 8);
-        re.setContext(LITERAL_CTX, byte(0));
+    if (_bsVersion < ROLZCodec::CHUNK_SIZES_VERSION) {
+        // Older streams: one range coder for all the chunks
+        ROLZEncoder re(9, _logPosChecks, &dst[0], dstIdx);
 
-        for (int j = 0; j < n; j++) {
-            re.encode9Bits((LITERAL_FLAG << 8) | int(src[srcIdx]));
-            srcIdx++;
+        for (int i = 0; i < nbChunks; i++)
+            encodeChunk(re, chunks[i]);
+
+        re.dispose();
+    }
+    else if (nbTasks <= 1) {
+        // Encode the chunks directly to the output
+        for (int i = 0; i < nbChunks; i++) {
+            chunks[i]._buf = &dst[dstIdx + 4];
+            chunks[i]._bufSize = dstEnd - dstIdx - 4;
+
+            if (encodeChunk(chunks[i]) == false)
+                return false;
+
+            BigEndian::writeInt32(&dst[dstIdx], chunks[i]._encodedSize);
+            dstIdx += (4 + chunks[i]._encodedSize);
+        }
+    }
+    else {
+#ifdef CONCURRENCY_ENABLED
+        // Encode the chunks concurrently to private buffers, then copy them
+        // in order. The output does not depend on the number of jobs.
+        for (int i = 0; i < nbChunks; i++) {
+            chunks[i]._bufSize = getMaxEncodedLength(chunks[i]._size + 4);
+            chunks[i]._buf = allocate<byte>(_allocator, chunks[i]._bufSize, MemoryUsage::TRANSFORM);
         }
 
-        while (srcIdx < sizeChunk) {
-            re.setContext(LITERAL_CTX, src[srcIdx - 1]);
-            uint32 key = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&src[srcIdx - dt]) : ROLZCodec::getKey2(&src[srcIdx - dt]);
-            const int match = findMatch(src, srcIdx, sizeChunk, key);
+        bool res = runChunkTasks(*this, chunks, true, nbTasks, _pool);
 
-            if (match < 0) {
-                // Emit one literal
-                re.encode9Bits((LITERAL_FLAG << 8) | int(src[srcIdx]));
-                srcIdx++;
-                continue;
+        for (int i = 0; i < nbChunks; i++) {
+            if ((res == true) && (dstIdx + 4 + chunks[i]._encodedSize <= dstEnd)) {
+                BigEndian::writeInt32(&dst[dstIdx], chunks[i]._encodedSize);
+                memcpy(&dst[dstIdx + 4], chunks[i]._buf, chunks[i]._encodedSize);
+                dstIdx += (4 + chunks[i]._encodedSize);
+            }
+            else {
+                res = false;
             }
 
-            // Emit one match length and index
-            const int matchLen = match & 0xFFFF;
-            re.encode9Bits((MATCH_FLAG << 8) | matchLen);
-            const int matchIdx = match >> 16;
-            re.setContext(MATCH_CTX, src[srcIdx - 1]);
-            re.encodeBits(matchIdx, _logPosChecks);
-            srcIdx += (matchLen + _minMatch);
+            deallocate(_allocator, chunks[i]._buf);
         }
 
-        startChunk = endChunk;
+        if (res == false)
+            return false;
+#endif
     }
 
-    // Emit last literals
-    for (int i = 0; i < 4; i++, srcIdx++) {
-        re.setContext(LITERAL_CTX, src[srcIdx - 1]);
+    input._index += count;
+    output._index += dstIdx;
+    return dstIdx < count;
+}
+
+
+// Encode the chunk to chunk._buf with a new range coder.
+// The range coder does not check the bounds of the buffer: it must be large
+// enough (see getMaxEncodedLength).
+bool ROLZCodec2::encodeChunk(ROLZChunk& chunk)
+{
+    int dstIdx = 0;
+    ROLZEncoder re(9, _logPosChecks, chunk._buf, dstIdx);
+    encodeChunk(re, chunk);
+    re.dispose();
+    chunk._encodedSize = dstIdx;
+    return dstIdx <= chunk._bufSize;
+}
+
+
+// The last chunk also encodes the last 4 bytes of the block.
+void ROLZCodec2::encodeChunk(ROLZEncoder& re, const ROLZChunk& chunk)
+{
+    const byte* src = chunk._data;
+    const int sizeChunk = chunk._size;
+    const int mm = _minMatch;
+    const int dt = _delta;
+    nextChunk();
+    re.reset();
+    int srcIdx = 0;
+
+    // First literals
+    const int n = min(sizeChunk, 8);
+    re.setContext(LITERAL_CTX, byte(0));
+
+    for (int j = 0; j < n; j++) {
         re.encode9Bits((LITERAL_FLAG << 8) | int(src[srcIdx]));
+        srcIdx++;
     }
 
-    re.dispose();
-    input._index = startChunk - sizeChunk + srcIdx;
-    output._index = dstIdx;
-    return (input._index == count) && (output._index < count);
+    while (srcIdx < sizeChunk) {
+        re.setContext(LITERAL_CTX, src[srcIdx - 1]);
+        uint32 key = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&src[srcIdx - dt]) : ROLZCodec::getKey2(&src[srcIdx - dt]);
+        const int match = findMatch(src, srcIdx, sizeChunk, key);
+
+        if (match < 0) {
+            // Emit one literal
+            re.encode9Bits((LITERAL_FLAG << 8) | int(src[srcIdx]));
+            srcIdx++;
+            continue;
+        }
+
+        // Emit one match length and index
+        const int matchLen = match & 0xFFFF;
+        re.encode9Bits((MATCH_FLAG << 8) | matchLen);
+        const int matchIdx = match >> 16;
+        re.setContext(MATCH_CTX, src[srcIdx - 1]);
+        re.encodeBits(matchIdx, _logPosChecks);
+        srcIdx += (matchLen + mm);
+    }
+
+    if (chunk._last == true) {
+        // Emit last literals
+        for (int i = 0; i < 4; i++, srcIdx++) {
+            re.setContext(LITERAL_CTX, src[srcIdx - 1]);
+            re.encode9Bits((LITERAL_FLAG << 8) | int(src[srcIdx]));
+        }
+    }
 }
 
+
 bool ROLZCodec2::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 {
     if (count == 0)
@@ -876,93 +1225,160 @@ bool ROLZCodec2::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int
     if (input._array == output._array)
         return false;
 
+    if (count < 13)
+        return false;
+
     byte* src = &input._array[input._index];
+    byte* dst = &output._array[output._index];
     const int dstEnd = BigEndian::readInt32(&src[0]);
-    
-    if ((dstEnd <= 0) || (dstEnd > output._length - output._index))
+
+    if ((dstEnd <= 4) || (dstEnd > output._length - output._index))
         return false;
 
-    int srcIdx = 5;
-    int sizeChunk = min(dstEnd, ROLZCodec::CHUNK_SIZE);
-    int startChunk = 0;
     _minMatch = MIN_MATCH3;
+    _delta = 2;
     const int flags = int(src[4]);
-    int delta = 2;
 
     if ((flags & 0x0E) == 8) {
-        delta = 3;
+        _delta = 3;
     } else if ((flags & 0x0E) == 4) {
-        delta = 8;
+        _delta = 8;
         _minMatch = MIN_MATCH7;
     }
 
-    const int mm = _minMatch;
-    const int dt = delta;
-    ROLZDecoder rd(9, _logPosChecks, &src[0], srcIdx);
-    memset(&_counters[0], 0, sizeof(_counters));
+    int srcIdx = 5;
 
-    while (startChunk < dstEnd) {
-        memset(&_matches[0], 0, sizeof(int32) * (ROLZCodec::HASH_SIZE << _logPosChecks));
-        const int endChunk = min(startChunk + sizeChunk, dstEnd);
-        sizeChunk = endChunk - startChunk;
-        rd.reset();
-        byte* dst = &output._array[output._index];
-        int dstIdx = 0;
+    if (_bsVersion < ROLZCodec::CHUNK_SIZES_VERSION) {
+        // Older streams: one range coder for all the chunks
+        ROLZDecoder rd(9, _logPosChecks, &src[0], srcIdx);
 
-        // First literals
-        rd.setContext(LITERAL_CTX, byte(0));
-        const int n = min(dstEnd - output._index, 8);
+        for (int startChunk = 0; startChunk < dstEnd; startChunk += ROLZCodec::CHUNK_SIZE) {
+            const int sizeChunk = min(dstEnd - startChunk, ROLZCodec::CHUNK_SIZE);
 
-        for (int j = 0; j < n; j++) {
-            int val = rd.decode9Bits();
+            if (decodeChunk(rd, &dst[startChunk], sizeChunk, min(sizeChunk, 8), output._length - output._index - startChunk) == false)
+                return false;
+        }
 
-            // Sanity check
-            if ((val >> 8) == MATCH_FLAG) {
-                output._index += dstIdx;
+        rd.dispose();
+    }
+    else {
+        // Chunks (the last 4 bytes of the block belong to the last one)
+        const int srcEnd = dstEnd - 4;
+        const int nbChunks = (srcEnd + ROLZCodec::CHUNK_SIZE - 1) / ROLZCodec::CHUNK_SIZE;
+        vector<ROLZChunk> chunks(nbChunks);
+
+        for (int i = 0; i < nbChunks; i++) {
+            const int startChunk = i * ROLZCodec::CHUNK_SIZE;
+            chunks[i]._data = &dst[startChunk];
+            chunks[i]._size = min(srcEnd - startChunk, ROLZCodec::CHUNK_SIZE);
+            chunks[i]._last = i == nbChunks - 1;
+
+            // Do not let fast copies spill into the next chunk (may be decoded concurrently)
+            chunks[i]._capacity = (chunks[i]._last == true) ? output._length - output._index - startChunk : chunks[i]._size;
+
+            if (srcIdx + 4 > count)
                 return false;
-            }
 
-            dst[dstIdx++] = byte(val);
+            const int size = BigEndian::readInt32(&src[srcIdx]);
+            srcIdx += 4;
+
+            if ((size < 8) || (size > count - srcIdx))
+                return false;
+
+            chunks[i]._buf = &src[srcIdx];
+            chunks[i]._bufSize = size;
+            srcIdx += size;
         }
 
-        // Next chunk
-        while (dstIdx < sizeChunk) {
-            const int savedIdx = dstIdx;
-            const uint32 key = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&dst[dstIdx - dt]) : ROLZCodec::getKey2(&dst[dstIdx - dt]);
-            int32* matches = &_matches[key << _logPosChecks];
-            rd.setContext(LITERAL_CTX, dst[dstIdx - 1]);
-            int val = rd.decode9Bits();
+        const int nbTasks = min(_jobs, nbChunks);
 
-            if ((val >> 8) == LITERAL_FLAG) {
-                dst[dstIdx++] = byte(val);
+        if (nbTasks <= 1) {
+            for (int i = 0; i < nbChunks; i++) {
+                if (decodeChunk(chunks[i]) == false)
+                    return false;
             }
-            else {
-                // Read one match length and index
-                const int matchLen = val & 0xFF;
-                prefetchRead(&_counters[key]);
+        }
+        else {
+#ifdef CONCURRENCY_ENABLED
+            if (runChunkTasks(*this, chunks, false, nbTasks, _pool) == false)
+                return false;
+#endif
+        }
+    }
 
-                // Sanity check
-                if (dstIdx + matchLen + 3 > dstEnd) {
-                    output._index += dstIdx;
-                    return false;
-                }
+    input._index += srcIdx;
+    output._index += dstEnd;
+    return srcIdx == count;
+}
 
-                rd.setContext(MATCH_CTX, dst[dstIdx - 1]);
-                const int32 matchIdx = int32(rd.decodeBits(_logPosChecks));
-                const int32 ref = matches[(_counters[key] - matchIdx) & _maskChecks];
-                dstIdx = ROLZCodec::emitCopy(dst, dstIdx, ref, matchLen + _minMatch);
-            }
 
-            // Update map
-            _counters[key]++;
-            matches[_counters[key] & _maskChecks] = savedIdx;
+// Decode the chunk with a new range coder
+bool ROLZCodec2::decodeChunk(ROLZChunk& chunk)
+{
+    int srcIdx = 0;
+    ROLZDecoder rd(9, _logPosChecks, chunk._buf, srcIdx);
+    const int count = (chunk._last == true) ? chunk._size + 4 : chunk._size;
+
+    if (decodeChunk(rd, chunk._data, count, min(chunk._size, 8), chunk._capacity) == false)
+        return false;
+
+    rd.dispose();
+    chunk._encodedSize = srcIdx;
+    return srcIdx <= chunk._bufSize;
+}
+
+
+// Decode 'count' bytes to dst. The first literals are decoded without context.
+bool ROLZCodec2::decodeChunk(ROLZDecoder& rd, byte dst[], int count, int firstLiterals, int capacity)
+{
+    const int mm = _minMatch;
+    const int dt = _delta;
+    nextChunk();
+    rd.reset();
+    int dstIdx = 0;
+
+    // First literals
+    rd.setContext(LITERAL_CTX, byte(0));
+
+    for (int j = 0; j < firstLiterals; j++) {
+        int val = rd.decode9Bits();
+
+        // Sanity check
+        if ((val >> 8) == MATCH_FLAG)
+            return false;
+
+        dst[dstIdx++] = byte(val);
+    }
+
+    while (dstIdx < count) {
+        const int savedIdx = dstIdx;
+        const uint32 key = (mm == MIN_MATCH3) ? ROLZCodec::getKey1(&dst[dstIdx - dt]) : ROLZCodec::getKey2(&dst[dstIdx - dt]);
+        int32* matches = getMatches(key);
+        rd.setContext(LITERAL_CTX, dst[dstIdx - 1]);
+        int val = rd.decode9Bits();
+
+        if ((val >> 8) == LITERAL_FLAG) {
+            dst[dstIdx++] = byte(val);
+        }
+        else {
+            // Read one match length and index
+            const int matchLen = val & 0xFF;
+            prefetchRead(&_counters[key]);
+
+            // Sanity check
+            if (dstIdx + matchLen + mm > count)
+                return false;
+
+            rd.setContext(MATCH_CTX, dst[dstIdx - 1]);
+            const int32 matchIdx = int32(rd.decodeBits(_logPosChecks));
+            const int32 ref = matches[(_counters[key] - matchIdx) & _maskChecks];
+            dstIdx = ROLZCodec::emitCopy(dst, dstIdx, ref, matchLen + mm, capacity);
         }
 
-        startChunk = endChunk;
-        output._index += dstIdx;
+        // Update map
+        _counters[key]++;
+        matches[_counters[key] & _maskChecks] = savedIdx;
     }
 
-    rd.dispose();
-    input._index = srcIdx;
-    return srcIdx == count;
+    return true;
 }
@@ -17,6 +17,9 @@ limitations under the License.
 #ifndef _ROLZCodec_
 #define _ROLZCodec_
 
+#include <vector>
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
 #include "../Context.hpp"
 #include "../Memory.hpp"
 #include "../Transform.hpp"
@@ -52,8 +55,8 @@ namespace kanzi {
 
        ~ROLZEncoder()
        {
-           delete[] _probs[LITERAL_FLAG];
-           delete[] _probs[MATCH_FLAG];
+           deallocate(_probs[LITERAL_FLAG]);
+           deallocate(_probs[MATCH_FLAG]);
        }
 
        void encodeBits(int val, int n);
@@ -94,8 +97,8 @@ namespace kanzi {
 
        ~ROLZDecoder()
        {
-           delete[] _probs[LITERAL_FLAG];
-           delete[] _probs[MATCH_FLAG];
+           deallocate(_probs[LITERAL_FLAG]);
+           deallocate(_probs[MATCH_FLAG]);
        }
 
        int decodeBits(int n);
@@ -109,6 +112,40 @@ namespace kanzi {
        void setContext(int n, byte ctx) { _pIdx = n; _ctx = int32(ctx) << _logSizes[_pIdx]; }
    };
 
+   // A chunk of a block. Chunks are encoded and decoded independently.
+   struct ROLZChunk
+   {
+      byte* _data; // uncompressed data (encoder input, decoder output)
+      int _size; // number of uncompressed bytes (without the last 4 bytes of the block)
+      int _capacity; // room available at _data (decoder only)
+      byte* _buf; // compressed data (encoder output, decoder input)
+      int _bufSize; // capacity of _buf (encoder) or size of compressed data (decoder)
+      int _encodedSize; // number of compressed bytes written or read
+      bool _last; // last chunk of the block
+   };
+
+
+   // A task used to encode or decode a range of chunks concurrently.
+   // Each task owns a copy of the codec, hence private match tables.
+   template <class T, class C>
+   class ROLZTask FINAL : public Task<T> {
+   private:
+       C _codec;
+       std::vector<ROLZChunk>& _chunks;
+       int _firstChunk;
+       int _lastChunk;
+       bool _forward;
+       MemoryTracker::BlockScope* _memScope; // scope of the block that created the task
+
+   public:
+       ROLZTask(const C& parent, std::vector<ROLZChunk>& chunks, int firstChunk, int lastChunk, bool forward);
+
+       ~ROLZTask() {}
+
+       T run();
+   };
+
+
    // Use ANS to encode/decode literals and matches
    class ROLZCodec1 FINAL : public Transform<byte> {
    public:
@@ -116,7 +153,10 @@ namespace kanzi {
 
        ROLZCodec1(Context& ctx);
 
-       ~ROLZCodec1() { delete[] _matches; }
+       // Same configuration as the parent but private match tables
+       ROLZCodec1(const ROLZCodec1& parent);
+
+       ~ROLZCodec1() { deallocate(_allocator, _matches); }
 
        bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
 
@@ -136,15 +176,35 @@ namespace kanzi {
        static const int LOG_POS_CHECKS = 4;
 
        int32* _matches;
+       Allocator* _allocator; // match tables and chunk buffers
        uint8 _counters[65536];
+       uint32 _keyGens[65536]; // chunk generation of last access per key
+       uint32 _gen;
        int _logPosChecks;
        int _posChecks;
        Context* _pCtx;
        int _minMatch;
-       uint8 _maskChecks;	   
+       int _delta;
+       int _litOrder;
+       uint8 _maskChecks;
+       int _bsVersion;
+       int _jobs;
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* _pool;
+#endif
+
+       template <class T, class C> friend class ROLZTask;
+
+       bool encodeChunk(ROLZChunk& chunk);
+
+       bool decodeChunk(ROLZChunk& chunk);
 
        int findMatch(const byte buf[], int pos, int end, int32 hash32, const int32* matches, const uint8* counter) const;
 
+       int32* getMatches(uint32 key);
+
+       void nextChunk();
+
        int emitLength(byte block[], int length) const;
 
        int readLength(const byte block[], int& idx) const;
@@ -158,7 +218,10 @@ namespace kanzi {
 
        ROLZCodec2(Context& ctx);
 
-       ~ROLZCodec2() { delete[] _matches; }
+       // Same configuration as the parent but private match tables
+       ROLZCodec2(const ROLZCodec2& parent);
+
+       ~ROLZCodec2() { deallocate(_allocator, _matches); }
 
        bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
 
@@ -183,14 +246,37 @@ namespace kanzi {
        static const int LOG_POS_CHECKS = 5;
 
        int32* _matches;
+       Allocator* _allocator; // match tables and chunk buffers
        uint8 _counters[65536];
+       uint32 _keyGens[65536]; // chunk generation of last access per key
+       uint32 _gen;
        int _logPosChecks;
        uint8 _maskChecks;
        Context* _pCtx;
        int _minMatch;
+       int _delta;
        int _posChecks;
+       int _bsVersion;
+       int _jobs;
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool* _pool;
+#endif
+
+       template <class T, class C> friend class ROLZTask;
+
+       bool encodeChunk(ROLZChunk& chunk);
+
+       bool decodeChunk(ROLZChunk& chunk);
+
+       void encodeChunk(ROLZEncoder& re, const ROLZChunk& chunk);
+
+       bool decodeChunk(ROLZDecoder& rd, byte dst[], int count, int firstLiterals, int capacity);
 
        int findMatch(const byte buf[], int pos, int end, uint32 key);
+
+       int32* getMatches(uint32 key);
+
+       void nextChunk();
    };
 
    class ROLZCodec FINAL : public Transform<byte> {
@@ -221,6 +307,7 @@ namespace kanzi {
        static const int32 HASH_MASK = ~(CHUNK_SIZE - 1);
        static const int MAX_BLOCK_SIZE = 1024 * 1024 * 1024;
        static const int MIN_BLOCK_SIZE = 64;
+       static const int CHUNK_SIZES_VERSION = 6; // first bitstream version with independent, sized chunks
 
        Transform<byte>* _delegate;
 
@@ -239,9 +326,57 @@ namespace kanzi {
            return ((LittleEndian::readInt32(p) << 8) * HASH) & HASH_MASK;
        }
 
-       static int emitCopy(byte dst[], int dstIdx, int ref, int matchLen);
+       static int emitCopy(byte dst[], int dstIdx, int ref, int matchLen, int dstCap);
    };
 
+   // Return the match slots for the key, clearing them (and the key counter)
+   // on first access in the current chunk. Cheaper than clearing the whole
+   // table for each chunk, especially for small blocks.
+   inline int32* ROLZCodec1::getMatches(uint32 key)
+   {
+       int32* matches = &_matches[key << _logPosChecks];
+
+       if (_keyGens[key] != _gen) {
+           _keyGens[key] = _gen;
+           _counters[key] = 0;
+           memset(matches, 0, sizeof(int32) << _logPosChecks);
+       }
+
+       return matches;
+   }
+
+   inline void ROLZCodec1::nextChunk()
+   {
+       if (++_gen == 0) {
+           memset(&_keyGens[0], 0, sizeof(_keyGens));
+           _gen = 1;
+       }
+   }
+
+   // Return the match slots for the key, clearing them (and the key counter)
+   // on first access in the current chunk. Cheaper than clearing the whole
+   // table for each chunk, especially for small blocks.
+   inline int32* ROLZCodec2::getMatches(uint32 key)
+   {
+       int32* matches = &_matches[key << _logPosChecks];
+
+       if (_keyGens[key] != _gen) {
+           _keyGens[key] = _gen;
+           _counters[key] = 0;
+           memset(matches, 0, sizeof(int32) << _logPosChecks);
+       }
+
+       return matches;
+   }
+
+   inline void ROLZCodec2::nextChunk()
+   {
+       if (++_gen == 0) {
+           memset(&_keyGens[0], 0, sizeof(_keyGens));
+           _gen = 1;
+       }
+   }
+
    inline int ROLZCodec1::emitLength(byte block[], int length) const
    {
        if (length < 1 << 7) {
@@ -286,15 +421,12 @@ namespace kanzi {
        return length;
    }
 
-   inline int ROLZCodec::emitCopy(byte dst[], int dstIdx, int ref, int matchLen)
+   // dstCap is the size of the dst buffer (to decide if the fast copy can be used)
+   inline int ROLZCodec::emitCopy(byte dst[], int dstIdx, int ref, int matchLen, int dstCap)
    {
-       if (dstIdx >= ref + 8) {
-           while (matchLen >= 8) {
-               memcpy(&dst[dstIdx], &dst[ref], 8);
-               dstIdx += 8;
-               ref += 8;
-               matchLen -= 8;
-           }
+       if (dstIdx + matchLen + MATCH_COPY_SLACK <= dstCap) {
+           copyMatch(&dst[dstIdx], dstIdx - ref, matchLen);
+           return dstIdx + matchLen;
        }
 
        while (matchLen != 0) {
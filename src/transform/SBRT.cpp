@@ -36,6 +36,42 @@ SBRT::SBRT(int mode, Context&) :
         throw std::invalid_argument("Invalid mode parameter");
 }
 
+// Return the rank where a symbol with access time 'qc' is inserted. The
+// access times of the symbols (q, indexed by symbol) decrease with the rank
+// and the symbol goes before the ones not more recent (at most at rank 'r').
+static inline int findInsertRank(const uint8 r2s[], const int q[], int r, int qc)
+{
+#if defined(__AVX2__)
+    // Check 8 ranks at a time, from the current rank down
+    const __m256i vqc = _mm256_set1_epi32(qc);
+
+    while (r >= 8) {
+        const __m256i syms = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) &r2s[r - 8]));
+        const __m256i gt = _mm256_cmpgt_epi32(_mm256_i32gather_epi32(q, syms, 4), vqc);
+        const int m = _mm256_movemask_ps(_mm256_castsi256_ps(gt));
+
+        if (m != 0)
+            return r - 8 + Global::_log2(uint32(m)) + 1;
+
+        r -= 8;
+    }
+#endif
+
+    while ((r > 0) && (q[r2s[r - 1]] <= qc))
+        r--;
+
+    return r;
+}
+
+// Move the symbol at rank 'r' with access time 'qc' to its new rank (long moves)
+static void moveToRank(uint8 r2s[], const int q[], int r, int qc)
+{
+    const int rr = findInsertRank(r2s, q, r, qc);
+
+    if (rr != r)
+        SBRT::moveUp(r2s, r, rr);
+}
+
 bool SBRT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 {
     if (count == 0)
@@ -50,33 +86,50 @@ bool SBRT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     // Aliasing
     const byte* src = &input._array[input._index];
     byte* dst = &output._array[output._index];
-    int p[256] = { 0 };
-    int q[256] = { 0 };
-    uint8 s2r[256];
-    uint8 r2s[256];
+    uint8 buf[256 + 2 * RANK_TABLE_PADDING] = { 0 };
+    uint8* r2s = &buf[RANK_TABLE_PADDING];
 
-    for (int i = 0; i < 256; i++) {
-        s2r[i] = uint8(i);
+    for (int i = 0; i < 256; i++)
         r2s[i] = uint8(i);
-    }
 
-    for (int i = 0; i < count; i++) {
-        const uint8 c = uint8(src[i]);
-        int r = int(s2r[c]);
-        dst[i] = byte(r);
-        const int qc = ((i & _mask1) + (p[c] & _mask2)) >> _shift;
-        p[c] = i;
-        q[c] = qc;
-
-        // Move up symbol to correct rank
-        while ((r > 0) && (q[r2s[r - 1]] <= qc)) {
-            r2s[r] = r2s[r - 1];
-            s2r[r2s[r]] = r;
-            r--;
-        }
+    if (_mask2 == 0) {
+        // MTF: each symbol moves to the front
+        for (int i = 0; i < count; i++) {
+            const uint8 c = uint8(src[i]);
+            const int r = findRank(r2s, c);
+            dst[i] = byte(r);
 
-        r2s[r] = c;
-        s2r[c] = r;
+            if (r != 0)
+                moveUp(r2s, r, 0);
+        }
+    }
+    else {
+        int p[256] = { 0 };
+        int q[256] = { 0 };
+
+        for (int i = 0; i < count; i++) {
+            const uint8 c = uint8(src[i]);
+            const int r = findRank(r2s, c);
+            dst[i] = byte(r);
+            const int qc = ((i & _mask1) + (p[c] & _mask2)) >> _shift;
+            p[c] = i;
+            q[c] = qc;
+
+            // Move up symbol to correct rank (vectorized for long moves)
+            if (r >= 16) {
+                moveToRank(r2s, q, r, qc);
+                continue;
+            }
+
+            int rr = r;
+
+            while ((rr > 0) && (q[r2s[rr - 1]] <= qc)) {
+                r2s[rr] = r2s[rr - 1];
+                rr--;
+            }
+
+            r2s[rr] = c;
+        }
     }
 
     input._index += count;
@@ -98,28 +151,49 @@ bool SBRT::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     // Aliasing
     const byte* src = &input._array[input._index];
     byte* dst = &output._array[output._index];
-    int p[256] = { 0 };
-    int q[256] = { 0 };
-    uint8 r2s[256];
+    uint8 buf[256 + 2 * RANK_TABLE_PADDING] = { 0 };
+    uint8* r2s = &buf[RANK_TABLE_PADDING];
 
     for (int i = 0; i < 256; i++)
         r2s[i] = uint8(i);
 
-    for (int i = 0; i < count; i++) {
-        int r = int(src[i]);
-        const int c = int(r2s[r]);
-        dst[i] = byte(r2s[r]);
-        const int qc = ((i & _mask1) + (p[c] & _mask2)) >> _shift;
-        p[c] = i;
-        q[c] = qc;
-
-        // Move up symbol to correct rank
-        while ((r > 0) && (q[r2s[r - 1]] <= qc)) {
-            r2s[r] = r2s[r - 1];
-            r--;
-        }
+    if (_mask2 == 0) {
+        // MTF: each symbol moves to the front
+        for (int i = 0; i < count; i++) {
+            const int r = int(src[i]);
+            dst[i] = byte(r2s[r]);
 
-        r2s[r] = uint8(c);
+            if (r != 0)
+                moveUp(r2s, r, 0);
+        }
+    }
+    else {
+        int p[256] = { 0 };
+        int q[256] = { 0 };
+
+        for (int i = 0; i < count; i++) {
+            const int r = int(src[i]);
+            const uint8 c = r2s[r];
+            dst[i] = byte(c);
+            const int qc = ((i & _mask1) + (p[c] & _mask2)) >> _shift;
+            p[c] = i;
+            q[c] = qc;
+
+            // Move up symbol to correct rank (vectorized for long moves)
+            if (r >= 16) {
+                moveToRank(r2s, q, r, qc);
+                continue;
+            }
+
+            int rr = r;
+
+            while ((rr > 0) && (q[r2s[rr - 1]] <= qc)) {
+                r2s[rr] = r2s[rr - 1];
+                rr--;
+            }
+
+            r2s[rr] = c;
+        }
     }
 
     input._index += count;
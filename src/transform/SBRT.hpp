@@ -18,6 +18,7 @@ limitations under the License.
 #define _SBRT_
 
 #include "../Context.hpp"
+#include "../Global.hpp"
 #include "../Transform.hpp"
 
 
@@ -49,6 +50,22 @@ namespace kanzi
 
        int getMaxEncodedLength(int srcLen) const { return srcLen; }
 
+       // Rank table helpers (shared with SRT). A rank table maps ranks to
+       // symbols (256 entries) and must be readable RANK_TABLE_PADDING bytes
+       // before and after its bounds (vector loads).
+       static const int RANK_TABLE_PADDING = 32;
+
+       // Return the rank of symbol 'c' (must be in the table)
+       static int findRank(const uint8 r2s[], uint8 c);
+
+       // Move the symbol at rank 'from' to rank 'to' <= 'from'. The symbols
+       // at ranks [to, from) move down by one rank.
+       static void moveUp(uint8 r2s[], int from, int to);
+
+       // Move the symbol at rank 'from' to rank 'to' >= 'from'. The symbols
+       // at ranks (from, to] move up by one rank.
+       static void moveDown(uint8 r2s[], int from, int to);
+
    private:
 
        const int _mask1;
@@ -56,6 +73,110 @@ namespace kanzi
        const int _shift;
    };
 
+
+   inline int SBRT::findRank(const uint8 r2s[], uint8 c)
+   {
+       // Most ranks are small after a BWT
+       if (r2s[0] == c)
+           return 0;
+
+#if defined(__AVX2__)
+       const __m256i vc = _mm256_set1_epi8(char(c));
+
+       for (int r = 0; ; r += 32) {
+           const __m256i v = _mm256_loadu_si256((const __m256i*) &r2s[r]);
+           const uint32 m = uint32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vc)));
+
+           if (m != 0)
+               return r + Global::trailingZeros(m);
+       }
+#elif defined(__SSE2__)
+       const __m128i vc = _mm_set1_epi8(char(c));
+
+       for (int r = 0; ; r += 16) {
+           const __m128i v = _mm_loadu_si128((const __m128i*) &r2s[r]);
+           const uint32 m = uint32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, vc)));
+
+           if (m != 0)
+               return r + Global::trailingZeros(m);
+       }
+#else
+       int r = 1;
+
+       while (r2s[r] != c)
+           r++;
+
+       return r;
+#endif
+   }
+
+   inline void SBRT::moveUp(uint8 r2s[], int from, int to)
+   {
+       const uint8 c = r2s[from];
+
+#if defined(__SSE2__)
+       if (from - to >= 4) {
+           int k = from;
+
+           // Shift blocks of 16 symbols, top down
+           while (k - 16 >= to) {
+               _mm_storeu_si128((__m128i*) &r2s[k - 15], _mm_loadu_si128((const __m128i*) &r2s[k - 16]));
+               k -= 16;
+           }
+
+           // Last block: merge the current and shifted windows ending at rank k
+           const __m128i idx = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+           const __m128i t = _mm_set1_epi8(char(to - k + 15));
+           const __m128i gt = _mm_cmpgt_epi8(idx, t);
+           const __m128i eq = _mm_cmpeq_epi8(idx, t);
+           const __m128i cur = _mm_loadu_si128((const __m128i*) &r2s[k - 15]);
+           const __m128i sft = _mm_loadu_si128((const __m128i*) &r2s[k - 16]);
+           __m128i res = _mm_or_si128(_mm_and_si128(gt, sft), _mm_andnot_si128(gt, cur));
+           res = _mm_or_si128(_mm_and_si128(eq, _mm_set1_epi8(char(c))), _mm_andnot_si128(eq, res));
+           _mm_storeu_si128((__m128i*) &r2s[k - 15], res);
+           return;
+       }
+#endif
+
+       for (int r = from; r > to; r--)
+           r2s[r] = r2s[r - 1];
+
+       r2s[to] = c;
+   }
+
+   inline void SBRT::moveDown(uint8 r2s[], int from, int to)
+   {
+       const uint8 c = r2s[from];
+
+#if defined(__SSE2__)
+       if (to - from >= 4) {
+           int k = from;
+
+           // Shift blocks of 16 symbols, bottom up
+           while (k + 16 <= to) {
+               _mm_storeu_si128((__m128i*) &r2s[k], _mm_loadu_si128((const __m128i*) &r2s[k + 1]));
+               k += 16;
+           }
+
+           // Last block: merge the current and shifted windows starting at rank k
+           const __m128i idx = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+           const __m128i t = _mm_set1_epi8(char(to - k));
+           const __m128i lt = _mm_cmplt_epi8(idx, t);
+           const __m128i eq = _mm_cmpeq_epi8(idx, t);
+           const __m128i cur = _mm_loadu_si128((const __m128i*) &r2s[k]);
+           const __m128i sft = _mm_loadu_si128((const __m128i*) &r2s[k + 1]);
+           __m128i res = _mm_or_si128(_mm_and_si128(lt, sft), _mm_andnot_si128(lt, cur));
+           res = _mm_or_si128(_mm_and_si128(eq, _mm_set1_epi8(char(c))), _mm_andnot_si128(eq, res));
+           _mm_storeu_si128((__m128i*) &r2s[k], res);
+           return;
+       }
+#endif
+
+       for (int r = from; r < to; r++)
+           r2s[r] = r2s[r + 1];
+
+       r2s[to] = c;
+   }
 }
 #endif
 
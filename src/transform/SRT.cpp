@@ -13,9 +13,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
-#include <cstring>
 #include <stdexcept>
 #include "SRT.hpp"
+#include "SBRT.hpp"
 
 using namespace kanzi;
 
@@ -34,8 +34,8 @@ bool SRT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int length)
         return false;
 
     int freqs[256] = { 0 };
-    uint8 s2r[256] = { 0 };
-    uint8 r2s[256] = { 0 };
+    uint8 buf[256 + 2 * SBRT::RANK_TABLE_PADDING] = { 0 };
+    uint8* r2s = &buf[SBRT::RANK_TABLE_PADDING];
     byte* src = &input._array[input._index];
 
     // find first symbols and count occurrences
@@ -48,7 +48,6 @@ bool SRT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int length)
 
         if (freqs[c] == 0) {
             r2s[b] = c;
-            s2r[c] = uint8(b);
             b++;
         }
 
@@ -75,22 +74,13 @@ bool SRT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int length)
     // encoding
     for (int i = 0; i < length;) {
         uint8 c = uint8(src[i]);
-        int r = s2r[c];
+        const int r = SBRT::findRank(r2s, c);
         int p = buckets[c];
         dst[p] = byte(r);
         p++;
 
-        if (r != 0) {
-            do {
-                const uint8 t = r2s[r - 1];
-                r2s[r] = t;
-                s2r[t] = uint8(r);
-                r--;
-            } while (r != 0);
-
-            r2s[0] = c;
-            s2r[c] = 0;
-        }
+        if (r != 0)
+            SBRT::moveUp(r2s, r, 0);
 
         i++;
 
@@ -130,7 +120,8 @@ bool SRT::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int length)
     int nbSymbols = preprocess(freqs, symbols);
     int buckets[256] = { 0 };
     int bucketEnds[256] = { 0 };
-    uint8 r2s[256] = { 0 };
+    uint8 buf[256 + 2 * SBRT::RANK_TABLE_PADDING] = { 0 };
+    uint8* r2s = &buf[SBRT::RANK_TABLE_PADDING];
 
     for (int i = 0, bucketPos = 0; i < nbSymbols; i++) {
         const uint8 c = symbols[i];
@@ -154,8 +145,7 @@ bool SRT::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int length)
             if (r == 0)
                 continue;
 
-            memmove(&r2s[0], &r2s[1], r);
-            r2s[r] = c;
+            SBRT::moveDown(r2s, 0, r);
             c = r2s[0];
         }
         else {
@@ -163,7 +153,7 @@ bool SRT::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int length)
                 continue;
 
             nbSymbols--;
-            memmove(&r2s[0], &r2s[1], nbSymbols);
+            SBRT::moveDown(r2s, 0, nbSymbols);
             c = r2s[0];
         }
     }
@@ -200,38 +200,23 @@ byte TextCodec::computeStats(const byte block[], int count, uint freqs0[], bool
         return TextCodec::MASK_NOT_TEXT;
     }
 
-    uint* freqs1 = new uint[65536];
-    memset(&freqs1[0], 0, 65536 * sizeof(uint));
     uint f0[256] = { 0 };
     uint f1[256] = { 0 };
     uint f3[256] = { 0 };
     uint f2[256] = { 0 };
-    uint8 prv = 0;
     const uint8* data = reinterpret_cast<const uint8*>(&block[0]);
     const int count4 = count & -4;
 
     // Unroll loop
     for (int i = 0; i < count4; i += 4) {
-        const uint8 cur0 = data[i];
-        const uint8 cur1 = data[i + 1];
-        const uint8 cur2 = data[i + 2];
-        const uint8 cur3 = data[i + 3];
-        f0[cur0]++;
-        f1[cur1]++;
-        f2[cur2]++;
-        f3[cur3]++;
-        freqs1[(prv  * 256) + cur0]++;
-        freqs1[(cur0 * 256) + cur1]++;
-        freqs1[(cur1 * 256) + cur2]++;
-        freqs1[(cur2 * 256) + cur3]++;
-        prv = cur3;
+        f0[data[i]]++;
+        f1[data[i + 1]]++;
+        f2[data[i + 2]]++;
+        f3[data[i + 3]]++;
     }
 
-    for (int i = count4; i < count; i++) {
+    for (int i = count4; i < count; i++)
         freqs0[data[i]]++;
-        freqs1[(prv * 256) + data[i]]++;
-        prv = data[i];
-    }
 
     for (int i = 0; i < 256; i++) {
         freqs0[i] += (f0[i] + f1[i] + f2[i] + f3[i]);
@@ -263,11 +248,8 @@ byte TextCodec::computeStats(const byte block[], int count, uint freqs0[], bool
 
     byte res = byte(0);
 
-    if (notText == true) {
-        res = detectType(freqs0, freqs1, count);
-        delete[] freqs1;
-        return res;
-    }
+    if (notText == true)
+        return detectType(freqs0, block, count);
 
     if (nbBinChars <= count - count / 10) {
         // Check if likely XML/HTML
@@ -276,11 +258,17 @@ byte TextCodec::computeStats(const byte block[], int count, uint freqs0[], bool
         // Getting this flag wrong results in a very small compression speed degradation.
         const int f60 = freqs0[60]; // '<'
         const int f62 = freqs0[62]; // '>'
-        const int f38 = freqs1[38 * 256 + 97]  + freqs1[38 * 256 + 103] + 
-                        freqs1[38 * 256 + 108] + freqs1[38 * 256 + 113]; // '&a', '&g', '&l', '&q'
         const int minFreq = max((count - nbBinChars) >> 9, 2);
+        int f38 = 0;
 
-        if ((f60 >= minFreq) && (f62 >= minFreq) && (f38 > 0)) {
+        if ((f60 >= minFreq) && (f62 >= minFreq) && (freqs0[38] != 0)) {
+            const byte amp = byte(38);
+            uint freqs1[1][256];
+            computeStats1(block, count, &amp, 1, freqs1);
+            f38 = freqs1[0][97] + freqs1[0][103] + freqs1[0][108] + freqs1[0][113]; // '&a', '&g', '&l', '&q'
+        }
+
+        if (f38 > 0) {
             if (f60 < f62) {
                 if (f60 >= (f62 - f62 / 100))
                     res |= TextCodec::MASK_XML_HTML;
@@ -296,27 +284,66 @@ byte TextCodec::computeStats(const byte block[], int count, uint freqs0[], bool
     }
 
     // Check CR+LF matches
+    // All CR must be followed by LF and all LF preceded by CR (same counts)
     if ((freqs0[cr] != 0) && (freqs0[cr] == freqs0[lf])) {
-        res |= TextCodec::MASK_CRLF;
+        const byte eol = CR;
+        uint freqs1[1][256];
+        computeStats1(block, count, &eol, 1, freqs1);
 
-        for (int i = 0; i < 256; i++) {
-            if ((i != lf) && (freqs1[(cr * 256) + i]) != 0) {
-                res &= ~TextCodec::MASK_CRLF;
-                break;
+        if (freqs1[0][lf] == freqs0[lf])
+            res |= TextCodec::MASK_CRLF;
+    }
+
+    return res;
+}
+
+// Compute the order 1 frequencies of the symbols following each byte in 'leads'
+// (at most 4). Only a few rows of the order 1 histogram are ever needed, so
+// locate the leading bytes with vector compares and skip everything else.
+void TextCodec::computeStats1(const byte block[], int count, const byte leads[], int nbLeads, uint freqs1[][256])
+{
+    memset(&freqs1[0][0], 0, size_t(nbLeads) * 256 * sizeof(uint));
+    const uint8* data = reinterpret_cast<const uint8*>(&block[0]);
+    const int end = count - 1; // the last byte has no successor
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128i vLeads[4];
+
+    for (int k = 0; k < 4; k++)
+        vLeads[k] = _mm_set1_epi8(char(leads[(k < nbLeads) ? k : 0]));
+
+    for (; i + 16 <= end; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i]));
+        const __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, vLeads[0]), _mm_cmpeq_epi8(v, vLeads[1])),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v, vLeads[2]), _mm_cmpeq_epi8(v, vLeads[3])));
+        uint mask = uint(_mm_movemask_epi8(m));
+
+        while (mask != 0) {
+            const int j = i + Global::trailingZeros(mask);
+            mask &= (mask - 1);
+
+            for (int k = 0; k < nbLeads; k++) {
+                if (data[j] == uint8(leads[k])) {
+                    freqs1[k][data[j + 1]]++;
+                    break;
+                }
             }
+        }
+    }
+#endif
 
-            if ((i != cr) && (freqs1[(i * 256) + lf]) != 0) {
-                res &= ~TextCodec::MASK_CRLF;
+    for (; i < end; i++) {
+        for (int k = 0; k < nbLeads; k++) {
+            if (data[i] == uint8(leads[k])) {
+                freqs1[k][data[i + 1]]++;
                 break;
             }
         }
     }
-
-    delete[] freqs1;
-    return res;
 }
 
-byte TextCodec::detectType(const uint freqs0[], const uint freqs1[], int count) {
+byte TextCodec::detectType(const uint freqs0[], const byte block[], int count) {
     Global::DataType dt = Global::detectSimpleType(count, freqs0);
 
     if (dt != Global::UNDEFINED)
@@ -342,23 +369,27 @@ byte TextCodec::detectType(const uint freqs0[], const uint freqs1[], int count)
             return TextCodec::MASK_NOT_TEXT;
     }
    
+    // Order 1 frequencies of the lead bytes with restricted second bytes
+    const byte leads[4] = { byte(0xE0), byte(0xED), byte(0xF0), byte(0xF4) };
+    uint freqs1[4][256];
+    computeStats1(block, count, leads, 4, freqs1);
     int sum = 0;
 
     for (int i = 0; i < 256; i++) {
         // Exclude < 0xE0A0 || > 0xE0BF
-        if (((i < 0xA0) || (i > 0xBF)) && (freqs1[(0xE0 << 8) + i] > 0))
+        if (((i < 0xA0) || (i > 0xBF)) && (freqs1[0][i] > 0))
             return TextCodec::MASK_NOT_TEXT;
 
         // Exclude < 0xED80 || > 0xEDE9F
-        if (((i < 0x80) || (i > 0x9F)) && (freqs1[(0xED << 8) + i] > 0))
+        if (((i < 0x80) || (i > 0x9F)) && (freqs1[1][i] > 0))
             return TextCodec::MASK_NOT_TEXT;
 
         // Exclude < 0xF090 || > 0xF0BF
-        if (((i < 0x90) || (i > 0xBF)) && (freqs1[(0xF0 << 8) + i] > 0))
+        if (((i < 0x90) || (i > 0xBF)) && (freqs1[2][i] > 0))
             return TextCodec::MASK_NOT_TEXT;
 
         // Exclude < 0xF480 || > 0xF4BF
-        if (((i < 0x80) || (i > 0xBF)) && (freqs1[(0xF4 << 8) + i] > 0))
+        if (((i < 0x80) || (i > 0xBF)) && (freqs1[3][i] > 0))
             return TextCodec::MASK_NOT_TEXT;
 
         // Count non-primary bytes
@@ -427,6 +458,7 @@ TextCodec1::TextCodec1()
 {
     _logHashSize = TextCodec::LOG_HASHES_SIZE;
     _dictSize = 1 << 13;
+    _dictCapacity = 0;
     _dictMap = nullptr;
     _dictList = nullptr;
     _hashMask = (1 << _logHashSize) - 1;
@@ -444,6 +476,7 @@ TextCodec1::TextCodec1(Context& ctx)
     const int log = blockSize >= 8 ? max(min(Global::log2(uint32(blockSize / 8)), 26), 13) : 13;
     _logHashSize = ctx.getString("entropy") == "TPAQX" ? log + 1 : log;
     _dictSize = 1 << 13;
+    _dictCapacity = 0;
     _dictMap = nullptr;
     _dictList = nullptr;
     _hashMask = (1 << _logHashSize) - 1;
@@ -458,17 +491,30 @@ void TextCodec1::reset(int count)
 {
     // Select an appropriate initial dictionary size
     const int log = count < 1024 ? 13 : max(min(Global::log2(uint32(count / 128)), 18), 13);
-    _dictSize = max(TextCodec::STATIC_DICT_WORDS + 2, 1 << log);
-    const int mapSize = 1 << _logHashSize;
+    const int dictSize = max(TextCodec::STATIC_DICT_WORDS + 2, 1 << log);
+
+    if (_dictMap == nullptr) {
+        const int mapSize = 1 << _logHashSize;
+        _dictMap = allocate<DictEntry*>(mapSize, MemoryUsage::TRANSFORM);
+
+        for (int i = 0; i < mapSize; i++)
+            _dictMap[i] = nullptr;
+    }
+    else {
+        // Reused instance: only clear the map slots referenced by the previous
+        // dictionary instead of the whole (possibly very large) map
+        for (int i = 0; i < _dictSize; i++)
+            _dictMap[_dictList[i]._hash & _hashMask] = nullptr;
+    }
 
-    if (_dictMap == nullptr)
-        _dictMap = new DictEntry*[mapSize];
+    _dictSize = dictSize;
 
-    for (int i = 0; i < mapSize; i++)
-        _dictMap[i] = nullptr;
+    if (_dictCapacity < _dictSize) {
+        if (_dictList != nullptr)
+            deallocate(_dictList);
 
-    if (_dictList == nullptr) {
-        _dictList = new DictEntry[_dictSize];
+        _dictList = allocate<DictEntry>(_dictSize, MemoryUsage::TRANSFORM);
+        _dictCapacity = _dictSize;
 #if __cplusplus >= 201103L
         memcpy(&_dictList[0], &TextCodec::STATIC_DICTIONARY[0], sizeof(TextCodec::STATIC_DICTIONARY));
 #else
@@ -547,7 +593,7 @@ bool TextCodec1::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
         const int8 cType = TextCodec::getType(src[srcIdx]);
 
         if (cType == 0) {
-            srcIdx++;
+            srcIdx = TextCodec::skipText(src, srcIdx + 1, srcEnd);
             continue;
         }
 
@@ -666,14 +712,15 @@ bool TextCodec1::expandDictionary()
     if (_dictSize >= TextCodec::MAX_DICT_SIZE)
         return false;
 
-    DictEntry* newDict = new DictEntry[_dictSize * 2];
+    DictEntry* newDict = allocate<DictEntry>(_dictSize * 2, MemoryUsage::TRANSFORM);
     memcpy(static_cast<void*>(&newDict[0]), &_dictList[0], sizeof(DictEntry) * _dictSize);
 
     for (int i = _dictSize; i < _dictSize * 2; i++)
         newDict[i] = DictEntry(nullptr, 0, i);
 
-    delete[] _dictList;
+    deallocate(_dictList);
     _dictList = newDict;
+    _dictCapacity = _dictSize * 2;
 
     // Reset map (values must point to addresses of new DictEntry items)
     for (int i = 0; i < _dictSize; i++) {
@@ -921,6 +968,7 @@ TextCodec2::TextCodec2()
 {
     _logHashSize = TextCodec::LOG_HASHES_SIZE;
     _dictSize = 1 << 13;
+    _dictCapacity = 0;
     _dictMap = nullptr;
     _dictList = nullptr;
     _hashMask = (1 << _logHashSize) - 1;
@@ -935,6 +983,7 @@ TextCodec2::TextCodec2(Context& ctx)
     const int log = blockSize >= 32 ? max(min(Global::log2(uint32(blockSize / 32)), 24), 13) : 13;
     _logHashSize = ctx.getString("entropy") == "TPAQX" ? log + 1 : log;
     _dictSize = 1 << 13;
+    _dictCapacity = 0;
     _dictMap = nullptr;
     _dictList = nullptr;
     _hashMask = (1 << _logHashSize) - 1;
@@ -947,17 +996,30 @@ void TextCodec2::reset(int count)
 {
     // Select an appropriate initial dictionary size
     const int log = count < 1024 ? 13 : max(min(Global::log2(uint32(count / 128)), 18), 13);
-    _dictSize = max(TextCodec::STATIC_DICT_WORDS, 1 << log);
-    const int mapSize = 1 << _logHashSize;
+    const int dictSize = max(TextCodec::STATIC_DICT_WORDS, 1 << log);
 
-    if (_dictMap == nullptr)
-        _dictMap = new DictEntry*[mapSize];
+    if (_dictMap == nullptr) {
+        const int mapSize = 1 << _logHashSize;
+        _dictMap = allocate<DictEntry*>(mapSize, MemoryUsage::TRANSFORM);
 
-    for (int i = 0; i < mapSize; i++)
-        _dictMap[i] = nullptr;
+        for (int i = 0; i < mapSize; i++)
+            _dictMap[i] = nullptr;
+    }
+    else {
+        // Reused instance: only clear the map slots referenced by the previous
+        // dictionary instead of the whole (possibly very large) map
+        for (int i = 0; i < _dictSize; i++)
+            _dictMap[_dictList[i]._hash & _hashMask] = nullptr;
+    }
+
+    _dictSize = dictSize;
 
-    if (_dictList == nullptr) {
-        _dictList = new DictEntry[_dictSize];
+    if (_dictCapacity < _dictSize) {
+        if (_dictList != nullptr)
+            deallocate(_dictList);
+
+        _dictList = allocate<DictEntry>(_dictSize, MemoryUsage::TRANSFORM);
+        _dictCapacity = _dictSize;
 #if __cplusplus >= 201103L
         memcpy(&_dictList[0], &TextCodec::STATIC_DICTIONARY[0], sizeof(TextCodec::STATIC_DICTIONARY));
 #else
@@ -1030,7 +1092,7 @@ bool TextCodec2::forward(SliceArray<byte>& input, SliceArray<byte>& output, int
         const int8 cType = TextCodec::getType(src[srcIdx]);
 
         if (cType == 0) {
-            srcIdx++;
+            srcIdx = TextCodec::skipText(src, srcIdx + 1, srcEnd);
             continue;
         }
 
@@ -1148,14 +1210,15 @@ bool TextCodec2::expandDictionary()
     if (_dictSize >= TextCodec::MAX_DICT_SIZE)
         return false;
 
-    DictEntry* newDict = new DictEntry[_dictSize * 2];
+    DictEntry* newDict = allocate<DictEntry>(_dictSize * 2, MemoryUsage::TRANSFORM);
     memcpy(static_cast<void*>(&newDict[0]), &_dictList[0], sizeof(DictEntry) * _dictSize);
 
     for (int i = _dictSize; i < _dictSize * 2; i++)
         newDict[i] = DictEntry(nullptr, 0, i);
 
-    delete[] _dictList;
+    deallocate(_dictList);
     _dictList = newDict;
+    _dictCapacity = _dictSize * 2;
 
     // Reset map (values must point to addresses of new DictEntry items)
     for (int i = 0; i < _dictSize; i++) {
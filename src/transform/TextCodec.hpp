@@ -17,7 +17,9 @@ limitations under the License.
 #ifndef _TextCodec_
 #define _TextCodec_
 
+#include "../Allocator.hpp"
 #include "../Context.hpp"
+#include "../Global.hpp"
 #include "../Transform.hpp"
 
 
@@ -61,8 +63,8 @@ namespace kanzi {
 
        ~TextCodec1()
        {
-           if (_dictList != nullptr) delete[] _dictList;
-           if (_dictMap != nullptr) delete[] _dictMap;
+           if (_dictList != nullptr) deallocate(_dictList);
+           if (_dictMap != nullptr) deallocate(_dictMap);
        }
 
        bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
@@ -79,6 +81,7 @@ namespace kanzi {
        byte _escapes[2];
        int _staticDictSize;
        int _dictSize;
+       int _dictCapacity; // allocated entries in _dictList
        int _logHashSize;
        int _hashMask;
        bool _isCRLF; // EOL = CR + LF
@@ -102,8 +105,8 @@ namespace kanzi {
 
        ~TextCodec2()
        {
-           if (_dictList != nullptr) delete[] _dictList;
-           if (_dictMap != nullptr) delete[] _dictMap;
+           if (_dictList != nullptr) deallocate(_dictList);
+           if (_dictMap != nullptr) deallocate(_dictMap);
        }
 
        bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length);
@@ -119,6 +122,7 @@ namespace kanzi {
        DictEntry* _dictList;
        int _staticDictSize;
        int _dictSize;
+       int _dictCapacity; // allocated entries in _dictList
        int _logHashSize;
        int _hashMask;
        bool _isCRLF; // EOL = CR + LF
@@ -199,9 +203,13 @@ namespace kanzi {
 
        static bool sameWords(const byte src[], const byte dst[], int length);
 
+       static int skipText(const byte src[], int srcIdx, int srcEnd);
+
        static byte computeStats(const byte block[], int count, uint freqs[], bool strict);
 
-       static byte detectType(const uint freqs0[], const uint freqs1[], int count);
+       static void computeStats1(const byte block[], int count, const byte leads[], int nbLeads, uint freqs1[][256]);
+
+       static byte detectType(const uint freqs0[], const byte block[], int count);
        
        // Common English words.
        static char DICT_EN_1024[];
@@ -245,6 +253,33 @@ namespace kanzi {
    }
 #endif
 
+   // Return the index of the first non letter at or after srcIdx (or srcEnd).
+   // Letters are classified 16 at a time: (c | 0x20) - 'a' < 26 for [A-Za-z].
+   inline int TextCodec::skipText(const byte src[], int srcIdx, int srcEnd)
+   {
+#if defined(__SSE2__)
+       const __m128i vCase = _mm_set1_epi8(0x20);
+       const __m128i vBias = _mm_set1_epi8(char(0x80 - 'a')); // 'a' -> -128
+       const __m128i vLimit = _mm_set1_epi8(char(-128 + 26));
+
+       while (srcIdx + 16 <= srcEnd) {
+           __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[srcIdx]));
+           v = _mm_add_epi8(_mm_or_si128(v, vCase), vBias);
+           const int mask = _mm_movemask_epi8(_mm_cmplt_epi8(v, vLimit));
+
+           if (mask != 0xFFFF)
+               return srcIdx + Global::trailingZeros(uint(~mask));
+
+           srcIdx += 16;
+       }
+#endif
+
+       while ((srcIdx < srcEnd) && (isText(src[srcIdx]) == true))
+           srcIdx++;
+
+       return srcIdx;
+   }
+
    inline bool TextCodec::sameWords(const byte src[], const byte dst[], int length)
    {
        while (length >= 4) {
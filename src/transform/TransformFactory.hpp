@@ -201,17 +201,25 @@ namespace kanzi {
 	TransformSequence<T>* TransformFactory<T>::newTransform(Context& ctx, uint64 functionType)
 	{
 		Transform<T>* transforms[8];
+		const char* names[8];
 		int nbtr = 0;
 
 		for (int i = 0; i < 8; i++) {
 			transforms[i] = nullptr;
 			const uint64 t = (functionType >> (MAX_SHIFT - ONE_SHIFT * i)) & MASK;
 
-			if ((t != NONE_TYPE) || (i == 0))
+			if ((t != NONE_TYPE) || (i == 0)) {
+				names[nbtr] = getNameToken(t);
 				transforms[nbtr++] = newToken(ctx, t);
+			}
 		}
 
-		return new TransformSequence<T>(transforms, true);
+		TransformSequence<T>* seq = new TransformSequence<T>(transforms, true);
+
+		for (int i = 0; i < nbtr; i++)
+			seq->setName(i, names[i]);
+
+		return seq;
 	}
 
 	template <class T>
@@ -19,6 +19,9 @@ limitations under the License.
 
 #include <cstring>
 #include <stdexcept>
+#include <vector>
+#include "../Allocator.hpp"
+#include "../Listener.hpp"
 #include "../Transform.hpp"
 
 namespace kanzi {
@@ -44,6 +47,21 @@ namespace kanzi {
 
        int getNbTransforms() const { return _length; }
 
+       // Name of the transform at index 'stage' (reported in stage events)
+       void setName(int stage, const char* name) { _names[stage & 7] = name; }
+
+       // Listeners notified before and after each individual transform
+       // of the sequence is applied to the block 'blockId'
+       void setListeners(const std::vector<Listener*>& listeners, int blockId)
+       {
+           _listeners = listeners;
+           _blockId = blockId;
+       }
+
+       // Allocator of the buffers (re)allocated by forward() and inverse().
+       // It must be the allocator of the provided slices (null: new[]).
+       void setAllocator(Allocator* allocator) { _allocator = allocator; }
+
    private:
        static const byte SKIP_MASK = byte(0xFF);
 
@@ -51,6 +69,12 @@ namespace kanzi {
        bool _deallocate; // deallocate memory for transforms ?
        int _length; // number of transforms
        byte _skipFlags; // skip transforms
+       const char* _names[8];
+       std::vector<Listener*> _listeners;
+       int _blockId;
+       Allocator* _allocator;
+
+       void notifyListeners(Event::Type type, int stage, int64 size) const;
    };
 
    template <class T>
@@ -59,9 +83,12 @@ namespace kanzi {
        _deallocate = deallocate;
        _length = 8;
        _skipFlags = byte(0);
+       _blockId = -1;
+       _allocator = nullptr;
 
        for (int i = 7; i >= 0; i--) {
            _transforms[i] = transforms[i];
+           _names[i] = "";
 
            if (_transforms[i] == nullptr)
                _length = i;
@@ -112,25 +139,36 @@ namespace kanzi {
 
            // Check that the output buffer has enough room. If not, allocate a new one.
            if (out->_length < requiredSize) {
-               delete[] out->_array;
-               out->_array = new byte[requiredSize];
+               deallocate(_allocator, out->_array);
+               out->_array = allocate<byte>(_allocator, requiredSize, MemoryUsage::TRANSFORM);
                out->_length = requiredSize;
            }
 
            const int savedIIdx = in->_index;
            const int savedOIdx = out->_index;
 
+           if (_listeners.size() > 0)
+               notifyListeners(Event::BEFORE_TRANSFORM_STAGE, i, count);
+
            // Apply forward transform
            if (_transforms[i]->forward(*in, *out, count) == false) {
                // Transform failed. Either it does not apply to this type
                // of data or a recoverable error occured => revert
                in->_index = savedIIdx;
                out->_index = savedOIdx;
+
+               if (_listeners.size() > 0)
+                   notifyListeners(Event::AFTER_TRANSFORM_STAGE, i, count);
+
                continue;
            }
 
            _skipFlags &= ~byte(1 << (7 - i));
            count = out->_index - savedOIdx;
+
+           if (_listeners.size() > 0)
+               notifyListeners(Event::AFTER_TRANSFORM_STAGE, i, count);
+
            in->_index = savedIIdx;
            out->_index = savedOIdx;
            std::swap(in, out);
@@ -187,14 +225,17 @@ namespace kanzi {
 
            // Check that the output buffer has enough room. If not, allocate a new one.
            if (out->_length < output._length) {
-               delete[] out->_array;
-               out->_array = new byte[output._length];
+               deallocate(_allocator, out->_array);
+               out->_array = allocate<byte>(_allocator, output._length, MemoryUsage::TRANSFORM);
                out->_length = output._length;
            }
 
            const int savedIIdx = in->_index;
            const int savedOIdx = out->_index;
 
+           if (_listeners.size() > 0)
+               notifyListeners(Event::BEFORE_TRANSFORM_STAGE, i, count);
+
            // Apply inverse transform
            res = _transforms[i]->inverse(*in, *out, count);
 
@@ -203,6 +244,10 @@ namespace kanzi {
                break;
 
            count = out->_index - savedOIdx;
+
+           if (_listeners.size() > 0)
+               notifyListeners(Event::AFTER_TRANSFORM_STAGE, i, count);
+
            in->_index = savedIIdx;
            out->_index = savedOIdx;
            std::swap(in, out);
@@ -235,6 +280,15 @@ namespace kanzi {
 
        return requiredSize;
    }
+
+   template <class T>
+   void TransformSequence<T>::notifyListeners(Event::Type type, int stage, int64 size) const
+   {
+       const Event evt(type, _blockId, size, stage, _names[stage]);
+
+       for (std::vector<Listener*>::const_iterator it = _listeners.begin(); it != _listeners.end(); ++it)
+           (*it)->processEvent(evt);
+   }
 }
 #endif
 
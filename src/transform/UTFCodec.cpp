@@ -17,6 +17,7 @@ limitations under the License.
 #include <cstring>
 #include <vector>
 #include "UTFCodec.hpp"
+#include "../Allocator.hpp"
 #include "../Global.hpp"
 #include "../types.hpp"
 
@@ -25,6 +26,14 @@ using namespace std;
 
 const int UTFCodec::SIZES[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 2, 2, 3, 4 };
 
+#if defined(__SSE2__)
+// Unsigned byte range check: 0xFF in lanes where lo <= x <= hi
+static inline __m128i inRange(__m128i x, __m128i lo, __m128i hi)
+{
+    return _mm_cmpeq_epi8(_mm_min_epu8(_mm_max_epu8(x, lo), hi), x);
+}
+#endif
+
 
 bool UTFCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 {
@@ -71,14 +80,27 @@ bool UTFCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int co
     // 001 -> 11 bits
     // 010 -> 16 bits
     // 1xx -> 21 bits
-    uint32* aliasMap = new uint32[1 << 22];
+    uint32* aliasMap = allocate<uint32>(1 << 22, MemoryUsage::TRANSFORM);
     memset(aliasMap, 0, size_t(1 << 22) * sizeof(uint32));
     vector<sdUTF> v;
     v.reserve(count);
     int n = 0;
     bool res = true;
 
-    for (int i = start; i < count - 4; ) {
+    const int srcEnd = count - 4;
+
+    // ASCII symbols are only counted here and registered after the loop
+    // (the symbols are sorted later, so the order of registration does not matter)
+    for (int i = start; i < srcEnd; ) {
+        if (src[i] < byte(0x80)) {
+            const int end = skipASCII(src, i, srcEnd);
+
+            for ( ; i < end; i++)
+                aliasMap[uint8(src[i])]++;
+
+            continue;
+        }
+
         uint32 val;
         const int s = pack(&src[i], val);
 
@@ -105,10 +127,25 @@ bool UTFCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int co
         i += s;
     }
 
+    for (uint32 i = 0; (i < 128) && (res == true); i++) {
+        if (aliasMap[i] == 0)
+            continue;
+
+#if __cplusplus >= 201103L
+        v.emplace_back(i, 0);
+#else
+        sdUTF u(i, 0);
+        v.push_back(u);
+#endif
+
+        if (++n >= 32768)
+            res = false;
+    }
+
     const int dstEnd = count - (count / 10);
 
     if ((res == false) || (n == 0) || ((3 * n + 6) >= dstEnd)) {
-        delete[] aliasMap;
+        deallocate(aliasMap);
         return false;
     }
 
@@ -138,7 +175,7 @@ bool UTFCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int co
 
     if (estimate >= dstEnd) {
         // Not worth it
-        delete[] aliasMap;
+        deallocate(aliasMap);
         return false;
     }
 
@@ -150,7 +187,21 @@ bool UTFCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int co
     int srcIdx = start;
 
     // Emit aliases
-    while (srcIdx < count - 4) {
+    while (srcIdx < srcEnd) {
+        if (src[srcIdx] < byte(0x80)) {
+            // Run of ASCII symbols: no need to pack
+            const int end = skipASCII(src, srcIdx, srcEnd);
+
+            for ( ; srcIdx < end; srcIdx++) {
+                const uint32 alias = aliasMap[uint8(src[srcIdx])];
+                dst[dstIdx++] = byte(alias);
+                dst[dstIdx] = byte(alias >> 8);
+                dstIdx += (alias >> 16);
+            }
+
+            continue;
+        }
+
         uint32 val;
         srcIdx += pack(&src[srcIdx], val);
         const uint32 alias = aliasMap[val];
@@ -160,13 +211,13 @@ bool UTFCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int co
     }
 
     dst[0] = byte(start);
-    dst[1] = byte(srcIdx - (count - 4));
+    dst[1] = byte(srcIdx - srcEnd);
 
     // Emit last (possibly invalid) symbols (due to block truncation)
     while (srcIdx < count)
         dst[dstIdx++] = src[srcIdx++];
 
-    delete[] aliasMap;
+    deallocate(aliasMap);
     input._index += srcIdx;
     output._index += dstIdx;
     return dstIdx < dstEnd;
@@ -245,105 +296,122 @@ bool UTFCodec::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int co
 }
 
 
+// Check whether the block is (likely) UTF-8 text.
+// See Unicode 14 Standard - UTF-8 Table 3.7
+// U+0000..U+007F          00..7F
+// U+0080..U+07FF          C2..DF 80..BF
+// U+0800..U+0FFF          E0 A0..BF 80..BF
+// U+1000..U+CFFF          E1..EC 80..BF 80..BF
+// U+D000..U+D7FF          ED 80..9F 80..BF 80..BF
+// U+E000..U+FFFF          EE..EF 80..BF 80..BF
+// U+10000..U+3FFFF        F0 90..BF 80..BF 80..BF
+// U+40000..U+FFFFF        F1..F3 80..BF 80..BF 80..BF
+// U+100000..U+10FFFF      F4 80..8F 80..BF 80..BF
+// The block is rejected as soon as an invalid byte (C0, C1, F5..FF) or an
+// invalid second byte (after E0, ED, F0, F4) shows up or when the number of
+// non-primary bytes can no longer reach the threshold (1/4 of the block).
+// Most non UTF-8 blocks are thus rejected after a short prefix.
 bool UTFCodec::validate(const byte block[], int count)
 {
-    uint freqs0[256] = { 0 };
-    uint* freqs1 = new uint[65536];
-    memset(&freqs1[0], 0, 65536 * sizeof(uint));
-    uint f0[256] = { 0 };
-    uint f1[256] = { 0 };
-    uint f3[256] = { 0 };
-    uint f2[256] = { 0 };
-    uint8 prv = 0;
     const uint8* data = reinterpret_cast<const uint8*>(&block[0]);
-    const int count4 = count & -4;
-    bool res = true;
+    const int minSum = count / 4; // ad-hoc threshold
+    const int maxPrimary = count - minSum;
+    int sum = 0; // number of non-primary bytes
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i vC0 = _mm_set1_epi8(char(0xC0));
+    const __m128i vFE = _mm_set1_epi8(char(0xFE));
+    const __m128i vF5 = _mm_set1_epi8(char(0xF5));
+    const __m128i v80 = _mm_set1_epi8(char(0x80));
+    const __m128i v90 = _mm_set1_epi8(char(0x90));
+    const __m128i v9F = _mm_set1_epi8(char(0x9F));
+    const __m128i vA0 = _mm_set1_epi8(char(0xA0));
+    const __m128i vBF = _mm_set1_epi8(char(0xBF));
+    const __m128i vE0 = _mm_set1_epi8(char(0xE0));
+    const __m128i vED = _mm_set1_epi8(char(0xED));
+    const __m128i vF0 = _mm_set1_epi8(char(0xF0));
+    const __m128i vF4 = _mm_set1_epi8(char(0xF4));
+
+    for (; i + 17 <= count; i += 16) {
+        const __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i]));
+
+        // C0, C1 or F5..FF
+        __m128i bad = _mm_or_si128(_mm_cmpeq_epi8(_mm_and_si128(cur, vFE), vC0),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(cur, vF5), cur));
+        const __m128i lE0 = _mm_cmpeq_epi8(cur, vE0);
+        const __m128i lED = _mm_cmpeq_epi8(cur, vED);
+        const __m128i lF0 = _mm_cmpeq_epi8(cur, vF0);
+        const __m128i lF4 = _mm_cmpeq_epi8(cur, vF4);
+        const __m128i leads = _mm_or_si128(_mm_or_si128(lE0, lED), _mm_or_si128(lF0, lF4));
+
+        if (_mm_movemask_epi8(leads) != 0) {
+            const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i + 1]));
+            bad = _mm_or_si128(bad, _mm_andnot_si128(inRange(next, vA0, vBF), lE0));
+            bad = _mm_or_si128(bad, _mm_andnot_si128(inRange(next, v80, v9F), lED));
+            bad = _mm_or_si128(bad, _mm_andnot_si128(inRange(next, v90, vBF), lF0));
+            bad = _mm_or_si128(bad, _mm_andnot_si128(inRange(next, v80, vBF), lF4));
+        }
 
-    // Unroll loop
-    for (int i = 0; i < count4; i += 4) {
-        const uint8 cur0 = data[i];
-        const uint8 cur1 = data[i + 1];
-        const uint8 cur2 = data[i + 2];
-        const uint8 cur3 = data[i + 3];
-        f0[cur0]++;
-        f1[cur1]++;
-        f2[cur2]++;
-        f3[cur3]++;
-        freqs1[(prv * 256) + cur0]++;
-        freqs1[(cur0 * 256) + cur1]++;
-        freqs1[(cur1 * 256) + cur2]++;
-        freqs1[(cur2 * 256) + cur3]++;
-        prv = cur3;
-    }
+        if (_mm_movemask_epi8(bad) != 0)
+            return false;
 
-    for (int i = count4; i < count; i++) {
-        freqs0[data[i]]++;
-        freqs1[(prv * 256) + data[i]]++;
-        prv = data[i];
-    }
+        // Count non-primary bytes (80..BF)
+        const __m128i cont = _mm_cmpeq_epi8(_mm_and_si128(cur, vC0), v80);
+        sum += popcount(uint(_mm_movemask_epi8(cont)));
 
-    for (int i = 0; i < 256; i++) {
-        freqs0[i] += (f0[i] + f1[i] + f2[i] + f3[i]);
+        if (i + 16 - sum > maxPrimary)
+            return false;
     }
+#endif
 
-    int sum = 0;
-
-    // Check UTF-8
-    // See Unicode 14 Standard - UTF-8 Table 3.7
-    // U+0000..U+007F          00..7F
-    // U+0080..U+07FF          C2..DF 80..BF
-    // U+0800..U+0FFF          E0 A0..BF 80..BF
-    // U+1000..U+CFFF          E1..EC 80..BF 80..BF
-    // U+D000..U+D7FF          ED 80..9F 80..BF 80..BF
-    // U+E000..U+FFFF          EE..EF 80..BF 80..BF
-    // U+10000..U+3FFFF        F0 90..BF 80..BF 80..BF
-    // U+40000..U+FFFFF        F1..F3 80..BF 80..BF 80..BF
-    // U+100000..U+10FFFF      F4 80..8F 80..BF 80..BF
-    if ((freqs0[0xC0] > 0) || (freqs0[0xC1] > 0)) {
-        res = false;
-        goto end;
-    }
+    for (; i < count; i++) {
+        const uint8 cur = data[i];
 
-    for (int i = 0xF5; i <= 0xFF; i++) {
-        if (freqs0[i] > 0) {
-            res = false;
-            goto end;
-        }
-    }
+        if ((cur == 0xC0) || (cur == 0xC1) || (cur >= 0xF5))
+            return false;
 
-    for (int i = 0; i < 256; i++) {
-        // Exclude < 0xE0A0 || > 0xE0BF
-        if (((i < 0xA0) || (i > 0xBF)) && (freqs1[(0xE0 * 256) + i] > 0)) {
-            res = false;
-            goto end;
-        }
+        if ((cur & 0xC0) == 0x80)
+            sum++;
 
-        // Exclude < 0xED80 || > 0xEDE9F
-        if (((i < 0x80) || (i > 0x9F)) && (freqs1[(0xED * 256) + i] > 0)) {
-            res = false;
-            goto end;
-        }
+        if (i + 1 >= count)
+            break;
 
-        // Exclude < 0xF090 || > 0xF0BF
-        if (((i < 0x90) || (i > 0xBF)) && (freqs1[(0xF0 * 256) + i] > 0)) {
-            res = false;
-            goto end;
-        }
+        const uint8 next = data[i + 1];
 
-        // Exclude < 0xF480 || > 0xF4BF
-        if (((i < 0x80) || (i > 0xBF)) && (freqs1[(0xF4 * 256) + i] > 0)) {
-            res = false;
-            goto end;
-        }
+        switch (cur) {
+        case 0xE0:
+            // Exclude < 0xE0A0 || > 0xE0BF
+            if ((next < 0xA0) || (next > 0xBF))
+                return false;
 
-        // Count non-primary bytes
-        if ((i >= 0x80) && (i <= 0xBF))
-            sum += freqs0[i];
-    }
+            break;
+
+        case 0xED:
+            // Exclude < 0xED80 || > 0xED9F
+            if ((next < 0x80) || (next > 0x9F))
+                return false;
+
+            break;
+
+        case 0xF0:
+            // Exclude < 0xF090 || > 0xF0BF
+            if ((next < 0x90) || (next > 0xBF))
+                return false;
+
+            break;
+
+        case 0xF4:
+            // Exclude < 0xF480 || > 0xF4BF
+            if ((next < 0x80) || (next > 0xBF))
+                return false;
+
+            break;
 
-end:
-    delete[] freqs1;
+        default:
+            break;
+        }
+    }
 
-    // Ad-hoc threshold
-    return (res == true) && (sum >= (count / 4));
+    return sum >= minSum;
 }
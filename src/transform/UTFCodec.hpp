@@ -18,6 +18,7 @@ limitations under the License.
 #define _UTFCodec_
 
 #include "../Context.hpp"
+#include "../Global.hpp"
 #include "../Transform.hpp"
 
 
@@ -61,12 +62,36 @@ namespace kanzi
        
         static bool validate(const byte src[], int count);
 
+        static int skipASCII(const byte src[], int srcIdx, int srcEnd);
+
         static int pack(const byte in[], uint32& out);
 
         static int unpack(uint32 in, byte out[]);
    };
 
 
+    // Return the index of the first non ASCII byte at or after srcIdx (or srcEnd)
+    inline int UTFCodec::skipASCII(const byte src[], int srcIdx, int srcEnd)
+    {
+#if defined(__SSE2__)
+       while (srcIdx + 16 <= srcEnd) {
+           const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[srcIdx]));
+           const int mask = _mm_movemask_epi8(v);
+
+           if (mask != 0)
+              return srcIdx + Global::trailingZeros(uint(mask));
+
+           srcIdx += 16;
+       }
+#endif
+
+       while ((srcIdx < srcEnd) && (src[srcIdx] < byte(0x80)))
+           srcIdx++;
+
+       return srcIdx;
+    }
+
+
     inline int UTFCodec::pack(const byte in[], uint32& out)
     {   
        int s;
@@ -16,6 +16,7 @@ limitations under the License.
 #include <cstring>
 #include <stddef.h>
 #include "../Global.hpp"
+#include "../Memory.hpp"
 #include "ZRLT.hpp"
 
 using namespace kanzi;
@@ -42,18 +43,27 @@ bool ZRLT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int length
     const int srcEnd = length;
     const int dstEnd = length; // do not expand
     bool res = true;
-    byte zeros[4] = { byte(0) };
 
     while (srcIdx < srcEnd) {
-        if (src[srcIdx] == byte(0)) {
-            int runLength = 1;
-
-            while ((srcIdx + runLength + 4 < srcEnd) && (memcmp(&src[srcIdx + runLength], &zeros[0], 4) == 0))
-                runLength += 4;
-
-            while ((srcIdx + runLength < srcEnd) && src[srcIdx + runLength] == byte(0))
-                runLength++;
+#if defined(__SSE2__)
+        if ((srcIdx + 16 <= srcEnd) && (dstIdx + 16 <= dstEnd)) {
+            // Fast path: block of literals in [1..0xFD], emitted as val + 1
+            const __m128i x = _mm_loadu_si128((const __m128i*) &src[srcIdx]);
+            const __m128i t = _mm_sub_epi8(x, _mm_set1_epi8(1));
+            const __m128i lit = _mm_cmpeq_epi8(_mm_max_epu8(t, _mm_set1_epi8(char(0xFC))), _mm_set1_epi8(char(0xFC)));
+            const int n = Global::trailingZeros(~uint32(_mm_movemask_epi8(lit))); // leading literals
+
+            if (n != 0) {
+                _mm_storeu_si128((__m128i*) &dst[dstIdx], _mm_add_epi8(x, _mm_set1_epi8(1)));
+                srcIdx += n;
+                dstIdx += n;
+                continue;
+            }
+        }
+#endif
 
+        if (src[srcIdx] == byte(0)) {
+            int runLength = 1 + countRun(&src[srcIdx + 1], srcEnd - srcIdx - 1, byte(0));
             srcIdx += runLength;
 
             // Encode length
@@ -124,6 +134,27 @@ bool ZRLT::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int length
     int runLength = 0;
 
     while (true) {
+#if defined(__SSE2__)
+        if ((srcIdx + 16 <= srcEnd) && (dstIdx + 16 <= dstEnd)) {
+            // Fast path: block of literals in [2..0xFE], decoded as val - 1
+            const __m128i x = _mm_loadu_si128((const __m128i*) &src[srcIdx]);
+            const __m128i t = _mm_sub_epi8(x, _mm_set1_epi8(2));
+            const __m128i lit = _mm_cmpeq_epi8(_mm_max_epu8(t, _mm_set1_epi8(char(0xFC))), _mm_set1_epi8(char(0xFC)));
+            const int n = Global::trailingZeros(~uint32(_mm_movemask_epi8(lit))); // leading literals
+
+            if (n != 0) {
+                _mm_storeu_si128((__m128i*) &dst[dstIdx], _mm_sub_epi8(x, _mm_set1_epi8(1)));
+                srcIdx += n;
+                dstIdx += n;
+
+                if (srcIdx >= srcEnd)
+                    break;
+
+                continue;
+            }
+        }
+#endif
+
         int val = int(src[srcIdx]);
 
         if (val <= 1) {
@@ -51,6 +51,10 @@ limitations under the License.
       #include <pmmintrin.h>
    #endif
 
+   #ifdef __SSSE3__
+      #include <tmmintrin.h>
+   #endif
+
    #ifdef __SSE4_1__
        #include <smmintrin.h> 
    #endif